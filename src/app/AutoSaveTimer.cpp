@@ -39,6 +39,12 @@ QAutoSaveTimer::getAutoSaveInputDir()
     return QSettings().value(_key_autosave_inputdir, "").toString();
 }
 
+bool
+QAutoSaveTimer::isJournalEnabled()
+{
+    return QSettings().value(_key_autosave_journal, _key_autosave_journal_def).toBool();
+}
+
 void
 QAutoSaveTimer::autoSaveProject()
 {
@@ -51,6 +57,8 @@ QAutoSaveTimer::autoSaveProject()
     if (m_MW->numImages() != 0) {
         if (m_MW->projectFile().isEmpty()) {
             m_MW->saveProjectWithFeedback(unnamed_autosave_projectFile);
+        } else if (isJournalEnabled() && m_MW->saveProjectJournal()) {
+            // Only the changes were written, next to the project file.
         } else {
             QString const project_filename = m_MW->projectFile();
             QFileInfo const project_file(project_filename);
@@ -66,6 +74,7 @@ QAutoSaveTimer::autoSaveProject()
                 }
                 if (copyFileTo(file_as_path, project_filename)) {
                     QFile::remove(file_as_path);
+                    m_MW->startProjectJournal();
                 }
                 //QFile::remove(project_filename+".bak");
             }
@@ -18,6 +18,7 @@ public slots:
 private:
     bool copyFileTo(const QString& sFromPath, const QString& sToPath);
     const QString getAutoSaveInputDir();
+    bool isJournalEnabled();
 private:
     MainWindow* m_MW;
 };
@@ -44,6 +44,7 @@
 #include "BasicImageView.h"
 #include "ProjectWriter.h"
 #include "ProjectReader.h"
+#include "ProjectJournal.h"
 #include "ThumbnailPixmapCache.h"
 #include "ThumbnailFactory.h"
 #include "ContentBoxPropagator.h"
@@ -84,6 +85,9 @@
 #include "filters/output/Task.h"
 #include "filters/output/CacheDrivenTask.h"
 #include "LoadFileTask.h"
+#include "ProcessingContext.h"
+#include "TiffReader.h"
+#include "imageproc/ImageArena.h"
 #include "CompositeCacheDrivenTask.h"
 #include "ScopedIncDec.h"
 #include "ui_AboutDialog.h"
@@ -110,6 +114,7 @@
 #include <QCheckBox>
 #include <QFileInfo>
 #include <QFile>
+#include <QBuffer>
 #include <QDir>
 #include <QString>
 #include <QByteArray>
@@ -142,6 +147,7 @@
 MainWindow::MainWindow()
     :   m_ptrPages(new ProjectPages),
         m_ptrStages(new StageSequence(m_ptrPages, newPageSelectionAccessor())),
+        m_ptrJournal(new ProjectJournal),
         m_ptrWorkerThread(new WorkerThread),
         m_ptrInteractiveQueue(new ProcessingTaskQueue(ProcessingTaskQueue::RANDOM_ORDER)),
         m_curFilter(0),
@@ -438,10 +444,14 @@ MainWindow::switchToNewProject(
     stopBatchProcessing(CLEAR_MAIN_AREA);
     m_ptrInteractiveQueue->cancelAndClear();
 
+    // Don't keep the previous project's input files open.
+    TiffReader::closeCachedFiles();
+
     Utils::maybeCreateCacheDir(out_dir);
 
     m_ptrPages = pages;
     m_projectFile = project_file_path;
+    m_ptrJournal.reset(new ProjectJournal);
 
     if (project_reader) {
         m_selectedPage = project_reader->selectedPage();
@@ -764,10 +774,11 @@ MainWindow::promptProjectSave()
 }
 
 bool
-MainWindow::compareFiles(QString const& fpath1, QString const& fpath2)
+MainWindow::compareFiles(QByteArray const& data1, QString const& fpath2)
 {
     // rough comparision as order of elements in XML may vary
-    QFile file1(fpath1);
+    QBuffer file1;
+    file1.setData(data1);
     QFile file2(fpath2);
 
     if (!file1.open(QIODevice::ReadOnly)) {
@@ -777,7 +788,7 @@ MainWindow::compareFiles(QString const& fpath1, QString const& fpath2)
         return false;
     }
 
-    if (!file1.isSequential() && !file2.isSequential()) {
+    if (!file2.isSequential()) {
         if (file1.size() != file2.size()) {
             return false;
         }
@@ -1627,6 +1638,9 @@ MainWindow::stopBatchProcessing(MainAreaAction main_area)
     m_ptrBatchQueue->cancelAndClear();
     m_ptrBatchQueue.reset();
 
+    // Pooled page buffers are of no use until the next batch.
+    imageproc::ImageArena::trim();
+
     filterList->setBatchProcessingInProgress(false);
     filterList->setEnabled(true);
 
@@ -1773,6 +1787,7 @@ MainWindow::saveProjectTriggered()
 
     pauseAutoSaveTimer();
     if (saveProjectWithFeedback(m_projectFile)) {
+        startProjectJournal();
         updateWindowTitle();
     }
     resumeAutoSaveTimer();
@@ -1809,6 +1824,7 @@ MainWindow::saveProjectAsTriggered()
 
     if (saveProjectWithFeedback(project_file)) {
         m_projectFile = project_file;
+        startProjectJournal();
         updateWindowTitle();
 
         QSettings settings;
@@ -1896,8 +1912,15 @@ MainWindow::openProject(QString const& project_file)
         return;
     }
 
-    QDomDocument doc;
-    if (!doc.setContent(&file)) {
+    QByteArray data(file.readAll());
+    file.close();
+
+    // Bring in the changes autosave has journaled.
+    ProjectJournal::replay(project_file, data);
+
+    ProjectOpeningContext* context = new ProjectOpeningContext(this, project_file, data);
+    if (!context->projectReader()->success()) {
+        delete context;
         QMessageBox::warning(
             this, tr("Error"),
             tr("The project file is broken.")
@@ -1905,10 +1928,6 @@ MainWindow::openProject(QString const& project_file)
         resumeAutoSaveTimer();
         return;
     }
-
-    file.close();
-
-    ProjectOpeningContext* context = new ProjectOpeningContext(this, project_file, doc);
     connect(context, SIGNAL(done(ProjectOpeningContext*)), SLOT(projectOpened(ProjectOpeningContext*)));
     context->proceed();
 }
@@ -2154,7 +2173,8 @@ MainWindow::exportRequestedReprocessing(const PageId& page_id, QImage* fore_subs
     BackgroundTaskPtr task = BackgroundTaskPtr(
                 new LoadFileTask(
                     BackgroundTask::INTERACTIVE,
-                    page_info, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+                    page_info, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+                    ProcessingContext::create(CommandLine::get())
                     )
                 );
 
@@ -2314,7 +2334,7 @@ bool
 MainWindow::checkReadyForOutput(PageId const* ignore) const
 {
     return m_ptrStages->pageLayoutFilter()->checkReadyForOutput(
-               *m_ptrPages, ignore
+               *m_ptrPages, *ProcessingContext::create(CommandLine::get()), ignore
            );
 }
 
@@ -2436,7 +2456,18 @@ MainWindow::closeProjectInteractive()
         return true;
     }
 
-    if (compareFiles(m_projectFile, backup_file_path)) {
+    // The project as opening it would load it, which includes
+    // the changes autosave has journaled.
+    QByteArray saved_data;
+    {
+        QFile file(m_projectFile);
+        if (file.open(QIODevice::ReadOnly)) {
+            saved_data = file.readAll();
+        }
+    }
+    ProjectJournal::replay(m_projectFile, saved_data);
+
+    if (compareFiles(saved_data, backup_file_path)) {
         // The project hasn't really changed.
         QFile::remove(backup_file_path);
         closeProjectWithoutSaving();
@@ -2445,6 +2476,7 @@ MainWindow::closeProjectInteractive()
 
     switch (promptProjectSave()) {
     case SAVE:
+        m_ptrJournal->stop();
         if (!Utils::overwritingRename(
                     backup_file_path, m_projectFile)) {
             QMessageBox::warning(
@@ -2453,8 +2485,14 @@ MainWindow::closeProjectInteractive()
             );
             return false;
         }
-    // fall through
+        ProjectJournal::remove(m_projectFile);
+        QFile::remove(backup_file_path);
+        break;
     case DONT_SAVE:
+        // Otherwise the changes autosave has journaled would
+        // come back the next time the project is opened.
+        m_ptrJournal->stop();
+        ProjectJournal::remove(m_projectFile);
         QFile::remove(backup_file_path);
         break;
     case CANCEL:
@@ -2481,6 +2519,8 @@ MainWindow::saveProjectWithFeedback(QString const& project_file)
         sb->showMessage(tr("Saving project..."), 1000);
     }
 
+    m_ptrJournal->beginFullSave(m_ptrStages->filters());
+
     if (!writer.write(project_file, m_ptrStages->filters())) {
         QMessageBox::warning(
             this, tr("Error"),
@@ -2492,6 +2532,29 @@ MainWindow::saveProjectWithFeedback(QString const& project_file)
     return true;
 }
 
+bool
+MainWindow::saveProjectJournal()
+{
+    if (m_projectFile.isEmpty()) {
+        return false;
+    }
+
+    ProjectWriter writer(m_ptrPages, m_selectedPage, m_outFileNameGen);
+    return m_ptrJournal->append(m_projectFile, writer, m_ptrStages->filters());
+}
+
+void
+MainWindow::startProjectJournal()
+{
+    if (QSettings().value(_key_autosave_journal, _key_autosave_journal_def).toBool()) {
+        ProjectWriter writer(m_ptrPages, m_selectedPage, m_outFileNameGen);
+        m_ptrJournal->start(m_projectFile, writer);
+    } else {
+        // The project file has all the journaled changes now.
+        ProjectJournal::remove(m_projectFile);
+    }
+}
+
 /**
  * Note: showInsertFileDialog(BEFORE, ImageId()) is legal and means inserting at the end.
  */
@@ -2946,7 +3009,8 @@ MainWindow::createCompositeTask(
     return BackgroundTaskPtr(
                new LoadFileTask(
                    batch ? BackgroundTask::BATCH : BackgroundTask::INTERACTIVE,
-                   page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+                   page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+                   ProcessingContext::create(CommandLine::get())
                )
            );
 }
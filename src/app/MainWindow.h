@@ -72,6 +72,7 @@ class PageInfo;
 class QStackedLayout;
 class WorkerThread;
 class ProjectReader;
+class ProjectJournal;
 class DebugImages;
 class ContentBoxPropagator;
 class PageOrientationPropagator;
@@ -122,6 +123,17 @@ public:
         return m_projectFile;
     }
     bool saveProjectWithFeedback(QString const& project_file);
+
+    /**
+     * Appends the changes made since the last save to the project journal.
+     * Returns false if the project has to be saved in full instead.
+     */
+    bool saveProjectJournal();
+
+    /**
+     * To be called once the project file got saved in full.
+     */
+    void startProjectJournal();
     // AutoSave Timer / end
 
 public slots:
@@ -283,7 +295,7 @@ private:
 
     SavePromptResult promptProjectSave();
 
-    static bool compareFiles(QString const& fpath1, QString const& fpath2);
+    static bool compareFiles(QByteArray const& data1, QString const& fpath2);
 
     IntrusivePtr<PageOrderProvider const> currentPageOrderProvider() const;
 
@@ -385,6 +397,7 @@ private:
     IntrusivePtr<ProjectPages> m_ptrPages;
     IntrusivePtr<StageSequence> m_ptrStages;
     QString m_projectFile;
+    std::unique_ptr<ProjectJournal> m_ptrJournal;
     OutputFileNameGenerator m_outFileNameGen;
     IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
     std::unique_ptr<ThumbnailSequence> m_ptrThumbSequence;
@@ -27,9 +27,9 @@
 #include <assert.h>
 
 ProjectOpeningContext::ProjectOpeningContext(
-    QWidget* parent, QString const& project_file, QDomDocument const& doc)
+    QWidget* parent, QString const& project_file, QByteArray const& data)
     :   m_projectFile(project_file),
-        m_reader(doc),
+        m_reader(data),
         m_pParent(parent)
 {
 }
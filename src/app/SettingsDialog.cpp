@@ -514,6 +514,7 @@ void SettingsDialog::on_stackedWidget_currentChanged(int /*arg1*/)
         ui.useHorizontalPredictor->setChecked(m_settings.value(_key_tiff_compr_horiz_pred, _key_tiff_compr_horiz_pred_def).toBool());
     } else if (currentPage == ui.pageAutoSaveProject) {
         ui.sbSavePeriod->setValue(abs(m_settings.value(_key_autosave_time_period_min, _key_autosave_time_period_min_def).toInt()));
+        ui.cbAutoSaveJournal->setChecked(m_settings.value(_key_autosave_journal, _key_autosave_journal_def).toBool());
     } else if (currentPage == ui.pageOutput) {
         ui.dpiDefaultXValue->setValue(m_settings.value(_key_output_default_dpi_x, _key_output_default_dpi_x_def).toUInt());
         ui.dpiDefaultYValue->setValue(m_settings.value(_key_output_default_dpi_y, _key_output_default_dpi_y_def).toUInt());
@@ -691,6 +692,11 @@ void SettingsDialog::on_sbSavePeriod_valueChanged(int arg1)
     m_settings.setValue(_key_autosave_time_period_min, arg1);
 }
 
+void SettingsDialog::on_cbAutoSaveJournal_clicked(bool checked)
+{
+    m_settings.setValue(_key_autosave_journal, checked);
+}
+
 void SettingsDialog::onThresholdValueChanged(int)
 {
     int min = ui.ThresholdMinValue->value();
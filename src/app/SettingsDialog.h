@@ -55,6 +55,8 @@ private slots:
 
     void on_sbSavePeriod_valueChanged(int arg1);
 
+    void on_cbAutoSaveJournal_clicked(bool checked);
+
     void onThresholdValueChanged(int);
 
     void on_despecklingDefaultsValue_currentIndexChanged(int index);
@@ -39,6 +39,7 @@
 #include <string.h>
 
 #include "CommandLine.h"
+#include "imageproc/ImageArena.h"
 
 int main(int argc, char** argv)
 {
@@ -71,6 +72,8 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    imageproc::ImageArena::removeStaleBackingFiles();
+
     QSettings settings;
     GlobalStaticSettings::applyAppStyle(settings);
 
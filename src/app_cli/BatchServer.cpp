@@ -0,0 +1,404 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BatchServer.h"
+#include "ConsoleBatch.h"
+#include "imageproc/ImageArena.h"
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QFileSystemWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QEvent>
+#include <QRunnable>
+#include <memory>
+#include <stdexcept>
+#include <iostream>
+
+class BatchServer::Job : public QRunnable
+{
+public:
+    Job(BatchServer& server, QString const& id, QStringList const& args);
+
+    virtual void run();
+private:
+    void post(QJsonObject const& status);
+
+    BatchServer& m_rServer;
+    QString m_id;
+    QStringList m_args;
+};
+
+class BatchServer::JobEvent : public QEvent
+{
+public:
+    JobEvent(QString const& id, QJsonObject const& status);
+
+    QString const& id() const
+    {
+        return m_id;
+    }
+
+    QJsonObject const& status() const
+    {
+        return m_status;
+    }
+private:
+    QString m_id;
+    QJsonObject m_status;
+};
+
+/*=============================== BatchServer ===============================*/
+
+BatchServer::BatchServer(CommandLine const& cli, QObject* parent)
+    :   QObject(parent),
+        m_cli(cli),
+        m_pServer(0),
+        m_pSpoolWatcher(0),
+        m_lastJobNo(0)
+{
+    m_pool.setMaxThreadCount(m_cli.getMaxJobs());
+}
+
+BatchServer::~BatchServer()
+{
+    // Jobs post events to us, so they have to be gone first.
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool
+BatchServer::start()
+{
+    bool started = false;
+
+    if (m_cli.hasDaemonSocket()) {
+        QString const name(m_cli.getDaemonSocket());
+        m_pServer = new QLocalServer(this);
+        bool listening = m_pServer->listen(name);
+        if (!listening && m_pServer->serverError() == QAbstractSocket::AddressInUseError) {
+            // Probably left behind by a daemon that didn't exit cleanly.
+            QLocalServer::removeServer(name);
+            listening = m_pServer->listen(name);
+        }
+
+        if (listening) {
+            connect(m_pServer, SIGNAL(newConnection()), SLOT(acceptConnections()));
+            started = true;
+        } else {
+            std::cerr << "Unable to listen on " << name.toLocal8Bit().constData()
+                      << ": " << m_pServer->errorString().toLocal8Bit().constData() << std::endl;
+        }
+    }
+
+    if (m_cli.hasSpoolDirectory()) {
+        QString const dir(m_cli.getSpoolDirectory());
+        if (QFileInfo(dir).isDir()) {
+            m_pSpoolWatcher = new QFileSystemWatcher(QStringList(dir), this);
+            connect(
+                m_pSpoolWatcher, SIGNAL(directoryChanged(QString const&)),
+                SLOT(scanSpoolDirectory())
+            );
+            scanSpoolDirectory();
+            started = true;
+        } else {
+            std::cerr << "Spool directory " << dir.toLocal8Bit().constData()
+                      << " doesn't exist" << std::endl;
+        }
+    }
+
+    return started;
+}
+
+void
+BatchServer::acceptConnections()
+{
+    while (QLocalSocket* socket = m_pServer->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), SLOT(readRequests()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void
+BatchServer::readRequests()
+{
+    QLocalSocket* const socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    while (socket->canReadLine()) {
+        QByteArray const line(socket->readLine().trimmed());
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError error;
+        QJsonDocument const request(QJsonDocument::fromJson(line, &error));
+        if (!request.isObject()) {
+            JobState job;
+            job.socket = socket;
+            QJsonObject status;
+            status["state"] = QString("failed");
+            status["error"] = error.error != QJsonParseError::NoError
+                              ? error.errorString() : QString("A job has to be a JSON object.");
+            report(job, QString(), status);
+            continue;
+        }
+
+        submit(request.object(), socket, QString());
+    }
+}
+
+void
+BatchServer::scanSpoolDirectory()
+{
+    QDir const dir(m_cli.getSpoolDirectory());
+    QStringList const job_files(
+        dir.entryList(QStringList("*.job"), QDir::Files, QDir::Name)
+    );
+
+    for (QString const& job_file : job_files) {
+        QString const base(dir.filePath(QFileInfo(job_file).completeBaseName()));
+        QString const running_file(base + ".running");
+
+        // Renaming claims the job, even if several daemons share the directory.
+        if (!QFile::rename(dir.filePath(job_file), running_file)) {
+            continue;
+        }
+
+        QFile file(running_file);
+        QJsonObject request;
+        if (file.open(QIODevice::ReadOnly)) {
+            request = QJsonDocument::fromJson(file.readAll()).object();
+            file.close();
+        }
+        if (!request.contains("id")) {
+            request["id"] = QFileInfo(base).fileName();
+        }
+
+        submit(request, 0, running_file);
+    }
+}
+
+void
+BatchServer::submit(
+    QJsonObject const& request, QLocalSocket* socket, QString const& spool_file)
+{
+    JobState job;
+    job.socket = socket;
+    job.spoolFile = spool_file;
+
+    QString id(request.value("id").toString());
+    if (id.isEmpty()) {
+        id = QString("job-%1").arg(++m_lastJobNo);
+    }
+
+    QStringList args;
+    for (QJsonValue const& arg : request.value("args").toArray()) {
+        args.push_back(arg.toString());
+    }
+
+    QString error(checkArguments(args));
+    if (error.isEmpty() && m_jobs.contains(id)) {
+        error = "A job with this id is already queued or running.";
+    }
+    if (!error.isEmpty()) {
+        QJsonObject status;
+        status["state"] = QString("failed");
+        status["error"] = error;
+        report(job, id, status);
+        return;
+    }
+
+    m_jobs.insert(id, job);
+
+    QJsonObject status;
+    status["state"] = QString("queued");
+    report(job, id, status);
+
+    m_pool.start(new Job(*this, id, args));
+}
+
+void
+BatchServer::customEvent(QEvent* event)
+{
+    JobEvent* const job_event = dynamic_cast<JobEvent*>(event);
+    if (!job_event) {
+        return;
+    }
+
+    QMap<QString, JobState>::iterator const it(m_jobs.find(job_event->id()));
+    if (it == m_jobs.end()) {
+        return;
+    }
+
+    JobState const job(it.value());
+    QString const state(job_event->status().value("state").toString());
+    if (state == "done" || state == "failed") {
+        m_jobs.erase(it);
+        if (m_jobs.isEmpty()) {
+            // Jobs share the pool of page buffers, so it's only
+            // released once there are no more jobs to reuse it.
+            imageproc::ImageArena::trim();
+        }
+    }
+
+    report(job, job_event->id(), job_event->status());
+}
+
+void
+BatchServer::report(JobState const& job, QString const& id, QJsonObject status)
+{
+    if (!id.isEmpty()) {
+        status["id"] = id;
+    }
+    QByteArray const line(QJsonDocument(status).toJson(QJsonDocument::Compact) + '\n');
+
+    if (job.socket && job.socket->state() == QLocalSocket::ConnectedState) {
+        job.socket->write(line);
+    }
+
+    if (!job.spoolFile.isEmpty()) {
+        QFileInfo const running(job.spoolFile);
+        QString const base(running.dir().filePath(running.completeBaseName()));
+
+        QSaveFile status_file(base + ".status");
+        if (status_file.open(QIODevice::WriteOnly)) {
+            status_file.write(line);
+            status_file.commit();
+        }
+
+        QString const state(status.value("state").toString());
+        if (state == "done" || state == "failed") {
+            QFile::remove(base + "." + state);
+            QFile::rename(job.spoolFile, base + "." + state);
+        }
+    }
+
+    if (m_cli.isVerbose()) {
+        std::cout << line.constData() << std::flush;
+    }
+}
+
+QString
+BatchServer::checkArguments(QStringList const& args)
+{
+    if (args.isEmpty()) {
+        return "No arguments given.";
+    }
+
+    for (QString const& arg : args) {
+        if (arg == "-") {
+            return "Reading file names from stdin is not supported in jobs.";
+        }
+    }
+
+    // CommandLine exits on a bad output directory, so check it here.
+    QString const& last(args.back());
+    if (!last.startsWith("-")
+            && !last.endsWith(".ScanTailor", Qt::CaseInsensitive)
+            && !QFileInfo(last).isDir()) {
+        return "The last argument has to be an existing output directory or a project file.";
+    }
+
+    // Malformed option values are only reported through isError().
+    QStringList argv(args);
+    argv.prepend(QCoreApplication::applicationFilePath());
+    if (CommandLine(argv, false).isError()) {
+        return "Invalid arguments.";
+    }
+
+    return QString();
+}
+
+/*============================ BatchServer::Job ============================*/
+
+BatchServer::Job::Job(BatchServer& server, QString const& id, QStringList const& args)
+    :   m_rServer(server),
+        m_id(id),
+        m_args(args)
+{
+}
+
+void
+BatchServer::Job::run()
+{
+    QJsonObject status;
+
+    try {
+        QStringList argv(m_args);
+        argv.prepend(QCoreApplication::applicationFilePath());
+        CommandLine const cli(argv, false);
+        if (cli.isError()) {
+            throw std::runtime_error("Invalid arguments.");
+        }
+
+        std::unique_ptr<ConsoleBatch> batch;
+        if (!cli.projectFile().isEmpty()) {
+            batch.reset(new ConsoleBatch(cli, cli.projectFile()));
+        } else if (!cli.images().empty() && !cli.outputDirectory().isEmpty()) {
+            batch.reset(new ConsoleBatch(cli, cli.images(), cli.outputDirectory(), cli.getLayoutDirection()));
+        } else {
+            throw std::runtime_error("Either input images and an output directory or a project file are required.");
+        }
+
+        batch->process(
+            [this](int filter_idx, int page_no, int num_pages) {
+                QJsonObject progress;
+                progress["state"] = QString("running");
+                progress["filter"] = filter_idx + 1;
+                progress["page"] = page_no + 1;
+                progress["pages"] = num_pages;
+                post(progress);
+            }
+        );
+
+        if (cli.hasOutputProject()) {
+            batch->saveProject(cli.outputProjectFile());
+        }
+
+        status["state"] = QString("done");
+    } catch (std::exception const& e) {
+        status["state"] = QString("failed");
+        status["error"] = QString::fromLocal8Bit(e.what());
+    }
+
+    post(status);
+}
+
+void
+BatchServer::Job::post(QJsonObject const& status)
+{
+    QCoreApplication::postEvent(&m_rServer, new JobEvent(m_id, status));
+}
+
+/*========================== BatchServer::JobEvent ==========================*/
+
+BatchServer::JobEvent::JobEvent(QString const& id, QJsonObject const& status)
+    :   QEvent(QEvent::User),
+        m_id(id),
+        m_status(status)
+{
+}
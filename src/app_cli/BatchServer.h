@@ -0,0 +1,103 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCHSERVER_H_
+#define BATCHSERVER_H_
+
+#include "NonCopyable.h"
+#include "CommandLine.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QPointer>
+#include <QMap>
+
+class QLocalServer;
+class QLocalSocket;
+class QFileSystemWatcher;
+class QJsonObject;
+class QEvent;
+
+/**
+ * \brief Keeps running and processes batch jobs, several at a time.
+ *
+ * A job is a JSON object:
+ * \code
+ * {"id": "book-42", "args": ["--color-mode=black_and_white", "in/", "out/"]}
+ * \endcode
+ * where "args" are the scantailor-cli arguments for a single batch, that is
+ * either input images and an output directory, or a project file.
+ * Each job gets its own project, filters and settings, so jobs don't
+ * affect each other.
+ *
+ * Jobs may be submitted in two ways:
+ * \li One per line to the local socket given with --daemon.  Progress of
+ *     the jobs is reported back over the same connection, as JSON lines.
+ * \li As *.job files in the directory given with --spool-dir.  A job file
+ *     is renamed to *.running while being processed and to *.done or
+ *     *.failed afterwards.  Its progress is kept in a *.status file.
+ */
+class BatchServer : public QObject
+{
+    Q_OBJECT
+    DECLARE_NON_COPYABLE(BatchServer)
+public:
+    BatchServer(CommandLine const& cli, QObject* parent = 0);
+
+    virtual ~BatchServer();
+
+    /**
+     * \brief Starts listening for jobs.
+     *
+     * \return false if neither the socket nor the spool directory
+     *         could be set up.  The reason is printed to stderr.
+     */
+    bool start();
+protected:
+    virtual void customEvent(QEvent* event);
+private slots:
+    void acceptConnections();
+
+    void readRequests();
+
+    void scanSpoolDirectory();
+private:
+    class Job;
+    class JobEvent;
+
+    struct JobState {
+        QPointer<QLocalSocket> socket;
+        QString spoolFile;
+    };
+
+    void submit(QJsonObject const& request, QLocalSocket* socket, QString const& spool_file);
+
+    void report(JobState const& job, QString const& id, QJsonObject status);
+
+    static QString checkArguments(QStringList const& args);
+
+    CommandLine m_cli;
+    QThreadPool m_pool;
+    QLocalServer* m_pServer;
+    QFileSystemWatcher* m_pSpoolWatcher;
+    QMap<QString, JobState> m_jobs;
+    int m_lastJobNo;
+};
+
+#endif
@@ -38,6 +38,7 @@
 #include "LoadFileTask.h"
 #include "ProjectWriter.h"
 #include "ProjectReader.h"
+#include "ProjectJournal.h"
 #include "OrthogonalRotation.h"
 #include "SelectedPage.h"
 
@@ -74,8 +75,9 @@
 #include "ConsoleBatch.h"
 #include "CommandLine.h"
 
-ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString const& output_directory, Qt::LayoutDirection const layout)
-    :   batch(true), debug(true),
+ConsoleBatch::ConsoleBatch(CommandLine const& cli, std::vector<ImageFileInfo> const& images, QString const& output_directory, Qt::LayoutDirection const layout)
+    :   m_cli(cli), m_ptrContext(ProcessingContext::create(cli)),
+        batch(true), debug(true),
         m_ptrDisambiguator(new FileNameDisambiguator),
         m_ptrPages(new ProjectPages(images, ProjectPages::AUTO_PAGES, layout))
 {
@@ -87,22 +89,24 @@ ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString con
     m_outFileNameGen = OutputFileNameGenerator(m_ptrDisambiguator, output_directory, m_ptrPages->layoutDirection());
 }
 
-ConsoleBatch::ConsoleBatch(QString const project_file)
-    :   batch(true), debug(true)
+ConsoleBatch::ConsoleBatch(CommandLine const& cli, QString const project_file)
+    :   m_cli(cli), m_ptrContext(ProcessingContext::create(cli)),
+        batch(true), debug(true)
 {
     QFile file(project_file);
     if (!file.open(QIODevice::ReadOnly)) {
         throw std::runtime_error("Unable to open the project file.");
     }
 
-    QDomDocument doc;
-    if (!doc.setContent(&file)) {
-        throw std::runtime_error("The project file is broken.");
-    }
-
+    QByteArray data(file.readAll());
     file.close();
 
-    m_ptrReader.reset(new ProjectReader(doc));
+    ProjectJournal::replay(project_file, data);
+
+    m_ptrReader.reset(new ProjectReader(data));
+    if (!m_ptrReader->success()) {
+        throw std::runtime_error("The project file is broken.");
+    }
     m_ptrPages = m_ptrReader->pages();
 
     PageSelectionAccessor const accessor((IntrusivePtr<PageSelectionProvider>())); // Won't be used anyway.
@@ -111,10 +115,9 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
     m_ptrStages = IntrusivePtr<StageSequence>(new StageSequence(m_ptrPages, accessor));
     m_ptrReader->readFilterSettings(m_ptrStages->filters());
 
-    CommandLine const& cli = CommandLine::get();
     QString output_directory = m_ptrReader->outputDirectory();
-    if (!cli.outputDirectory().isEmpty()) {
-        output_directory = cli.outputDirectory();
+    if (!m_cli.outputDirectory().isEmpty()) {
+        output_directory = m_cli.outputDirectory();
     }
 
     //m_ptrThumbnailCache = IntrusivePtr<ThumbnailPixmapCache>(new ThumbnailPixmapCache(output_directory+"/cache/thumbs", QSize(200,200), 40, 5));
@@ -179,21 +182,20 @@ ConsoleBatch::createCompositeTask(
     return BackgroundTaskPtr(
                new LoadFileTask(
                    BackgroundTask::BATCH,
-                   page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+                   page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+                   m_ptrContext
                )
            );
 }
 
 // process the image vector **images** and save output to **output_dir**
 void
-ConsoleBatch::process()
+ConsoleBatch::process(ProgressCallback const& progress)
 {
-    CommandLine const& cli = CommandLine::get();
-
     // get first filter id
     int startFilterIdx = m_ptrStages->fixOrientationFilterIdx();
-    if (cli.hasStartFilterIdx()) {
-        unsigned int sf = cli.getStartFilterIdx();
+    if (m_cli.hasStartFilterIdx()) {
+        unsigned int sf = m_cli.getStartFilterIdx();
         if (sf >= m_ptrStages->filters().size()) {
             throw std::runtime_error("Start filter out of range");
         }
@@ -202,8 +204,8 @@ ConsoleBatch::process()
 
     // get last filter id
     int endFilterIdx = m_ptrStages->outputFilterIdx();
-    if (cli.hasEndFilterIdx()) {
-        unsigned int ef = cli.getEndFilterIdx();
+    if (m_cli.hasEndFilterIdx()) {
+        unsigned int ef = m_cli.getEndFilterIdx();
         if (ef >= m_ptrStages->filters().size()) {
             throw std::runtime_error("End filter out of range");
         }
@@ -212,15 +214,20 @@ ConsoleBatch::process()
 
     // run filters
     for (int j = startFilterIdx; j <= endFilterIdx; j++) {
-        if (cli.isVerbose()) {
+        if (m_cli.isVerbose()) {
             std::cout << "Filter: " << (j + 1) << "\n";
         }
 
         // process pages
         PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
         setupFilter(j, page_sequence.asPageIdSet());
+        int page_no = 0;
         for (const PageInfo& page : page_sequence) {
-            if (cli.isVerbose()) {
+            if (progress) {
+                progress(j, page_no, static_cast<int>(page_sequence.numPages()));
+            }
+            ++page_no;
+            if (m_cli.isVerbose()) {
                 std::cout << "\tProcessing: " << page.imageId().filePath().toLocal8Bit().constData() << "\n";
             }
             BackgroundTaskPtr bgTask = createCompositeTask(page, j);
@@ -246,7 +253,10 @@ ConsoleBatch::saveProject(QString const project_file)
     PageInfo fpage = m_ptrPages->toPageSequence(PAGE_VIEW).pageAt(0);
     SelectedPage sPage(fpage.id(), IMAGE_VIEW);
     ProjectWriter writer(m_ptrPages, sPage, m_outFileNameGen);
-    writer.write(project_file, m_ptrStages->filters());
+    if (writer.write(project_file, m_ptrStages->filters())) {
+        // The journal doesn't belong to the new contents.
+        ProjectJournal::remove(project_file);
+    }
 }
 
 void
@@ -271,14 +281,13 @@ void
 ConsoleBatch::setupFixOrientation(std::set<PageId> allPages)
 {
     IntrusivePtr<fix_orientation::Filter> fix_orientation = m_ptrStages->fixOrientationFilter();
-    CommandLine const& cli = CommandLine::get();
 
     for (PageId const& page : allPages) {
 
         OrthogonalRotation rotation;
         // FIX ORIENTATION FILTER
-        if (cli.hasOrientation()) {
-            switch (cli.getOrientation()) {
+        if (m_cli.hasOrientation()) {
+            switch (m_cli.getOrientation()) {
             case CommandLine::LEFT:
                 rotation.prevClockwiseDirection();
                 break;
@@ -301,11 +310,10 @@ void
 ConsoleBatch::setupPageSplit(std::set<PageId> allPages)
 {
     IntrusivePtr<page_split::Filter> page_split = m_ptrStages->pageSplitFilter();
-    CommandLine const& cli = CommandLine::get();
 
     // PAGE SPLIT
-    if (cli.hasLayout()) {
-        page_split->getSettings()->setLayoutTypeForAllPages(cli.getLayout());
+    if (m_cli.hasLayout()) {
+        page_split->getSettings()->setLayoutTypeForAllPages(m_cli.getLayout());
     }
 }
 
@@ -313,16 +321,15 @@ void
 ConsoleBatch::setupDeskew(std::set<PageId> allPages)
 {
     IntrusivePtr<deskew::Filter> deskew = m_ptrStages->deskewFilter();
-    CommandLine const& cli = CommandLine::get();
 
     for (PageId const& page : allPages) {
 
         // DESKEW FILTER
         OrthogonalRotation rotation;
-        if (cli.hasDeskewAngle() || cli.hasDeskew()) {
+        if (m_cli.hasDeskewAngle() || m_cli.hasDeskew()) {
             double angle = 0.0;
-            if (cli.hasDeskewAngle()) {
-                angle = cli.getDeskewAngle();
+            if (m_cli.hasDeskewAngle()) {
+                angle = m_cli.getDeskewAngle();
             }
             deskew::Dependencies deps(QPolygonF(), rotation);
             deskew::Params params(angle, deps, MODE_MANUAL);
@@ -330,8 +337,8 @@ ConsoleBatch::setupDeskew(std::set<PageId> allPages)
         }
     }
 
-    if (cli.hasSkewDeviation()) {
-        deskew->getSettings()->setMaxDeviation(cli.getSkewDeviation());
+    if (m_cli.hasSkewDeviation()) {
+        deskew->getSettings()->setMaxDeviation(m_cli.getSkewDeviation());
     }
 }
 
@@ -339,7 +346,6 @@ void
 ConsoleBatch::setupSelectContent(std::set<PageId> allPages)
 {
     IntrusivePtr<select_content::Filter> select_content = m_ptrStages->selectContentFilter();
-    CommandLine const& cli = CommandLine::get();
 
     for (PageId const& page : allPages) {
         select_content::Dependencies deps;
@@ -352,33 +358,33 @@ ConsoleBatch::setupSelectContent(std::set<PageId> allPages)
         }
 
         // SELECT CONTENT FILTER
-        if (cli.hasContentRect()) {
-            params.setContentRect(cli.getContentRect());
+        if (m_cli.hasContentRect()) {
+            params.setContentRect(m_cli.getContentRect());
             //QRectF rect(cli.getContentRect());
             //QSizeF size_mm(rect.width(), rect.height());
             //select_content::Params params(rect, size_mm, deps, MODE_MANUAL);
         }
 
-        params.setContentDetect(cli.isContentDetectionEnabled());
-        params.setPageDetect(cli.isPageDetectionEnabled());
-        params.setFineTuneCorners(cli.isFineTuningEnabled());
-        if (cli.hasPageBorders()) {
-            params.setPageBorders(cli.getPageBorders());
+        params.setContentDetect(m_cli.isContentDetectionEnabled());
+        params.setPageDetect(m_cli.isPageDetectionEnabled());
+        params.setFineTuneCorners(m_cli.isFineTuningEnabled());
+        if (m_cli.hasPageBorders()) {
+            params.setPageBorders(m_cli.getPageBorders());
         }
 
         select_content->getSettings()->setPageParams(page, params);
     }
 
-    if (cli.hasContentDeviation()) {
-        select_content->getSettings()->setMaxDeviation(cli.getContentDeviation());
+    if (m_cli.hasContentDeviation()) {
+        select_content->getSettings()->setMaxDeviation(m_cli.getContentDeviation());
     }
 
-    if (cli.hasPageDetectionBox()) {
-        select_content->getSettings()->setPageDetectionBox(cli.getPageDetectionBox());
+    if (m_cli.hasPageDetectionBox()) {
+        select_content->getSettings()->setPageDetectionBox(m_cli.getPageDetectionBox());
     }
 
-    if (cli.hasPageDetectionTolerance()) {
-        select_content->getSettings()->setPageDetectionTolerance(cli.getPageDetectionTolerance());
+    if (m_cli.hasPageDetectionTolerance()) {
+        select_content->getSettings()->setPageDetectionTolerance(m_cli.getPageDetectionTolerance());
     }
 }
 
@@ -386,20 +392,19 @@ void
 ConsoleBatch::setupPageLayout(std::set<PageId> allPages)
 {
     IntrusivePtr<page_layout::Filter> page_layout = m_ptrStages->pageLayoutFilter();
-    CommandLine const& cli = CommandLine::get();
     QMap<QString, float> img_cache;
 
     for (PageId const& page : allPages) {
         // PAGE LAYOUT FILTER
-        page_layout::Alignment alignment = cli.getAlignment();
-        if (cli.hasMatchLayoutTolerance()) {
+        page_layout::Alignment alignment = m_cli.getAlignment();
+        if (m_cli.hasMatchLayoutTolerance()) {
             QString const path = page.imageId().filePath();
             if (!img_cache.contains(path)) {
                 QImage img(path);
                 img_cache[path] = float(img.width()) / float(img.height());
             }
             float imgAspectRatio = img_cache[path];
-            float tolerance = cli.getMatchLayoutTolerance();
+            float tolerance = m_cli.getMatchLayoutTolerance();
             std::vector<float> diffs;
             for (PageId const& page : allPages) {
                 ImageId pimageId = page.imageId();
@@ -425,10 +430,10 @@ ConsoleBatch::setupPageLayout(std::set<PageId> allPages)
                 alignment.setNull(true);
             }
         }
-        if (cli.hasMargins()) {
-            page_layout->getSettings()->setHardMarginsMM(page, MarginsWithAuto(cli.getMargins()));
+        if (m_cli.hasMargins()) {
+            page_layout->getSettings()->setHardMarginsMM(page, MarginsWithAuto(m_cli.getMargins()));
         }
-        if (cli.hasAlignment()) {
+        if (m_cli.hasAlignment()) {
             page_layout->getSettings()->setPageAlignment(page, alignment);
         }
     }
@@ -438,68 +443,59 @@ void
 ConsoleBatch::setupOutput(std::set<PageId> allPages)
 {
     IntrusivePtr<output::Filter> output = m_ptrStages->outputFilter();
-    CommandLine const& cli = CommandLine::get();
 
     for (PageId const& page : allPages) {
 
         // OUTPUT FILTER
         output::Params params(output->getSettings()->getParams(page));
-        if (cli.hasOutputDpi()) {
-            Dpi outputDpi = cli.getOutputDpi();
+        if (m_cli.hasOutputDpi()) {
+            Dpi outputDpi = m_cli.getOutputDpi();
             params.setOutputDpi(outputDpi);
         }
 
         output::ColorParams colorParams = params.colorParams();
-        if (cli.hasColorMode()) {
-            colorParams.setColorMode(cli.getColorMode());
+        if (m_cli.hasColorMode()) {
+            colorParams.setColorMode(m_cli.getColorMode());
         }
 
-        if (cli.hasWhiteMargins() || cli.hasNormalizeIllumination() ||
-                cli.hasAutoLayer() || cli.hasPictureZonesLayer() || cli.hasForegroundLayer()) {
+        if (m_cli.hasWhiteMargins() || m_cli.hasNormalizeIllumination() ||
+                m_cli.hasAutoLayer() || m_cli.hasPictureZonesLayer() || m_cli.hasForegroundLayer()) {
             output::ColorGrayscaleOptions cgo;
-            if (cli.hasWhiteMargins()) {
+            if (m_cli.hasWhiteMargins()) {
                 cgo.setWhiteMargins(true);
             }
-            if (cli.hasNormalizeIllumination()) {
+            if (m_cli.hasNormalizeIllumination()) {
                 cgo.setNormalizeIllumination(true);
             }
-            if (cli.hasAutoLayer()) {
+            if (m_cli.hasAutoLayer()) {
                 cgo.setAutoLayerEnabled(true);
             }
-            if (cli.hasPictureZonesLayer()) {
+            if (m_cli.hasPictureZonesLayer()) {
                 cgo.setPictureZonesLayerEnabled(true);
             }
-            if (cli.hasForegroundLayer()) {
+            if (m_cli.hasForegroundLayer()) {
                 cgo.setForegroundLayerEnabled(true);
             }
             colorParams.setColorGrayscaleOptions(cgo);
         }
 
-        if (cli.hasThreshold()) {
+        if (m_cli.hasThreshold()) {
             output::BlackWhiteOptions bwo;
-            bwo.setThresholdAdjustment(cli.getThreshold());
+            bwo.setThresholdAdjustment(m_cli.getThreshold());
             colorParams.setBlackWhiteOptions(bwo);
         }
 
         params.setColorParams(colorParams);
 
-        if (cli.hasDespeckle()) {
-            params.setDespeckleLevel(cli.getDespeckleLevel());
-        }
-
-        if (cli.hasDewarping()) {
-            params.setDewarpingMode(cli.getDewarpingMode());
-        }
-        if (cli.hasDepthPerception()) {
-            params.setDepthPerception(cli.getDepthPerception());
+        if (m_cli.hasDespeckle()) {
+            params.setDespeckleLevel(m_cli.getDespeckleLevel());
         }
 
-        if (cli.hasTiffCompressionBW()) {
-            GlobalStaticSettings::setTiffCompressionBW(cli.getTiffCompressionBW());
+        if (m_cli.hasDewarping()) {
+            params.setDewarpingMode(m_cli.getDewarpingMode());
         }
-
-        if (cli.hasTiffCompressionColor()) {
-            GlobalStaticSettings::setTiffCompressionColor(cli.getTiffCompressionColor());
+        if (m_cli.hasDepthPerception()) {
+            params.setDepthPerception(m_cli.getDepthPerception());
         }
 
         output->getSettings()->setParams(page, params);
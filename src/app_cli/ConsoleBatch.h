@@ -38,20 +38,38 @@
 #include "StageSequence.h"
 #include "PageSelectionAccessor.h"
 #include "ProjectReader.h"
+#include "CommandLine.h"
+#include "ProcessingContext.h"
+#ifndef Q_MOC_RUN
+#include <boost/function.hpp>
+#endif
 
 class ConsoleBatch
 {
     // Member-wise copying is OK.
 public:
+    /**
+     * Called before processing each page, with the filter index,
+     * the page number within that filter's pass and the number of pages.
+     */
+    typedef boost::function<void(int filter_idx, int page_no, int num_pages)> ProgressCallback;
+
+    /**
+     * The options are taken from \p cli rather than from CommandLine::get(),
+     * so that several batches with different options may run concurrently.
+     */
     ConsoleBatch(
+        CommandLine                const& cli,
         std::vector<ImageFileInfo> const& images,
         QString                    const& output_directory,
         Qt::LayoutDirection        const  layout);
-    ConsoleBatch(QString const project_file);
+    ConsoleBatch(CommandLine const& cli, QString const project_file);
 
-    void process();
+    void process(ProgressCallback const& progress = ProgressCallback());
     void saveProject(QString const project_file);
 private:
+    CommandLine m_cli;
+    ProcessingContextPtr m_ptrContext;
     bool batch;
     bool debug;
     IntrusivePtr<FileNameDisambiguator> m_ptrDisambiguator;
@@ -25,6 +25,8 @@
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "BatchServer.h"
+#include "imageproc/ImageArena.h"
 #include "config.h"
 
 int main(int argc, char** argv)
@@ -52,6 +54,16 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    imageproc::ImageArena::removeStaleBackingFiles();
+
+    if (cli.isDaemon() && !cli.hasHelp()) {
+        BatchServer server(cli);
+        if (!server.start()) {
+            return 1;
+        }
+        return app.exec();
+    }
+
     if (cli.hasHelp() || cli.outputDirectory().isEmpty() || (cli.images().size() == 0 && cli.projectFile().isEmpty())) {
         cli.printHelp();
         return 0;
@@ -61,11 +73,13 @@ int main(int argc, char** argv)
 
     try {
         if (!cli.projectFile().isEmpty()) {
-            cbatch.reset(new ConsoleBatch(cli.projectFile()));
+            cbatch.reset(new ConsoleBatch(cli, cli.projectFile()));
         } else {
-            cbatch.reset(new ConsoleBatch(cli.images(), cli.outputDirectory(), cli.getLayoutDirection()));
+            cbatch.reset(new ConsoleBatch(cli, cli.images(), cli.outputDirectory(), cli.getLayoutDirection()));
         }
         cbatch->process();
+        // Pooled page buffers are of no use once the batch is done.
+        imageproc::ImageArena::trim();
     } catch (std::exception const& e) {
         std::cerr << e.what() << std::endl;
         exit(1);
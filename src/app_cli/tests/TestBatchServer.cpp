@@ -0,0 +1,117 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BatchServer.h"
+#include "CommandLine.h"
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QStringList>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#endif
+
+namespace tests
+{
+
+namespace
+{
+
+struct ApplicationFixture
+{
+    ApplicationFixture()
+        :   argc(1), argv0("scantailor-cli"), app(argc, argv)
+    {
+    }
+
+    int argc;
+    char const* argv0;
+    char* argv[2] = { const_cast<char*>(argv0), nullptr };
+    QCoreApplication app;
+};
+
+QStringList const& malformedOptions()
+{
+    static QStringList const options = QStringList()
+                                       << "--content-box=10x20"
+                                       << "--orientation=sideways"
+                                       << "--page-detection-box=210mm";
+    return options;
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(BatchServerTestSuite, ApplicationFixture);
+
+BOOST_AUTO_TEST_CASE(test_malformed_values_are_errors)
+{
+    QTemporaryDir out_dir;
+    BOOST_REQUIRE(out_dir.isValid());
+
+    for (QString const& option : malformedOptions()) {
+        QStringList const argv = QStringList() << "scantailor-cli" << option << out_dir.path();
+        BOOST_CHECK(CommandLine(argv, false).isError());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_malformed_jobs_fail)
+{
+    QTemporaryDir spool_dir;
+    QTemporaryDir out_dir;
+    BOOST_REQUIRE(spool_dir.isValid() && out_dir.isValid());
+    QDir const spool(spool_dir.path());
+
+    QStringList job_names;
+    for (QString const& option : malformedOptions()) {
+        QString const name(QString("job%1").arg(job_names.size()));
+        job_names.push_back(name);
+
+        QJsonObject job;
+        job["args"] = QJsonArray() << option << out_dir.path();
+        QFile file(spool.filePath(name + ".job"));
+        BOOST_REQUIRE(file.open(QIODevice::WriteOnly));
+        file.write(QJsonDocument(job).toJson());
+    }
+
+    CommandLine const cli(
+        QStringList() << "scantailor-cli" << ("--spool-dir=" + spool_dir.path()), false
+    );
+    BatchServer server(cli);
+
+    // Jobs already in the spool directory are submitted right away,
+    // and arguments are checked before a job gets queued.
+    BOOST_REQUIRE(server.start());
+
+    for (QString const& name : job_names) {
+        BOOST_CHECK(QFileInfo(spool.filePath(name + ".failed")).exists());
+
+        QFile status_file(spool.filePath(name + ".status"));
+        BOOST_REQUIRE(status_file.open(QIODevice::ReadOnly));
+        QJsonObject const status(QJsonDocument::fromJson(status_file.readAll()).object());
+        BOOST_CHECK(status.value("state").toString() == "failed");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
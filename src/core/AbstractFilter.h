@@ -23,6 +23,7 @@
 #include "PageView.h"
 #include "PageOrderOption.h"
 #include <vector>
+#include <set>
 
 class FilterUiInterface;
 class PageId;
@@ -68,8 +69,54 @@ public:
     virtual QDomElement saveSettings(
         ProjectWriter const& writer, QDomDocument& doc) const = 0;
 
-    virtual void loadSettings(
-        ProjectReader const& reader, QDomElement const& filters_el) = 0;
+    /**
+     * \brief Same as saveSettings(), but only writes the settings of \p pages.
+     *
+     * Filters keeping their settings per image write the images
+     * \p pages belong to.  The default implementation writes everything.
+     */
+    virtual QDomElement savePageSettings(
+        ProjectWriter const& writer, QDomDocument& doc,
+        std::set<PageId> const& pages) const
+    {
+        return saveSettings(writer, doc);
+    }
+
+    /**
+     * \brief Retrieves the pages whose settings changed since the last call.
+     *
+     * \param[out] pages The changed pages are added here.
+     * \return false if the filter can't tell, meaning all of its
+     *         settings have to be saved.  That's also what the default
+     *         implementation returns.
+     */
+    virtual bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return false;
+    }
+
+    /**
+     * \brief The tag name of the element saveSettings() returns.
+     */
+    virtual QString settingsElementName() const = 0;
+
+    /**
+     * \brief Discards all settings and loads the filter-wide ones.
+     *
+     * \param filter_el The filter element with its attributes but without
+     *        children, or a null element if the project has none.
+     */
+    virtual void loadFilterSettings(
+        ProjectReader const& reader, QDomElement const& filter_el) = 0;
+
+    /**
+     * \brief Loads the settings from a child of the filter element.
+     *
+     * Called after loadFilterSettings() for every child element,
+     * in document order.  Unknown elements are to be ignored.
+     */
+    virtual void loadPageSettings(
+        ProjectReader const& reader, QDomElement const& el) = 0;
 
     virtual void invalidateSetting(PageId const& page) {}
 };
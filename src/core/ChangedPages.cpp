@@ -0,0 +1,73 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChangedPages.h"
+#include <QMutexLocker>
+
+ChangedPages::ChangedPages()
+    :   m_all(true)
+{
+}
+
+void
+ChangedPages::add(PageId const& page_id)
+{
+    QMutexLocker const locker(&m_mutex);
+    if (!m_all) {
+        m_pages.insert(page_id);
+    }
+}
+
+void
+ChangedPages::add(std::set<PageId> const& pages)
+{
+    QMutexLocker const locker(&m_mutex);
+    if (!m_all) {
+        m_pages.insert(pages.begin(), pages.end());
+    }
+}
+
+void
+ChangedPages::add(ImageId const& image_id)
+{
+    add(PageId(image_id, PageId::SINGLE_PAGE));
+}
+
+void
+ChangedPages::addAll()
+{
+    QMutexLocker const locker(&m_mutex);
+    m_all = true;
+    m_pages.clear();
+}
+
+bool
+ChangedPages::take(std::set<PageId>& pages)
+{
+    QMutexLocker const locker(&m_mutex);
+
+    bool const all = m_all;
+    if (!all) {
+        pages.insert(m_pages.begin(), m_pages.end());
+    }
+
+    m_pages.clear();
+    m_all = false;
+
+    return !all;
+}
@@ -0,0 +1,78 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANGED_PAGES_H_
+#define CHANGED_PAGES_H_
+
+#include "NonCopyable.h"
+#include "PageId.h"
+#include <QMutex>
+#include <set>
+
+/**
+ * \brief Keeps track of pages whose settings have changed since the last
+ *        time they were saved.
+ *
+ * Filters record their changes here, so that a project journal
+ * only has to write the settings of those pages.
+ * This class is thread-safe.
+ */
+class ChangedPages
+{
+    DECLARE_NON_COPYABLE(ChangedPages)
+public:
+    /**
+     * \brief Constructs the object with every page marked as changed.
+     */
+    ChangedPages();
+
+    void add(PageId const& page_id);
+
+    void add(std::set<PageId> const& pages);
+
+    /**
+     * \brief Marks a page by its image.
+     *
+     * To be used by settings kept per image rather than per page.
+     * The image is recorded as its SINGLE_PAGE page id.
+     */
+    void add(ImageId const& image_id);
+
+    /**
+     * \brief Marks every page as changed.
+     *
+     * To be used for changes that can't be attributed to particular pages,
+     * like clearing or relinking.
+     */
+    void addAll();
+
+    /**
+     * \brief Retrieves the changed pages and starts tracking from scratch.
+     *
+     * \param[out] pages The changed pages are added here.
+     * \return false if every page has to be considered changed.
+     *         In that case, \p pages is left unmodified.
+     */
+    bool take(std::set<PageId>& pages);
+private:
+    mutable QMutex m_mutex;
+    std::set<PageId> m_pages;
+    bool m_all;
+};
+
+#endif
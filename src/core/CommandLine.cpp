@@ -18,6 +18,7 @@
 */
 
 #include <cstdlib>
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <tiff.h>
@@ -26,6 +27,7 @@
 #include <QMap>
 #include <QRegularExpression>
 #include <QStringList>
+#include <QThread>
 #include "settings/ini_keys.h"
 
 #include "Dpi.h"
@@ -127,6 +129,10 @@ CommandLine::parseCli(QStringList const& argv)
     opts << "tiff-force-rgb";
     opts << "tiff-force-grayscale";
     opts << "tiff-force-keep-color-space";
+    opts << "out-of-core-threshold";
+    opts << "daemon";
+    opts << "spool-dir";
+    opts << "max-jobs";
 
     QMap<QString, QString> shortMap;
     shortMap["h"] = "help";
@@ -276,6 +282,8 @@ CommandLine::setup()
     m_contentDeviation = fetchContentDeviation();
     m_orientation = fetchOrientation();
     m_threshold = fetchThreshold();
+    m_outOfCoreThreshold = fetchOutOfCoreThreshold();
+    m_maxJobs = fetchMaxJobs();
     m_deskewAngle = fetchDeskewAngle();
     m_deskewMode = fetchDeskewMode();
     m_skewDeviation = fetchSkewDeviation();
@@ -324,6 +332,7 @@ CommandLine::printHelp()
     std::cout << "\t2) scantailor <project_file>" << std::endl;
     std::cout << "\t3) scantailor-cli [options] <images|directory|-> <output_directory>" << std::endl;
     std::cout << "\t4) scantailor-cli [options] <project_file> [output_directory]" << std::endl;
+    std::cout << "\t5) scantailor-cli --daemon=<socket_name> | --spool-dir=<directory> [--max-jobs=<n>] [options]" << std::endl;
     std::cout << std::endl;
     std::cout << "1)" << std::endl;
     std::cout << "\tstart ScanTailor's GUI interface" << std::endl;
@@ -335,6 +344,10 @@ CommandLine::printHelp()
     std::cout << "4)" << std::endl;
     std::cout << "\tbatch processing project from command line; no GUI" << std::endl;
     std::cout << "\tif output_directory is specified as last argument, it overwrites the one in project file" << std::endl;
+    std::cout << "5)" << std::endl;
+    std::cout << "\tstay running and process jobs submitted to a local socket or a spool directory; no GUI" << std::endl;
+    std::cout << "\ta job is a JSON object with the arguments of 3) or 4): {\"id\": \"...\", \"args\": [...]}" << std::endl;
+    std::cout << "\t--default-* options come from the daemon's own arguments; --tiff-* and --out-of-core-threshold are per job" << std::endl;
     std::cout << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "\t--help, -h" << std::endl;
@@ -402,6 +415,10 @@ CommandLine::printHelp()
     std::cout << "\t--tiff-force-rgb\t\t\t-- all output tiffs will be rgb" << std::endl;
     std::cout << "\t--tiff-force-grayscale\t\t\t-- all output tiffs will be grayscale" << std::endl;
     std::cout << "\t--tiff-force-keep-color-space\t\t-- output tiffs will be in original color space" << std::endl;
+    std::cout << "\t--out-of-core-threshold=<megapixels>\t-- keep pages larger than that in temporary files\n\t\t\t\t\t\t   rather than RAM; default: 0 (disabled)" << std::endl;
+    std::cout << "\t--daemon=<socket_name>\t\t\t-- accept jobs on a local socket" << std::endl;
+    std::cout << "\t--spool-dir=<directory>\t\t\t-- accept jobs as *.job files in a directory" << std::endl;
+    std::cout << "\t--max-jobs=<n>\t\t\t\t-- jobs processed concurrently by the daemon;\n\t\t\t\t\t\t   default: half the number of CPU cores" << std::endl;
     std::cout << "\t--window-title=WindowTitle\t\t-- default: project name" << std::endl;
     std::cout << "\t--page-detection-box=<widthxheight>\t\t-- in mm" << std::endl;
     std::cout << "\t\t--page-detection-tolerance=<0.0..1.0>\t-- default: 0.1" << std::endl;
@@ -669,7 +686,8 @@ CommandLine::fetchContentRect()
     }
 
     std::cout << "invalid --content-box=" << m_options.value("content-box").toLocal8Bit().constData() << std::endl;
-    exit(1);
+    m_error = true;
+    return QRectF();
 }
 
 double
@@ -700,7 +718,8 @@ CommandLine::fetchOrientation()
         orient = UPSIDEDOWN;
     } else {
         std::cout << "Wrong orientation " << m_options.value("orientation").toLocal8Bit().constData() << std::endl;
-        exit(1);
+        m_error = true;
+        orient = TOP;
     }
 
     return orient;
@@ -726,6 +745,28 @@ CommandLine::fetchThreshold()
     return m_options.value("threshold").toInt();
 }
 
+int
+CommandLine::fetchOutOfCoreThreshold()
+{
+    if (!hasOutOfCoreThreshold()) {
+        return 0;
+    }
+
+    int const mpix = m_options.value("out-of-core-threshold").toInt();
+    return mpix > 0 ? mpix : 0;
+}
+
+int
+CommandLine::fetchMaxJobs()
+{
+    int const jobs = m_options.value("max-jobs").toInt();
+    if (jobs > 0) {
+        return jobs;
+    }
+
+    return std::max(1, QThread::idealThreadCount() / 2);
+}
+
 double
 CommandLine::fetchDeskewAngle()
 {
@@ -889,7 +930,7 @@ QString CommandLine::fetchWindowTitle() const
     return "";
 }
 
-QSizeF CommandLine::fetchPageDetectionBox() const
+QSizeF CommandLine::fetchPageDetectionBox()
 {
     if (! hasPageDetectionBox()) {
         return QSizeF();
@@ -902,7 +943,8 @@ QSizeF CommandLine::fetchPageDetectionBox() const
             return QSizeF(match.captured(1).toFloat(), match.captured(2).toFloat());
         }
         std::cout << "invalid --page-detection-box=" << m_options["page-detection-box"].toLocal8Bit().constData() << std::endl;
-        exit(1);
+        m_error = true;
+        return QSizeF();
     } else {
         QSettings settings;
         if (settings.value(_key_content_sel_page_detection_target_page_size_enabled, _key_content_sel_page_detection_target_page_size_enabled_def).toBool()) {
@@ -260,6 +260,22 @@ public:
     {
         return contains("tiff-force-keep-color-space");
     }
+    bool hasOutOfCoreThreshold() const
+    {
+        return contains("out-of-core-threshold") && !m_options["out-of-core-threshold"].isEmpty();
+    }
+    bool isDaemon() const
+    {
+        return hasDaemonSocket() || hasSpoolDirectory();
+    }
+    bool hasDaemonSocket() const
+    {
+        return contains("daemon") && !m_options["daemon"].isEmpty();
+    }
+    bool hasSpoolDirectory() const
+    {
+        return contains("spool-dir") && !m_options["spool-dir"].isEmpty();
+    }
     bool hasWindowTitle() const
     {
         return contains("window-title") && !m_options["window-title"].isEmpty();
@@ -354,6 +370,22 @@ public:
     {
         return m_threshold;
     }
+    int getOutOfCoreThreshold() const
+    {
+        return m_outOfCoreThreshold;
+    }
+    QString getDaemonSocket() const
+    {
+        return m_options.value("daemon");
+    }
+    QString getSpoolDirectory() const
+    {
+        return m_options.value("spool-dir");
+    }
+    int getMaxJobs() const
+    {
+        return m_maxJobs;
+    }
     double getDeskewAngle() const
     {
         return m_deskewAngle;
@@ -480,6 +512,8 @@ private:
     double m_contentDeviation;
     Orientation m_orientation;
     int m_threshold;
+    int m_outOfCoreThreshold;
+    int m_maxJobs;
     double m_deskewAngle;
     AutoManualMode m_deskewMode;
     double m_skewDeviation;
@@ -521,6 +555,8 @@ private:
     Orientation fetchOrientation();
     QString fetchOutputProjectFile();
     int fetchThreshold();
+    int fetchOutOfCoreThreshold();
+    int fetchMaxJobs();
     double fetchDeskewAngle();
     AutoManualMode fetchDeskewMode();
     double fetchSkewDeviation();
@@ -534,7 +570,7 @@ private:
     QString fetchCompressionColor() const;
     QString fetchLanguage() const;
     QString fetchWindowTitle() const;
-    QSizeF fetchPageDetectionBox() const;
+    QSizeF fetchPageDetectionBox();
     double fetchPageDetectionTolerance() const;
     bool fetchDefaultNull();
 };
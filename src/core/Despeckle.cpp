@@ -710,42 +710,20 @@ void voronoiDistances(
     }
 }
 
-} // anonymous namespace
-
-BinaryImage
-Despeckle::despeckle(
-    BinaryImage const& src, Dpi const& dpi, Level const level,
-    TaskStatus const& status, DebugImages* const dbg)
-{
-    BinaryImage dst(src);
-    despeckleInPlace(dst, dpi, level, status, dbg);
-    return dst;
-}
-
-void
-Despeckle::despeckleInPlace(
-    BinaryImage& image, Dpi const& dpi, Level const level,
-    TaskStatus const& status, DebugImages* const dbg)
+/**
+ * \brief Counts the pixels and finds the bounding box of each connected component.
+ */
+void measureComponents(
+    ConnectivityMap const& cmap, std::vector<Component>& components,
+    std::vector<BoundingBox>& bounding_boxes)
 {
-    Settings const settings(Settings::get(level, dpi));
-
-    ConnectivityMap cmap(image, CONN8);
-    if (cmap.maxLabel() == 0) {
-        // Completely white image?
-        return;
-    }
-
-    status.throwIfCancelled();
-
-    std::vector<Component> components(cmap.maxLabel() + 1);
-    std::vector<BoundingBox> bounding_boxes(cmap.maxLabel() + 1);
+    int const width = cmap.size().width();
+    int const height = cmap.size().height();
 
-    int const width = image.width();
-    int const height = image.height();
+    components.assign(cmap.maxLabel() + 1, Component());
+    bounding_boxes.assign(cmap.maxLabel() + 1, BoundingBox());
 
-    uint32_t* const cmap_data = cmap.data();
-
-    // Count the number of pixels and a bounding rect of each component.
+    uint32_t const* const cmap_data = cmap.data();
     int const cmap_stride = cmap.stride();
     #pragma omp parallel
     {
@@ -753,7 +731,7 @@ Despeckle::despeckleInPlace(
         std::vector<BoundingBox> bounding_boxes_l(cmap.maxLabel() + 1);
         #pragma omp for
         for (int y = 0; y < height; ++y) {
-            uint32_t* cmap_line = cmap_data + y * cmap_stride;
+            uint32_t const* cmap_line = cmap_data + y * cmap_stride;
             for (int x = 0; x < width; ++x) {
                 uint32_t const label = cmap_line[x];
                 ++components_l[label].num_pixels;
@@ -768,11 +746,36 @@ Despeckle::despeckleInPlace(
             }
         }
     }
+}
 
-    status.throwIfCancelled();
+/**
+ * \brief Decides which connected components survive despeckling.
+ *
+ * \param cmap The connectivity map of the image being despeckled.
+ *        On return, it will contain remapped labels, spread over
+ *        the background as well.
+ * \param components Pixel counts of connected components, indexed by
+ *        labels from \p cmap.  On return, it will be indexed by the remapped
+ *        labels, with the components to be retained tagged as ANCHORED_TO_BIG.
+ * \param bounding_boxes Bounding boxes of connected components, indexed by
+ *        labels from \p cmap.
+ * \param remapping_table Will be filled with the mapping from original
+ *        labels to the remapped ones.
+ */
+void markRetainedComponents(
+    ConnectivityMap& cmap, std::vector<Component>& components,
+    std::vector<BoundingBox> const& bounding_boxes,
+    std::vector<uint32_t>& remapping_table, Settings const& settings,
+    TaskStatus const& status, DebugImages* const dbg)
+{
+    int const width = cmap.size().width();
+    int const height = cmap.size().height();
+
+    uint32_t* const cmap_data = cmap.data();
+    int const cmap_stride = cmap.stride();
 
     // Unify big components into one.
-    std::vector<uint32_t> remapping_table(components.size());
+    remapping_table.resize(components.size());
     uint32_t unified_big_component = 0;
     uint32_t next_avail_component = 1;
     for (uint32_t label = 1; label <= cmap.maxLabel(); ++label) {
@@ -794,7 +797,6 @@ Despeckle::despeckleInPlace(
         }
     }
     components.resize(next_avail_component);
-    std::vector<BoundingBox>().swap(bounding_boxes); // We don't need them any more.
 
     status.throwIfCancelled();
 
@@ -984,6 +986,52 @@ Despeckle::despeckleInPlace(
     }
 
     status.throwIfCancelled();
+}
+
+} // anonymous namespace
+
+BinaryImage
+Despeckle::despeckle(
+    BinaryImage const& src, Dpi const& dpi, Level const level,
+    TaskStatus const& status, DebugImages* const dbg)
+{
+    BinaryImage dst(src);
+    despeckleInPlace(dst, dpi, level, status, dbg);
+    return dst;
+}
+
+void
+Despeckle::despeckleInPlace(
+    BinaryImage& image, Dpi const& dpi, Level const level,
+    TaskStatus const& status, DebugImages* const dbg)
+{
+    Settings const settings(Settings::get(level, dpi));
+
+    ConnectivityMap cmap(image, CONN8);
+    if (cmap.maxLabel() == 0) {
+        // Completely white image?
+        return;
+    }
+
+    status.throwIfCancelled();
+
+    std::vector<Component> components;
+    std::vector<BoundingBox> bounding_boxes;
+    measureComponents(cmap, components, bounding_boxes);
+
+    status.throwIfCancelled();
+
+    std::vector<uint32_t> remapping_table;
+    markRetainedComponents(
+        cmap, components, bounding_boxes, remapping_table, settings, status, dbg
+    );
+    std::vector<BoundingBox>().swap(bounding_boxes); // We don't need them any more.
+
+    int const width = image.width();
+    int const height = image.height();
+
+    uint32_t* const cmap_data = cmap.data();
+    int const cmap_stride = cmap.stride();
 
     // Remove unmarked components from the binary image.
     uint32_t const msb = uint32_t(1) << 31;
@@ -1001,3 +1049,89 @@ Despeckle::despeckleInPlace(
         }
     }
 }
+
+IntrusivePtr<Despeckle::SpeckleLevels>
+Despeckle::speckleLevels(
+    BinaryImage const& src, Dpi const& dpi,
+    TaskStatus const& status, DebugImages* const dbg)
+{
+    ConnectivityMap cmap(src, CONN8);
+
+    // A combination of levelBit() flags for each connected component.
+    std::vector<uint8_t> label_levels(cmap.maxLabel() + 1, 0);
+
+    if (cmap.maxLabel() == 0) {
+        // Completely white image?
+        return IntrusivePtr<SpeckleLevels>(new SpeckleLevels(cmap, label_levels));
+    }
+
+    status.throwIfCancelled();
+
+    std::vector<Component> components;
+    std::vector<BoundingBox> bounding_boxes;
+    measureComponents(cmap, components, bounding_boxes);
+
+    static Level const all_levels[] = { CAUTIOUS, NORMAL, AGGRESSIVE };
+    for (Level const level : all_levels) {
+        status.throwIfCancelled();
+
+        // markRetainedComponents() spoils both of these.
+        ConnectivityMap level_cmap(cmap);
+        std::vector<Component> level_components(components);
+
+        std::vector<uint32_t> remapping_table;
+        markRetainedComponents(
+            level_cmap, level_components, bounding_boxes, remapping_table,
+            Settings::get(level, dpi), status, level == NORMAL ? dbg : 0
+        );
+
+        uint8_t const bit = levelBit(level);
+        for (uint32_t label = 1; label <= cmap.maxLabel(); ++label) {
+            if (!level_components[remapping_table[label]].anchoredToBig()) {
+                label_levels[label] |= bit;
+            }
+        }
+    }
+
+    status.throwIfCancelled();
+
+    return IntrusivePtr<SpeckleLevels>(new SpeckleLevels(cmap, label_levels));
+}
+
+/*========================= Despeckle::SpeckleLevels ======================*/
+
+Despeckle::SpeckleLevels::SpeckleLevels(
+    ConnectivityMap& labels, std::vector<uint8_t>& label_levels)
+{
+    m_labels.swap(labels);
+    m_labelLevels.swap(label_levels);
+}
+
+BinaryImage
+Despeckle::SpeckleLevels::specklesAt(Level const level) const
+{
+    int const width = m_labels.size().width();
+    int const height = m_labels.size().height();
+
+    BinaryImage speckles(width, height, WHITE);
+
+    uint8_t const bit = levelBit(level);
+    uint32_t const msb = uint32_t(1) << 31;
+    uint32_t const* const labels_data = m_labels.data();
+    int const labels_stride = m_labels.stride();
+    uint32_t* const speckles_data = speckles.data();
+    int const speckles_stride = speckles.wordsPerLine();
+
+    #pragma omp parallel for
+    for (int y = 0; y < height; ++y) {
+        uint32_t const* labels_line = labels_data + y * labels_stride;
+        uint32_t* speckles_line = speckles_data + y * speckles_stride;
+        for (int x = 0; x < width; ++x) {
+            if (m_labelLevels[labels_line[x]] & bit) {
+                speckles_line[x >> 5] |= msb >> (x & 31);
+            }
+        }
+    }
+
+    return speckles;
+}
@@ -19,6 +19,12 @@
 #ifndef DESPECKLE_H_
 #define DESPECKLE_H_
 
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include "imageproc/ConnectivityMap.h"
+#include <vector>
+#include <stdint.h>
+
 class Dpi;
 class TaskStatus;
 class DebugImages;
@@ -33,6 +39,36 @@ class Despeckle
 public:
     enum Level { CAUTIOUS, NORMAL, AGGRESSIVE };
 
+    /**
+     * \brief The despeckling levels at which each connected component gets removed.
+     *
+     * \see speckleLevels()
+     */
+    class SpeckleLevels : public RefCountable
+    {
+    public:
+        /**
+         * Takes over the contents of \p labels and \p label_levels,
+         * leaving them empty.
+         */
+        SpeckleLevels(imageproc::ConnectivityMap& labels, std::vector<uint8_t>& label_levels);
+
+        /**
+         * \brief Selects the speckles removed at a particular level.
+         *
+         * \return An image with speckles removed at \p level being black.
+         *         The result is the same as subtracting despeckle() output
+         *         from its input.
+         */
+        imageproc::BinaryImage specklesAt(Level level) const;
+    private:
+        /** Connected components of the analyzed image. */
+        imageproc::ConnectivityMap m_labels;
+
+        /** A combination of levelBit() flags for each label of m_labels. */
+        std::vector<uint8_t> m_labelLevels;
+    };
+
     /**
      * \brief Removes small speckles from a binary image.
      *
@@ -53,6 +89,27 @@ public:
     static void despeckleInPlace(
         imageproc::BinaryImage& image, Dpi const& dpi,
         Level level, TaskStatus const& status, DebugImages* dbg = 0);
+
+    /**
+     * \brief Finds the despeckling levels at which each connected component
+     *        gets removed.
+     *
+     * This is equivalent to despeckling \p src at every level, except
+     * connected components are only labelled once.
+     *
+     * \param src The image to analyze.  Must not be null.
+     * \param dpi DPI of \p src.
+     * \param status For asynchronous task cancellation.
+     * \param dbg An optional sink for debugging images.
+     */
+    static IntrusivePtr<SpeckleLevels> speckleLevels(
+        imageproc::BinaryImage const& src, Dpi const& dpi,
+        TaskStatus const& status, DebugImages* dbg = 0);
+
+    static uint8_t levelBit(Level level)
+    {
+        return static_cast<uint8_t>(1 << level);
+    }
 };
 
 #endif
@@ -20,21 +20,181 @@
 #include "Dpm.h"
 #include "Dpi.h"
 #include "imageproc/Grayscale.h"
+#include "imageproc/Transform.h"
+#include "imageproc/Scale.h"
+#include "imageproc/Constants.h"
+#include <QMutexLocker>
+#include <QColor>
+#include <algorithm>
+#include <math.h>
+#include <assert.h>
 
 using namespace imageproc;
 
-FilterData::FilterData(QImage const& image)
+FilterData::FilterData(QImage const& image, ProcessingContextPtr const& context)
     :   m_origImage(image),
-        m_grayImage(toGrayscale(m_origImage)),
-        m_xform(image.rect(), Dpm(image)),
-        m_bwThreshold(BinaryThreshold::otsuThreshold(m_grayImage))
+        m_ptrGrayData(new GrayData),
+        m_ptrContext(context),
+        m_xform(image.rect(), Dpm(image))
 {
+    assert(m_ptrContext);
 }
 
 FilterData::FilterData(FilterData const& other, ImageTransformation const& xform)
     :   m_origImage(other.m_origImage),
-        m_grayImage(other.m_grayImage),
-        m_xform(xform),
-        m_bwThreshold(other.m_bwThreshold)
+        m_ptrGrayData(other.m_ptrGrayData),
+        m_ptrContext(other.m_ptrContext),
+        m_xform(xform)
 {
 }
+
+BinaryThreshold
+FilterData::bwThreshold() const
+{
+    return grayData().bwThreshold;
+}
+
+GrayImage const&
+FilterData::grayImage() const
+{
+    return grayData().grayImage;
+}
+
+uint8_t
+FilterData::darkestGrayLevel() const
+{
+    return grayData().darkestGrayLevel;
+}
+
+GrayImage
+FilterData::transformedGrayImage(Dpi const& dpi) const
+{
+    GrayData& data = grayData();
+
+    ImageTransformation xform(m_xform);
+    xform.preScaleToDpi(dpi);
+    QTransform const transform(xform.transform());
+    QRect const rect(xform.resultingRect().toRect());
+
+    {
+        QMutexLocker const locker(&data.mutex);
+        for (GrayData::TransformedLevel const& level : data.transformedLevels) {
+            if (level.xform == transform && level.rect == rect) {
+                return level.image;
+            }
+        }
+    }
+
+    if (rect.isEmpty()) {
+        return GrayImage();
+    }
+
+    // Computed without holding the lock.  Should two threads get here
+    // at the same time, they would produce identical images.
+    uint8_t const darkest = data.darkestGrayLevel;
+    GrayImage const image(
+        transformToGray(
+            data.grayImage, transform, rect,
+            OutsidePixels::assumeColor(QColor(darkest, darkest, darkest))
+        )
+    );
+
+    QMutexLocker const locker(&data.mutex);
+    GrayData::TransformedLevel level;
+    level.xform = transform;
+    level.rect = rect;
+    level.image = image;
+    data.transformedLevels.push_back(level);
+
+    return image;
+}
+
+BinaryImage
+FilterData::bwImage(Dpi const& dpi) const
+{
+    GrayData& data = grayData();
+    QSize const size(bwImageSize(dpi));
+
+    {
+        QMutexLocker const locker(&data.mutex);
+        for (GrayData::BinaryLevel const& level : data.binaryLevels) {
+            if (level.size == size) {
+                return level.image;
+            }
+        }
+    }
+
+    BinaryImage image;
+    if (size == data.grayImage.size()) {
+        image = BinaryImage(data.grayImage, data.bwThreshold);
+    } else {
+        image = BinaryImage(scaleToGray(data.grayImage, size), data.bwThreshold);
+    }
+
+    QMutexLocker const locker(&data.mutex);
+    GrayData::BinaryLevel level;
+    level.size = size;
+    level.image = image;
+    data.binaryLevels.push_back(level);
+
+    return image;
+}
+
+QTransform
+FilterData::bwImageTransform(Dpi const& dpi) const
+{
+    QTransform xform;
+    QSize const size(bwImageSize(dpi));
+    if (size != m_origImage.size()) {
+        xform.scale(
+            (dpi.horizontal() * constants::DPI2DPM) / m_origImage.dotsPerMeterX(),
+            (dpi.vertical() * constants::DPI2DPM) / m_origImage.dotsPerMeterY()
+        );
+    }
+    return xform;
+}
+
+QSize
+FilterData::bwImageSize(Dpi const& dpi) const
+{
+    if (dpi.isNull()) {
+        return m_origImage.size();
+    }
+
+    double const xfactor = (dpi.horizontal() * constants::DPI2DPM) / m_origImage.dotsPerMeterX();
+    double const yfactor = (dpi.vertical() * constants::DPI2DPM) / m_origImage.dotsPerMeterY();
+    if (fabs(xfactor - 1.0) < 0.1 && fabs(yfactor - 1.0) < 0.1) {
+        return m_origImage.size();
+    }
+
+    return QSize(
+        std::max(1, (int)ceil(xfactor * m_origImage.width())),
+        std::max(1, (int)ceil(yfactor * m_origImage.height()))
+    );
+}
+
+FilterData::GrayData&
+FilterData::grayData() const
+{
+    GrayData& data = *m_ptrGrayData;
+
+    QMutexLocker const locker(&data.mutex);
+    if (!data.computed) {
+        data.grayImage = GrayImage(toGrayscale(m_origImage));
+
+        GrayscaleHistogram const hist(data.grayImage);
+        data.bwThreshold = BinaryThreshold::otsuThreshold(hist);
+
+        data.darkestGrayLevel = 0xff;
+        for (int level = 0; level < 256; ++level) {
+            if (hist[level] != 0) {
+                data.darkestGrayLevel = level;
+                break;
+            }
+        }
+
+        data.computed = true;
+    }
+
+    return data;
+}
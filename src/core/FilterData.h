@@ -20,22 +20,34 @@
 #define FILTERDATA_H_
 
 #include "imageproc/BinaryThreshold.h"
+#include "imageproc/BinaryImage.h"
 #include "imageproc/GrayImage.h"
 #include "ImageTransformation.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include "ProcessingContext.h"
+#include "Dpi.h"
 #include <QImage>
+#include <QMutex>
+#include <QTransform>
+#include <QRect>
+#include <vector>
+#include <stdint.h>
 
 class FilterData
 {
     // Member-wise copying is OK.
 public:
-    FilterData(QImage const& image);
+    FilterData(QImage const& image, ProcessingContextPtr const& context);
 
     FilterData(FilterData const& other, ImageTransformation const& xform);
 
-    imageproc::BinaryThreshold bwThreshold() const
-    {
-        return m_bwThreshold;
-    }
+    /**
+     * \brief Returns the Otsu threshold of the grayscale image.
+     *
+     * Computed on first use along with grayImage().
+     */
+    imageproc::BinaryThreshold bwThreshold() const;
 
     ImageTransformation const& xform() const
     {
@@ -47,15 +59,109 @@ public:
         return m_origImage;
     }
 
-    imageproc::GrayImage const& grayImage() const
+    /**
+     * \brief Returns the settings of the job this page is processed for.
+     */
+    ProcessingContext const& context() const
+    {
+        return *m_ptrContext;
+    }
+
+    ProcessingContextPtr const& contextPtr() const
     {
-        return m_grayImage;
+        return m_ptrContext;
     }
+
+    /**
+     * \brief Returns the grayscale version of origImage().
+     *
+     * It's computed on first use and then shared by all copies
+     * of this FilterData.  This method is thread-safe.
+     */
+    imageproc::GrayImage const& grayImage() const;
+
+    /**
+     * \brief Returns the darkest gray level of grayImage().
+     *
+     * Computed on first use along with grayImage().
+     */
+    uint8_t darkestGrayLevel() const;
+
+    /**
+     * \brief Returns grayImage() transformed with xform() pre-scaled to \p dpi.
+     *
+     * Areas that come from outside of the original image are filled
+     * with darkestGrayLevel(), so that the shadow around the page,
+     * if any, is extended rather than interrupted.  The image corresponds
+     * to the resulting rectangle of the pre-scaled transformation.
+     *
+     * The result is computed on first use and then shared by all copies
+     * of this FilterData having an equivalent xform().  This method is
+     * thread-safe.
+     */
+    imageproc::GrayImage transformedGrayImage(Dpi const& dpi) const;
+
+    /**
+     * \brief Returns grayImage() binarized with bwThreshold().
+     *
+     * Unlike transformedGrayImage(), xform() is ignored here.  If \p dpi
+     * is within 10% of the original resolution or is null, the image has
+     * the original size.  Otherwise it's scaled to \p dpi first.
+     *
+     * The result is computed on first use and then shared by all copies
+     * of this FilterData.  This method is thread-safe.
+     */
+    imageproc::BinaryImage bwImage(Dpi const& dpi = Dpi()) const;
+
+    /**
+     * \brief Returns the transformation from origImage() coordinates
+     *        to bwImage(dpi) coordinates.
+     */
+    QTransform bwImageTransform(Dpi const& dpi = Dpi()) const;
 private:
+    /**
+     * The lazily computed data shared between copies of FilterData.
+     */
+    class GrayData : public RefCountable
+    {
+    public:
+        struct TransformedLevel
+        {
+            QTransform xform;
+            QRect rect;
+            imageproc::GrayImage image;
+        };
+
+        struct BinaryLevel
+        {
+            QSize size;
+            imageproc::BinaryImage image;
+        };
+
+        GrayData() : bwThreshold(0), darkestGrayLevel(0), computed(false) {}
+
+        QMutex mutex;
+        imageproc::GrayImage grayImage;
+        imageproc::BinaryThreshold bwThreshold;
+        uint8_t darkestGrayLevel;
+        bool computed;
+
+        /**
+         * Reduced working copies of grayImage(), built on demand.
+         * Protected by the same mutex.
+         */
+        std::vector<TransformedLevel> transformedLevels;
+        std::vector<BinaryLevel> binaryLevels;
+    };
+
+    GrayData& grayData() const;
+
+    QSize bwImageSize(Dpi const& dpi) const;
+
     QImage m_origImage;
-    imageproc::GrayImage m_grayImage;
+    IntrusivePtr<GrayData> m_ptrGrayData;
+    ProcessingContextPtr m_ptrContext;
     ImageTransformation m_xform;
-    imageproc::BinaryThreshold m_bwThreshold;
 };
 
 #endif
@@ -18,22 +18,85 @@
 
 #include "ImageId.h"
 #include <QFileInfo>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+namespace
+{
+
+/**
+ * Maps file paths to the keys returned by ImageId::filePathKey().
+ * Entries are never removed, which is fine, as the number of distinct
+ * file paths a session sees is bounded by the number of input files
+ * plus relinking.
+ */
+class FilePathKeys
+{
+public:
+    int keyFor(QString const& file_path);
+private:
+    QReadWriteLock m_lock;
+    QHash<QString, int> m_keys;
+};
+
+int
+FilePathKeys::keyFor(QString const& file_path)
+{
+    if (file_path.isEmpty()) {
+        return 0;
+    }
+
+    {
+        QReadLocker const locker(&m_lock);
+        QHash<QString, int>::const_iterator const it(m_keys.constFind(file_path));
+        if (it != m_keys.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QWriteLocker const locker(&m_lock);
+    // Another thread might have added it in the meantime.
+    QHash<QString, int>::iterator it(m_keys.find(file_path));
+    if (it == m_keys.end()) {
+        it = m_keys.insert(file_path, m_keys.size() + 1);
+    }
+    return it.value();
+}
+
+int filePathKey(QString const& file_path)
+{
+    static FilePathKeys keys;
+    return keys.keyFor(file_path);
+}
+
+} // anonymous namespace
 
 ImageId::ImageId(QString const& file_path, int const page)
     :   m_filePath(file_path),
-        m_page(page)
+        m_page(page),
+        m_filePathKey(filePathKey(file_path))
 {
 }
 
 ImageId::ImageId(QFileInfo const& file_info, int const page)
     :   m_filePath(file_info.absoluteFilePath()),
-        m_page(page)
+        m_page(page),
+        m_filePathKey(filePathKey(m_filePath))
 {
 }
 
+void
+ImageId::setFilePath(QString const& path)
+{
+    m_filePath = path;
+    m_filePathKey = filePathKey(path);
+}
+
 bool operator==(ImageId const& lhs, ImageId const& rhs)
 {
-    return lhs.page() == rhs.page() && lhs.filePath() == rhs.filePath();
+    return lhs.page() == rhs.page() && lhs.filePathKey() == rhs.filePathKey();
 }
 
 bool operator!=(ImageId const& lhs, ImageId const& rhs)
@@ -43,11 +106,23 @@ bool operator!=(ImageId const& lhs, ImageId const& rhs)
 
 bool operator<(ImageId const& lhs, ImageId const& rhs)
 {
-    int const comp = lhs.filePath().compare(rhs.filePath());
-    if (comp < 0) {
-        return true;
-    } else if (comp > 0) {
-        return false;
+    // Equal keys mean equal paths, and that's the common case in lookups.
+    if (lhs.filePathKey() != rhs.filePathKey()) {
+        int const comp = lhs.filePath().compare(rhs.filePath());
+        if (comp < 0) {
+            return true;
+        } else if (comp > 0) {
+            return false;
+        }
     }
     return lhs.page() < rhs.page();
 }
+
+uint qHash(ImageId const& image_id, uint const seed)
+{
+    // Keys are small consecutive integers, and so are page numbers,
+    // so simply xor-ing them would produce lots of collisions.
+    uint hash = qHash(image_id.filePathKey(), seed);
+    hash ^= uint(image_id.page()) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+    return hash;
+}
@@ -20,6 +20,8 @@
 #define IMAGEID_H_
 
 #include <QString>
+#include <functional>
+#include <stddef.h>
 
 class QFileInfo;
 
@@ -27,7 +29,7 @@ class ImageId
 {
     // Member-wise copying is OK.
 public:
-    ImageId() : m_filePath(), m_page(0) {}
+    ImageId() : m_filePath(), m_page(0), m_filePathKey(0) {}
 
     explicit ImageId(QString const& file_path, int page = 0);
 
@@ -43,9 +45,18 @@ public:
         return m_filePath;
     }
 
-    void setFilePath(QString const& path)
+    void setFilePath(QString const& path);
+
+    /**
+     * \brief A small integer uniquely identifying filePath().
+     *
+     * File paths are interned in a process-wide table, so equal paths
+     * get equal keys, and comparing or hashing image ids doesn't
+     * have to look at the strings.  Empty paths have a key of zero.
+     */
+    int filePathKey() const
     {
-        m_filePath = path;
+        return m_filePathKey;
     }
 
     int page() const
@@ -75,10 +86,27 @@ private:
      * If above zero, indicates Nth page in a multipage file.
      */
     int m_page;
+
+    int m_filePathKey;
 };
 
 bool operator==(ImageId const& lhs, ImageId const& rhs);
 bool operator!=(ImageId const& lhs, ImageId const& rhs);
 bool operator<(ImageId const& lhs, ImageId const& rhs);
+uint qHash(ImageId const& image_id, uint seed = 0);
+
+namespace std
+{
+
+template<>
+struct hash<ImageId>
+{
+    size_t operator()(ImageId const& image_id) const
+    {
+        return qHash(image_id);
+    }
+};
+
+} // namespace std
 
 #endif
@@ -32,7 +32,28 @@
 QImage
 ImageLoader::load(ImageId const& image_id)
 {
-    return load(image_id.filePath(), image_id.zeroBasedPage());
+    QString const& file_path = image_id.filePath();
+    if (file_path.startsWith(":")) {
+        return load(file_path, image_id.zeroBasedPage());
+    }
+
+    QFile file(file_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+
+    // Input files don't change under us, so TIFF files among them
+    // can be mapped into memory, and pages of multi-page ones can be
+    // read through TiffReader's open files.
+    if (TiffReader::canRead(file)) {
+        if (image_id.isMultiPageFile()) {
+            file.close();
+            return TiffReader::readImage(file_path, image_id.zeroBasedPage());
+        }
+        return TiffReader::readImage(file, 0, true);
+    }
+
+    return load(file, image_id.zeroBasedPage());
 }
 
 QImage
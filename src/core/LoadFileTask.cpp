@@ -61,15 +61,18 @@ LoadFileTask::LoadFileTask(
     Type type, PageInfo const& page,
     IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
     IntrusivePtr<ProjectPages> const& pages,
-    IntrusivePtr<fix_orientation::Task> const& next_task)
+    IntrusivePtr<fix_orientation::Task> const& next_task,
+    ProcessingContextPtr const& context)
     :   BackgroundTask(type),
         m_ptrThumbnailCache(thumbnail_cache),
         m_imageId(page.imageId()),
         m_imageMetadata(page.metadata()),
         m_ptrPages(pages),
-        m_ptrNextTask(next_task)
+        m_ptrNextTask(next_task),
+        m_ptrContext(context)
 {
     assert(m_ptrNextTask);
+    assert(m_ptrContext);
 }
 
 LoadFileTask::~LoadFileTask()
@@ -96,7 +99,7 @@ LoadFileTask::operator()()
             updateImageSizeIfChanged(image);
             overrideDpi(image);
             m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
-            return m_ptrNextTask->process(*this, FilterData(image));
+            return m_ptrNextTask->process(*this, FilterData(image, m_ptrContext));
         }
     } catch (CancelledException const&) {
         return FilterResultPtr();
@@ -25,6 +25,7 @@
 #include "IntrusivePtr.h"
 #include "ImageId.h"
 #include "ImageMetadata.h"
+#include "ProcessingContext.h"
 
 class ThumbnailPixmapCache;
 class PageInfo;
@@ -43,7 +44,8 @@ public:
     LoadFileTask(Type type, PageInfo const& page,
                  IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
                  IntrusivePtr<ProjectPages> const& pages,
-                 IntrusivePtr<fix_orientation::Task> const& next_task);
+                 IntrusivePtr<fix_orientation::Task> const& next_task,
+                 ProcessingContextPtr const& context);
 
     virtual ~LoadFileTask();
 
@@ -60,6 +62,7 @@ private:
     ImageMetadata m_imageMetadata;
     IntrusivePtr<ProjectPages> const m_ptrPages;
     IntrusivePtr<fix_orientation::Task> const m_ptrNextTask;
+    ProcessingContextPtr const m_ptrContext;
 };
 
 #endif
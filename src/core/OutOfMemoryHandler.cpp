@@ -18,6 +18,7 @@
 
 #include "OutOfMemoryHandler.h"
 
+#include "imageproc/ImageArena.h"
 #include <QMutexLocker>
 #include <QMetaObject>
 #include <Qt>
@@ -60,6 +61,7 @@ OutOfMemoryHandler::handleOutOfMemorySituation()
 
     m_hadOOM = true;
     boost::scoped_array<char>().swap(m_emergencyBuffer);
+    imageproc::ImageArena::trim();
     QMetaObject::invokeMethod(this, "outOfMemory", Qt::QueuedConnection);
 }
 
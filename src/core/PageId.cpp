@@ -97,8 +97,8 @@ bool operator<(PageId const& lhs, PageId const& rhs)
 
 uint qHash(const PageId& tag, uint seed)
 {
-    return qHash(tag.imageId().filePath(), seed) ^
-           qHash(tag.imageId().page(), seed) ^
-           qHash(tag.subPage(), seed ^ 0xA11A);
+    uint hash = qHash(tag.imageId(), seed);
+    hash ^= uint(tag.subPage()) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+    return hash;
 }
 
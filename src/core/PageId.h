@@ -21,6 +21,8 @@
 
 #include "ImageId.h"
 #include <QHash>
+#include <functional>
+#include <stddef.h>
 
 class QString;
 
@@ -83,4 +85,18 @@ bool operator!=(PageId const& lhs, PageId const& rhs);
 bool operator<(PageId const& lhs, PageId const& rhs);
 uint qHash(const PageId& tag, uint seed = 0);
 
+namespace std
+{
+
+template<>
+struct hash<PageId>
+{
+    size_t operator()(PageId const& page_id) const
+    {
+        return qHash(page_id);
+    }
+};
+
+} // namespace std
+
 #endif
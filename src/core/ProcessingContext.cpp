@@ -0,0 +1,94 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProcessingContext.h"
+#include "CommandLine.h"
+#include "settings/globalstaticsettings.h"
+#include "settings/TiffCompressionInfo.h"
+#include <tiff.h>
+
+/**
+ * Unlike TiffCompressions::info(), doesn't insert unknown names,
+ * so it's safe to call from any thread.
+ */
+static int compressionId(QString const& name)
+{
+    for (auto it = TiffCompressions::constBegin(); it != TiffCompressions::constEnd(); ++it) {
+        if (it.key() == name) {
+            return it.value().id;
+        }
+    }
+    return COMPRESSION_LZW;
+}
+
+ProcessingContext::Options::Options()
+    :   tiffCompressionBW(GlobalStaticSettings::m_tiff_compr_method_bw),
+        tiffCompressionColor(GlobalStaticSettings::m_tiff_compr_method_color),
+        useHorizontalPredictor(GlobalStaticSettings::m_use_horizontal_predictor),
+        tiffForceRGB(false),
+        tiffForceGrayscale(false),
+        tiffForceKeepColorSpace(false),
+        disableBwSmoothing(GlobalStaticSettings::m_disable_bw_smoothing),
+        pictureDetectionSensitivity(GlobalStaticSettings::m_picture_detection_sensitivity),
+        outOfCoreThresholdMpix(GlobalStaticSettings::m_out_of_core_threshold_mpix),
+        dewarpAutoVertHalfCorrection(GlobalStaticSettings::m_dewarpAutoVertHalfCorrection),
+        dewarpAutoDeskewAfterDewarp(GlobalStaticSettings::m_dewarpAutoDeskewAfterDewarp),
+        contentDespeckleLevel(Despeckle::NORMAL),
+        contentTextMask(true),
+        interactive(false),
+        forcePageDetectionDisabled(false),
+        disableCheckOutput(false)
+{
+}
+
+ProcessingContext::Options::Options(CommandLine const& cli)
+    :   Options()
+{
+    if (cli.hasTiffCompressionBW()) {
+        tiffCompressionBW = cli.getTiffCompressionBW();
+    }
+    if (cli.hasTiffCompressionColor()) {
+        tiffCompressionColor = cli.getTiffCompressionColor();
+    }
+    tiffForceRGB = cli.hasTiffForceRGB();
+    tiffForceGrayscale = cli.hasTiffForceGrayscale();
+    tiffForceKeepColorSpace = cli.hasTiffForceKeepColorSpace();
+    if (cli.hasOutOfCoreThreshold()) {
+        outOfCoreThresholdMpix = cli.getOutOfCoreThreshold();
+    }
+    if (cli.hasContentRect()) {
+        contentDespeckleLevel = cli.getContentDetection();
+    }
+    contentTextMask = cli.hasContentText();
+    interactive = cli.isGui();
+    forcePageDetectionDisabled = cli.isForcePageDetectionDisabled();
+    disableCheckOutput = cli.hasDisableCheckOutput();
+}
+
+ProcessingContextPtr
+ProcessingContext::create(CommandLine const& cli)
+{
+    return ProcessingContextPtr(new ProcessingContext(Options(cli)));
+}
+
+ProcessingContext::ProcessingContext(Options const& options)
+    :   m_options(options),
+        m_tiffCompressionBWId(compressionId(options.tiffCompressionBW)),
+        m_tiffCompressionColorId(compressionId(options.tiffCompressionColor))
+{
+}
@@ -0,0 +1,212 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROCESSINGCONTEXT_H_
+#define PROCESSINGCONTEXT_H_
+
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include "Despeckle.h"
+#include <QString>
+
+class CommandLine;
+class ProcessingContext;
+
+typedef IntrusivePtr<ProcessingContext const> ProcessingContextPtr;
+
+/**
+ * \brief The settings page processing depends on, other than
+ *        the per-page parameters stored in a project.
+ *
+ * A context is immutable and is passed along with FilterData, so that
+ * tasks with different settings may run side by side on the same
+ * worker threads.  Code running as part of a task should take its
+ * settings from here rather than from GlobalStaticSettings or
+ * CommandLine::get().
+ */
+class ProcessingContext : public RefCountable
+{
+public:
+    struct Options
+    {
+        QString tiffCompressionBW;
+        QString tiffCompressionColor;
+        bool useHorizontalPredictor;
+        bool tiffForceRGB;
+        bool tiffForceGrayscale;
+        bool tiffForceKeepColorSpace;
+        bool disableBwSmoothing;
+        float pictureDetectionSensitivity;
+
+        /**
+         * Pages above this many megapixels are processed out of core.
+         * Zero disables that.
+         */
+        int outOfCoreThresholdMpix;
+        bool dewarpAutoVertHalfCorrection;
+        bool dewarpAutoDeskewAfterDewarp;
+
+        /**
+         * How aggressively content detection removes speckles.
+         */
+        Despeckle::Level contentDespeckleLevel;
+
+        /**
+         * Whether content detection looks for text.
+         */
+        bool contentTextMask;
+
+        /**
+         * Whether pages are processed for an interactive session,
+         * where the page being edited is likely to be processed again.
+         */
+        bool interactive;
+
+        /**
+         * Whether page detection without content detection is
+         * replaced with a manual content box equal to the page box.
+         */
+        bool forcePageDetectionDisabled;
+
+        /**
+         * Whether output may be produced before the page layout
+         * of every page is defined.
+         */
+        bool disableCheckOutput;
+
+        /**
+         * \brief Takes the values from GlobalStaticSettings.
+         */
+        Options();
+
+        /**
+         * \brief Takes the values from GlobalStaticSettings, except
+         *        for those set in \p cli.
+         */
+        explicit Options(CommandLine const& cli);
+    };
+
+    /**
+     * \brief Same as ProcessingContext(Options(cli)).
+     */
+    static ProcessingContextPtr create(CommandLine const& cli);
+
+    explicit ProcessingContext(Options const& options);
+
+    QString const& tiffCompressionBW() const
+    {
+        return m_options.tiffCompressionBW;
+    }
+
+    QString const& tiffCompressionColor() const
+    {
+        return m_options.tiffCompressionColor;
+    }
+
+    /**
+     * \brief Returns the libtiff COMPRESSION_* value of tiffCompressionBW().
+     */
+    int tiffCompressionBWId() const
+    {
+        return m_tiffCompressionBWId;
+    }
+
+    /**
+     * \brief Returns the libtiff COMPRESSION_* value of tiffCompressionColor().
+     */
+    int tiffCompressionColorId() const
+    {
+        return m_tiffCompressionColorId;
+    }
+
+    bool useHorizontalPredictor() const
+    {
+        return m_options.useHorizontalPredictor;
+    }
+
+    bool tiffForceRGB() const
+    {
+        return m_options.tiffForceRGB;
+    }
+
+    bool tiffForceGrayscale() const
+    {
+        return m_options.tiffForceGrayscale;
+    }
+
+    bool tiffForceKeepColorSpace() const
+    {
+        return m_options.tiffForceKeepColorSpace;
+    }
+
+    bool disableBwSmoothing() const
+    {
+        return m_options.disableBwSmoothing;
+    }
+
+    float pictureDetectionSensitivity() const
+    {
+        return m_options.pictureDetectionSensitivity;
+    }
+
+    int outOfCoreThresholdMpix() const
+    {
+        return m_options.outOfCoreThresholdMpix;
+    }
+
+    bool dewarpAutoVertHalfCorrection() const
+    {
+        return m_options.dewarpAutoVertHalfCorrection;
+    }
+
+    bool dewarpAutoDeskewAfterDewarp() const
+    {
+        return m_options.dewarpAutoDeskewAfterDewarp;
+    }
+
+    Despeckle::Level contentDespeckleLevel() const
+    {
+        return m_options.contentDespeckleLevel;
+    }
+
+    bool contentTextMask() const
+    {
+        return m_options.contentTextMask;
+    }
+
+    bool interactive() const
+    {
+        return m_options.interactive;
+    }
+
+    bool forcePageDetectionDisabled() const
+    {
+        return m_options.forcePageDetectionDisabled;
+    }
+
+    bool disableCheckOutput() const
+    {
+        return m_options.disableCheckOutput;
+    }
+private:
+    Options const m_options;
+    int const m_tiffCompressionBWId;
+    int const m_tiffCompressionColorId;
+};
+
+#endif
@@ -0,0 +1,716 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProjectJournal.h"
+#include "ProjectWriter.h"
+#include "AbstractFilter.h"
+#include "AbstractCommand.h"
+#include "AtomicFileOverwriter.h"
+#include "RefCountable.h"
+#include "ImageId.h"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QDomNamedNodeMap>
+#include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace
+{
+
+/**
+ * Once the journal grows larger than the project file divided by this,
+ * it gets merged into the project file.  This keeps the cost of merging
+ * proportional to the amount of changes written.
+ */
+int const MERGE_RATIO = 4;
+
+QByteArray hashOf(QByteArray const& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+QByteArray journalHeader(QByteArray const& project_hash)
+{
+    return QByteArray("ScanTailorJournal 1 ") + project_hash + '\n';
+}
+
+bool readFile(QString const& path, QByteArray& data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    data = file.readAll();
+    return file.error() == QFile::NoError;
+}
+
+bool overwriteFile(QString const& path, QByteArray const& data)
+{
+    AtomicFileOverwriter overwriter;
+    QIODevice* const dev = overwriter.startWriting(path);
+    if (!dev) {
+        return false;
+    }
+
+    if (dev->write(data) != data.size()) {
+        return false;
+    }
+
+    return overwriter.commit();
+}
+
+void writeElement(QXmlStreamWriter& writer, QDomElement const& el)
+{
+    writer.writeStartElement(el.tagName());
+
+    QDomNamedNodeMap const attrs(el.attributes());
+    for (int i = 0; i < attrs.count(); ++i) {
+        QDomAttr const attr(attrs.item(i).toAttr());
+        writer.writeAttribute(attr.name(), attr.value());
+    }
+
+    for (QDomNode node(el.firstChild()); !node.isNull(); node = node.nextSibling()) {
+        if (node.isElement()) {
+            writeElement(writer, node.toElement());
+        } else if (node.isCDATASection()) {
+            writer.writeCDATA(node.nodeValue());
+        } else if (node.isText()) {
+            writer.writeCharacters(node.nodeValue());
+        }
+    }
+
+    writer.writeEndElement();
+}
+
+/**
+ * \brief The filter settings the records of a journal replace.
+ *
+ * Records are small, so they are collected in a DOM, while the
+ * project they apply to is only ever streamed through.
+ */
+class JournalOverlay
+{
+public:
+    /**
+     * \brief Collects the records of a journal.
+     *
+     * Collection stops at the first incomplete or broken record, which is
+     * what a crash in the middle of writing one leaves behind.
+     *
+     * \return The number of bytes of \p journal collected, including the
+     *         header, or -1 if \p journal doesn't belong to \p project_data.
+     */
+    int load(QByteArray const& journal, QByteArray const& project_data);
+
+    bool isEmpty() const
+    {
+        return m_order.empty();
+    }
+
+    /**
+     * \brief Writes \p project_data with the collected settings
+     *        replacing its own into \p result.
+     *
+     * \return false if \p project_data is not well-formed.
+     */
+    bool apply(QByteArray const& project_data, QByteArray& result) const;
+private:
+    struct FilterUpdate
+    {
+        /**
+         * The complete settings of a filter if \p full is set,
+         * otherwise filter-wide attributes and the page and image
+         * elements replacing those with ids in \p replacedIds.
+         */
+        QDomElement el;
+        std::set<QString> replacedIds;
+        bool full;
+
+        FilterUpdate() : full(false) {}
+    };
+
+    void addRecord(QDomElement const& record_el);
+
+    void writeUnwritten(QXmlStreamWriter& writer, std::set<QString>& written) const;
+
+    QDomDocument m_doc;
+    std::map<QString, FilterUpdate> m_updates;
+    std::vector<QString> m_order;
+};
+
+int
+JournalOverlay::load(QByteArray const& journal, QByteArray const& project_data)
+{
+    QByteArray const header(journalHeader(hashOf(project_data)));
+    if (!journal.startsWith(header)) {
+        return -1;
+    }
+
+    int pos = header.size();
+    while (pos < journal.size()) {
+        int const eol = journal.indexOf('\n', pos);
+        if (eol < 0) {
+            break;
+        }
+
+        bool ok = true;
+        int const size = journal.mid(pos, eol - pos).toInt(&ok);
+        int const end = eol + 1 + size;
+        if (!ok || size < 0 || end >= journal.size() || journal[end] != '\n') {
+            break;
+        }
+
+        QDomDocument record_doc;
+        if (!record_doc.setContent(journal.mid(eol + 1, size))) {
+            break;
+        }
+
+        addRecord(record_doc.documentElement());
+        pos = end + 1;
+    }
+
+    return pos;
+}
+
+void
+JournalOverlay::addRecord(QDomElement const& record_el)
+{
+    QDomElement update_el(record_el.firstChildElement("update"));
+    for (; !update_el.isNull(); update_el = update_el.nextSiblingElement("update")) {
+        QDomElement new_filter_el(
+            m_doc.importNode(update_el.firstChildElement(), true).toElement()
+        );
+        if (new_filter_el.isNull()) {
+            continue;
+        }
+
+        QString const name(new_filter_el.tagName());
+        std::map<QString, FilterUpdate>::iterator it(m_updates.find(name));
+        if (it == m_updates.end()) {
+            it = m_updates.insert(std::make_pair(name, FilterUpdate())).first;
+            m_order.push_back(name);
+        } else if (!it->second.el.isNull() && update_el.hasAttribute("ids")) {
+            FilterUpdate& update = it->second;
+
+            std::set<QString> ids;
+            for (QString const& id : update_el.attribute("ids").split(' ', QString::SkipEmptyParts)) {
+                ids.insert(id);
+            }
+
+            // Filter-wide settings always come along.
+            QDomNamedNodeMap const attrs(new_filter_el.attributes());
+            for (int i = 0; i < attrs.count(); ++i) {
+                QDomAttr const attr(attrs.item(i).toAttr());
+                update.el.setAttribute(attr.name(), attr.value());
+            }
+
+            // Numeric ids are unique across images and pages,
+            // so there is no need to look at the tag names.
+            QDomElement el(update.el.firstChildElement());
+            while (!el.isNull()) {
+                QDomElement const next(el.nextSiblingElement());
+                if (ids.find(el.attribute("id")) != ids.end()) {
+                    update.el.removeChild(el);
+                }
+                el = next;
+            }
+
+            while (!new_filter_el.firstChild().isNull()) {
+                update.el.appendChild(new_filter_el.firstChild());
+            }
+
+            if (!update.full) {
+                update.replacedIds.insert(ids.begin(), ids.end());
+            }
+            continue;
+        }
+
+        FilterUpdate& update = it->second;
+        update.el = new_filter_el;
+        update.full = !update_el.hasAttribute("ids");
+        update.replacedIds.clear();
+        if (!update.full) {
+            for (QString const& id : update_el.attribute("ids").split(' ', QString::SkipEmptyParts)) {
+                update.replacedIds.insert(id);
+            }
+        }
+    }
+}
+
+bool
+JournalOverlay::apply(QByteArray const& project_data, QByteArray& result) const
+{
+    QByteArray out;
+    QXmlStreamWriter writer(&out);
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(2);
+
+    QXmlStreamReader reader(project_data);
+    std::set<QString> written;
+    int depth = 0;
+    bool in_filters = false;
+    bool filters_seen = false;
+
+    // Set while copying a filter element some records only partially cover.
+    FilterUpdate const* patching = 0;
+
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::StartElement: {
+            ++depth;
+            QString const name(reader.name().toString());
+
+            if (depth == 2 && name == "filters" && !filters_seen) {
+                in_filters = true;
+                filters_seen = true;
+            } else if (depth == 3 && in_filters) {
+                std::map<QString, FilterUpdate>::const_iterator const it(m_updates.find(name));
+                if (it != m_updates.end()) {
+                    written.insert(name);
+                    if (it->second.full) {
+                        writeElement(writer, it->second.el);
+                        reader.skipCurrentElement();
+                        --depth;
+                        break;
+                    }
+
+                    patching = &it->second;
+                    writer.writeStartElement(name);
+                    for (QXmlStreamAttribute const& attr : reader.attributes()) {
+                        QString const attr_name(attr.qualifiedName().toString());
+                        if (!patching->el.hasAttribute(attr_name)) {
+                            writer.writeAttribute(attr);
+                        }
+                    }
+                    QDomNamedNodeMap const attrs(patching->el.attributes());
+                    for (int i = 0; i < attrs.count(); ++i) {
+                        QDomAttr const attr(attrs.item(i).toAttr());
+                        writer.writeAttribute(attr.name(), attr.value());
+                    }
+                    break;
+                }
+            } else if (depth == 4 && patching) {
+                QString const id(reader.attributes().value("id").toString());
+                if (patching->replacedIds.find(id) != patching->replacedIds.end()) {
+                    reader.skipCurrentElement();
+                    --depth;
+                    break;
+                }
+            }
+
+            writer.writeStartElement(reader.qualifiedName().toString());
+            writer.writeAttributes(reader.attributes());
+            break;
+        }
+        case QXmlStreamReader::EndElement:
+            if (depth == 3 && patching) {
+                for (QDomElement el(patching->el.firstChildElement());
+                        !el.isNull(); el = el.nextSiblingElement()) {
+                    writeElement(writer, el);
+                }
+                patching = 0;
+            } else if (depth == 2 && in_filters) {
+                writeUnwritten(writer, written);
+                in_filters = false;
+            } else if (depth == 1 && !filters_seen) {
+                writer.writeStartElement("filters");
+                writeUnwritten(writer, written);
+                writer.writeEndElement();
+            }
+            writer.writeEndElement();
+            --depth;
+            break;
+        case QXmlStreamReader::Characters:
+            if (reader.isCDATA()) {
+                writer.writeCDATA(reader.text().toString());
+            } else if (!reader.isWhitespace()) {
+                writer.writeCharacters(reader.text().toString());
+            }
+            break;
+        case QXmlStreamReader::Comment:
+            writer.writeComment(reader.text().toString());
+            break;
+        case QXmlStreamReader::ProcessingInstruction:
+            writer.writeProcessingInstruction(
+                reader.processingInstructionTarget().toString(),
+                reader.processingInstructionData().toString()
+            );
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (reader.hasError()) {
+        return false;
+    }
+
+    result = out;
+    return true;
+}
+
+void
+JournalOverlay::writeUnwritten(QXmlStreamWriter& writer, std::set<QString>& written) const
+{
+    for (QString const& name : m_order) {
+        if (written.insert(name).second) {
+            writeElement(writer, m_updates.find(name)->second.el);
+        }
+    }
+}
+
+} // anonymous namespace
+
+/*========================== ProjectJournal::Shared ========================*/
+
+/**
+ * The state shared with a merge running in the background.
+ * Access to everything here has to be protected by the mutex,
+ * which also serializes access to the project file and the journal.
+ */
+class ProjectJournal::Shared : public RefCountable
+{
+public:
+    Shared() : projectSize(0), generation(0), mergePending(false) {}
+
+    QMutex mutex;
+
+    /**
+     * The project file being journaled, or an empty string if none.
+     */
+    QString projectFile;
+
+    QByteArray structureHash;
+
+    int projectSize;
+
+    /**
+     * Incremented whenever a journal is started or stopped, which
+     * makes merges scheduled earlier discard their results.
+     */
+    int generation;
+
+    bool mergePending;
+};
+
+/*======================== ProjectJournal::MergeTask =======================*/
+
+class ProjectJournal::MergeTask :
+    public AbstractCommand0<BackgroundExecutor::TaskResultPtr>
+{
+public:
+    MergeTask(IntrusivePtr<Shared> const& shared, int generation);
+
+    virtual BackgroundExecutor::TaskResultPtr operator()();
+private:
+    bool merge();
+
+    IntrusivePtr<Shared> m_ptrShared;
+    int m_generation;
+};
+
+ProjectJournal::MergeTask::MergeTask(
+    IntrusivePtr<Shared> const& shared, int const generation)
+    :   m_ptrShared(shared),
+        m_generation(generation)
+{
+}
+
+BackgroundExecutor::TaskResultPtr
+ProjectJournal::MergeTask::operator()()
+{
+    bool const merged = merge();
+
+    QMutexLocker const locker(&m_ptrShared->mutex);
+    if (m_ptrShared->generation == m_generation) {
+        m_ptrShared->mergePending = false;
+        if (!merged) {
+            // The next append() will fail and lead to a full save.
+            m_ptrShared->projectFile.clear();
+            ++m_ptrShared->generation;
+        }
+    }
+
+    return BackgroundExecutor::TaskResultPtr();
+}
+
+bool
+ProjectJournal::MergeTask::merge()
+{
+    QString project_file;
+    QByteArray project_data;
+    QByteArray journal;
+
+    {
+        QMutexLocker const locker(&m_ptrShared->mutex);
+        if (m_ptrShared->generation != m_generation) {
+            return true;
+        }
+
+        project_file = m_ptrShared->projectFile;
+        if (!readFile(project_file, project_data)
+                || !readFile(journalPath(project_file), journal)) {
+            return false;
+        }
+    }
+
+    // The expensive part happens without holding the lock.
+    JournalOverlay overlay;
+    int const merged_size = overlay.load(journal, project_data);
+    if (merged_size < 0) {
+        return false;
+    }
+
+    QByteArray merged_data;
+    if (!overlay.apply(project_data, merged_data)) {
+        return false;
+    }
+
+    QMutexLocker const locker(&m_ptrShared->mutex);
+    if (m_ptrShared->generation != m_generation) {
+        // A full save or a new journal supersedes this merge.
+        return true;
+    }
+
+    // Records appended in the meantime are carried over.
+    QByteArray current_journal;
+    if (!readFile(journalPath(project_file), current_journal)
+            || !current_journal.startsWith(journal.left(merged_size))) {
+        return false;
+    }
+
+    if (!overwriteFile(project_file, merged_data)) {
+        return false;
+    }
+
+    QByteArray const new_journal(
+        journalHeader(hashOf(merged_data)) + current_journal.mid(merged_size)
+    );
+    if (!overwriteFile(journalPath(project_file), new_journal)) {
+        // The old journal doesn't match the new project file anymore,
+        // so replay() would ignore it anyway.
+        ProjectJournal::remove(project_file);
+        return false;
+    }
+
+    m_ptrShared->projectSize = merged_data.size();
+    return true;
+}
+
+/*============================= ProjectJournal =============================*/
+
+ProjectJournal::ProjectJournal()
+    :   m_ptrShared(new Shared)
+{
+}
+
+ProjectJournal::~ProjectJournal()
+{
+    // m_executor is destroyed first and waits for a merge in progress.
+}
+
+QString
+ProjectJournal::journalPath(QString const& project_file)
+{
+    return project_file + QLatin1String(".journal");
+}
+
+bool
+ProjectJournal::replay(QString const& project_file, QByteArray& project_data)
+{
+    QByteArray journal;
+    if (!readFile(journalPath(project_file), journal)) {
+        return false;
+    }
+
+    // Don't bother parsing the project if the journal isn't for it,
+    // or if nothing was journaled since it was written.
+    JournalOverlay overlay;
+    if (overlay.load(journal, project_data) < 0 || overlay.isEmpty()) {
+        return false;
+    }
+
+    QByteArray replayed;
+    if (!overlay.apply(project_data, replayed)) {
+        return false;
+    }
+
+    project_data = replayed;
+    return true;
+}
+
+void
+ProjectJournal::remove(QString const& project_file)
+{
+    QFile::remove(journalPath(project_file));
+}
+
+void
+ProjectJournal::beginFullSave(std::vector<FilterPtr> const& filters)
+{
+    stop();
+    collectChanges(filters);
+}
+
+bool
+ProjectJournal::start(QString const& project_file, ProjectWriter const& writer)
+{
+    stop();
+
+    QByteArray project_data;
+    if (!readFile(project_file, project_data)) {
+        return false;
+    }
+
+    QMutexLocker const locker(&m_ptrShared->mutex);
+
+    if (!overwriteFile(journalPath(project_file), journalHeader(hashOf(project_data)))) {
+        return false;
+    }
+
+    m_ptrShared->projectFile = project_file;
+    m_ptrShared->structureHash = writer.structureHash();
+    m_ptrShared->projectSize = project_data.size();
+
+    // Everything collected by beginFullSave() is in the project file.
+    m_pendingChanges.clear();
+
+    return true;
+}
+
+bool
+ProjectJournal::append(
+    QString const& project_file, ProjectWriter const& writer,
+    std::vector<FilterPtr> const& filters)
+{
+    collectChanges(filters);
+
+    {
+        QMutexLocker const locker(&m_ptrShared->mutex);
+        if (m_ptrShared->projectFile != project_file
+                || m_ptrShared->structureHash != writer.structureHash()) {
+            return false;
+        }
+    }
+
+    QDomDocument doc;
+    QDomElement record_el(doc.createElement("journal-record"));
+    doc.appendChild(record_el);
+
+    for (size_t i = 0; i < filters.size(); ++i) {
+        PendingChanges const& changes = m_pendingChanges[i];
+
+        QDomElement update_el(doc.createElement("update"));
+        if (changes.all) {
+            update_el.appendChild(filters[i]->saveSettings(writer, doc));
+        } else if (!changes.pages.empty()) {
+            // Pages without settings have to be covered as well,
+            // as their old settings have to go.
+            QStringList ids;
+            writer.enumImages(changes.pages, [&ids](ImageId const&, int numeric_id) {
+                ids.push_back(QString::number(numeric_id));
+            });
+            writer.enumPages(changes.pages, [&ids](PageId const&, int numeric_id) {
+                ids.push_back(QString::number(numeric_id));
+            });
+            update_el.setAttribute("ids", ids.join(' '));
+            update_el.appendChild(
+                filters[i]->savePageSettings(writer, doc, changes.pages)
+            );
+        } else {
+            continue;
+        }
+        record_el.appendChild(update_el);
+    }
+
+    if (!record_el.hasChildNodes()) {
+        return true;
+    }
+
+    QByteArray const record(doc.toByteArray(-1));
+
+    QMutexLocker const locker(&m_ptrShared->mutex);
+    if (m_ptrShared->projectFile != project_file) {
+        // A failed merge stopped journaling.
+        return false;
+    }
+
+    QFile file(journalPath(project_file));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+
+    QByteArray const chunk(QByteArray::number(record.size()) + '\n' + record + '\n');
+    if (file.write(chunk) != chunk.size() || !file.flush()) {
+        // Whatever got written is an incomplete record that would hide
+        // the ones after it.  Start over with a full save.
+        m_ptrShared->projectFile.clear();
+        ++m_ptrShared->generation;
+        return false;
+    }
+
+    m_pendingChanges.clear();
+
+    if (!m_ptrShared->mergePending
+            && file.size() > m_ptrShared->projectSize / MERGE_RATIO) {
+        m_ptrShared->mergePending = true;
+        m_executor.enqueueTask(
+            BackgroundExecutor::TaskPtr(
+                new MergeTask(m_ptrShared, m_ptrShared->generation)
+            )
+        );
+    }
+
+    return true;
+}
+
+void
+ProjectJournal::stop()
+{
+    QMutexLocker const locker(&m_ptrShared->mutex);
+    m_ptrShared->projectFile.clear();
+    m_ptrShared->mergePending = false;
+    ++m_ptrShared->generation;
+}
+
+void
+ProjectJournal::collectChanges(std::vector<FilterPtr> const& filters)
+{
+    m_pendingChanges.resize(filters.size());
+
+    for (size_t i = 0; i < filters.size(); ++i) {
+        PendingChanges& changes = m_pendingChanges[i];
+        if (!filters[i]->takeChangedPages(changes.pages)) {
+            changes.all = true;
+        }
+        if (changes.all) {
+            changes.pages.clear();
+        }
+    }
+}
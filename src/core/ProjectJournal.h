@@ -0,0 +1,140 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTJOURNAL_H_
+#define PROJECTJOURNAL_H_
+
+#include "NonCopyable.h"
+#include "IntrusivePtr.h"
+#include "PageId.h"
+#include "BackgroundExecutor.h"
+#include <QString>
+#include <vector>
+#include <set>
+
+class AbstractFilter;
+class ProjectWriter;
+class QByteArray;
+
+/**
+ * \brief Saves a project incrementally, by appending the settings of
+ *        changed pages to a journal file next to the project file.
+ *
+ * A journal is started right after the project file was written in full.
+ * From then on, append() writes the settings of the pages that changed
+ * since the previous call.  The journal is bound to the exact contents of
+ * the project file it was started for, so a project file written by other
+ * means makes it stale, and replay() will ignore it.
+ * \par
+ * Once the journal grows large compared to the project file, it's merged
+ * into the project file in a background thread.  That doesn't touch
+ * any filter settings, only the files.
+ * \par
+ * Apart from replay(), which is static, this class is meant to be used
+ * from a single thread.
+ */
+class ProjectJournal
+{
+    DECLARE_NON_COPYABLE(ProjectJournal)
+public:
+    typedef IntrusivePtr<AbstractFilter> FilterPtr;
+
+    ProjectJournal();
+
+    /**
+     * \brief Waits for a merge in progress to finish, then destroys the object.
+     */
+    ~ProjectJournal();
+
+    /**
+     * \brief Returns the path of the journal belonging to a project file.
+     */
+    static QString journalPath(QString const& project_file);
+
+    /**
+     * \brief Applies the journal of a project file to its contents.
+     *
+     * \param project_file The path of the project file.
+     * \param[in,out] project_data The raw contents of \p project_file.
+     *        If a journal is applied, they are replaced with the result.
+     * \return true if a journal belonging to \p project_data was found
+     *         and had changes to apply.  A journal started for different
+     *         contents of the project file is ignored.  The project is
+     *         streamed through rather than loaded into a DOM.
+     */
+    static bool replay(QString const& project_file, QByteArray& project_data);
+
+    /**
+     * \brief Removes the journal of a project file.
+     */
+    static void remove(QString const& project_file);
+
+    /**
+     * \brief To be called right before writing the project in full.
+     *
+     * Stops journaling and collects the changes made so far, as the file
+     * about to be written will contain them.  If start() isn't called
+     * afterwards, they will be written by the next append().
+     */
+    void beginFullSave(std::vector<FilterPtr> const& filters);
+
+    /**
+     * \brief Starts a new journal for a project file that has just been
+     *        written in full.
+     *
+     * \param project_file The project file written after beginFullSave().
+     * \param writer The ProjectWriter that wrote it.
+     */
+    bool start(QString const& project_file, ProjectWriter const& writer);
+
+    /**
+     * \brief Appends the settings of the pages that changed since the
+     *        previous call.
+     *
+     * \return false if the project has to be written in full instead.
+     *         That happens if the journal wasn't started for \p project_file,
+     *         if the set of pages changed since, or if the journal couldn't
+     *         be written.  The changes are kept for the next attempt.
+     */
+    bool append(
+        QString const& project_file, ProjectWriter const& writer,
+        std::vector<FilterPtr> const& filters);
+
+    /**
+     * \brief Stops journaling.  The journal file is left as it is.
+     */
+    void stop();
+private:
+    class Shared;
+    class MergeTask;
+
+    struct PendingChanges {
+        std::set<PageId> pages;
+        bool all;
+
+        PendingChanges() : all(false) {}
+    };
+
+    void collectChanges(std::vector<FilterPtr> const& filters);
+
+    IntrusivePtr<Shared> m_ptrShared;
+    std::vector<PendingChanges> m_pendingChanges;
+    BackgroundExecutor m_executor;
+};
+
+#endif
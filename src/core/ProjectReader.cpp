@@ -24,53 +24,120 @@
 #include "Dpi.h"
 #include <QSize>
 #include <QDir>
+#include <QDomDocument>
 #include <QDomElement>
-#include <QDomNode>
+#include <QXmlStreamReader>
+#include <QLatin1String>
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
 #endif
 #include <set>
 
-ProjectReader::ProjectReader(QDomDocument const& doc)
-    :   m_doc(doc),
-        m_ptrDisambiguator(new FileNameDisambiguator)
+namespace
 {
-    QDomElement project_el(m_doc.documentElement());
-    m_outDir = project_el.attribute("outputDirectory");
 
-    Qt::LayoutDirection layout_direction = Qt::LeftToRight;
-    if (project_el.attribute("layoutDirection") == "RTL") {
-        layout_direction = Qt::RightToLeft;
+void copyAttributes(QXmlStreamReader const& reader, QDomElement& el)
+{
+    for (QXmlStreamAttribute const& attr : reader.attributes()) {
+        el.setAttribute(attr.qualifiedName().toString(), attr.value().toString());
     }
+}
 
-    QDomElement const dirs_el(project_el.namedItem("directories").toElement());
-    if (dirs_el.isNull()) {
-        return;
+/**
+ * \brief Turns the element \p reader is positioned at into DOM.
+ *
+ * The element is consumed along with its children.  The result
+ * is the same QDomDocument::setContent() would produce for it.
+ */
+QDomElement readElement(QXmlStreamReader& reader, QDomDocument& doc)
+{
+    QDomElement el(doc.createElement(reader.qualifiedName().toString()));
+    copyAttributes(reader, el);
+
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::StartElement:
+            el.appendChild(readElement(reader, doc));
+            break;
+        case QXmlStreamReader::Characters:
+            if (!reader.isWhitespace()) {
+                el.appendChild(doc.createTextNode(reader.text().toString()));
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            return el;
+        default:
+            break;
+        }
     }
-    processDirectories(dirs_el);
 
-    QDomElement const files_el(project_el.namedItem("files").toElement());
-    if (files_el.isNull()) {
+    return el;
+}
+
+} // anonymous namespace
+
+ProjectReader::ProjectReader(QByteArray const& data)
+    :   m_data(data),
+        m_ptrDisambiguator(new FileNameDisambiguator)
+{
+    QXmlStreamReader reader(m_data);
+    reader.setNamespaceProcessing(false);
+    if (!reader.readNextStartElement()) {
         return;
     }
-    processFiles(files_el);
 
-    QDomElement const images_el(project_el.namedItem("images").toElement());
-    if (images_el.isNull()) {
-        return;
+    m_outDir = reader.attributes().value("outputDirectory").toString();
+
+    Qt::LayoutDirection layout_direction = Qt::LeftToRight;
+    if (reader.attributes().value("layoutDirection") == QLatin1String("RTL")) {
+        layout_direction = Qt::RightToLeft;
     }
-    processImages(images_el, layout_direction);
 
-    QDomElement const pages_el(project_el.namedItem("pages").toElement());
-    if (pages_el.isNull()) {
+    // The sections are expected in the order ProjectWriter writes them,
+    // as each one refers to the ids defined by the previous ones.
+    QDomDocument doc;
+    QDomElement disambig_el;
+    std::vector<ImageInfo> images;
+    bool dirs_found = false;
+    bool files_found = false;
+    bool images_found = false;
+    while (reader.readNextStartElement()) {
+        if (reader.name() == QLatin1String("directories")) {
+            dirs_found = true;
+            while (reader.readNextStartElement()) {
+                processDirectory(readElement(reader, doc));
+            }
+        } else if (reader.name() == QLatin1String("files")) {
+            files_found = true;
+            while (reader.readNextStartElement()) {
+                processFile(readElement(reader, doc));
+            }
+        } else if (reader.name() == QLatin1String("images")) {
+            images_found = true;
+            while (reader.readNextStartElement()) {
+                processImage(readElement(reader, doc), images);
+            }
+        } else if (reader.name() == QLatin1String("pages")) {
+            while (reader.readNextStartElement()) {
+                processPage(readElement(reader, doc));
+            }
+        } else if (reader.name() == QLatin1String("file-name-disambiguation")) {
+            disambig_el = readElement(reader, doc);
+        } else {
+            // That includes <filters>, which readFilterSettings() takes care of.
+            // Skipping it still checks it's well-formed.
+            reader.skipCurrentElement();
+        }
+    }
+
+    // These sections are required, though they may be empty.
+    if (reader.hasError() || !(dirs_found && files_found && images_found)) {
         return;
     }
-    processPages(pages_el);
+
+    m_ptrPages.reset(new ProjectPages(images, layout_direction));
 
     // Load naming disambiguator.  This needs to be done after processing pages.
-    QDomElement const disambig_el(
-        project_el.namedItem("file-name-disambiguation").toElement()
-    );
     m_ptrDisambiguator.reset(
         new FileNameDisambiguator(
             disambig_el, boost::bind(&ProjectReader::expandFilePath, this, _1)
@@ -85,153 +152,154 @@ ProjectReader::~ProjectReader()
 void
 ProjectReader::readFilterSettings(std::vector<FilterPtr> const& filters) const
 {
-    QDomElement project_el(m_doc.documentElement());
-    QDomElement filters_el(project_el.namedItem("filters").toElement());
-
-    std::vector<FilterPtr>::const_iterator it(filters.begin());
-    std::vector<FilterPtr>::const_iterator const end(filters.end());
-    for (; it != end; ++it) {
-        (*it)->loadSettings(*this, filters_el);
+    std::vector<bool> loaded(filters.size(), false);
+
+    QXmlStreamReader reader(m_data);
+    reader.setNamespaceProcessing(false);
+    if (reader.readNextStartElement()) {
+        while (reader.readNextStartElement()) {
+            if (reader.name() == QLatin1String("filters")) {
+                break;
+            }
+            reader.skipCurrentElement();
+        }
     }
-}
 
-void
-ProjectReader::processDirectories(QDomElement const& dirs_el)
-{
-    QString const dir_tag_name("directory");
-
-    QDomNode node(dirs_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
+    while (reader.readNextStartElement()) {
+        // Like QDomNode::namedItem(), take the first element with a given name.
+        QString const name(reader.qualifiedName().toString());
+        size_t idx = 0;
+        for (; idx < filters.size(); ++idx) {
+            if (!loaded[idx] && filters[idx]->settingsElementName() == name) {
+                break;
+            }
         }
-        if (node.nodeName() != dir_tag_name) {
+        if (idx == filters.size()) {
+            reader.skipCurrentElement();
             continue;
         }
-        QDomElement el(node.toElement());
+        loaded[idx] = true;
 
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
+        QDomDocument doc;
+        QDomElement filter_el(doc.createElement(name));
+        copyAttributes(reader, filter_el);
+        filters[idx]->loadFilterSettings(*this, filter_el);
 
-        QString const path(el.attribute("path"));
-        if (path.isEmpty()) {
-            continue;
+        while (reader.readNextStartElement()) {
+            filters[idx]->loadPageSettings(*this, readElement(reader, doc));
         }
+    }
 
-        m_dirMap.insert(DirMap::value_type(id, path));
-        m_inputDir = path;
+    for (size_t i = 0; i < filters.size(); ++i) {
+        if (!loaded[i]) {
+            filters[i]->loadFilterSettings(*this, QDomElement());
+        }
     }
 }
 
 void
-ProjectReader::processFiles(QDomElement const& files_el)
+ProjectReader::processDirectory(QDomElement const& el)
 {
-    QString const file_tag_name("file");
-
-    QDomNode node(files_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != file_tag_name) {
-            continue;
-        }
-        QDomElement el(node.toElement());
-
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-        int const dir_id = el.attribute("dirId").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-
-        QString const name(el.attribute("name"));
-        if (name.isEmpty()) {
-            continue;
-        }
-
-        QString const dir_path(getDirPath(dir_id));
-        if (dir_path.isEmpty()) {
-            continue;
-        }
+    if (el.tagName() != "directory") {
+        return;
+    }
 
-        // Backwards compatibility.
-        bool const compat_multi_page = (el.attribute("multiPage") == "1");
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
+    }
 
-        QString const file_path(QDir(dir_path).filePath(name));
-        FileRecord const rec(file_path, compat_multi_page);
-        m_fileMap.insert(FileMap::value_type(id, rec));
+    QString const path(el.attribute("path"));
+    if (path.isEmpty()) {
+        return;
     }
+
+    m_dirMap.insert(DirMap::value_type(id, path));
+    m_inputDir = path;
 }
 
 void
-ProjectReader::processImages(
-    QDomElement const& images_el,
-    Qt::LayoutDirection const layout_direction)
+ProjectReader::processFile(QDomElement const& el)
 {
-    QString const image_tag_name("image");
+    if (el.tagName() != "file") {
+        return;
+    }
 
-    std::vector<ImageInfo> images;
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
+    }
+    int const dir_id = el.attribute("dirId").toInt(&ok);
+    if (!ok) {
+        return;
+    }
 
-    QDomNode node(images_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != image_tag_name) {
-            continue;
-        }
-        QDomElement el(node.toElement());
+    QString const name(el.attribute("name"));
+    if (name.isEmpty()) {
+        return;
+    }
 
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-        int const sub_pages = el.attribute("subPages").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-        int const file_id = el.attribute("fileId").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-        int const file_image = el.attribute("fileImage").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
+    QString const dir_path(getDirPath(dir_id));
+    if (dir_path.isEmpty()) {
+        return;
+    }
 
-        QString const removed(el.attribute("removed"));
-        bool const left_half_removed = (removed == "L");
-        bool const right_half_removed = (removed == "R");
+    // Backwards compatibility.
+    bool const compat_multi_page = (el.attribute("multiPage") == "1");
 
-        FileRecord const file_record(getFileRecord(file_id));
-        if (file_record.filePath.isEmpty()) {
-            continue;
-        }
-        ImageId const image_id(
-            file_record.filePath,
-            file_image + int(file_record.compatMultiPage)
-        );
-        ImageMetadata const metadata(processImageMetadata(el));
-        ImageInfo const image_info(
-            image_id, metadata, sub_pages,
-            left_half_removed, right_half_removed
-        );
+    QString const file_path(QDir(dir_path).filePath(name));
+    FileRecord const rec(file_path, compat_multi_page);
+    m_fileMap.insert(FileMap::value_type(id, rec));
+}
 
-        images.push_back(image_info);
-        m_imageMap.insert(ImageMap::value_type(id, image_info));
+void
+ProjectReader::processImage(
+    QDomElement const& el, std::vector<ImageInfo>& images)
+{
+    if (el.tagName() != "image") {
+        return;
     }
 
-    if (!images.empty()) {
-        m_ptrPages.reset(new ProjectPages(images, layout_direction));
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
     }
+    int const sub_pages = el.attribute("subPages").toInt(&ok);
+    if (!ok) {
+        return;
+    }
+    int const file_id = el.attribute("fileId").toInt(&ok);
+    if (!ok) {
+        return;
+    }
+    int const file_image = el.attribute("fileImage").toInt(&ok);
+    if (!ok) {
+        return;
+    }
+
+    QString const removed(el.attribute("removed"));
+    bool const left_half_removed = (removed == "L");
+    bool const right_half_removed = (removed == "R");
+
+    FileRecord const file_record(getFileRecord(file_id));
+    if (file_record.filePath.isEmpty()) {
+        return;
+    }
+    ImageId const image_id(
+        file_record.filePath,
+        file_image + int(file_record.compatMultiPage)
+    );
+    ImageMetadata const metadata(processImageMetadata(el));
+    ImageInfo const image_info(
+        image_id, metadata, sub_pages,
+        left_half_removed, right_half_removed
+    );
+
+    images.push_back(image_info);
+    m_imageMap.insert(ImageMap::value_type(id, image_info));
 }
 
 ImageMetadata
@@ -259,50 +327,41 @@ ProjectReader::processImageMetadata(QDomElement const& image_el)
 }
 
 void
-ProjectReader::processPages(QDomElement const& pages_el)
+ProjectReader::processPage(QDomElement const& el)
 {
-    QString const page_tag_name("page");
-
-    QDomNode node(pages_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != page_tag_name) {
-            continue;
-        }
-        QDomElement el(node.toElement());
+    if (el.tagName() != "page") {
+        return;
+    }
 
-        bool ok = true;
+    bool ok = true;
 
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
+    }
 
-        int const image_id = el.attribute("imageId").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
+    int const image_id = el.attribute("imageId").toInt(&ok);
+    if (!ok) {
+        return;
+    }
 
-        PageId::SubPage const sub_page = PageId::subPageFromString(
-                                             el.attribute("subPage"), &ok
-                                         );
-        if (!ok) {
-            continue;
-        }
+    PageId::SubPage const sub_page = PageId::subPageFromString(
+                                         el.attribute("subPage"), &ok
+                                     );
+    if (!ok) {
+        return;
+    }
 
-        ImageInfo const image(getImageInfo(image_id));
-        if (image.id().filePath().isEmpty()) {
-            continue;
-        }
+    ImageInfo const image(getImageInfo(image_id));
+    if (image.id().filePath().isEmpty()) {
+        return;
+    }
 
-        PageId const page_id(image.id(), sub_page);
-        m_pageMap.insert(PageMap::value_type(id, page_id));
+    PageId const page_id(image.id(), sub_page);
+    m_pageMap.insert(PageMap::value_type(id, page_id));
 
-        if (el.attribute("selected") == "selected") {
-            m_selectedPage.set(page_id, PAGE_VIEW);
-        }
+    if (el.attribute("selected") == "selected") {
+        m_selectedPage.set(page_id, PAGE_VIEW);
     }
 }
 
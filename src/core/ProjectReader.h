@@ -26,7 +26,7 @@
 #include "SelectedPage.h"
 #include "IntrusivePtr.h"
 #include <QString>
-#include <QDomDocument>
+#include <QByteArray>
 #include <Qt>
 #include <vector>
 #include <map>
@@ -37,15 +37,35 @@ class ProjectPages;
 class FileNameDisambiguator;
 class AbstractFilter;
 
+/**
+ * \brief Loads a project written by ProjectWriter.
+ *
+ * The project file is parsed with QXmlStreamReader, and only a single
+ * page, image or file record is turned into DOM at a time.  That keeps
+ * memory usage small even for projects with tens of thousands of pages.
+ */
 class ProjectReader
 {
 public:
     typedef IntrusivePtr<AbstractFilter> FilterPtr;
 
-    ProjectReader(QDomDocument const& doc);
+    /**
+     * \brief Reads everything but filter settings.
+     *
+     * \param data The contents of a project file.  If it's not well-formed
+     *        XML, success() will return false.
+     */
+    ProjectReader(QByteArray const& data);
 
     ~ProjectReader();
 
+    /**
+     * \brief Loads the settings of each filter from its element
+     *        under \<filters\>.
+     *
+     * Every filter gets its AbstractFilter::loadFilterSettings() called,
+     * even those the project has no settings for.
+     */
     void readFilterSettings(std::vector<FilterPtr> const& filters) const;
 
     bool success() const
@@ -97,16 +117,15 @@ private:
     typedef std::map<int, ImageInfo> ImageMap;
     typedef std::map<int, PageId> PageMap;
 
-    void processDirectories(QDomElement const& dirs_el);
+    void processDirectory(QDomElement const& el);
 
-    void processFiles(QDomElement const& files_el);
+    void processFile(QDomElement const& el);
 
-    void processImages(QDomElement const& images_el,
-                       Qt::LayoutDirection layout_direction);
+    void processImage(QDomElement const& el, std::vector<ImageInfo>& images);
 
     ImageMetadata processImageMetadata(QDomElement const& image_el);
 
-    void processPages(QDomElement const& pages_el);
+    void processPage(QDomElement const& el);
 
     QString getDirPath(int id) const;
 
@@ -116,7 +135,7 @@ private:
 
     ImageInfo getImageInfo(int id) const;
 
-    QDomDocument m_doc;
+    QByteArray m_data;
     QString m_outDir;
     QString m_inputDir;
     DirMap m_dirMap;
@@ -30,6 +30,9 @@
 #include <QFile>
 #include <QTextStream>
 #include <QFileInfo>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QBuffer>
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
 #endif
@@ -306,6 +309,74 @@ ProjectWriter::enumPagesImpl(VirtualFunction2<void, PageId const&, int>& out) co
     }
 }
 
+void
+ProjectWriter::enumImagesImpl(
+    std::set<PageId> const& pages,
+    VirtualFunction2<void, ImageId const&, int>& out) const
+{
+    ImageId prev_image_id;
+    for (PageId const& page_id : pages) {
+        // The set is ordered by image first, so this skips the second
+        // sub-page of the same image.
+        if (page_id.imageId() == prev_image_id) {
+            continue;
+        }
+        prev_image_id = page_id.imageId();
+
+        Images::const_iterator const it(m_images.find(page_id.imageId()));
+        if (it != m_images.end()) {
+            out(it->id, it->numericId);
+        }
+    }
+}
+
+void
+ProjectWriter::enumPagesImpl(
+    std::set<PageId> const& pages,
+    VirtualFunction2<void, PageId const&, int>& out) const
+{
+    for (PageId const& page_id : pages) {
+        Pages::const_iterator const it(m_pages.find(page_id));
+        if (it != m_pages.end()) {
+            out(it->id, it->numericId);
+        }
+    }
+}
+
+QByteArray
+ProjectWriter::structureHash() const
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream strm(&buffer);
+
+    strm << m_outFileNameGen.outDir() << int(m_layoutDirection);
+
+    for (Directory const& dir : m_dirs.get<Sequenced>()) {
+        strm << dir.numericId << dir.path;
+    }
+
+    for (File const& file : m_files.get<Sequenced>()) {
+        strm << file.numericId << file.path;
+    }
+
+    for (Image const& image : m_images.get<Sequenced>()) {
+        ImageMetadata const& metadata = m_metadataByImage.find(image.id)->second;
+        strm << image.numericId << image.id.filePath() << image.id.page()
+             << image.numSubPages << image.leftHalfRemoved << image.rightHalfRemoved
+             << metadata.size() << metadata.dpi().horizontal() << metadata.dpi().vertical()
+             << metadata.isGrayScale();
+    }
+
+    for (Page const& page : m_pages.get<Sequenced>()) {
+        strm << page.numericId << imageId(page.id.imageId()) << int(page.id.subPage());
+    }
+
+    buffer.close();
+
+    return QCryptographicHash::hash(buffer.data(), QCryptographicHash::Sha1);
+}
+
 /*======================== ProjectWriter::Image =========================*/
 
 ProjectWriter::Image::Image(PageInfo const& page, int numeric_id)
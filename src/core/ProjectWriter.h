@@ -33,9 +33,11 @@
 #include <boost/multi_index/member.hpp>
 #endif
 #include <QString>
+#include <QByteArray>
 #include <Qt>
 #include <vector>
 #include <map>
+#include <set>
 
 class AbstractFilter;
 class ProjectPages;
@@ -69,6 +71,33 @@ public:
      */
     template<typename OutFunc>
     void enumPages(OutFunc out) const;
+
+    /**
+     * \brief Same as enumImages(OutFunc), but limited to the images
+     *        \p pages belong to.
+     *
+     * Pages that aren't part of the project are skipped.
+     */
+    template<typename OutFunc>
+    void enumImages(std::set<PageId> const& pages, OutFunc out) const;
+
+    /**
+     * \brief Same as enumPages(OutFunc), but limited to \p pages.
+     *
+     * Pages that aren't part of the project are skipped.
+     */
+    template<typename OutFunc>
+    void enumPages(std::set<PageId> const& pages, OutFunc out) const;
+
+    /**
+     * \brief A hash of everything but the filter settings.
+     *
+     * That covers the directories, files, images and pages along with
+     * their numeric ids.  As long as it stays the same, the numeric ids
+     * used by filter settings written by different ProjectWriter objects
+     * refer to the same things.
+     */
+    QByteArray structureHash() const;
 private:
     struct Directory {
         QString path;
@@ -174,6 +203,14 @@ private:
 
     void enumPagesImpl(VirtualFunction2<void, PageId const&, int>& out) const;
 
+    void enumImagesImpl(
+        std::set<PageId> const& pages,
+        VirtualFunction2<void, ImageId const&, int>& out) const;
+
+    void enumPagesImpl(
+        std::set<PageId> const& pages,
+        VirtualFunction2<void, PageId const&, int>& out) const;
+
     PageSequence m_pageSequence;
     OutputFileNameGenerator m_outFileNameGen;
     SelectedPage m_selectedPage;
@@ -201,4 +238,20 @@ ProjectWriter::enumPages(OutFunc out) const
     enumPagesImpl(proxy);
 }
 
+template<typename OutFunc>
+void
+ProjectWriter::enumImages(std::set<PageId> const& pages, OutFunc out) const
+{
+    ProxyFunction2<OutFunc, void, ImageId const&, int> proxy(out);
+    enumImagesImpl(pages, proxy);
+}
+
+template<typename OutFunc>
+void
+ProjectWriter::enumPages(std::set<PageId> const& pages, OutFunc out) const
+{
+    ProxyFunction2<OutFunc, void, PageId const&, int> proxy(out);
+    enumPagesImpl(pages, proxy);
+}
+
 #endif
@@ -24,11 +24,22 @@
 #include <QtGlobal>
 #include <QSysInfo>
 #include <QIODevice>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QString>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
 #include <QImage>
 #include <QColor>
 #include <QSize>
 #include <QDebug>
 #include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
 #include <tiff.h>
 #include <tiffio.h>
 #include <new>
@@ -217,15 +228,258 @@ static toff_t deviceSize(thandle_t context)
     return dev->size();
 }
 
-static int deviceMap(thandle_t, tdata_t*, toff_t*)
+/**
+ * Maps the whole file into memory, letting libtiff read directories
+ * and uncompressed strips in place instead of copying them.
+ * Only files can be mapped, and only when the open mode allows it.
+ */
+static int deviceMap(thandle_t context, tdata_t* base, toff_t* size)
 {
-    // Not implemented.
-    return 0;
+    QFile* file = qobject_cast<QFile*>((QIODevice*)context);
+    if (!file) {
+        return 0;
+    }
+
+    qint64 const file_size = file->size();
+    uchar* const data = file->map(0, file_size);
+    if (!data) {
+        return 0;
+    }
+
+    *base = data;
+    *size = file_size;
+    return 1;
 }
 
-static void deviceUnmap(thandle_t, tdata_t, toff_t)
+static void deviceUnmap(thandle_t context, tdata_t base, toff_t)
 {
-    // Not implemented.
+    QFile* file = qobject_cast<QFile*>((QIODevice*)context);
+    if (file) {
+        file->unmap(static_cast<uchar*>(base));
+    }
+}
+
+/**
+ * \brief Open multi-page files and the offsets of their directories.
+ *
+ * Unless given a directory's offset, libtiff finds a directory by walking
+ * the chain of directories from the first one.  We remember the offsets
+ * of the directories we've seen in every file, and keep a few files open,
+ * so getting to any page is a single seek.  An open file is used by one
+ * thread at a time: it's taken out of the cache while being read
+ * and put back afterwards.
+ */
+class TiffReader::FileCache
+{
+    DECLARE_NON_COPYABLE(FileCache)
+public:
+    /**
+     * Identifies a version of a file, so that we don't use
+     * the offsets of a file that has been overwritten since.
+     */
+    struct Stamp
+    {
+        qint64 size;
+        QDateTime modified;
+
+        Stamp() : size(-1) {}
+
+        explicit Stamp(QFileInfo const& info)
+            : size(info.size()), modified(info.lastModified()) {}
+
+        bool operator==(Stamp const& other) const
+        {
+            return size == other.size && modified == other.modified;
+        }
+    };
+
+    class OpenFile
+    {
+        DECLARE_NON_COPYABLE(OpenFile)
+    public:
+        OpenFile(QString const& path, Stamp const& stamp)
+            : m_path(path), m_stamp(stamp), m_file(path) {}
+
+        bool open();
+
+        QString const& path() const { return m_path; }
+
+        Stamp const& stamp() const { return m_stamp; }
+
+        TiffHeader const& header() const { return m_header; }
+
+        TiffHandle const& tif() const { return *m_ptrTif; }
+    private:
+        QString m_path;
+        Stamp m_stamp;
+        QFile m_file;
+        TiffHeader m_header;
+        std::unique_ptr<TiffHandle> m_ptrTif;
+    };
+
+    static FileCache& instance();
+
+    FileCache();
+
+    /**
+     * \brief Takes an open file out of the cache, or opens a new one.
+     *
+     * \return The open file, or null if it couldn't be opened as a TIFF file.
+     */
+    std::unique_ptr<OpenFile> acquire(QString const& file_path);
+
+    /**
+     * \brief Puts a file taken by acquire() back into the cache.
+     */
+    void release(std::unique_ptr<OpenFile> file);
+
+    void closeFiles();
+
+    std::vector<toff_t> directoryOffsets(QString const& file_path, Stamp const& stamp) const;
+
+    /**
+     * \brief Remembers the offsets of the first offsets.size() directories of a file.
+     */
+    void setDirectoryOffsets(
+        QString const& file_path, Stamp const& stamp, std::vector<toff_t> const& offsets);
+private:
+    struct Index
+    {
+        Stamp stamp;
+        std::vector<toff_t> offsets;
+    };
+
+    mutable QMutex m_mutex;
+    std::list<std::unique_ptr<OpenFile> > m_openFiles; // Most recently used first.
+    std::map<QString, Index> m_indexes;
+    size_t m_maxOpenFiles;
+};
+
+bool
+TiffReader::FileCache::OpenFile::open()
+{
+    // Pages are read from the mapping, so Qt's buffering would only
+    // add a copy to whatever still goes through deviceRead().
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    m_header = readHeader(m_file);
+    if (!checkHeader(m_header)) {
+        return false;
+    }
+
+    TIFF* const tif = TIFFClientOpen(
+        "file", "rB", &m_file, &deviceRead, &deviceWrite,
+        &deviceSeek, &deviceClose, &deviceSize,
+        &deviceMap, &deviceUnmap
+    );
+    if (!tif) {
+        return false;
+    }
+
+    m_ptrTif.reset(new TiffHandle(tif));
+    return true;
+}
+
+TiffReader::FileCache&
+TiffReader::FileCache::instance()
+{
+    static FileCache cache;
+    return cache;
+}
+
+TiffReader::FileCache::FileCache()
+    :   m_maxOpenFiles(std::max(4, QThread::idealThreadCount()))
+{
+}
+
+std::unique_ptr<TiffReader::FileCache::OpenFile>
+TiffReader::FileCache::acquire(QString const& file_path)
+{
+    Stamp const stamp((QFileInfo(file_path)));
+
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        auto it = m_openFiles.begin();
+        while (it != m_openFiles.end()) {
+            if ((*it)->path() != file_path) {
+                ++it;
+            } else if (!((*it)->stamp() == stamp)) {
+                it = m_openFiles.erase(it);
+            } else {
+                std::unique_ptr<OpenFile> file(std::move(*it));
+                m_openFiles.erase(it);
+                return file;
+            }
+        }
+    }
+
+    std::unique_ptr<OpenFile> file(new OpenFile(file_path, stamp));
+    if (!file->open()) {
+        return std::unique_ptr<OpenFile>();
+    }
+
+    // A freshly opened file is positioned at its first directory.
+    if (directoryOffsets(file_path, stamp).empty()) {
+        std::vector<toff_t> const offsets(1, TIFFCurrentDirOffset(file->tif().handle()));
+        setDirectoryOffsets(file_path, stamp, offsets);
+    }
+
+    return file;
+}
+
+void
+TiffReader::FileCache::release(std::unique_ptr<OpenFile> file)
+{
+    QMutexLocker const locker(&m_mutex);
+
+    m_openFiles.push_front(std::move(file));
+    if (m_openFiles.size() > m_maxOpenFiles) {
+        m_openFiles.pop_back();
+    }
+}
+
+void
+TiffReader::FileCache::closeFiles()
+{
+    QMutexLocker const locker(&m_mutex);
+
+    // Directory offsets are kept, as they are checked against
+    // the file's stamp anyway.
+    m_openFiles.clear();
+}
+
+std::vector<toff_t>
+TiffReader::FileCache::directoryOffsets(QString const& file_path, Stamp const& stamp) const
+{
+    QMutexLocker const locker(&m_mutex);
+
+    auto const it(m_indexes.find(file_path));
+    if (it == m_indexes.end() || !(it->second.stamp == stamp)) {
+        return std::vector<toff_t>();
+    }
+
+    return it->second.offsets;
+}
+
+void
+TiffReader::FileCache::setDirectoryOffsets(
+    QString const& file_path, Stamp const& stamp, std::vector<toff_t> const& offsets)
+{
+    QMutexLocker const locker(&m_mutex);
+
+    Index& index = m_indexes[file_path];
+    if (!(index.stamp == stamp)) {
+        index.stamp = stamp;
+        index.offsets.clear();
+    }
+
+    // Another thread may have gotten further.
+    if (offsets.size() > index.offsets.size()) {
+        index.offsets = offsets;
+    }
 }
 
 bool
@@ -271,10 +525,22 @@ TiffReader::readMetadata(
         return ImageMetadataLoader::GENERIC_ERROR;
     }
 
+    // Remember where the pages are while we are at it,
+    // to spare readImage() from walking the directories again.
+    std::vector<toff_t> offsets;
     do {
+        offsets.push_back(TIFFCurrentDirOffset(tif.handle()));
         out(currentPageMetadata(tif));
     } while (TIFFReadDirectory(tif.handle()));
 
+    QFile const* file = qobject_cast<QFile const*>(&device);
+    if (file && !file->fileName().isEmpty() && offsets.size() > 1) {
+        QString const file_path(file->fileName());
+        FileCache::instance().setDirectoryOffsets(
+            file_path, FileCache::Stamp(QFileInfo(file_path)), offsets
+        );
+    }
+
     return ImageMetadataLoader::LOADED;
 }
 
@@ -291,7 +557,7 @@ static void convertAbgrToArgb(uint32 const* src, uint32* dst, int count)
 }
 
 QImage
-TiffReader::readImage(QIODevice& device, int const page_num)
+TiffReader::readImage(QIODevice& device, int const page_num, bool const map_file)
 {
     if (!device.isReadable()) {
         return QImage();
@@ -308,7 +574,7 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 
     TiffHandle tif(
         TIFFClientOpen(
-            "file", "rBm", &device, &deviceRead, &deviceWrite,
+            "file", map_file ? "rB" : "rBm", &device, &deviceRead, &deviceWrite,
             &deviceSeek, &deviceClose, &deviceSize,
             &deviceMap, &deviceUnmap
         )
@@ -321,6 +587,57 @@ TiffReader::readImage(QIODevice& device, int const page_num)
         return QImage();
     }
 
+    return readCurrentPage(tif, header);
+}
+
+QImage
+TiffReader::readImage(QString const& file_path, int const page_num)
+{
+    FileCache& cache = FileCache::instance();
+    std::unique_ptr<FileCache::OpenFile> file(cache.acquire(file_path));
+    if (!file) {
+        return QImage();
+    }
+
+    TIFF* const tif = file->tif().handle();
+    std::vector<toff_t> offsets(cache.directoryOffsets(file->path(), file->stamp()));
+    if (offsets.empty()) {
+        // The file was overwritten after we opened it.
+        return QImage();
+    }
+
+    if (page_num < (int)offsets.size()) {
+        if (!TIFFSetSubDirectory(tif, offsets[page_num])) {
+            return QImage();
+        }
+    } else {
+        // Continue from the last directory we know of.
+        if (!TIFFSetSubDirectory(tif, offsets.back())) {
+            return QImage();
+        }
+        while ((int)offsets.size() <= page_num) {
+            if (!TIFFReadDirectory(tif)) {
+                return QImage();
+            }
+            offsets.push_back(TIFFCurrentDirOffset(tif));
+        }
+        cache.setDirectoryOffsets(file->path(), file->stamp(), offsets);
+    }
+
+    QImage const image(readCurrentPage(file->tif(), file->header()));
+    cache.release(std::move(file));
+    return image;
+}
+
+void
+TiffReader::closeCachedFiles()
+{
+    FileCache::instance().closeFiles();
+}
+
+QImage
+TiffReader::readCurrentPage(TiffHandle const& tif, TiffHeader const& header)
+{
     TiffInfo const info(tif, header);
 
     ImageMetadata const metadata(currentPageMetadata(tif));
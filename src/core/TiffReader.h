@@ -24,6 +24,7 @@
 
 class QIODevice;
 class QImage;
+class QString;
 class ImageMetadata;
 class Dpi;
 
@@ -43,12 +44,36 @@ public:
      *        opened for reading and must be seekable.
      * \param page_num A zero-based page number within a multi-page
      *        TIFF file.
+     * \param map_file If \p device is a QFile, map it into memory rather
+     *        than reading it.  Only for files that won't be truncated
+     *        while being read, as that would crash the process.
      * \return The resulting image, or a null image in case of failure.
      */
-    static QImage readImage(QIODevice& device, int page_num = 0);
+    static QImage readImage(QIODevice& device, int page_num = 0, bool map_file = false);
+
+    /**
+     * \brief Reads a page of a multi-page TIFF file.
+     *
+     * Unlike the version taking a QIODevice, this one keeps a few files
+     * open between calls and remembers where their pages are, so that
+     * reading the last page of a file costs the same as reading the
+     * first one.  Files are mapped into memory, so only use it for files
+     * that aren't being written to.
+     *
+     * \param file_path The full path to the file.
+     * \param page_num A zero-based page number.
+     * \return The resulting image, or a null image in case of failure.
+     */
+    static QImage readImage(QString const& file_path, int page_num);
+
+    /**
+     * \brief Closes the files kept open by readImage(QString const&, int).
+     */
+    static void closeCachedFiles();
 private:
     class TiffHeader;
     class TiffHandle;
+    class FileCache;
     struct TiffInfo;
     template<typename T> class TiffBuffer;
 
@@ -58,6 +83,8 @@ private:
 
     static ImageMetadata currentPageMetadata(TiffHandle const& tif);
 
+    static QImage readCurrentPage(TiffHandle const& tif, TiffHeader const& header);
+
     static Dpi getDpi(float xres, float yres, unsigned res_unit);
 
     static QImage extractBinaryOrIndexed8Image(
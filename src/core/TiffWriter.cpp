@@ -16,12 +16,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "CommandLine.h"
 #include "TiffWriter.h"
 #include "imageproc/Grayscale.h"
 #include "Dpm.h"
 #include "imageproc/Constants.h"
-#include "settings/globalstaticsettings.h"
 #include <QtGlobal>
 #include <QFile>
 #include <QIODevice>
@@ -154,14 +152,18 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
 }
 
 bool
-TiffWriter::writeImage(QString const& file_path, QImage const& image, bool multipage, int page_no, QString* compression_used)
+TiffWriter::writeImage(
+    ProcessingContext const& context, QString const& file_path,
+    QImage const& image, bool multipage, int page_no, QString* compression_used)
 {
     if (image.isNull()) {
         return false;
     }
 
+    // libtiff buffers whole strips before writing them,
+    // so Qt's buffering would only add a copy.
     QFile file(file_path);
-    QIODevice::OpenMode open_mode = QFile::ReadWrite;
+    QIODevice::OpenMode open_mode = QFile::ReadWrite | QFile::Unbuffered;
     if (!multipage || page_no == 0) {
         // libtiff don't truncate existing file even in "wBm" mode
         open_mode.setFlag(QFile::Truncate);
@@ -170,7 +172,7 @@ TiffWriter::writeImage(QString const& file_path, QImage const& image, bool multi
         return false;
     }
 
-    if (!writeImage(file, image, multipage, page_no, compression_used)) {
+    if (!writeImage(context, file, image, multipage, page_no, compression_used)) {
         file.remove();
         return false;
     }
@@ -179,7 +181,9 @@ TiffWriter::writeImage(QString const& file_path, QImage const& image, bool multi
 }
 
 bool
-TiffWriter::writeImage(QIODevice& device, QImage const& image, bool multipage, int page_no, QString* compression_used)
+TiffWriter::writeImage(
+    ProcessingContext const& context, QIODevice& device,
+    QImage const& image, bool multipage, int page_no, QString* compression_used)
 {
     if (image.isNull()) {
         return false;
@@ -192,20 +196,35 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image, bool multipage, i
         return false;
     }
 
-    const QString open_mode = (multipage && page_no > 0) ? "aBm" : "wBm";
-    TiffHandle tif(
-        TIFFClientOpen(
-            // Libtiff seems to be buggy with L or H flags,
-            // so we use B.
-            "file", open_mode.toStdString().c_str(), &device, &deviceRead, &deviceWrite,
-            &deviceSeek, &deviceClose, &deviceSize,
-            &deviceMap, &deviceUnmap
-        )
-    );
+    // Libtiff seems to be buggy with L or H flags, so we use B.
+    TiffHandle tif(openDevice(device, (multipage && page_no > 0) ? "aBm" : "wBm"));
     if (!tif.handle()) {
         return false;
     }
 
+    return writePage(context, tif, image, multipage, page_no, compression_used);
+}
+
+TIFF*
+TiffWriter::openDevice(QIODevice& device, char const* mode)
+{
+    return TIFFClientOpen(
+        "file", mode, &device, &deviceRead, &deviceWrite,
+        &deviceSeek, &deviceClose, &deviceSize,
+        &deviceMap, &deviceUnmap
+    );
+}
+
+/**
+ * Writes the image as the current directory of \p tif.
+ * If \p multipage is set, the directory is finished, so that
+ * the next call starts a new one.
+ */
+bool
+TiffWriter::writePage(
+    ProcessingContext const& context, TiffHandle const& tif,
+    QImage const& image, bool multipage, int page_no, QString* compression_used)
+{
     if (multipage) {
         TIFFSetField(tif.handle(), TIFFTAG_PAGENUMBER, page_no, page_no);
         TIFFSetField(tif.handle(), TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
@@ -218,28 +237,29 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image, bool multipage, i
     TIFFSetField(tif.handle(), TIFFTAG_SOFTWARE, "Scan Tailor \"Universal\" " VERSION);
     setDpm(tif, Dpm(image));
 
-    CommandLine const& cli = CommandLine::get();
-
-    int compression = GlobalStaticSettings::m_tiff_compression_color_id;
+    bool const predictor = context.useHorizontalPredictor();
+    int compression = context.tiffCompressionColorId();
     if (compression_used) {
-        *compression_used = GlobalStaticSettings::m_tiff_compr_method_color;
+        *compression_used = context.tiffCompressionColor();
     }
 
-    if (! cli.hasTiffForceRGB()) {
-        if (cli.hasTiffForceGrayscale()) {
-            return writeBitonalOrIndexed8Image(tif, imageproc::toGrayscale(image), multipage, compression);
+    if (!context.tiffForceRGB()) {
+        if (context.tiffForceGrayscale()) {
+            return writeBitonalOrIndexed8Image(
+                       tif, imageproc::toGrayscale(image), multipage, compression, predictor
+                   );
         }
         switch (image.format()) {
         case QImage::Format_Mono:
         case QImage::Format_MonoLSB: {
-            compression = GlobalStaticSettings::m_tiff_compression_bw_id;
+            compression = context.tiffCompressionBWId();
             if (compression_used) {
-                *compression_used = GlobalStaticSettings::m_tiff_compr_method_bw;
+                *compression_used = context.tiffCompressionBW();
             }
-            return writeBitonalOrIndexed8Image(tif, image, multipage, compression);
+            return writeBitonalOrIndexed8Image(tif, image, multipage, compression, predictor);
         }
         case QImage::Format_Indexed8: {
-            return writeBitonalOrIndexed8Image(tif, image, multipage, compression);
+            return writeBitonalOrIndexed8Image(tif, image, multipage, compression, predictor);
         }
         default:;
         }
@@ -247,11 +267,11 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image, bool multipage, i
 
     if (image.hasAlphaChannel()) {
         return writeARGB32Image(
-                   tif, image.convertToFormat(QImage::Format_ARGB32), multipage, compression
+                   tif, image.convertToFormat(QImage::Format_ARGB32), multipage, compression, predictor
                );
     } else {
         return writeRGB32Image(
-                   tif, image.convertToFormat(QImage::Format_RGB32), multipage, compression
+                   tif, image.convertToFormat(QImage::Format_RGB32), multipage, compression, predictor
                );
     }
 }
@@ -292,7 +312,8 @@ TiffWriter::setDpm(TiffHandle const& tif, Dpm const& dpm)
 
 bool
 TiffWriter::writeBitonalOrIndexed8Image(
-    TiffHandle const& tif, QImage const& image, bool multipage, int compression)
+    TiffHandle const& tif, QImage const& image, bool multipage,
+    int compression, bool horizontal_predictor)
 {
     TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(1));
 
@@ -329,7 +350,7 @@ TiffWriter::writeBitonalOrIndexed8Image(
     TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, photometric);
     TIFFSetField(tif.handle(), TIFFTAG_FILLORDER, FILLORDER_MSB2LSB);
 
-    if (GlobalStaticSettings::m_use_horizontal_predictor && bits_per_sample == 8) {
+    if (horizontal_predictor && bits_per_sample == 8) {
         TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
     }
 
@@ -375,7 +396,8 @@ TiffWriter::writeBitonalOrIndexed8Image(
 
 bool
 TiffWriter::writeRGB32Image(
-    TiffHandle const& tif, QImage const& image, bool multipage, int compression)
+    TiffHandle const& tif, QImage const& image, bool multipage,
+    int compression, bool horizontal_predictor)
 {
     assert(image.format() == QImage::Format_RGB32);
 
@@ -383,7 +405,7 @@ TiffWriter::writeRGB32Image(
     TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, uint16(compression));
     TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
     TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-    if (GlobalStaticSettings::m_use_horizontal_predictor) {
+    if (horizontal_predictor) {
         TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
     }
 
@@ -419,7 +441,8 @@ TiffWriter::writeRGB32Image(
 
 bool
 TiffWriter::writeARGB32Image(
-    TiffHandle const& tif, QImage const& image, bool multipage, int compression)
+    TiffHandle const& tif, QImage const& image, bool multipage,
+    int compression, bool horizontal_predictor)
 {
     assert(image.format() == QImage::Format_ARGB32);
 
@@ -427,7 +450,7 @@ TiffWriter::writeARGB32Image(
     TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, uint16(compression));
     TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
     TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-    if (GlobalStaticSettings::m_use_horizontal_predictor) {
+    if (horizontal_predictor) {
         TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
     }
 
@@ -531,3 +554,74 @@ TiffWriter::writeBinaryLinesReversed(
 
     return true;
 }
+
+
+MultipageTiffWriter::MultipageTiffWriter(
+    ProcessingContextPtr const& context, QString const& file_path)
+    :   m_ptrContext(context),
+        m_ptrFile(new QFile(file_path)),
+        m_pagesWritten(0),
+        m_failed(false)
+{
+    // libtiff doesn't truncate existing files even in "w" mode.
+    // It also buffers whole strips, so we don't need Qt to.
+    if (!m_ptrFile->open(QFile::ReadWrite | QFile::Truncate | QFile::Unbuffered)) {
+        m_failed = true;
+        return;
+    }
+
+    // Libtiff seems to be buggy with L or H flags, so we use B.
+    TIFF* const tif = TiffWriter::openDevice(*m_ptrFile, "wBm");
+    if (!tif) {
+        m_ptrFile->remove();
+        m_failed = true;
+        return;
+    }
+
+    m_ptrTiff.reset(new TiffWriter::TiffHandle(tif));
+}
+
+MultipageTiffWriter::~MultipageTiffWriter()
+{
+    finish();
+}
+
+bool
+MultipageTiffWriter::isOpen() const
+{
+    return m_ptrTiff.get() != nullptr;
+}
+
+bool
+MultipageTiffWriter::writePage(QImage const& image, QString* compression_used)
+{
+    if (!m_ptrTiff || m_failed || image.isNull()) {
+        return false;
+    }
+
+    if (!TiffWriter::writePage(*m_ptrContext, *m_ptrTiff, image, true, m_pagesWritten, compression_used)) {
+        m_failed = true;
+        return false;
+    }
+
+    ++m_pagesWritten;
+    return true;
+}
+
+bool
+MultipageTiffWriter::finish()
+{
+    if (!m_ptrTiff) {
+        return false;
+    }
+
+    // Closing flushes whatever libtiff still buffers.
+    m_ptrTiff.reset();
+
+    if (m_failed || m_pagesWritten == 0) {
+        m_ptrFile->remove();
+        return false;
+    }
+
+    return true;
+}
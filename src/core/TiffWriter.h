@@ -19,21 +19,27 @@
 #ifndef TIFFWRITER_H_
 #define TIFFWRITER_H_
 
+#include "NonCopyable.h"
+#include "ProcessingContext.h"
+#include <memory>
 #include <stdint.h>
 #include <stddef.h>
 #include <tiff.h>
 
 class QIODevice;
+class QFile;
 class QString;
 class QImage;
 class Dpm;
 
 class TiffWriter
 {
+    friend class MultipageTiffWriter;
 public:
     /**
      * \brief Writes a QImage in TIFF format to a file.
      *
+     * \param context Provides the compression and the other TIFF options.
      * \param file_path The full path to the file.
      * \param image The image to write.  Writing a null image will fail.
      * \param multipage Is this a multipage tiff and new page should be
@@ -44,10 +50,11 @@ public:
      * \return True on success, false on failure.
      */
 
-    static bool writeImage(QString const& file_path, QImage const& image, bool multipage = false, int page_no = 0, QString* compression_used = nullptr);
+    static bool writeImage(ProcessingContext const& context, QString const& file_path, QImage const& image, bool multipage = false, int page_no = 0, QString* compression_used = nullptr);
     /**
      * \brief Writes a QImage in TIFF format to an IO device.
      *
+     * \param context Provides the compression and the other TIFF options.
      * \param device The device to write to.  This device must be
      *        opened for writing and seekable.
      * \param image The image to write.  Writing a null image will fail.
@@ -60,19 +67,27 @@ public:
      */
 
 private:
-    static bool writeImage(QIODevice& device, QImage const& image, bool multipage = false, int page_no = 0, QString* compression_used = nullptr);
+    static bool writeImage(ProcessingContext const& context, QIODevice& device, QImage const& image, bool multipage = false, int page_no = 0, QString* compression_used = nullptr);
 
     class TiffHandle;
 
+    static TIFF* openDevice(QIODevice& device, char const* mode);
+
+    static bool writePage(ProcessingContext const& context, TiffHandle const& tif, QImage const& image, bool multipage, int page_no, QString* compression_used);
+
     static void setDpm(TiffHandle const& tif, Dpm const& dpm);
 
     static bool writeBitonalOrIndexed8Image(
-        TiffHandle const& tif, QImage const& image, bool multipage, int compression = COMPRESSION_LZW);
+        TiffHandle const& tif, QImage const& image, bool multipage,
+        int compression, bool horizontal_predictor);
 
     static bool writeRGB32Image(
-        TiffHandle const& tif, QImage const& image, bool multipage, int compression = COMPRESSION_LZW);
+        TiffHandle const& tif, QImage const& image, bool multipage,
+        int compression, bool horizontal_predictor);
 
-    static bool writeARGB32Image(TiffHandle const& tif, QImage const& image, bool multipage, int compression = COMPRESSION_LZW);
+    static bool writeARGB32Image(
+        TiffHandle const& tif, QImage const& image, bool multipage,
+        int compression, bool horizontal_predictor);
 
     static bool write8bitLines(
         TiffHandle const& tif, QImage const& image);
@@ -86,4 +101,62 @@ private:
     static uint8_t const m_reverseBitsLUT[256];
 };
 
+/**
+ * \brief Writes the pages of a multipage TIFF one after another,
+ *        keeping the file open in between.
+ *
+ * TiffWriter::writeImage() reopens the file for every page it appends,
+ * and libtiff then walks the whole directory chain to find its end,
+ * which makes writing N pages that way O(N^2).  Exports only put up to
+ * five pages (the whole image, the subscans and the masks) into a file,
+ * so there that cost is bounded, and what this saves is reopening the
+ * file and rereading its directories for each of them.
+ */
+class MultipageTiffWriter
+{
+    DECLARE_NON_COPYABLE(MultipageTiffWriter)
+public:
+    /**
+     * \brief Creates or truncates the file.
+     *
+     * Check isOpen() to see if that succeeded.
+     */
+    MultipageTiffWriter(ProcessingContextPtr const& context, QString const& file_path);
+
+    /**
+     * Calls finish() if it wasn't called yet.
+     */
+    ~MultipageTiffWriter();
+
+    bool isOpen() const;
+
+    /**
+     * \brief Appends a page.
+     *
+     * \param image The image to write.  Writing a null image will fail.
+     * \param compression_used Pointer to a string that'll return compression
+     *        name that was actually used to save the image.
+     * \return True on success, false on failure.
+     */
+    bool writePage(QImage const& image, QString* compression_used = nullptr);
+
+    int pagesWritten() const { return m_pagesWritten; }
+
+    /**
+     * \brief Flushes and closes the file.
+     *
+     * If any page failed to be written, or there are no pages at all,
+     * the file is removed.
+     *
+     * \return True if the file was written successfully.
+     */
+    bool finish();
+private:
+    ProcessingContextPtr m_ptrContext;
+    std::unique_ptr<QFile> m_ptrFile;
+    std::unique_ptr<TiffWriter::TiffHandle> m_ptrTiff;
+    int m_pagesWritten;
+    bool m_failed;
+};
+
 #endif
@@ -20,6 +20,7 @@
 #define UTILS_H_
 
 #include <QString>
+#include <utility>
 #include "ThumbnailPixmapCache.h"
 #include "StatusBarProvider.h"
 
@@ -30,6 +31,13 @@ public:
     static typename M::iterator mapSetValue(
         M& map, K const& key, V const& val);
 
+    /**
+     * \brief Same as mapSetValue(), but for std::unordered_map.
+     */
+    template<typename M, typename K, typename V>
+    static typename M::iterator hashMapSetValue(
+        M& map, K const& key, V const& val);
+
     /**
      * \brief If \p output_dir exists, creates a "cache" subdirectory under it.
      *
@@ -90,4 +98,17 @@ Utils::mapSetValue(M& map, K const& key, V const& val)
     }
 }
 
+template<typename M, typename K, typename V>
+typename M::iterator
+Utils::hashMapSetValue(M& map, K const& key, V const& val)
+{
+    std::pair<typename M::iterator, bool> const res(
+        map.insert(typename M::value_type(key, val))
+    );
+    if (!res.second) {
+        res.first->second = val;
+    }
+    return res.first;
+}
+
 #endif
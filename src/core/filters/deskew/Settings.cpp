@@ -20,7 +20,8 @@
 #include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include "settings/ini_keys.h"
 #include <cmath>
 #include <iostream>
@@ -42,14 +43,15 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_perPageParams.clear();
+    m_changedPages.addAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     PerPageParams new_params;
 
     for (PerPageParams::value_type const& kv : m_perPageParams) {
@@ -60,10 +62,14 @@ Settings::performRelinking(AbstractRelinker const& relinker)
     }
 
     m_perPageParams.swap(new_params);
+    m_changedPages.addAll();
 }
 
 void Settings::updateDeviation()
 {
+    QWriteLocker const locker(&m_lock);
+
+    double const old_avg = m_avg;
     m_avg = 0.0;
     for (PerPageParams::value_type const& kv : m_perPageParams) {
         m_avg += kv.second.deskewAngle();
@@ -84,26 +90,33 @@ void Settings::updateDeviation()
     std::cout << "sigma2 = " << sigma2 << std::endl;
     std::cout << "sigma = " << m_sigma << std::endl;
 #endif
+
+    if (m_avg != old_avg) {
+        // The deviation of every page is relative to the average.
+        m_changedPages.addAll();
+    }
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker locker(&m_mutex);
-    Utils::mapSetValue(m_perPageParams, page_id, params);
+    QWriteLocker const locker(&m_lock);
+    Utils::hashMapSetValue(m_perPageParams, page_id, params);
+    m_changedPages.add(page_id);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_perPageParams.erase(page_id);
+    m_changedPages.add(page_id);
 }
 
 std::unique_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PerPageParams::const_iterator it(m_perPageParams.find(page_id));
     if (it != m_perPageParams.end()) {
@@ -116,10 +129,11 @@ Settings::getPageParams(PageId const& page_id) const
 void
 Settings::setDegress(std::set<PageId> const& pages, Params const& params)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     for (PageId const& page : pages) {
-        Utils::mapSetValue(m_perPageParams, page, params);
+        Utils::hashMapSetValue(m_perPageParams, page, params);
     }
+    m_changedPages.add(pages);
 }
 
 } // namespace deskew
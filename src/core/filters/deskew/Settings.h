@@ -23,9 +23,10 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
-#include <QMutex>
+#include "ChangedPages.h"
+#include <QReadWriteLock>
 #include <memory>
-#include <map>
+#include <unordered_map>
 #include <set>
 
 class AbstractRelinker;
@@ -55,6 +56,11 @@ public:
 
     void setDegress(std::set<PageId> const& pages, Params const& params);
 
+    bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return m_changedPages.take(pages);
+    }
+
     double maxDeviation() const
     {
         return m_maxDeviation;
@@ -83,13 +89,14 @@ public:
     }
 
 private:
-    typedef std::map<PageId, Params> PerPageParams;
+    typedef std::unordered_map<PageId, Params> PerPageParams;
 
-    mutable QMutex m_mutex;
+    mutable QReadWriteLock m_lock;
     PerPageParams m_perPageParams;
     double m_avg;
     double m_sigma;
     double m_maxDeviation;
+    ChangedPages m_changedPages;
 };
 
 } // namespace deskew
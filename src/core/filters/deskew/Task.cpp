@@ -167,14 +167,17 @@ Task::process(TaskStatus const& status, FilterData const& data)
         status.throwIfCancelled();
 
         if (bounded_image_area.isValid()) {
+            // The B/W version of the whole image is shared with other
+            // filters, so we take the area we need out of it.
+            BinaryImage bw_image(data.bwImage());
+            if (bounded_image_area != bw_image.rect()) {
+                BinaryImage bw_area(bounded_image_area.size());
+                rasterOp<RopSrc>(bw_area, bw_area.rect(), bw_image, bounded_image_area.topLeft());
+                bw_image.swap(bw_area);
+            }
+
             BinaryImage rotated_image(
-                orthogonalRotation(
-                    BinaryImage(
-                        data.grayImage(), bounded_image_area,
-                        data.bwThreshold()
-                    ),
-                    data.xform().preRotation().toDegrees()
-                )
+                orthogonalRotation(bw_image, data.xform().preRotation().toDegrees())
             );
             if (m_ptrDbg.get()) {
                 m_ptrDbg->add(rotated_image, "bw_rotated");
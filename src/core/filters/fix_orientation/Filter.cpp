@@ -99,7 +99,7 @@ QDomElement
 Filter::saveSettings(
     ProjectWriter const& writer, QDomDocument& doc) const
 {
-    QDomElement filter_el(doc.createElement("fix-orientation"));
+    QDomElement filter_el(doc.createElement(settingsElementName()));
     writer.enumImages([this, &doc, &filter_el](ImageId const& image_id, int numeric_id) {
         writeImageSettings(doc, filter_el, image_id, numeric_id);
     });
@@ -107,43 +107,63 @@ Filter::saveSettings(
     return filter_el;
 }
 
+QDomElement
+Filter::savePageSettings(
+    ProjectWriter const& writer, QDomDocument& doc,
+    std::set<PageId> const& pages) const
+{
+    QDomElement filter_el(doc.createElement(settingsElementName()));
+    writer.enumImages(pages, [this, &doc, &filter_el](ImageId const& image_id, int numeric_id) {
+        writeImageSettings(doc, filter_el, image_id, numeric_id);
+    });
+
+    return filter_el;
+}
+
+bool
+Filter::takeChangedPages(std::set<PageId>& pages)
+{
+    return m_ptrSettings->takeChangedPages(pages);
+}
+
+QString
+Filter::settingsElementName() const
+{
+    return "fix-orientation";
+}
+
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadFilterSettings(
+    ProjectReader const& reader, QDomElement const& filter_el)
 {
     m_ptrSettings->clear();
+}
 
-    QDomElement filter_el(filters_el.namedItem("fix-orientation").toElement());
-
-    QString const image_tag_name("image");
-    QDomNode node(filter_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != image_tag_name) {
-            continue;
-        }
-        QDomElement el(node.toElement());
-
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-
-        ImageId const image_id(reader.imageId(id));
-        if (image_id.isNull()) {
-            continue;
-        }
+void
+Filter::loadPageSettings(ProjectReader const& reader, QDomElement const& el)
+{
+    if (el.tagName() != "image") {
+        return;
+    }
 
-        OrthogonalRotation const rotation(
-            XmlUnmarshaller::rotation(
-                el.namedItem("rotation").toElement()
-            )
-        );
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
+    }
 
-        m_ptrSettings->applyRotation(image_id, rotation);
+    ImageId const image_id(reader.imageId(id));
+    if (image_id.isNull()) {
+        return;
     }
+
+    OrthogonalRotation const rotation(
+        XmlUnmarshaller::rotation(
+            el.namedItem("rotation").toElement()
+        )
+    );
+
+    m_ptrSettings->applyRotation(image_id, rotation);
 }
 
 IntrusivePtr<Task>
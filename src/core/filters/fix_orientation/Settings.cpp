@@ -35,14 +35,15 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_perImageRotation.clear();
+    m_changedPages.addAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     PerImageRotation new_rotations;
 
     for (PerImageRotation::value_type const& kv : m_perImageRotation) {
@@ -53,13 +54,14 @@ Settings::performRelinking(AbstractRelinker const& relinker)
     }
 
     m_perImageRotation.swap(new_rotations);
+    m_changedPages.addAll();
 }
 
 void
 Settings::applyRotation(
     ImageId const& image_id, OrthogonalRotation const rotation)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     setImageRotationLocked(image_id, rotation);
 }
 
@@ -67,7 +69,7 @@ void
 Settings::applyRotation(
     std::set<PageId> const& pages, OrthogonalRotation const rotation)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     for (PageId const& page : pages) {
         setImageRotationLocked(page.imageId(), rotation);
@@ -77,7 +79,7 @@ Settings::applyRotation(
 OrthogonalRotation
 Settings::getRotationFor(ImageId const& image_id) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PerImageRotation::const_iterator it(m_perImageRotation.find(image_id));
     if (it != m_perImageRotation.end()) {
@@ -91,7 +93,8 @@ void
 Settings::setImageRotationLocked(
     ImageId const& image_id, OrthogonalRotation const& rotation)
 {
-    Utils::mapSetValue(m_perImageRotation, image_id, rotation);
+    Utils::hashMapSetValue(m_perImageRotation, image_id, rotation);
+    m_changedPages.add(image_id);
 }
 
 } // namespace fix_orientation
@@ -24,8 +24,9 @@
 #include "OrthogonalRotation.h"
 #include "ImageId.h"
 #include "PageId.h"
-#include <QMutex>
-#include <map>
+#include "ChangedPages.h"
+#include <QReadWriteLock>
+#include <unordered_map>
 #include <set>
 
 class AbstractRelinker;
@@ -50,14 +51,20 @@ public:
     void applyRotation(std::set<PageId> const& pages, OrthogonalRotation rotation);
 
     OrthogonalRotation getRotationFor(ImageId const& image_id) const;
+
+    bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return m_changedPages.take(pages);
+    }
 private:
-    typedef std::map<ImageId, OrthogonalRotation> PerImageRotation;
+    typedef std::unordered_map<ImageId, OrthogonalRotation> PerImageRotation;
 
     void setImageRotationLocked(
         ImageId const& image_id, OrthogonalRotation const& rotation);
 
-    mutable QMutex m_mutex;
+    mutable QReadWriteLock m_lock;
     PerImageRotation m_perImageRotation;
+    ChangedPages m_changedPages;
 };
 
 } // namespace fix_orientation
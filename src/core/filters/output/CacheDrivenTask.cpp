@@ -32,6 +32,8 @@
 #include "Utils.h"
 #include "AbstractFilterDataCollector.h"
 #include "ThumbnailCollector.h"
+#include "ProcessingContext.h"
+#include "CommandLine.h"
 #include <QString>
 #include <QFileInfo>
 #include <QRect>
@@ -61,6 +63,10 @@ CacheDrivenTask::process(
 {
     if (ThumbnailCollector* thumb_col = dynamic_cast<ThumbnailCollector*>(collector)) {
 
+        // Thumbnails are only shown by the GUI, which processes pages
+        // with the current settings.
+        ProcessingContextPtr const context(ProcessingContext::create(CommandLine::get()));
+
         QString const out_file_path(m_outFileNameGen.filePathFor(page_info.id()));
         Params const params(m_ptrSettings->getParams(page_info.id()));
 
@@ -89,7 +95,7 @@ CacheDrivenTask::process(
 
             OutputGenerator const generator(
                 params.outputDpi(), params.colorParams(), params.despeckleLevel(),
-                new_xform, content_rect_phys
+                new_xform, content_rect_phys, context
             );
             OutputImageParams const new_output_image_params(
                 generator.outputImageSize(), generator.outputContentRect(),
@@ -97,8 +103,8 @@ CacheDrivenTask::process(
                 params.dewarpingMode(), params.distortionModel(),
                 params.depthPerception(), params.despeckleLevel(),
                 params.colorParams().colorMode() == ColorParams::BLACK_AND_WHITE ?
-                            GlobalStaticSettings::m_tiff_compr_method_bw :
-                            GlobalStaticSettings::m_tiff_compr_method_color
+                            context->tiffCompressionBW() :
+                            context->tiffCompressionColor()
             );
 
             if (!stored_output_params->outputImageParams().matches(new_output_image_params)) {
@@ -107,10 +113,12 @@ CacheDrivenTask::process(
             }
 
             ZoneSet new_picture_zones(m_ptrSettings->pictureZonesForPage(page_info.id()));
-            if (!PictureZoneComparator::equal(stored_output_params->pictureZones(), new_picture_zones)) {
+            if (!PictureZoneComparator::equal(
+                        stored_output_params->pictureZones(), new_picture_zones,
+                        context->pictureDetectionSensitivity())) {
                 need_reprocess = true;
                 if (new_picture_zones.pictureZonesSensitivity() !=
-                        GlobalStaticSettings::m_picture_detection_sensitivity) {
+                        context->pictureDetectionSensitivity()) {
                     // currently there is no control to change sensitivity of a single page
                     // so force it to be equal default value
                     new_picture_zones.remove_auto_zones();
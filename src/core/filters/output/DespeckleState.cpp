@@ -22,6 +22,7 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "imageproc/RasterOp.h"
+#include <algorithm>
 #include <new>
 #include <stdint.h>
 
@@ -30,6 +31,32 @@ using namespace imageproc;
 namespace output
 {
 
+namespace
+{
+
+Despeckle::Level toDespeckleLevel(DespeckleLevel const level)
+{
+    switch (level) {
+    case DESPECKLE_CAUTIOUS:
+        return Despeckle::CAUTIOUS;
+    case DESPECKLE_AGGRESSIVE:
+        return Despeckle::AGGRESSIVE;
+    default:
+        return Despeckle::NORMAL;
+    }
+}
+
+/** Reverses the bit order of a byte, for Format_MonoLSB images. */
+inline uint8_t reverseBits(uint8_t byte)
+{
+    byte = static_cast<uint8_t>((byte & 0xf0) >> 4 | (byte & 0x0f) << 4);
+    byte = static_cast<uint8_t>((byte & 0xcc) >> 2 | (byte & 0x33) << 2);
+    byte = static_cast<uint8_t>((byte & 0xaa) >> 1 | (byte & 0x55) << 1);
+    return byte;
+}
+
+} // anonymous namespace
+
 DespeckleState::DespeckleState(
     QImage const& output,
     imageproc::BinaryImage const& speckles,
@@ -61,32 +88,143 @@ DespeckleState::redespeckle(
 
     new_state.m_despeckleLevel = level;
 
-    Despeckle::Level level2 = Despeckle::NORMAL;
-    switch (level) {
-    case DESPECKLE_OFF:
+    if (level == DESPECKLE_OFF) {
         // Null speckles image is equivalent to a white one.
         new_state.m_speckles.release();
         return new_state;
-    case DESPECKLE_CAUTIOUS:
-        level2 = Despeckle::CAUTIOUS;
-        break;
-    case DESPECKLE_NORMAL:
-        level2 = Despeckle::NORMAL;
+    }
+
+    if (!m_ptrSpeckleLevels) {
+        new_state.m_ptrSpeckleLevels = Despeckle::speckleLevels(
+                                           m_everythingBW, m_dpi, status, dbg
+                                       );
+    }
+    new_state.m_speckles = new_state.m_ptrSpeckleLevels->specklesAt(toDespeckleLevel(level));
+
+    status.throwIfCancelled();
+
+    return new_state;
+}
+
+BinaryImage
+DespeckleState::specklesAt(
+    DespeckleLevel const level,
+    TaskStatus const& status, DebugImages* dbg) const
+{
+    if (level == DESPECKLE_OFF) {
+        return BinaryImage();
+    }
+
+    BinaryImage speckles(
+        Despeckle::despeckle(m_everythingBW, m_dpi, toDespeckleLevel(level), status, dbg)
+    );
+
+    status.throwIfCancelled();
+
+    rasterOp<RopSubtract<RopSrc, RopDst> >(speckles, m_everythingBW);
+
+    return speckles;
+}
+
+bool
+DespeckleState::replaceSpeckles(
+    QImage& output, imageproc::BinaryImage const& old_speckles,
+    imageproc::BinaryImage const& new_speckles)
+{
+    if ((!old_speckles.isNull() && old_speckles.size() != output.size()) ||
+            (!new_speckles.isNull() && new_speckles.size() != output.size())) {
+        return false;
+    }
+
+    uint black = 0;
+    uint white = 0;
+    switch (output.format()) {
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+    case QImage::Format_Indexed8: {
+        int const black_idx = output.colorTable().indexOf(qRgb(0x00, 0x00, 0x00));
+        int const white_idx = output.colorTable().indexOf(qRgb(0xff, 0xff, 0xff));
+        if (black_idx < 0 || white_idx < 0) {
+            return false;
+        }
+        black = black_idx;
+        white = white_idx;
         break;
-    case DESPECKLE_AGGRESSIVE:
-        level2 = Despeckle::AGGRESSIVE;
+    }
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        black = 0xff000000;
+        white = 0xffffffff;
         break;
+    default:
+        return false;
     }
 
-    new_state.m_speckles = Despeckle::despeckle(
-                               m_everythingBW, m_dpi, level2, status, dbg
-                           );
+    uint32_t const* old_line = old_speckles.isNull() ? 0 : old_speckles.data();
+    int const old_stride = old_speckles.wordsPerLine();
+    uint32_t const* new_line = new_speckles.isNull() ? 0 : new_speckles.data();
+    int const new_stride = new_speckles.wordsPerLine();
+    uint32_t const msb = uint32_t(1) << 31;
 
-    status.throwIfCancelled();
+    QImage::Format const format = output.format();
+    int const width = output.width();
+    int const height = output.height();
+    int const words_per_line = (width + 31) / 32;
+    int const bytes_per_line = output.bytesPerLine();
 
-    rasterOp<RopSubtract<RopSrc, RopDst> >(new_state.m_speckles, m_everythingBW);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* const out_line = output.scanLine(y);
+        for (int i = 0; i < words_per_line; ++i) {
+            // New speckles become white, while old speckles that are
+            // no longer speckles are restored to black.
+            uint32_t const white_word = new_line ? new_line[i] : 0;
+            uint32_t const black_word = old_line ? old_line[i] & ~white_word : 0;
+            if (!(white_word | black_word)) {
+                // Speckles are sparse, so most words are skipped here.
+                continue;
+            }
 
-    return new_state;
+            if (format == QImage::Format_Mono || format == QImage::Format_MonoLSB) {
+                // Up to 4 bytes of output per word of speckles.
+                int const byte_end = std::min(i * 4 + 4, bytes_per_line);
+                for (int byte_idx = i * 4, shift = 24; byte_idx < byte_end; ++byte_idx, shift -= 8) {
+                    uint8_t to_white = static_cast<uint8_t>(white_word >> shift);
+                    uint8_t to_black = static_cast<uint8_t>(black_word >> shift);
+                    if (format == QImage::Format_MonoLSB) {
+                        to_white = reverseBits(to_white);
+                        to_black = reverseBits(to_black);
+                    }
+                    // Set bits are pixels of color index 1.
+                    uint8_t const to_ones = white == 1 ? to_white : to_black;
+                    uint8_t const to_zeros = white == 1 ? to_black : to_white;
+                    out_line[byte_idx] = static_cast<uint8_t>((out_line[byte_idx] & ~to_zeros) | to_ones);
+                }
+                continue;
+            }
+
+            int const x_end = std::min(i * 32 + 32, width);
+            for (int x = i * 32; x < x_end; ++x) {
+                uint32_t const mask = msb >> (x & 31);
+                if (!((white_word | black_word) & mask)) {
+                    continue;
+                }
+                uint const color = (white_word & mask) ? white : black;
+                if (format == QImage::Format_Indexed8) {
+                    out_line[x] = static_cast<uint8_t>(color);
+                } else {
+                    reinterpret_cast<uint32_t*>(out_line)[x] = color;
+                }
+            }
+        }
+        if (old_line) {
+            old_line += old_stride;
+        }
+        if (new_line) {
+            new_line += new_stride;
+        }
+    }
+
+    return true;
 }
 
 QImage
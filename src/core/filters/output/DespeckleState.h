@@ -21,6 +21,8 @@
 
 #include "DespeckleLevel.h"
 #include "Dpi.h"
+#include "Despeckle.h"
+#include "IntrusivePtr.h"
 #include "imageproc/BinaryImage.h"
 #include <QImage>
 
@@ -49,10 +51,45 @@ public:
         return m_despeckleLevel;
     }
 
+    imageproc::BinaryImage const& speckles() const
+    {
+        return m_speckles;
+    }
+
     DespeckleVisualization visualize() const;
 
+    /**
+     * The first call finds the levels at which each speckle gets removed.
+     * The returned state keeps them, so switching levels again is just
+     * a matter of selecting the speckles for the new level.
+     */
     DespeckleState redespeckle(DespeckleLevel level,
                                TaskStatus const& status, DebugImages* dbg = 0) const;
+
+    /**
+     * \brief Despeckles the B/W content at a different level.
+     *
+     * Unlike redespeckle(), this doesn't analyze the other levels,
+     * which makes it cheaper for a one-off level change.
+     *
+     * \return The speckles removed at \p level.  A null image for DESPECKLE_OFF.
+     */
+    imageproc::BinaryImage specklesAt(DespeckleLevel level,
+                                      TaskStatus const& status, DebugImages* dbg = 0) const;
+
+    /**
+     * \brief Converts an output image from one set of speckles to another.
+     *
+     * \param[in,out] output The output image with \p old_speckles removed.
+     *        On return, it will have \p new_speckles removed instead.
+     * \param old_speckles Speckles removed from \p output.  May be null.
+     * \param new_speckles Speckles to be removed.  May be null.
+     * \return false if the format of \p output is not supported, in which
+     *         case it's left unmodified.
+     */
+    static bool replaceSpeckles(
+        QImage& output, imageproc::BinaryImage const& old_speckles,
+        imageproc::BinaryImage const& new_speckles);
 private:
     static QImage overlaySpeckles(
         QImage const& mixed, imageproc::BinaryImage const& speckles);
@@ -79,7 +116,13 @@ private:
     imageproc::BinaryImage m_speckles;
 
     /**
-     * The DPI of all 3 above images.
+     * Levels at which connected components of m_everythingBW get removed.
+     * Null until the first redespeckle() call.
+     */
+    IntrusivePtr<Despeckle::SpeckleLevels const> m_ptrSpeckleLevels;
+
+    /**
+     * The DPI of all the above images.
      */
     Dpi m_dpi;
 
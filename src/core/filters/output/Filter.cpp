@@ -101,7 +101,7 @@ Filter::saveSettings(
     ProjectWriter const& writer, QDomDocument& doc) const
 {
 
-    QDomElement filter_el(doc.createElement("output"));
+    QDomElement filter_el(doc.createElement(settingsElementName()));
 
     writer.enumPages([this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
         writePageSettings(doc, filter_el, page_id, numeric_id);
@@ -110,6 +110,26 @@ Filter::saveSettings(
     return filter_el;
 }
 
+QDomElement
+Filter::savePageSettings(
+    ProjectWriter const& writer, QDomDocument& doc,
+    std::set<PageId> const& pages) const
+{
+    QDomElement filter_el(doc.createElement(settingsElementName()));
+
+    writer.enumPages(pages, [this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
+        writePageSettings(doc, filter_el, page_id, numeric_id);
+    });
+
+    return filter_el;
+}
+
+bool
+Filter::takeChangedPages(std::set<PageId>& pages)
+{
+    return m_ptrSettings->takeChangedPages(pages);
+}
+
 void
 Filter::writePageSettings(
     QDomDocument& doc, QDomElement& filter_el,
@@ -132,58 +152,57 @@ Filter::writePageSettings(
     filter_el.appendChild(page_el);
 }
 
+QString
+Filter::settingsElementName() const
+{
+    return "output";
+}
+
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadFilterSettings(
+    ProjectReader const& reader, QDomElement const& filter_el)
 {
     m_ptrSettings->clear();
+}
 
-    QDomElement const filter_el(
-        filters_el.namedItem("output").toElement()
-    );
-
-    QString const page_tag_name("page");
-    QDomNode node(filter_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != page_tag_name) {
-            continue;
-        }
-        QDomElement const el(node.toElement());
+void
+Filter::loadPageSettings(ProjectReader const& reader, QDomElement const& el)
+{
+    if (el.tagName() != "page") {
+        return;
+    }
 
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
+    }
 
-        PageId const page_id(reader.pageId(id));
-        if (page_id.isNull()) {
-            continue;
-        }
+    PageId const page_id(reader.pageId(id));
+    if (page_id.isNull()) {
+        return;
+    }
 
-        ZoneSet const picture_zones(el.namedItem("zones").toElement(), m_pictureZonePropFactory);
-        if (!picture_zones.empty()) {
-            m_ptrSettings->setPictureZones(page_id, picture_zones);
-        }
+    ZoneSet const picture_zones(el.namedItem("zones").toElement(), m_pictureZonePropFactory);
+    if (!picture_zones.empty()) {
+        m_ptrSettings->setPictureZones(page_id, picture_zones);
+    }
 
-        ZoneSet const fill_zones(el.namedItem("fill-zones").toElement(), m_fillZonePropFactory);
-        if (!fill_zones.empty()) {
-            m_ptrSettings->setFillZones(page_id, fill_zones);
-        }
+    ZoneSet const fill_zones(el.namedItem("fill-zones").toElement(), m_fillZonePropFactory);
+    if (!fill_zones.empty()) {
+        m_ptrSettings->setFillZones(page_id, fill_zones);
+    }
 
-        QDomElement const params_el(el.namedItem("params").toElement());
-        if (!params_el.isNull()) {
-            Params const params(params_el);
-            m_ptrSettings->setParams(page_id, params);
-        }
+    QDomElement const params_el(el.namedItem("params").toElement());
+    if (!params_el.isNull()) {
+        Params const params(params_el);
+        m_ptrSettings->setParams(page_id, params);
+    }
 
-        QDomElement const output_params_el(el.namedItem("output-params").toElement());
-        if (!output_params_el.isNull()) {
-            OutputParams const output_params(output_params_el);
-            m_ptrSettings->setOutputParams(page_id, output_params);
-        }
+    QDomElement const output_params_el(el.namedItem("output-params").toElement());
+    if (!output_params_el.isNull()) {
+        OutputParams const output_params(output_params_el);
+        m_ptrSettings->setOutputParams(page_id, output_params);
     }
 }
 
@@ -428,7 +428,9 @@ OptionsWidget::reloadIfNecessary()
         saved_despeckle_level = output_params->outputImageParams().despeckleLevel();
     }
 
-    if (!PictureZoneComparator::equal(saved_picture_zones, m_ptrSettings->pictureZonesForPage(m_pageId))) {
+    if (!PictureZoneComparator::equal(
+                saved_picture_zones, m_ptrSettings->pictureZonesForPage(m_pageId),
+                GlobalStaticSettings::m_picture_detection_sensitivity)) {
         emit reloadRequested();
         return;
     } else if (!FillZoneComparator::equal(saved_fill_zones, m_ptrSettings->fillZonesForPage(m_pageId))) {
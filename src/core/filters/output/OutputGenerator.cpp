@@ -16,7 +16,6 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "CommandLine.h"
 #include "OutputGenerator.h"
 #include "ImageTransformation.h"
 #include "FilterData.h"
@@ -33,12 +32,15 @@
 #include "ZoneSet.h"
 #include "PictureLayerProperty.h"
 #include "FillColorProperty.h"
+#include "FillZoneComparator.h"
+#include "OutputLayers.h"
 #include "dewarping/CylindricalSurfaceDewarper.h"
 #include "dewarping/TextLineTracer.h"
 #include "dewarping/TopBottomEdgeTracer.h"
 #include "dewarping/DistortionModelBuilder.h"
 #include "dewarping/DewarpingPointMapper.h"
 #include "dewarping/RasterDewarper.h"
+#include "dewarping/DewarpPlan.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/BinaryThreshold.h"
@@ -47,6 +49,7 @@
 #include "imageproc/Transform.h"
 #include "imageproc/Scale.h"
 #include "imageproc/Morphology.h"
+#include "imageproc/HitMissReplacer.h"
 #include "imageproc/Connectivity.h"
 #include "imageproc/ConnCompEraser.h"
 #include "imageproc/SeedFill.h"
@@ -62,7 +65,6 @@
 #include "imageproc/ConnectivityMap.h"
 #include "imageproc/InfluenceMap.h"
 #include "config.h"
-#include "settings/globalstaticsettings.h"
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
@@ -246,13 +248,15 @@ OutputGenerator::OutputGenerator(
     Dpi const& dpi, ColorParams const& color_params,
     DespeckleLevel const despeckle_level,
     ImageTransformation const& xform,
-    QPolygonF const& content_rect_phys)
+    QPolygonF const& content_rect_phys,
+    ProcessingContextPtr const& context)
     :   m_dpi(dpi),
         m_colorParams(color_params),
         m_xform(xform),
         m_outRect(xform.resultingRect().toAlignedRect()),
         m_contentRect(xform.transform().map(content_rect_phys).boundingRect().toAlignedRect()),
-        m_despeckleLevel(despeckle_level)
+        m_despeckleLevel(despeckle_level),
+        m_ptrContext(context)
 {
     /*
     std::cout << "m_outRect.left(): " << m_outRect.left() << " right(): " << m_outRect.right() << " top: " << m_outRect.top() << " bottom: " << m_outRect.bottom() << std::endl;
@@ -300,7 +304,8 @@ OutputGenerator::process(
     imageproc::BinaryImage* speckles_image,
     DebugImages* const dbg,
     PageId* p_pageId,
-    IntrusivePtr<Settings>* p_settings
+    IntrusivePtr<Settings>* p_settings,
+    OutputLayers* layers
 ) const
 {
     QImage image(
@@ -309,7 +314,7 @@ OutputGenerator::process(
             dewarping_mode, distortion_model, depth_perception,
             keep_orig_fore_subscan,
             auto_layer_mask, speckles_image, dbg,
-            p_pageId, p_settings
+            p_pageId, p_settings, layers
         )
     );
     assert(!image.isNull());
@@ -322,6 +327,146 @@ OutputGenerator::process(
     return image;
 }
 
+QImage
+OutputGenerator::recompose(
+    TaskStatus const& status, OutputLayers& layers,
+    ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+    imageproc::BinaryImage* auto_layer_mask,
+    imageproc::BinaryImage* speckles_image, DebugImages* const dbg) const
+{
+    assert(!layers.normalized.isNull());
+
+    if (auto_layer_mask) {
+        *auto_layer_mask = layers.autoLayerMask;
+    }
+
+    QImage image(
+        composeOutput(
+            status, layers.normalized, layers.smoothed,
+            layers.bwMask, layers.bwAutoLayerMask,
+            layers.smallMarginsRect, layers.cropArea,
+            picture_zones, fill_zones, auto_layer_mask, speckles_image, dbg, &layers
+        )
+    );
+    layers.pictureZones = picture_zones;
+
+    // Set the correct DPI.
+    Dpm const output_dpm(m_dpi);
+    image.setDotsPerMeterX(output_dpm.horizontal());
+    image.setDotsPerMeterY(output_dpm.vertical());
+
+    return image;
+}
+
+void
+OutputGenerator::refill(
+    QImage& output, OutputLayers const& layers,
+    ZoneSet const& old_fill_zones, ZoneSet const& new_fill_zones) const
+{
+    assert(output.size() == layers.unfilledOutput.size());
+
+    // Zones are painted in order, so a change to one of them may
+    // affect the way any of the following ones look.  Therefore,
+    // everything starting from the first mismatch has to be repainted.
+    ZoneSet::const_iterator old_it(old_fill_zones.begin());
+    ZoneSet::const_iterator new_it(new_fill_zones.begin());
+    ZoneSet::const_iterator const old_end(old_fill_zones.end());
+    ZoneSet::const_iterator const new_end(new_fill_zones.end());
+    for (; old_it != old_end && new_it != new_end; ++old_it, ++new_it) {
+        if (!FillZoneComparator::equal(*old_it, *new_it)) {
+            break;
+        }
+    }
+
+    QTransform const& orig_to_output = m_xform.transform();
+    std::vector<QRect> dirty_rects;
+    for (; old_it != old_end; ++old_it) {
+        dirty_rects.push_back(zoneBoundingRect(*old_it, orig_to_output));
+    }
+    for (; new_it != new_end; ++new_it) {
+        dirty_rects.push_back(zoneBoundingRect(*new_it, orig_to_output));
+    }
+
+    if (dirty_rects.empty()) {
+        return;
+    }
+
+    // An image read back from disk may come in a different format.
+    if (output.format() != layers.unfilledOutput.format()) {
+        output = output.convertToFormat(layers.unfilledOutput.format());
+    }
+
+    bool const bw_output = output.format() == QImage::Format_Mono
+                           || output.format() == QImage::Format_MonoLSB;
+    BinaryImage bw_output_img;
+    if (bw_output) {
+        bw_output_img = BinaryImage(output);
+    }
+
+    int const tile_size = 256;
+    QRect const output_rect(output.rect());
+    for (int tile_y = 0; tile_y < output_rect.height(); tile_y += tile_size) {
+        for (int tile_x = 0; tile_x < output_rect.width(); tile_x += tile_size) {
+            QRect const tile(
+                QRect(tile_x, tile_y, tile_size, tile_size).intersected(output_rect)
+            );
+
+            bool dirty = false;
+            for (QRect const& rect : dirty_rects) {
+                if (rect.intersects(tile)) {
+                    dirty = true;
+                    break;
+                }
+            }
+            if (!dirty) {
+                continue;
+            }
+
+            // Repaint the fill zones over the unfilled tile.  Shifting them
+            // by a whole number of pixels doesn't affect rasterization.
+            QTransform orig_to_tile(orig_to_output);
+            orig_to_tile *= QTransform().translate(-tile.left(), -tile.top());
+            typedef QPointF(QTransform::*MapPointFunc)(QPointF const&) const;
+            boost::function<QPointF(QPointF const&)> const mapper(
+                boost::bind((MapPointFunc)&QTransform::map, orig_to_tile, _1)
+            );
+
+            if (bw_output) {
+                BinaryImage bw_tile(layers.unfilledOutput, tile);
+                applyFillZonesInPlace(bw_tile, new_fill_zones, mapper);
+                rasterOp<RopSrc>(bw_output_img, tile, bw_tile, QPoint(0, 0));
+            } else {
+                QImage tile_img(layers.unfilledOutput.copy(tile));
+                applyFillZonesInPlace(tile_img, new_fill_zones, mapper);
+                drawOver(output, tile, tile_img, tile_img.rect());
+            }
+        }
+    }
+
+    if (bw_output) {
+        output = bw_output_img.toQImage();
+        Dpm const output_dpm(m_dpi);
+        output.setDotsPerMeterX(output_dpm.horizontal());
+        output.setDotsPerMeterY(output_dpm.vertical());
+    }
+}
+
+QRect
+OutputGenerator::zoneBoundingRect(Zone const& zone, QTransform const& orig_to_output)
+{
+    QRectF rect;
+    if (zone.type() == Zone::SplineType) {
+        rect = orig_to_output.map(zone.spline().toPolygon()).boundingRect();
+    } else if (zone.type() == Zone::EllipseType) {
+        SerializableEllipse const e(zone.ellipse().transformed(orig_to_output));
+        double const r = std::max(e.rx(), e.ry());
+        rect = QRectF(e.center() - QPointF(r, r), e.center() + QPointF(r, r));
+    }
+
+    // Antialiasing may touch an extra pixel on each side.
+    return rect.toAlignedRect().adjusted(-1, -1, 1, 1);
+}
+
 QSize
 OutputGenerator::outputImageSize() const
 {
@@ -541,7 +686,8 @@ OutputGenerator::processImpl(
     imageproc::BinaryImage* speckles_image,
     DebugImages* const dbg,
     PageId* p_pageId,
-    IntrusivePtr<Settings>* p_settings
+    IntrusivePtr<Settings>* p_settings,
+    OutputLayers* layers
 ) const
 {
     RenderParams const render_params(m_colorParams);
@@ -590,7 +736,7 @@ OutputGenerator::processImpl(
         return processWithoutDewarping(
                    status, input, picture_zones, fill_zones,
                    auto_layer_mask, speckles_image, dbg,
-                   p_pageId, p_settings
+                   p_pageId, p_settings, layers
                );
     }
 }
@@ -611,9 +757,8 @@ OutputGenerator::processAsIs(
     QColor const bg_color(dominant_gray, dominant_gray, dominant_gray);
 
     QImage out;
-    CommandLine const& cli = CommandLine::get();
 
-    if (input.origImage().allGray() && !cli.hasTiffForceKeepColorSpace()) {
+    if (input.origImage().allGray() && !m_ptrContext->tiffForceKeepColorSpace()) {
         if (m_outRect.isEmpty()) {
             QImage image(1, 1, QImage::Format_Indexed8);
             image.setColorTable(createGrayscalePalette());
@@ -653,11 +798,12 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
         imageproc::BinaryImage* auto_layer_mask,
         imageproc::BinaryImage* speckles_image,
         DebugImages* dbg, PageId* p_pageId,
-        IntrusivePtr<Settings>* p_settings
+        IntrusivePtr<Settings>* p_settings,
+        OutputLayers* layers
                                         ) const
 {
     RenderParams const render_params(m_colorParams);
-    const bool suppress_smoothing = GlobalStaticSettings::m_disable_bw_smoothing &&
+    const bool suppress_smoothing = m_ptrContext->disableBwSmoothing() &&
                                     (m_colorParams.colorMode() == ColorParams::BLACK_AND_WHITE);
 
     // The whole image minus the part cut off by the split line.
@@ -774,6 +920,10 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
             );
         }
 
+        if (layers) {
+            layers->unfilledOutput = dst.toQImage();
+        }
+
         applyFillZonesInPlace(dst, fill_zones);
         return dst.toQImage();
     }
@@ -810,7 +960,7 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
             if (render_params.pictureZonesLayer()) {
                 if (!picture_zones.auto_zones_found()) {
                     std::vector<QRect> areas;
-                    bw_mask.rectangularize(WHITE, areas, GlobalStaticSettings::m_picture_detection_sensitivity);
+                    bw_mask.rectangularize(WHITE, areas, m_ptrContext->pictureDetectionSensitivity());
 
                     QTransform xform1(m_xform.transform());
                     xform1 *= QTransform().translate(-small_margins_rect.x(), -small_margins_rect.y());
@@ -827,7 +977,7 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
                         picture_zones.add(zone1);
                     }
 
-                    picture_zones.setPictureZonesSensitivity(GlobalStaticSettings::m_picture_detection_sensitivity);
+                    picture_zones.setPictureZonesSensitivity(m_ptrContext->pictureDetectionSensitivity());
                     (*p_settings)->setPictureZones(*p_pageId, picture_zones);
                 }
 
@@ -895,6 +1045,50 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
 
     }
 
+    if (layers) {
+        layers->normalized = maybe_normalized;
+        layers->smoothed = maybe_smoothed;
+        layers->bwMask = bw_mask;
+        layers->bwAutoLayerMask = bw_auto_layer_mask;
+        layers->autoLayerMask = auto_layer_mask ? *auto_layer_mask : BinaryImage();
+        layers->smallMarginsRect = small_margins_rect;
+        layers->cropArea = normalize_illumination_crop_area;
+    }
+
+    return composeOutput(
+               status, maybe_normalized, maybe_smoothed, bw_mask, bw_auto_layer_mask,
+               small_margins_rect, normalize_illumination_crop_area,
+               picture_zones, fill_zones, auto_layer_mask, speckles_image, dbg, layers
+           );
+}
+
+/**
+ * \brief The part of processWithoutDewarping() that depends on zones.
+ *
+ * \param maybe_normalized The color or grayscale image in \p small_margins_rect
+ *        coordinates.
+ * \param maybe_smoothed The grayscale image to binarize.
+ * \param bw_mask The binarization mask before picture zones are applied.
+ * \param bw_auto_layer_mask The binarization mask from picture detection.
+ * \param crop_area The crop area in \p small_margins_rect coordinates.
+ * \param layers If provided, the output before applying fill zones
+ *        will be stored there.
+ */
+QImage
+OutputGenerator::composeOutput(
+    TaskStatus const& status, QImage maybe_normalized, QImage maybe_smoothed,
+    BinaryImage bw_mask, BinaryImage bw_auto_layer_mask,
+    QRect const& small_margins_rect, QPolygonF const& crop_area,
+    ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+    imageproc::BinaryImage* auto_layer_mask,
+    imageproc::BinaryImage* speckles_image,
+    DebugImages* dbg, OutputLayers* layers) const
+{
+    RenderParams const render_params(m_colorParams);
+    const bool suppress_smoothing = m_ptrContext->disableBwSmoothing() &&
+                                    (m_colorParams.colorMode() == ColorParams::BLACK_AND_WHITE);
+    QSize const target_size(m_outRect.size().expandedTo(QSize(1, 1)));
+
     if (!render_params.mixedOutput()) {
         // It's "Color / Grayscale" mode, as we handle B/W above.
         reserveBlackAndWhite(maybe_normalized);
@@ -907,16 +1101,31 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
             }
         }
 
-        BinaryImage bw_content(
-            binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask)
-        );
+        bool const separate_foreground = render_params.foregroundLayer() &&
+                                         (m_colorParams.blackWhiteOptions().thresholdAdjustment()
+                                          != m_colorParams.blackWhiteOptions().thresholdForegroundAdjustment());
+        const int foreground_adj = m_colorParams.blackWhiteOptions().thresholdForegroundAdjustment();
 
+        BinaryImage bw_content;
         std::unique_ptr<BinaryImage> foreground_mask = nullptr;
-        if (render_params.foregroundLayer() &&
-                (m_colorParams.blackWhiteOptions().thresholdAdjustment()
-                 != m_colorParams.blackWhiteOptions().thresholdForegroundAdjustment())) {
-            const int adj = m_colorParams.blackWhiteOptions().thresholdForegroundAdjustment();
-            foreground_mask.reset(new BinaryImage(binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask, &adj)));
+        if (layers) {
+            // Zone edits only change the mask in the edited zones, so
+            // this doesn't go through the whole image again, unless
+            // the edit moved the threshold.
+            updateBinarizationMask(maybe_smoothed, crop_area, bw_mask, *layers);
+            std::map<int, BinaryImage> thresholded;
+            bw_content = binarize(maybe_smoothed, *layers, thresholded);
+            if (separate_foreground) {
+                foreground_mask.reset(new BinaryImage(
+                                          binarize(maybe_smoothed, *layers, thresholded, &foreground_adj)
+                                      ));
+            }
+            layers->thresholded.swap(thresholded);
+        } else {
+            bw_content = binarize(maybe_smoothed, crop_area, &bw_mask);
+            if (separate_foreground) {
+                foreground_mask.reset(new BinaryImage(binarize(maybe_smoothed, crop_area, &bw_mask, &foreground_adj)));
+            }
         }
 
         maybe_smoothed = QImage(); // Save memory.
@@ -1037,6 +1246,10 @@ OutputGenerator::processWithoutDewarping(TaskStatus const& status, FilterData co
         drawOver(dst, dst_rect, maybe_normalized, src_rect);
     }
 
+    if (layers) {
+        layers->unfilledOutput = dst;
+    }
+
     applyFillZonesInPlace(dst, fill_zones);
     return dst;
 }
@@ -1061,7 +1274,7 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
     }
 
     RenderParams const render_params(m_colorParams);
-    const bool suppress_smoothing = GlobalStaticSettings::m_disable_bw_smoothing &&
+    const bool suppress_smoothing = m_ptrContext->disableBwSmoothing() &&
                                     (m_colorParams.colorMode() == ColorParams::BLACK_AND_WHITE);
 
     // The whole image minus the part cut off by the split line.
@@ -1214,7 +1427,7 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
         if (render_params.pictureZonesLayer()) {
             if (!picture_zones.auto_zones_found()) {
                 std::vector<QRect> areas;
-                warped_bw_mask.rectangularize(WHITE, areas, GlobalStaticSettings::m_picture_detection_sensitivity);
+                warped_bw_mask.rectangularize(WHITE, areas, m_ptrContext->pictureDetectionSensitivity());
 
                 QTransform xform1(m_xform.transform());
                 xform1 *= QTransform().translate(-small_margins_rect.x(), -small_margins_rect.y());
@@ -1231,7 +1444,7 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
                     picture_zones.add(zone1);
                 }
 
-                picture_zones.setPictureZonesSensitivity(GlobalStaticSettings::m_picture_detection_sensitivity);
+                picture_zones.setPictureZonesSensitivity(m_ptrContext->pictureDetectionSensitivity());
                 (*p_settings)->setPictureZones(*p_pageId, picture_zones);
 
             }
@@ -1302,7 +1515,7 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
 
 //begin of modified by monday2000
 //Auto_Dewarping_Vert_Half_Correction
-        if (GlobalStaticSettings::m_dewarpAutoVertHalfCorrection) {
+        if (m_ptrContext->dewarpAutoVertHalfCorrection()) {
             BinaryThreshold bw_threshold(64);
             BinaryImage bw_image(input.grayImage(), bw_threshold);
 
@@ -1544,19 +1757,17 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
         bg_color = QColor(dominant_gray, dominant_gray, dominant_gray);
     }
 
+    // The same plan is used for every image we dewarp for this page.
+    DewarpPlan plan;
     QImage dewarped;
     try {
-        dewarped = dewarp(
-                       QTransform(), normalized_original, m_xform.transform(),
-                       distortion_model, depth_perception, bg_color
-                   );
+        plan = createDewarpPlan(distortion_model, depth_perception);
+        dewarped = dewarp(plan, normalized_original, bg_color);
     } catch (std::runtime_error const&) {
         // Probably an impossible distortion model.  Let's fall back to a trivial one.
         setupTrivialDistortionModel(distortion_model);
-        dewarped = dewarp(
-                       QTransform(), normalized_original, m_xform.transform(),
-                       distortion_model, depth_perception, bg_color
-                   );
+        plan = createDewarpPlan(distortion_model, depth_perception);
+        dewarped = dewarp(plan, normalized_original, bg_color);
     }
     normalized_original = QImage(); // Save memory.
     if (dbg) {
@@ -1577,10 +1788,12 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
     }
 
     boost::shared_ptr<DewarpingPointMapper> mapper(
-        new DewarpingPointMapper(
+        plan.isNull()
+        ? new DewarpingPointMapper(
             distortion_model, depth_perception.value(),
             m_xform.transform(), m_contentRect
         )
+        : new DewarpingPointMapper(plan)
     );
     boost::function<QPointF(QPointF const&)> const orig_to_output(
         boost::bind(&DewarpingPointMapper::mapToDewarpedSpace, mapper, _1)
@@ -1615,7 +1828,7 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
 
         applyFillZonesInPlace(dewarped_bw_content, fill_zones, orig_to_output);
 
-        if (GlobalStaticSettings::m_dewarpAutoDeskewAfterDewarp) {
+        if (m_ptrContext->dewarpAutoDeskewAfterDewarp()) {
             QImage tmp_image(dewarped_bw_content.toQImage());
             maybe_deskew(&tmp_image, dewarping_mode);
             return tmp_image.convertToFormat(QImage::Format_Mono);
@@ -1638,16 +1851,13 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
                 -small_margins_rect.top()
             )
         );
-        QTransform small_margins_to_output;
-        small_margins_to_output.translate(
-            small_margins_rect.left(), small_margins_rect.top()
+        DewarpPlan const mask_plan(
+            orig_to_small_margins.isAffine()
+            ? plan.transformed(orig_to_small_margins)
+            : createDewarpPlan(distortion_model, depth_perception, orig_to_small_margins)
         );
         BinaryImage dewarped_bw_mask(
-            dewarp(
-                orig_to_small_margins, warped_bw_mask.toQImage(),
-                small_margins_to_output, distortion_model,
-                depth_perception, Qt::black
-            )
+            dewarp(mask_plan, warped_bw_mask.toQImage(), Qt::black)
         );
         if (dbg) {
             dbg->add(dewarped_bw_mask, "dewarped_bw_mask");
@@ -1689,7 +1899,7 @@ OutputGenerator::processWithDewarping(TaskStatus const& status, FilterData const
 
         status.throwIfCancelled();
 
-        if (GlobalStaticSettings::m_dewarpAutoDeskewAfterDewarp) {
+        if (m_ptrContext->dewarpAutoDeskewAfterDewarp()) {
             double const angle = maybe_deskew(&dewarped, dewarping_mode);
             if (angle != 0.) {
                 // we deskew img and mask before merging together
@@ -1774,21 +1984,17 @@ OutputGenerator::createDewarper(
 }
 
 /**
- * \param orig_to_src Transformation from the original image coordinates
- *                    to the coordinate system of \p src image.
- * \param src_to_output Transformation from the \p src image coordinates
- *                      to output image coordinates.
  * \param distortion_model Distortion model.
  * \param depth_perception Depth perception.
- * \param bg_color The color to use for areas outsize of \p src.
- * \param modified_content_rect A vertically shrunk version of outputContentRect().
- *                              See function definition for more details.
+ * \param orig_to_src Transformation from the original image coordinates
+ *                    to the coordinate system of the images to be dewarped.
+ * \return A plan mapping output image pixels to source images,
+ *         or a null plan if the model domain turns out to be empty.
  */
-QImage
-OutputGenerator::dewarp(
-    QTransform const& orig_to_src, QImage const& src,
-    QTransform const& src_to_output, DistortionModel const& distortion_model,
-    DepthPerception const& depth_perception, QColor const& bg_color) const
+DewarpPlan
+OutputGenerator::createDewarpPlan(
+    DistortionModel const& distortion_model,
+    DepthPerception const& depth_perception, QTransform const& orig_to_src) const
 {
     CylindricalSurfaceDewarper const dewarper(
         createDewarper(distortion_model, orig_to_src, depth_perception.value())
@@ -1798,18 +2004,33 @@ OutputGenerator::dewarp(
     // will be mapped to our curved quadrilateral.
     QRect const model_domain(
         distortion_model.modelDomain(
-            dewarper, orig_to_src * src_to_output, outputContentRect()
+            dewarper, m_xform.transform(), outputContentRect()
         ).toRect()
     );
     if (model_domain.isEmpty()) {
+        return DewarpPlan();
+    }
+
+    return DewarpPlan(dewarper, model_domain, m_outRect.size());
+}
+
+/**
+ * \param plan A plan from createDewarpPlan(), possibly transformed
+ *             to the coordinate system of \p src.
+ * \param src The image to dewarp.
+ * \param bg_color The color to use for areas outsize of \p src.
+ */
+QImage
+OutputGenerator::dewarp(
+    DewarpPlan const& plan, QImage const& src, QColor const& bg_color) const
+{
+    if (plan.isNull()) {
         GrayImage out(src.size());
         out.fill(0xff); // white
         return out;
     }
 
-    return RasterDewarper::dewarp(
-               src, m_outRect.size(), dewarper, model_domain, bg_color
-           );
+    return RasterDewarper::dewarp(src, plan, bg_color);
 }
 
 QSize
@@ -2058,6 +2279,106 @@ OutputGenerator::binarize(QImage const& image,
     }
 }
 
+/**
+ * \brief Bring layers.binarizationMask and layers.binarizationHistogram
+ *        up to date with \p bw_mask.
+ *
+ * Only the pixels that entered or left the mask since the last call
+ * are counted, which makes it cheap after a zone edit.
+ */
+void
+OutputGenerator::updateBinarizationMask(
+    QImage const& image, QPolygonF const& crop_area,
+    BinaryImage const& bw_mask, OutputLayers& layers) const
+{
+    if (layers.cropMask.isNull()) {
+        BinaryImage crop_mask(image.size(), BLACK);
+        PolygonRasterizer::fillExcept(crop_mask, WHITE, crop_area, Qt::WindingFill);
+        layers.cropMask = erodeBrick(crop_mask, QSize(3, 3), WHITE);
+    }
+
+    BinaryImage mask(layers.cropMask);
+    rasterOp<RopAnd<RopSrc, RopDst> >(mask, bw_mask);
+
+    if (layers.binarizationMask.isNull() || layers.binarizationMask.size() != mask.size()
+            || image.format() != QImage::Format_Indexed8 || !image.isGrayscale()) {
+        layers.binarizationHistogram = GrayscaleHistogram(image, mask);
+        layers.binarizationMask = mask;
+        return;
+    }
+
+    GrayscaleHistogram& hist = layers.binarizationHistogram;
+    int const w = image.width();
+    int const h = image.height();
+    int const bpl = image.bytesPerLine();
+    int const wpl = mask.wordsPerLine();
+    int const last_word_idx = (w - 1) >> 5;
+    uint32_t const last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
+    uint32_t const msb = uint32_t(1) << 31;
+    uint8_t const* img_line = image.bits();
+    uint32_t const* old_line = layers.binarizationMask.data();
+    uint32_t const* new_line = mask.data();
+
+    for (int y = 0; y < h; ++y, img_line += bpl, old_line += wpl, new_line += wpl) {
+        for (int i = 0; i <= last_word_idx; ++i) {
+            uint32_t changed = old_line[i] ^ new_line[i];
+            if (i == last_word_idx) {
+                changed &= last_word_mask;
+            }
+            for (int bit = 0; changed; ++bit) {
+                uint32_t const bit_mask = msb >> bit;
+                if (!(changed & bit_mask)) {
+                    continue;
+                }
+                changed &= ~bit_mask;
+                int const gray = img_line[(i << 5) + bit];
+                if (new_line[i] & bit_mask) {
+                    ++hist[gray];
+                } else {
+                    --hist[gray];
+                }
+            }
+        }
+    }
+
+    layers.binarizationMask = mask;
+}
+
+/**
+ * \brief Same as binarize(image, crop_area, &bw_mask, adjustment), with
+ *        the mask and histogram coming from updateBinarizationMask().
+ *
+ * If the last composition of \p layers used the same threshold,
+ * its thresholded image is reused.  Every thresholded image this
+ * one uses is put into \p thresholded.
+ */
+BinaryImage
+OutputGenerator::binarize(
+    QImage const& image, OutputLayers const& layers,
+    std::map<int, BinaryImage>& thresholded, const int* adjustment) const
+{
+    BinaryThreshold const bw_thresh(
+        adjustThreshold(BinaryThreshold::otsuThreshold(layers.binarizationHistogram), adjustment)
+    );
+
+    BinaryImage& unmasked = thresholded[bw_thresh];
+    if (unmasked.isNull()) {
+        std::map<int, BinaryImage>::const_iterator const it(layers.thresholded.find(bw_thresh));
+        if (it != layers.thresholded.end()) {
+            unmasked = it->second;
+        } else {
+            unmasked = BinaryImage(image, bw_thresh);
+        }
+    }
+
+    BinaryImage binarized(unmasked);
+
+    // Fill masked out areas with white.
+    rasterOp<RopAnd<RopSrc, RopDst> >(binarized, layers.binarizationMask);
+
+    return binarized;
+}
+
 /**
  * \brief Remove small connected components that are considered to be garbage.
  *
@@ -2131,137 +2452,79 @@ OutputGenerator::maybeDespeckleInPlace(
     }
 }
 
-void
-OutputGenerator::morphologicalSmoothInPlace(
-    BinaryImage& bin_img, TaskStatus const& status)
+namespace
 {
-    // When removing black noise, remove small ones first.
-
-    {
-        char const pattern[] =
-            "XXX"
-            " - "
-            "   ";
-        hitMissReplaceAllDirections(bin_img, pattern, 3, 3);
-    }
-
-    status.throwIfCancelled();
-
-    {
-        char const pattern[] =
-            "X ?"
-            "X  "
-            "X- "
-            "X- "
-            "X  "
-            "X ?";
-        hitMissReplaceAllDirections(bin_img, pattern, 3, 6);
-    }
-
-    status.throwIfCancelled();
-
-    {
-        char const pattern[] =
-            "X ?"
-            "X ?"
-            "X  "
-            "X- "
-            "X- "
-            "X- "
-            "X  "
-            "X ?"
-            "X ?";
-        hitMissReplaceAllDirections(bin_img, pattern, 3, 9);
-    }
-
-    status.throwIfCancelled();
-
-    {
-        char const pattern[] =
-            "XX?"
-            "XX?"
-            "XX "
-            "X+ "
-            "X+ "
-            "X+ "
-            "XX "
-            "XX?"
-            "XX?";
-        hitMissReplaceAllDirections(bin_img, pattern, 3, 9);
-    }
 
-    status.throwIfCancelled();
-
-    {
-        char const pattern[] =
-            "XX?"
-            "XX "
-            "X+ "
-            "X+ "
-            "XX "
-            "XX?";
-        hitMissReplaceAllDirections(bin_img, pattern, 3, 6);
-    }
-
-    status.throwIfCancelled();
+// Smoothing patterns, applied in this order, each in all 4 orientations.
+// When removing black noise, remove small ones first.
+
+constexpr char SMOOTH_PATTERN_1[] =
+    "XXX"
+    " - "
+    "   ";
+
+constexpr char SMOOTH_PATTERN_2[] =
+    "X ?"
+    "X  "
+    "X- "
+    "X- "
+    "X  "
+    "X ?";
+
+constexpr char SMOOTH_PATTERN_3[] =
+    "X ?"
+    "X ?"
+    "X  "
+    "X- "
+    "X- "
+    "X- "
+    "X  "
+    "X ?"
+    "X ?";
+
+constexpr char SMOOTH_PATTERN_4[] =
+    "XX?"
+    "XX?"
+    "XX "
+    "X+ "
+    "X+ "
+    "X+ "
+    "XX "
+    "XX?"
+    "XX?";
+
+constexpr char SMOOTH_PATTERN_5[] =
+    "XX?"
+    "XX "
+    "X+ "
+    "X+ "
+    "XX "
+    "XX?";
+
+constexpr char SMOOTH_PATTERN_6[] =
+    "   "
+    "X+X"
+    "XXX";
 
-    {
-        char const pattern[] =
-            "   "
-            "X+X"
-            "XXX";
-        hitMissReplaceAllDirections(bin_img, pattern, 3, 3);
-    }
-}
+} // anonymous namespace
 
 void
-OutputGenerator::hitMissReplaceAllDirections(
-    imageproc::BinaryImage& img, char const* const pattern,
-    int const pattern_width, int const pattern_height)
+OutputGenerator::morphologicalSmoothInPlace(
+    BinaryImage& bin_img, TaskStatus const& status)
 {
-    hitMissReplaceInPlace(img, WHITE, pattern, pattern_width, pattern_height);
-
-    std::vector<char> pattern_data(pattern_width * pattern_height, ' ');
-    char* const new_pattern = &pattern_data[0];
-
-    // Rotate 90 degrees clockwise.
-    char const* p = pattern;
-    int new_width = pattern_height;
-    int new_height = pattern_width;
-    for (int y = 0; y < pattern_height; ++y) {
-        for (int x = 0; x < pattern_width; ++x, ++p) {
-            int const new_x = pattern_height - 1 - y;
-            int const new_y = x;
-            new_pattern[new_y * new_width + new_x] = *p;
-        }
-    }
-    hitMissReplaceInPlace(img, WHITE, new_pattern, new_width, new_height);
-
-    // Rotate upside down.
-    p = pattern;
-    new_width = pattern_width;
-    new_height = pattern_height;
-    for (int y = 0; y < pattern_height; ++y) {
-        for (int x = 0; x < pattern_width; ++x, ++p) {
-            int const new_x = pattern_width - 1 - x;
-            int const new_y = pattern_height - 1 - y;
-            new_pattern[new_y * new_width + new_x] = *p;
-        }
-    }
-    hitMissReplaceInPlace(img, WHITE, new_pattern, new_width, new_height);
-
-    // Rotate 90 degrees counter-clockwise.
-    p = pattern;
-    new_width = pattern_height;
-    new_height = pattern_width;
-    for (int y = 0; y < pattern_height; ++y) {
-        for (int x = 0; x < pattern_width; ++x, ++p) {
-            int const new_x = y;
-            int const new_y = pattern_width - 1 - x;
-            new_pattern[new_y * new_width + new_x] = *p;
-        }
-    }
-    hitMissReplaceInPlace(img, WHITE, new_pattern, new_width, new_height);
+    // All the patterns go through the image in a single pass,
+    // producing the same result as applying them one by one.
+    HitMissReplacer replacer;
+    replacer.addAllOrientations<SMOOTH_PATTERN_1, 3, 3>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_2, 3, 6>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_3, 3, 9>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_4, 3, 9>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_5, 3, 6>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_6, 3, 3>();
+
+    replacer.replaceInPlace(
+        bin_img, [&status]() { status.throwIfCancelled(); }
+    );
 }
 
 QSize
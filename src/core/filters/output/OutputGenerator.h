@@ -27,6 +27,7 @@
 #include "DespeckleLevel.h"
 #include "DewarpingMode.h"
 #include "ImageTransformation.h"
+#include "ProcessingContext.h"
 #ifndef Q_MOC_RUN
 #include <boost/function.hpp>
 #endif
@@ -38,6 +39,7 @@
 #include <QLineF>
 #include <QPolygonF>
 #include <vector>
+#include <map>
 #include <utility>
 #include <stdint.h>
 //begin of modified by monday2000
@@ -59,6 +61,7 @@ class TaskStatus;
 class DebugImages;
 class FilterData;
 class ZoneSet;
+class Zone;
 class QSize;
 class QImage;
 
@@ -73,6 +76,7 @@ namespace dewarping
 {
 class DistortionModel;
 class CylindricalSurfaceDewarper;
+class DewarpPlan;
 }
 //begin of modified by monday2000
 //Marginal_Dewarping
@@ -81,6 +85,8 @@ using namespace imageproc;
 namespace output
 {
 
+class OutputLayers;
+
 enum BinarizationMask {
     BINARIZATION_MASK_ERASER1 = 1,
     BINARIZATION_MASK_PAINTER2 = 2,
@@ -94,7 +100,8 @@ public:
         Dpi const& dpi, ColorParams const& color_params,
         DespeckleLevel despeckle_level,
         ImageTransformation const& xform,
-        QPolygonF const& content_rect_phys);
+        QPolygonF const& content_rect_phys,
+        ProcessingContextPtr const& context);
 
     /**
      * \brief Produce the output image.
@@ -119,6 +126,10 @@ public:
      *        to be performed again with different settings, without going
      *        through the whole output generation process again.
      * \param dbg An optional sink for debugging images.
+     * \param layers If provided, the intermediate images the output
+     *        was composed from will be written there, allowing recompose()
+     *        and refill() to be used after editing zones.  Only filled
+     *        when dewarping is off and the output is not kept as is.
      */
     QImage process(
         TaskStatus const& status, FilterData const& input,
@@ -133,9 +144,37 @@ public:
         imageproc::BinaryImage* auto_picture_mask = 0,
         imageproc::BinaryImage* speckles_image = 0,
         DebugImages* dbg = 0,
-        PageId* p_pageId = nullptr, IntrusivePtr<Settings>* p_settings = nullptr
+        PageId* p_pageId = nullptr, IntrusivePtr<Settings>* p_settings = nullptr,
+        OutputLayers* layers = nullptr
     ) const;
 
+    /**
+     * \brief Produce the output image from the layers of a previous
+     *        process() call, with a different set of picture zones.
+     *
+     * Illumination normalization and picture detection are skipped.
+     * \p layers.normalized must not be null, which is the case for
+     * color / grayscale and mixed output.  \p layers is updated
+     * to reflect the new output.
+     */
+    QImage recompose(
+        TaskStatus const& status, OutputLayers& layers,
+        ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+        imageproc::BinaryImage* auto_picture_mask = 0,
+        imageproc::BinaryImage* speckles_image = 0,
+        DebugImages* dbg = 0) const;
+
+    /**
+     * \brief Repaint the fill zones of an output image in place.
+     *
+     * Only the tiles touched by the zones that differ between
+     * \p old_fill_zones and \p new_fill_zones are repainted, from
+     * \p layers.unfilledOutput.
+     */
+    void refill(
+        QImage& output, OutputLayers const& layers,
+        ZoneSet const& old_fill_zones, ZoneSet const& new_fill_zones) const;
+
     QSize outputImageSize() const;
 
     /**
@@ -157,7 +196,8 @@ private:
         imageproc::BinaryImage* auto_layer_mask = 0,
         imageproc::BinaryImage* speckles_image = 0,
         DebugImages* dbg = 0,
-        PageId* p_pageId = nullptr, IntrusivePtr<Settings>* p_settings = nullptr
+        PageId* p_pageId = nullptr, IntrusivePtr<Settings>* p_settings = nullptr,
+        OutputLayers* layers = nullptr
     ) const;
 
     QImage processAsIs(
@@ -174,9 +214,21 @@ private:
                                    imageproc::BinaryImage* speckles_image = 0,
 //Picture_Shape
                                    DebugImages* dbg = 0,
-                                   PageId* p_pageId = nullptr, IntrusivePtr<Settings>* p_settings = nullptr
+                                   PageId* p_pageId = nullptr, IntrusivePtr<Settings>* p_settings = nullptr,
+                                   OutputLayers* layers = nullptr
                                   ) const;
 
+    QImage composeOutput(
+        TaskStatus const& status, QImage maybe_normalized, QImage maybe_smoothed,
+        imageproc::BinaryImage bw_mask, imageproc::BinaryImage bw_auto_layer_mask,
+        QRect const& small_margins_rect, QPolygonF const& crop_area,
+        ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+        imageproc::BinaryImage* auto_layer_mask,
+        imageproc::BinaryImage* speckles_image,
+        DebugImages* dbg, OutputLayers* layers) const;
+
+    static QRect zoneBoundingRect(Zone const& zone, QTransform const& orig_to_output);
+
     QImage processWithDewarping(
         TaskStatus const& status, FilterData const& input,
 //Quadro_Zoner
@@ -210,10 +262,14 @@ private:
         dewarping::DistortionModel const& distortion_model,
         QTransform const& distortion_model_to_target, double depth_perception);
 
+    dewarping::DewarpPlan createDewarpPlan(
+        dewarping::DistortionModel const& distortion_model,
+        DepthPerception const& depth_perception,
+        QTransform const& orig_to_src = QTransform()) const;
+
     QImage dewarp(
-        QTransform const& orig_to_src, QImage const& src,
-        QTransform const& src_to_output, dewarping::DistortionModel const& distortion_model,
-        DepthPerception const& depth_perception, QColor const& bg_color) const;
+        dewarping::DewarpPlan const& plan, QImage const& src,
+        QColor const& bg_color) const;
 
     static QSize from300dpi(QSize const& size, Dpi const& target_dpi);
 
@@ -258,6 +314,15 @@ private:
     imageproc::BinaryImage binarize(QImage const& image, QPolygonF const& crop_area,
                                     imageproc::BinaryImage const* mask = 0, const int* adjustment = nullptr) const;
 
+    void updateBinarizationMask(
+        QImage const& image, QPolygonF const& crop_area,
+        imageproc::BinaryImage const& bw_mask, OutputLayers& layers) const;
+
+    imageproc::BinaryImage binarize(
+        QImage const& image, OutputLayers const& layers,
+        std::map<int, imageproc::BinaryImage>& thresholded,
+        const int* adjustment = nullptr) const;
+
     void maybeDespeckleInPlace(
         imageproc::BinaryImage& image, QRect const& image_rect,
         QRect const& mask_rect, DespeckleLevel level,
@@ -269,10 +334,6 @@ private:
     static void morphologicalSmoothInPlace(
         imageproc::BinaryImage& img, TaskStatus const& status);
 
-    static void hitMissReplaceAllDirections(
-        imageproc::BinaryImage& img, char const* pattern,
-        int pattern_width, int pattern_height);
-
     static QSize calcLocalWindowSize(Dpi const& dpi);
 
     static unsigned char calcDominantBackgroundGrayLevel(QImage const& img);
@@ -317,6 +378,8 @@ private:
     QRect m_contentRect;
 
     DespeckleLevel m_despeckleLevel;
+
+    ProcessingContextPtr m_ptrContext;
 };
 
 } // namespace output
@@ -79,6 +79,11 @@ public:
         return m_despeckleLevel;
     }
 
+    void setDespeckleLevel(DespeckleLevel level)
+    {
+        m_despeckleLevel = level;
+    }
+
     QString const& TiffCompression() const
     {
         return m_TiffCompression;
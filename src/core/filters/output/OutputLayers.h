@@ -0,0 +1,130 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_LAYERS_H_
+#define OUTPUT_OUTPUT_LAYERS_H_
+
+#include "RefCountable.h"
+#include "OutputImageParams.h"
+#include "ZoneSet.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/Grayscale.h"
+#include <QImage>
+#include <QRect>
+#include <QPolygonF>
+#include <map>
+
+namespace output
+{
+
+/**
+ * \brief Intermediate images kept from the last output generation of a page.
+ *
+ * Zones only come into play after illumination normalization and picture
+ * detection, and fill zones are applied last.  Keeping these images
+ * allows OutputGenerator to apply zone edits without going through
+ * the whole output generation process again.
+ *
+ * Only produced by OutputGenerator::processWithoutDewarping().
+ */
+class OutputLayers : public RefCountable
+{
+public:
+    explicit OutputLayers(OutputImageParams const& params)
+        :   params(params), binarizationHistogram(QImage()) {}
+
+    /**
+     * Parameters of the output image these layers belong to.
+     */
+    OutputImageParams params;
+
+    /**
+     * Picture zones unfilledOutput was produced with.
+     */
+    ZoneSet pictureZones;
+
+    /**
+     * The output image before fill zones were applied to it.
+     */
+    QImage unfilledOutput;
+
+    /**
+     * The color or grayscale image, in smallMarginsRect coordinates,
+     * before being combined with B/W content.  Null for B/W output,
+     * which doesn't depend on picture zones.
+     */
+    QImage normalized;
+
+    /**
+     * The smoothed grayscale image binarization is applied to.
+     * Null, unless the output is mixed.
+     */
+    QImage smoothed;
+
+    /**
+     * The binarization mask before applying picture zones to it.
+     */
+    imageproc::BinaryImage bwMask;
+
+    /**
+     * The binarization mask from picture detection, kept for
+     * the foreground layer.  May be null.
+     */
+    imageproc::BinaryImage bwAutoLayerMask;
+
+    /**
+     * The auto picture mask as it was before applying picture zones.
+     * May be null.
+     */
+    imageproc::BinaryImage autoLayerMask;
+
+    QRect smallMarginsRect;
+
+    /**
+     * The crop area in smallMarginsRect coordinates.
+     */
+    QPolygonF cropArea;
+
+    /**
+     * cropArea rasterized and eroded the way binarization needs it.
+     * Null until the B/W content of mixed output is first binarized.
+     */
+    imageproc::BinaryImage cropMask;
+
+    /**
+     * The mask the B/W content was last binarized under, that is
+     * cropMask combined with bwMask after applying picture zones.
+     * Null until the B/W content of mixed output is first binarized.
+     */
+    imageproc::BinaryImage binarizationMask;
+
+    /**
+     * Gray levels of smoothed under binarizationMask.
+     */
+    imageproc::GrayscaleHistogram binarizationHistogram;
+
+    /**
+     * smoothed binarized at the thresholds the last composition
+     * used, not yet masked, keyed by threshold.
+     */
+    std::map<int, imageproc::BinaryImage> thresholded;
+};
+
+} // namespace output
+
+#endif
@@ -21,14 +21,13 @@
 #include "Zone.h"
 #include "PropertySet.h"
 #include "PictureLayerProperty.h"
-#include "settings/globalstaticsettings.h"
 #include <QPolygonF>
 
 namespace output
 {
 
 bool
-PictureZoneComparator::equal(ZoneSet const& lhs, ZoneSet const& rhs)
+PictureZoneComparator::equal(ZoneSet const& lhs, ZoneSet const& rhs, float const sensitivity)
 {
     ZoneSet::const_iterator lhs_it(lhs.begin());
     ZoneSet::const_iterator rhs_it(rhs.begin());
@@ -52,7 +51,7 @@ PictureZoneComparator::equal(ZoneSet const& lhs, ZoneSet const& rhs)
             return false;
         }
 
-        if (lhs.pictureZonesSensitivity() != GlobalStaticSettings::m_picture_detection_sensitivity) {
+        if (lhs.pictureZonesSensitivity() != sensitivity) {
             return false;
         }
     }
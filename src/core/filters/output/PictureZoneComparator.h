@@ -29,7 +29,11 @@ namespace output
 class PictureZoneComparator
 {
 public:
-    static bool equal(ZoneSet const& lhs, ZoneSet const& rhs);
+    /**
+     * Automatic picture zones are only considered equal if they were
+     * detected with \p sensitivity.
+     */
+    static bool equal(ZoneSet const& lhs, ZoneSet const& rhs, float sensitivity);
 
     static bool equal(Zone const& lhs, Zone const& rhs);
 
@@ -25,7 +25,8 @@
 #include "../../Utils.h"
 #include <Qt>
 #include <QColor>
-#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include <tiff.h>
 #include <QResource>
 #include "settings/ini_keys.h"
@@ -48,7 +49,7 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     initialPictureZoneProps().swap(m_defaultPictureZoneProps);
     initialFillZoneProps().swap(m_defaultFillZoneProps);
@@ -56,12 +57,15 @@ Settings::clear()
     m_perPageOutputParams.clear();
     m_perPagePictureZones.clear();
     m_perPageFillZones.clear();
+    m_changedPages.addAll();
+    m_outputLayersPage = PageId();
+    m_ptrOutputLayers.reset();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     PerPageParams new_params;
     PerPageOutputParams new_output_params;
@@ -100,12 +104,15 @@ Settings::performRelinking(AbstractRelinker const& relinker)
     m_perPageOutputParams.swap(new_output_params);
     m_perPagePictureZones.swap(new_picture_zones);
     m_perPageFillZones.swap(new_fill_zones);
+    m_changedPages.addAll();
+    m_outputLayersPage = PageId();
+    m_ptrOutputLayers.reset();
 }
 
 Params
 Settings::getParams(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PerPageParams::const_iterator const it(m_perPageParams.find(page_id));
     if (it != m_perPageParams.end()) {
@@ -118,20 +125,22 @@ Settings::getParams(PageId const& page_id) const
 void
 Settings::setParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPageParams, page_id, params);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
+    Utils::hashMapSetValue(m_perPageParams, page_id, params);
 }
 
 void
 Settings::setColorParams(PageId const& page_id, ColorParams const& prms, ColorParamsApplyFilter const& filter)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
+    PerPageParams::iterator const it(m_perPageParams.find(page_id));
+    if (it == m_perPageParams.end()) {
         Params params;
         params.setColorParams(prms, filter);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+        m_perPageParams.insert(PerPageParams::value_type(page_id, params));
     } else {
         ColorParams::ColorMode old_mode = it->second.colorParams().colorMode();
         if (old_mode == ColorParams::MIXED && prms.colorMode() != old_mode) {
@@ -150,13 +159,14 @@ Settings::setColorParams(PageId const& page_id, ColorParams const& prms, ColorPa
 void
 Settings::setDpi(PageId const& page_id, Dpi const& dpi)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
+    PerPageParams::iterator const it(m_perPageParams.find(page_id));
+    if (it == m_perPageParams.end()) {
         Params params;
         params.setOutputDpi(dpi);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+        m_perPageParams.insert(PerPageParams::value_type(page_id, params));
     } else {
         it->second.setOutputDpi(dpi);
     }
@@ -165,13 +175,14 @@ Settings::setDpi(PageId const& page_id, Dpi const& dpi)
 void
 Settings::setDewarpingMode(PageId const& page_id, DewarpingMode const& mode)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
+    PerPageParams::iterator const it(m_perPageParams.find(page_id));
+    if (it == m_perPageParams.end()) {
         Params params;
         params.setDewarpingMode(mode);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+        m_perPageParams.insert(PerPageParams::value_type(page_id, params));
     } else {
         it->second.setDewarpingMode(mode);
     }
@@ -180,13 +191,14 @@ Settings::setDewarpingMode(PageId const& page_id, DewarpingMode const& mode)
 void
 Settings::setDistortionModel(PageId const& page_id, dewarping::DistortionModel const& model)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
+    PerPageParams::iterator const it(m_perPageParams.find(page_id));
+    if (it == m_perPageParams.end()) {
         Params params;
         params.setDistortionModel(model);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+        m_perPageParams.insert(PerPageParams::value_type(page_id, params));
     } else {
         it->second.setDistortionModel(model);
     }
@@ -195,13 +207,14 @@ Settings::setDistortionModel(PageId const& page_id, dewarping::DistortionModel c
 void
 Settings::setDepthPerception(PageId const& page_id, DepthPerception const& depth_perception)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
+    PerPageParams::iterator const it(m_perPageParams.find(page_id));
+    if (it == m_perPageParams.end()) {
         Params params;
         params.setDepthPerception(depth_perception);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+        m_perPageParams.insert(PerPageParams::value_type(page_id, params));
     } else {
         it->second.setDepthPerception(depth_perception);
     }
@@ -210,13 +223,14 @@ Settings::setDepthPerception(PageId const& page_id, DepthPerception const& depth
 void
 Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
+    PerPageParams::iterator const it(m_perPageParams.find(page_id));
+    if (it == m_perPageParams.end()) {
         Params params;
         params.setDespeckleLevel(level);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+        m_perPageParams.insert(PerPageParams::value_type(page_id, params));
     } else {
         it->second.setDespeckleLevel(level);
     }
@@ -225,7 +239,7 @@ Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level)
 std::unique_ptr<OutputParams>
 Settings::getOutputParams(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PerPageOutputParams::const_iterator const it(m_perPageOutputParams.find(page_id));
     if (it != m_perPageOutputParams.end()) {
@@ -238,21 +252,23 @@ Settings::getOutputParams(PageId const& page_id) const
 void
 Settings::removeOutputParams(PageId const& page_id)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
     m_perPageOutputParams.erase(page_id);
 }
 
 void
 Settings::setOutputParams(PageId const& page_id, OutputParams const& params)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPageOutputParams, page_id, params);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
+    Utils::hashMapSetValue(m_perPageOutputParams, page_id, params);
 }
 
 ZoneSet
 Settings::pictureZonesForPage(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PerPageZones::const_iterator const it(m_perPagePictureZones.find(page_id));
     if (it != m_perPagePictureZones.end()) {
@@ -265,7 +281,7 @@ Settings::pictureZonesForPage(PageId const& page_id) const
 ZoneSet
 Settings::fillZonesForPage(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PerPageZones::const_iterator const it(m_perPageFillZones.find(page_id));
     if (it != m_perPageFillZones.end()) {
@@ -278,45 +294,69 @@ Settings::fillZonesForPage(PageId const& page_id) const
 void
 Settings::setPictureZones(PageId const& page_id, ZoneSet const& zones)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPagePictureZones, page_id, zones);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
+    Utils::hashMapSetValue(m_perPagePictureZones, page_id, zones);
 }
 
 void
 Settings::setFillZones(PageId const& page_id, ZoneSet const& zones)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPageFillZones, page_id, zones);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(page_id);
+    Utils::hashMapSetValue(m_perPageFillZones, page_id, zones);
 }
 
 PropertySet
 Settings::defaultPictureZoneProperties() const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
     return m_defaultPictureZoneProps;
 }
 
 PropertySet
 Settings::defaultFillZoneProperties() const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
     return m_defaultFillZoneProps;
 }
 
 void
 Settings::setDefaultPictureZoneProperties(PropertySet const& props)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_defaultPictureZoneProps = props;
 }
 
 void
 Settings::setDefaultFillZoneProperties(PropertySet const& props)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_defaultFillZoneProps = props;
 }
 
+IntrusivePtr<OutputLayers const>
+Settings::outputLayers(PageId const& page_id) const
+{
+    QReadLocker const locker(&m_lock);
+
+    if (m_outputLayersPage == page_id) {
+        return m_ptrOutputLayers;
+    } else {
+        return IntrusivePtr<OutputLayers const>();
+    }
+}
+
+void
+Settings::setOutputLayers(
+    PageId const& page_id, IntrusivePtr<OutputLayers const> const& layers)
+{
+    QWriteLocker const locker(&m_lock);
+
+    m_outputLayersPage = page_id;
+    m_ptrOutputLayers = layers;
+}
+
 PropertySet
 Settings::initialPictureZoneProps()
 {
@@ -31,9 +31,13 @@
 #include "DespeckleLevel.h"
 #include "ZoneSet.h"
 #include "PropertySet.h"
-#include <QMutex>
-#include <map>
+#include "OutputLayers.h"
+#include "IntrusivePtr.h"
+#include "ChangedPages.h"
+#include <QReadWriteLock>
+#include <unordered_map>
 #include <memory>
+#include <set>
 //begin of modified by monday2000
 //Picture_Shape
 #include "Params.h"
@@ -99,24 +103,41 @@ public:
     void setDefaultPictureZoneProperties(PropertySet const& props);
 
     void setDefaultFillZoneProperties(PropertySet const& props);
+
+    /**
+     * Output layers are not persistent, and are only kept
+     * for the last page they were set for.  Returns null if
+     * there are no layers for the given page.
+     */
+    IntrusivePtr<OutputLayers const> outputLayers(PageId const& page_id) const;
+
+    void setOutputLayers(PageId const& page_id, IntrusivePtr<OutputLayers const> const& layers);
+
+    bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return m_changedPages.take(pages);
+    }
 private:
-    typedef std::map<PageId, Params> PerPageParams;
-    typedef std::map<PageId, OutputParams> PerPageOutputParams;
-    typedef std::map<PageId, ZoneSet> PerPageZones;
+    typedef std::unordered_map<PageId, Params> PerPageParams;
+    typedef std::unordered_map<PageId, OutputParams> PerPageOutputParams;
+    typedef std::unordered_map<PageId, ZoneSet> PerPageZones;
 
     static PropertySet initialPictureZoneProps();
 
     static PropertySet initialFillZoneProps();
 
-    mutable QMutex m_mutex;
+    mutable QReadWriteLock m_lock;
     PerPageParams m_perPageParams;
     PerPageOutputParams m_perPageOutputParams;
     PerPageZones m_perPagePictureZones;
     PerPageZones m_perPageFillZones;
     PropertySet m_defaultPictureZoneProps;
     PropertySet m_defaultFillZoneProps;
+    PageId m_outputLayersPage;
+    IntrusivePtr<OutputLayers const> m_ptrOutputLayers;
     int m_compression;
     QString m_compressionName;
+    ChangedPages m_changedPages;
 };
 
 } // namespace output
@@ -54,10 +54,12 @@
 #include "ThumbnailPixmapCache.h"
 #include "DebugImages.h"
 #include "OutputGenerator.h"
+#include "OutputLayers.h"
 #include "TiffWriter.h"
 #include "ImageLoader.h"
 #include "ErrorWidget.h"
 #include "imageproc/BinaryImage.h"
+#include "imageproc/ImageArena.h"
 #include "imageproc/PolygonUtils.h"
 #include "imageproc/DrawOver.h"
 #include "imageproc/Transform.h"
@@ -190,10 +192,12 @@ Task::process(
 {
     status.throwIfCancelled();
 
+    ImageArenaUsage const arena_usage;
+
     Params params(m_ptrSettings->getParams(m_pageId));
-    CommandLine const& cli = CommandLine::get();
+    ProcessingContext const& context = data.context();
 
-    if (cli.hasTiffForceKeepColorSpace()) {
+    if (context.tiffForceKeepColorSpace()) {
         ColorParams colorParams = params.colorParams();
         switch (data.origImage().format()) {
         case QImage::Format_Mono:
@@ -243,17 +247,29 @@ Task::process(
 
     OutputGenerator const generator(
         params.outputDpi(), params.colorParams(), params.despeckleLevel(),
-        new_xform, content_rect_phys
+        new_xform, content_rect_phys, data.contextPtr()
     );
 
+    // Pages above the configured size get their large buffers
+    // from memory-mapped temporary files rather than from RAM.
+    int const out_of_core_mpix = context.outOfCoreThresholdMpix();
+    QSize const out_size(generator.outputImageSize());
+    size_t file_backing_threshold = 0;
+    if (out_of_core_mpix > 0
+            && qint64(out_size.width()) * out_size.height() > qint64(out_of_core_mpix) * 1000000) {
+        // Anything at least as big as a bi-level version of the page.
+        file_backing_threshold = size_t(out_size.width()) * out_size.height() / 8;
+    }
+    ImageArena::FileBackingScope const file_backing(file_backing_threshold);
+
     OutputImageParams new_output_image_params(
         generator.outputImageSize(), generator.outputContentRect(),
         new_xform, params.outputDpi(), params.colorParams(),
         params.dewarpingMode(), params.distortionModel(),
         params.depthPerception(), params.despeckleLevel(),
         params.colorParams().colorMode() == ColorParams::BLACK_AND_WHITE ?
-                    GlobalStaticSettings::m_tiff_compr_method_bw :
-                    GlobalStaticSettings::m_tiff_compr_method_color);
+                    context.tiffCompressionBW() :
+                    context.tiffCompressionColor());
 
 //begin of modified by monday2000
 //Quadro_Zoner
@@ -317,11 +333,30 @@ Task::process(
         m_ptrSettings->setParams(m_pageId, p);
     }
 
-    do { // Just to be able to break from it.
+    std::unique_ptr<OutputParams> stored_output_params(
+        m_ptrSettings->getOutputParams(m_pageId)
+    );
 
-        std::unique_ptr<OutputParams> stored_output_params(
-            m_ptrSettings->getOutputParams(m_pageId)
-        );
+    // Set when the stored output only differs by the despeckling level,
+    // in which case the stored speckles can be swapped for the new ones.
+    bool redespeckle_only = false;
+    DespeckleLevel stored_despeckle_level = DESPECKLE_OFF;
+
+    // Intermediate images of the last output generation are kept for the
+    // page being edited, to re-render only what zone edits affect.
+    bool const keep_layers = context.interactive() && !m_batchProcessing;
+    IntrusivePtr<OutputLayers const> stored_layers;
+    if (keep_layers) {
+        stored_layers = m_ptrSettings->outputLayers(m_pageId);
+    }
+    // Set when picture zones have changed and the output
+    // can be recomposed from stored_layers.
+    bool recompose = false;
+    // Set when only fill zones have changed and they can
+    // be repainted over the stored output using stored_layers.
+    bool refill_only = false;
+
+    do { // Just to be able to break from it.
 
         if (!stored_output_params.get()) {
             need_reprocess = true;
@@ -329,25 +364,59 @@ Task::process(
         }
 
         if (!stored_output_params->outputImageParams().matches(new_output_image_params)) {
-            need_reprocess = true;
-            break;
+            stored_despeckle_level = stored_output_params->outputImageParams().despeckleLevel();
+            OutputImageParams same_level_params(new_output_image_params);
+            same_level_params.setDespeckleLevel(stored_despeckle_level);
+            if (stored_despeckle_level == DESPECKLE_OFF || params.despeckleLevel() == DESPECKLE_OFF
+                    || params.colorParams().colorMode() == ColorParams::COLOR_GRAYSCALE
+                    || !stored_output_params->outputImageParams().matches(same_level_params)) {
+                need_reprocess = true;
+                break;
+            }
+
+            if (!speckles_file_info.exists()) {
+                need_reprocess = true;
+                break;
+            }
+            if (!stored_output_params->specklesFileParams().matches(OutputFileParams(speckles_file_info))) {
+                need_reprocess = true;
+                break;
+            }
+
+            redespeckle_only = true;
         }
 
-        if (!PictureZoneComparator::equal(stored_output_params->pictureZones(), new_picture_zones)) {
+        bool const layers_usable = stored_layers && !need_reprocess && !redespeckle_only
+                                   && stored_layers->params.matches(stored_output_params->outputImageParams())
+                                   && PictureZoneComparator::equal(
+                                       stored_layers->pictureZones, stored_output_params->pictureZones(),
+                                       context.pictureDetectionSensitivity()
+                                   );
+
+        if (!PictureZoneComparator::equal(
+                    stored_output_params->pictureZones(), new_picture_zones,
+                    context.pictureDetectionSensitivity())) {
             need_reprocess = true;
             // currently there is no control to change sensitivity of a single page
             // so force it to be equal default value
             if (new_picture_zones.pictureZonesSensitivity() !=
-                    GlobalStaticSettings::m_picture_detection_sensitivity) {
+                    context.pictureDetectionSensitivity()) {
                 new_picture_zones.remove_auto_zones();
 //                new_picture_zones.setPictureZonesSensitivity(GlobalStaticSettings::m_picture_detection_sensitivity);
+            } else if (layers_usable && !stored_layers->normalized.isNull()) {
+                // Picture detection doesn't have to be redone.
+                recompose = true;
             }
             break;
         }
 
         if (!FillZoneComparator::equal(stored_output_params->fillZones(), new_fill_zones)) {
-            need_reprocess = true;
-            break;
+            if (!layers_usable) {
+                need_reprocess = true;
+                break;
+            }
+            // Continue checking the output file, which will be refilled.
+            refill_only = true;
         }
 
         if (!out_file_info.exists()) {
@@ -404,7 +473,7 @@ Task::process(
             need_reprocess = automask_img.isNull() || automask_img.size() != out_img.size();
         }
 
-        if (need_speckles_image && !need_reprocess) {
+        if ((need_speckles_image || redespeckle_only) && !need_reprocess) {
             QFile speckles_file(speckles_file_path);
             if (speckles_file.open(QIODevice::ReadOnly)) {
                 speckles_img = BinaryImage(ImageLoader::load(speckles_file, 0));
@@ -413,6 +482,79 @@ Task::process(
         }
     }
 
+    if (refill_only && !need_reprocess) {
+        generator.refill(
+            out_img, *stored_layers, stored_output_params->fillZones(), new_fill_zones
+        );
+
+        status.throwIfCancelled();
+
+        QString TiffCompressionUsed;
+        if (!TiffWriter::writeImage(context, out_file_path, out_img, false, 0, &TiffCompressionUsed)) {
+            m_ptrSettings->removeOutputParams(m_pageId);
+        } else {
+            OutputParams const out_params(
+                stored_output_params->outputImageParams(),
+                OutputFileParams(QFileInfo(out_file_path)),
+                stored_output_params->automaskFileParams(),
+                stored_output_params->specklesFileParams(),
+                new_picture_zones, new_fill_zones
+            );
+
+            m_ptrSettings->setOutputParams(m_pageId, out_params);
+        }
+
+        m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
+    }
+
+    if (redespeckle_only && !need_reprocess) {
+        // Only the despeckling level has changed.  Instead of generating
+        // the output again, swap the old speckles for the new ones.
+        DespeckleState const old_state(
+            out_img, speckles_img, stored_despeckle_level, params.outputDpi()
+        );
+        BinaryImage const new_speckles(
+            old_state.specklesAt(params.despeckleLevel(), status)
+        );
+
+        status.throwIfCancelled();
+
+        if (!DespeckleState::replaceSpeckles(out_img, speckles_img, new_speckles)) {
+            need_reprocess = true;
+        } else {
+            speckles_img = new_speckles;
+
+            bool invalidate_params = false;
+
+            QString TiffCompressionUsed;
+            if (!TiffWriter::writeImage(context, out_file_path, out_img, false, 0, &TiffCompressionUsed)) {
+                invalidate_params = true;
+            } else if (TiffCompressionUsed != new_output_image_params.TiffCompression()) {
+                new_output_image_params.setTiffCompression(TiffCompressionUsed);
+            }
+
+            if (!TiffWriter::writeImage(context, speckles_file_path, speckles_img.toQImage(), false, 0)) {
+                invalidate_params = true;
+            }
+
+            if (invalidate_params) {
+                m_ptrSettings->removeOutputParams(m_pageId);
+            } else {
+                OutputParams const out_params(
+                    new_output_image_params,
+                    OutputFileParams(QFileInfo(out_file_path)),
+                    stored_output_params->automaskFileParams(),
+                    OutputFileParams(QFileInfo(speckles_file_path)),
+                        new_picture_zones, new_fill_zones
+                );
+
+                m_ptrSettings->setOutputParams(m_pageId, out_params);
+            }
+
+            m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
+        }
+    }
+
     if (need_reprocess) {
         // Even in batch processing mode we should still write automask, because it
         // will be needed when we view the results back in interactive mode.
@@ -433,15 +575,32 @@ Task::process(
         // OutputGenerator will write a new distortion model
         // there, if dewarping mode is AUTO.
 
-        out_img = generator.process(
-                      status, data, new_picture_zones, new_fill_zones,
-                      params.dewarpingMode(), distortion_model,
-                      params.depthPerception(),
-                      false,
-                      write_automask ? &automask_img : nullptr,
-                      write_speckles_file ? &speckles_img : nullptr,
-                      m_ptrDbg.get(), &m_pageId, &m_ptrSettings
-                  );
+        IntrusivePtr<OutputLayers> layers;
+        if (recompose) {
+            layers.reset(new OutputLayers(*stored_layers));
+            out_img = generator.recompose(
+                          status, *layers, new_picture_zones, new_fill_zones,
+                          write_automask ? &automask_img : nullptr,
+                          write_speckles_file ? &speckles_img : nullptr,
+                          m_ptrDbg.get()
+                      );
+        } else {
+            if (keep_layers) {
+                layers.reset(new OutputLayers(new_output_image_params));
+            }
+            out_img = generator.process(
+                          status, data, new_picture_zones, new_fill_zones,
+                          params.dewarpingMode(), distortion_model,
+                          params.depthPerception(),
+                          false,
+                          write_automask ? &automask_img : nullptr,
+                          write_speckles_file ? &speckles_img : nullptr,
+                          m_ptrDbg.get(), &m_pageId, &m_ptrSettings, layers.get()
+                      );
+            if (layers) {
+                layers->pictureZones = new_picture_zones;
+            }
+        }
 
         if ((params.dewarpingMode() == DewarpingMode::AUTO && distortion_model.isValid())
 //begin of modified by monday2000
@@ -467,7 +626,7 @@ Task::process(
 
         QString TiffCompressionUsed;
 
-        if (!TiffWriter::writeImage(out_file_path, out_img, false, 0, &TiffCompressionUsed)) {
+        if (!TiffWriter::writeImage(context, out_file_path, out_img, false, 0, &TiffCompressionUsed)) {
             invalidate_params = true;
         } else {
             deleteMutuallyExclusiveOutputFiles();
@@ -489,18 +648,25 @@ Task::process(
             // Also note that QDir::mkdir() will fail if the directory already exists,
             // so we ignore its return value here.
 
-            if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage(), false, 0)) {
+            if (!TiffWriter::writeImage(context, automask_file_path, automask_img.toQImage(), false, 0)) {
                 invalidate_params = true;
             }
         }
         if (write_speckles_file) {
             if (!QDir().mkpath(speckles_dir)) {
                 invalidate_params = true;
-            } else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage(), false, 0)) {
+            } else if (!TiffWriter::writeImage(context, speckles_file_path, speckles_img.toQImage(), false, 0)) {
                 invalidate_params = true;
             }
         }
 
+        if (layers && !layers->unfilledOutput.isNull() && !invalidate_params) {
+            layers->params = new_output_image_params;
+            m_ptrSettings->setOutputLayers(m_pageId, layers);
+        } else if (keep_layers) {
+            m_ptrSettings->setOutputLayers(m_pageId, IntrusivePtr<OutputLayers const>());
+        }
+
         if (invalidate_params) {
             m_ptrSettings->removeOutputParams(m_pageId);
         } else {
@@ -522,6 +688,10 @@ Task::process(
         m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
     }
 
+    if (m_ptrDbg) {
+        arena_usage.print("output: image buffers:");
+    }
+
     DespeckleState const despeckle_state(
         out_img, speckles_img, params.despeckleLevel(), params.outputDpi()
     );
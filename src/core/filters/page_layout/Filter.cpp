@@ -42,6 +42,7 @@
 #include <QDomElement>
 #include <assert.h>
 #include "CommandLine.h"
+#include "ProcessingContext.h"
 #include "XmlMarshaller.h"
 #include "XmlUnmarshaller.h"
 
@@ -138,7 +139,7 @@ Filter::saveSettings(
     ProjectWriter const& writer, QDomDocument& doc) const
 {
 
-    QDomElement filter_el(doc.createElement("page-layout"));
+    QDomElement filter_el(doc.createElement(settingsElementName()));
 
     writer.enumPages([this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
         writePageSettings(doc, filter_el, page_id, numeric_id);
@@ -147,6 +148,26 @@ Filter::saveSettings(
     return filter_el;
 }
 
+QDomElement
+Filter::savePageSettings(
+    ProjectWriter const& writer, QDomDocument& doc,
+    std::set<PageId> const& pages) const
+{
+    QDomElement filter_el(doc.createElement(settingsElementName()));
+
+    writer.enumPages(pages, [this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
+        writePageSettings(doc, filter_el, page_id, numeric_id);
+    });
+
+    return filter_el;
+}
+
+bool
+Filter::takeChangedPages(std::set<PageId>& pages)
+{
+    return m_ptrSettings->takeChangedPages(pages);
+}
+
 void
 Filter::writePageSettings(
     QDomDocument& doc, QDomElement& filter_el,
@@ -164,45 +185,44 @@ Filter::writePageSettings(
     filter_el.appendChild(page_el);
 }
 
+QString
+Filter::settingsElementName() const
+{
+    return "page-layout";
+}
+
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadFilterSettings(
+    ProjectReader const& reader, QDomElement const& filter_el)
 {
     m_ptrSettings->clear();
+}
+
+void
+Filter::loadPageSettings(ProjectReader const& reader, QDomElement const& el)
+{
+    if (el.tagName() != "page") {
+        return;
+    }
 
-    QDomElement const filter_el(
-        filters_el.namedItem("page-layout").toElement()
-    );
-
-    QString const page_tag_name("page");
-    QDomNode node(filter_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != page_tag_name) {
-            continue;
-        }
-        QDomElement const el(node.toElement());
-
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-
-        PageId const page_id(reader.pageId(id));
-        if (page_id.isNull()) {
-            continue;
-        }
-
-        QDomElement const params_el(el.namedItem("params").toElement());
-        if (params_el.isNull()) {
-            continue;
-        }
-
-        Params const params(params_el);
-        m_ptrSettings->setPageParams(page_id, params);
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
     }
+
+    PageId const page_id(reader.pageId(id));
+    if (page_id.isNull()) {
+        return;
+    }
+
+    QDomElement const params_el(el.namedItem("params").toElement());
+    if (params_el.isNull()) {
+        return;
+    }
+
+    Params const params(params_el);
+    m_ptrSettings->setPageParams(page_id, params);
 }
 
 void
@@ -221,9 +241,10 @@ Filter::invalidateContentBox(PageId const& page_id)
 }
 
 bool
-Filter::checkReadyForOutput(ProjectPages const& pages, PageId const* ignore)
+Filter::checkReadyForOutput(
+    ProjectPages const& pages, ProcessingContext const& context, PageId const* ignore)
 {
-    if (CommandLine::get().hasDisableCheckOutput()) {
+    if (context.disableCheckOutput()) {
         return true;
     }
     PageSequence const snapshot(pages.toPageSequence(PAGE_VIEW));
@@ -31,6 +31,7 @@
 
 class PageId;
 class ProjectPages;
+class ProcessingContext;
 class PageSelectionAccessor;
 class ImageTransformation;
 class QString;
@@ -79,8 +80,19 @@ public:
     virtual QDomElement saveSettings(
         ProjectWriter const& writer, QDomDocument& doc) const;
 
-    virtual void loadSettings(
-        ProjectReader const& reader, QDomElement const& filters_el);
+    virtual QDomElement savePageSettings(
+        ProjectWriter const& writer, QDomDocument& doc,
+        std::set<PageId> const& pages) const;
+
+    virtual bool takeChangedPages(std::set<PageId>& pages);
+
+    virtual QString settingsElementName() const;
+
+    virtual void loadFilterSettings(
+        ProjectReader const& reader, QDomElement const& filter_el);
+
+    virtual void loadPageSettings(
+        ProjectReader const& reader, QDomElement const& el);
 
     void setContentBox(
         PageId const& page_id, ImageTransformation const& xform,
@@ -89,7 +101,8 @@ public:
     void invalidateContentBox(PageId const& page_id);
 
     bool checkReadyForOutput(
-        ProjectPages const& pages, PageId const* ignore = 0);
+        ProjectPages const& pages, ProcessingContext const& context,
+        PageId const* ignore = 0);
 
     IntrusivePtr<Task> createTask(
         PageId const& page_id,
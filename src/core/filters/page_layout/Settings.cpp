@@ -27,18 +27,20 @@
 #include "CommandLine.h"
 #include <QSizeF>
 #include <QRectF>
-#include <QMutex>
-#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
 #ifndef Q_MOC_RUN
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #endif
 #include <algorithm>
-#include <functional> // for std::greater<>
+#include <functional> // for std::greater<> and std::hash<>
 #include <vector>
 #include <stddef.h>
 
@@ -188,7 +190,7 @@ private:
     typedef multi_index_container <
     Item,
     indexed_by <
-    ordered_unique<member<Item, PageId, &Item::pageId> >,
+    hashed_unique<member<Item, PageId, &Item::pageId>, std::hash<PageId> >,
     sequenced<tag<SequencedTag> >,
     ordered_non_unique <
     tag<DescWidthTag>,
@@ -223,7 +225,7 @@ private:
     typedef Container::index<DescWidthTag>::type DescWidthOrder;
     typedef Container::index<DescHeightTag>::type DescHeightOrder;
 
-    mutable QMutex m_mutex;
+    mutable QReadWriteLock m_lock;
     Container m_items;
     UnorderedItems& m_unorderedItems;
     DescWidthOrder& m_descWidthOrder;
@@ -257,25 +259,29 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    return m_ptrImpl->clear();
+    m_ptrImpl->clear();
+    m_changedPages.addAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
     m_ptrImpl->performRelinking(relinker);
+    m_changedPages.addAll();
 }
 
 void
 Settings::removePagesMissingFrom(PageSequence const& pages)
 {
     m_ptrImpl->removePagesMissingFrom(pages);
+    m_changedPages.addAll();
 }
 
 void
 Settings::removePages(const std::set<PageId>& pages)
 {
     m_ptrImpl->removePages(pages);
+    m_changedPages.add(pages);
 }
 
 bool
@@ -294,7 +300,8 @@ Settings::getPageParams(PageId const& page_id) const
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
-    return m_ptrImpl->setPageParams(page_id, params);
+    m_ptrImpl->setPageParams(page_id, params);
+    m_changedPages.add(page_id);
 }
 
 Params
@@ -302,10 +309,15 @@ Settings::getParams(
     PageId const& page_id, QRectF const& page_rect, QRectF const& content_rect, QSizeF const& content_size_mm,
     QSizeF* agg_hard_size_before, QSizeF* agg_hard_size_after)
 {
-    return m_ptrImpl->getParams(
-               page_id, page_rect, content_rect, content_size_mm,
-               agg_hard_size_before, agg_hard_size_after
-           );
+    Params const params(
+        m_ptrImpl->getParams(
+            page_id, page_rect, content_rect, content_size_mm,
+            agg_hard_size_before, agg_hard_size_after
+        )
+    );
+    // The content size got updated as well.
+    m_changedPages.add(page_id);
+    return params;
 }
 
 QRectF const&
@@ -324,6 +336,7 @@ void
 Settings::setHardMarginsMM(PageId const& page_id, MarginsWithAuto const& margins_mm)
 {
     m_ptrImpl->setHardMarginsMM(page_id, margins_mm);
+    m_changedPages.add(page_id);
 }
 
 Alignment
@@ -335,20 +348,27 @@ Settings::getPageAlignment(PageId const& page_id) const
 Settings::AggregateSizeChanged
 Settings::setPageAlignment(PageId const& page_id, Alignment const& alignment)
 {
-    return m_ptrImpl->setPageAlignment(page_id, alignment);
+    AggregateSizeChanged const changed(m_ptrImpl->setPageAlignment(page_id, alignment));
+    m_changedPages.add(page_id);
+    return changed;
 }
 
 Settings::AggregateSizeChanged
 Settings::setContentSizeMM(
     PageId const& page_id, QSizeF const& content_size_mm, QRectF const& content_rect)
 {
-    return m_ptrImpl->setContentSizeMM(page_id, content_size_mm, content_rect);
+    AggregateSizeChanged const changed(
+        m_ptrImpl->setContentSizeMM(page_id, content_size_mm, content_rect)
+    );
+    m_changedPages.add(page_id);
+    return changed;
 }
 
 void
 Settings::invalidateContentSize(PageId const& page_id)
 {
-    return m_ptrImpl->invalidateContentSize(page_id);
+    m_ptrImpl->invalidateContentSize(page_id);
+    m_changedPages.add(page_id);
 }
 
 QSizeF
@@ -424,14 +444,14 @@ Settings::Impl::~Impl()
 void
 Settings::Impl::clear()
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_items.clear();
 }
 
 void
 Settings::Impl::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     Container new_items;
 
     for (Item const& item : m_unorderedItems) {
@@ -447,7 +467,7 @@ Settings::Impl::performRelinking(AbstractRelinker const& relinker)
 void
 Settings::Impl::removePagesMissingFrom(PageSequence const& pages)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     std::vector<PageId> sorted_pages;
     sorted_pages.reserve(pages.numPages());
@@ -470,7 +490,7 @@ Settings::Impl::removePagesMissingFrom(PageSequence const& pages)
 void
 Settings::Impl::removePages(std::set<PageId> const& pages)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     UnorderedItems::const_iterator it(m_unorderedItems.begin());
     UnorderedItems::const_iterator const end(m_unorderedItems.end());
@@ -487,7 +507,7 @@ bool
 Settings::Impl::checkEverythingDefined(
     PageSequence const& pages, PageId const* ignore) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     for (const PageInfo& page_info : pages) {
         if (ignore && *ignore == page_info.id()) {
@@ -505,7 +525,7 @@ Settings::Impl::checkEverythingDefined(
 std::unique_ptr<Params>
 Settings::Impl::getPageParams(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     Container::iterator const it(m_items.find(page_id));
     if (it == m_items.end()) {
@@ -520,16 +540,16 @@ Settings::Impl::getPageParams(PageId const& page_id) const
 void
 Settings::Impl::setPageParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     Item const new_item(
         page_id, params.hardMarginsMM(), params.pageRect(),
         params.contentRect(), params.contentSizeMM(), params.alignment()
     );
 
-    Container::iterator const it(m_items.lower_bound(page_id));
-    if (it == m_items.end() || page_id < it->pageId) {
-        m_items.insert(it, new_item);
+    Container::iterator const it(m_items.find(page_id));
+    if (it == m_items.end()) {
+        m_items.insert(new_item);
     } else {
         m_items.replace(it, new_item);
     }
@@ -540,20 +560,20 @@ Settings::Impl::getParams(
     PageId const& page_id, QRectF const& page_rect, QRectF const& content_rect, QSizeF const& content_size_mm,
     QSizeF* agg_hard_size_before, QSizeF* agg_hard_size_after)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     if (agg_hard_size_before) {
         *agg_hard_size_before = getAggregateHardSizeMMLocked();
     }
 
-    Container::iterator const it(m_items.lower_bound(page_id));
+    Container::iterator const it(m_items.find(page_id));
     Container::iterator item_it(it);
-    if (it == m_items.end() || page_id < it->pageId) {
+    if (it == m_items.end()) {
         Item const item(
             page_id, m_defaultHardMarginsMM, page_rect,
             content_rect, content_size_mm, m_defaultAlignment
         );
-        item_it = m_items.insert(it, item);
+        item_it = m_items.insert(item).first;
     } else {
         m_items.modify(it, ModifyContentSize(content_size_mm, content_rect));
         m_items.modify(it, ModifyPageRect(page_rect)); // in case Proportional alignment was mass applied this rect may be empty or incorrect
@@ -572,7 +592,7 @@ Settings::Impl::getParams(
 MarginsWithAuto
 Settings::Impl::getHardMarginsMM(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     Container::iterator const it(m_items.find(page_id));
     if (it == m_items.end()) {
@@ -586,14 +606,14 @@ void
 Settings::Impl::setHardMarginsMM(
     PageId const& page_id, MarginsWithAuto const& margins_mm)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
-    Container::iterator const it(m_items.lower_bound(page_id));
-    if (it == m_items.end() || page_id < it->pageId) {
+    Container::iterator const it(m_items.find(page_id));
+    if (it == m_items.end()) {
         Item const item(
             page_id, margins_mm, m_invalidRect, m_invalidRect, m_invalidSize, m_defaultAlignment
         );
-        m_items.insert(it, item);
+        m_items.insert(item);
     } else {
         m_items.modify(it, ModifyMargins(margins_mm));
     }
@@ -602,7 +622,7 @@ Settings::Impl::setHardMarginsMM(
 Alignment
 Settings::Impl::getPageAlignment(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     Container::iterator const it(m_items.find(page_id));
     if (it == m_items.end()) {
@@ -616,16 +636,16 @@ Settings::AggregateSizeChanged
 Settings::Impl::setPageAlignment(
     PageId const& page_id, Alignment const& alignment)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     QSizeF const agg_size_before(getAggregateHardSizeMMLocked());
 
-    Container::iterator const it(m_items.lower_bound(page_id));
-    if (it == m_items.end() || page_id < it->pageId) {
+    Container::iterator const it(m_items.find(page_id));
+    if (it == m_items.end()) {
         Item const item(
             page_id, m_defaultHardMarginsMM, m_invalidRect, m_invalidRect, m_invalidSize, alignment
         );
-        m_items.insert(it, item);
+        m_items.insert(item);
     } else {
         m_items.modify(it, ModifyAlignment(alignment));
     }
@@ -642,17 +662,17 @@ Settings::AggregateSizeChanged
 Settings::Impl::setContentSizeMM(
     PageId const& page_id, QSizeF const& content_size_mm, QRectF const& content_rect)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     QSizeF const agg_size_before(getAggregateHardSizeMMLocked());
 
-    Container::iterator const it(m_items.lower_bound(page_id));
-    if (it == m_items.end() || page_id < it->pageId) {
+    Container::iterator const it(m_items.find(page_id));
+    if (it == m_items.end()) {
         Item const item(
             page_id, m_defaultHardMarginsMM, m_invalidRect, content_rect,
             content_size_mm, m_defaultAlignment
         );
-        m_items.insert(it, item);
+        m_items.insert(item);
     } else {
         m_items.modify(it, ModifyContentSize(content_size_mm, content_rect));
     }
@@ -668,7 +688,7 @@ Settings::Impl::setContentSizeMM(
 void
 Settings::Impl::invalidateContentSize(PageId const& page_id)
 {
-    QMutexLocker const locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     Container::iterator const it(m_items.find(page_id));
     if (it != m_items.end()) {
@@ -679,7 +699,7 @@ Settings::Impl::invalidateContentSize(PageId const& page_id)
 QSizeF
 Settings::Impl::getAggregateHardSizeMM() const
 {
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
     return getAggregateHardSizeMMLocked();
 }
 
@@ -708,7 +728,7 @@ Settings::Impl::getAggregateHardSizeMM(
         return getAggregateHardSizeMM();
     }
 
-    QMutexLocker const locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     if (m_items.empty()) {
         return QSizeF(0.0, 0.0);
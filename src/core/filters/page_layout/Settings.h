@@ -22,6 +22,7 @@
 #include "NonCopyable.h"
 #include "RefCountable.h"
 #include "Margins.h"
+#include "ChangedPages.h"
 #include <memory>
 #include <set>
 
@@ -163,6 +164,11 @@ public:
     QSizeF getAggregateHardSizeMM(
         PageId const& page_id, QSizeF const& hard_size_mm,
         Alignment const& alignment) const;
+
+    bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return m_changedPages.take(pages);
+    }
 private:
     class Impl;
     class Item;
@@ -172,6 +178,7 @@ private:
     class ModifyPageRect;
 
     std::unique_ptr<Impl> m_ptrImpl;
+    ChangedPages m_changedPages;
 };
 
 } // namespace page_layout
@@ -103,11 +103,7 @@ Filter::saveSettings(
     ProjectWriter const& writer, QDomDocument& doc) const
 {
 
-    QDomElement filter_el(doc.createElement("page-split"));
-    filter_el.setAttribute(
-        "defaultLayoutType",
-        layoutTypeToString(m_ptrSettings->defaultLayoutType())
-    );
+    QDomElement filter_el(createFilterElement(doc));
 
     writer.enumImages([this, &doc, &filter_el](ImageId const& image_id, int numeric_id) {
         writeImageSettings(doc, filter_el, image_id, numeric_id);
@@ -116,56 +112,89 @@ Filter::saveSettings(
     return filter_el;
 }
 
+QDomElement
+Filter::savePageSettings(
+    ProjectWriter const& writer, QDomDocument& doc,
+    std::set<PageId> const& pages) const
+{
+    QDomElement filter_el(createFilterElement(doc));
+
+    writer.enumImages(pages, [this, &doc, &filter_el](ImageId const& image_id, int numeric_id) {
+        writeImageSettings(doc, filter_el, image_id, numeric_id);
+    });
+
+    return filter_el;
+}
+
+bool
+Filter::takeChangedPages(std::set<PageId>& pages)
+{
+    return m_ptrSettings->takeChangedPages(pages);
+}
+
+QDomElement
+Filter::createFilterElement(QDomDocument& doc) const
+{
+    QDomElement filter_el(doc.createElement(settingsElementName()));
+    filter_el.setAttribute(
+        "defaultLayoutType",
+        layoutTypeToString(m_ptrSettings->defaultLayoutType())
+    );
+
+    return filter_el;
+}
+
+QString
+Filter::settingsElementName() const
+{
+    return "page-split";
+}
+
 void
-Filter::loadSettings(
-    ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadFilterSettings(
+    ProjectReader const& reader, QDomElement const& filter_el)
 {
     m_ptrSettings->clear();
 
-    QDomElement const filter_el(filters_el.namedItem("page-split").toElement());
     QString const default_layout_type(
         filter_el.attribute("defaultLayoutType")
     );
     m_ptrSettings->setLayoutTypeForAllPages(
         layoutTypeFromString(default_layout_type)
     );
+}
 
-    QString const image_tag_name("image");
-    QDomNode node(filter_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != image_tag_name) {
-            continue;
-        }
-        QDomElement el(node.toElement());
-
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-
-        ImageId const image_id(reader.imageId(id));
-        if (image_id.isNull()) {
-            continue;
-        }
-
-        Settings::UpdateAction update;
-
-        QString const layout_type(el.attribute("layoutType"));
-        if (!layout_type.isEmpty()) {
-            update.setLayoutType(layoutTypeFromString(layout_type));
-        }
-
-        QDomElement params_el(el.namedItem("params").toElement());
-        if (!params_el.isNull()) {
-            update.setParams(Params(params_el));
-        }
-
-        m_ptrSettings->updatePage(image_id, update);
+void
+Filter::loadPageSettings(ProjectReader const& reader, QDomElement const& el)
+{
+    if (el.tagName() != "image") {
+        return;
     }
+
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
+    }
+
+    ImageId const image_id(reader.imageId(id));
+    if (image_id.isNull()) {
+        return;
+    }
+
+    Settings::UpdateAction update;
+
+    QString const layout_type(el.attribute("layoutType"));
+    if (!layout_type.isEmpty()) {
+        update.setLayoutType(layoutTypeFromString(layout_type));
+    }
+
+    QDomElement params_el(el.namedItem("params").toElement());
+    if (!params_el.isNull()) {
+        update.setParams(Params(params_el));
+    }
+
+    m_ptrSettings->updatePage(image_id, update);
 }
 
 void
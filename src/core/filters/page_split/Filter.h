@@ -72,8 +72,19 @@ public:
     virtual QDomElement saveSettings(
         ProjectWriter const& wirter, QDomDocument& doc) const;
 
-    virtual void loadSettings(
-        ProjectReader const& reader, QDomElement const& filters_el);
+    virtual QDomElement savePageSettings(
+        ProjectWriter const& writer, QDomDocument& doc,
+        std::set<PageId> const& pages) const;
+
+    virtual bool takeChangedPages(std::set<PageId>& pages);
+
+    virtual QString settingsElementName() const;
+
+    virtual void loadFilterSettings(
+        ProjectReader const& reader, QDomElement const& filter_el);
+
+    virtual void loadPageSettings(
+        ProjectReader const& reader, QDomElement const& el);
 
     IntrusivePtr<Task> createTask(PageInfo const& page_info,
                                   IntrusivePtr<deskew::Task> const& next_task,
@@ -100,6 +111,8 @@ public:
     virtual int selectedPageOrder() const;
     virtual void selectPageOrder(int option);
 private:
+    QDomElement createFilterElement(QDomDocument& doc) const;
+
     void writeImageSettings(
         QDomDocument& doc, QDomElement& filter_el,
         ImageId const& image_id, int const numeric_id) const;
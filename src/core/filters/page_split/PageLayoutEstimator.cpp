@@ -26,6 +26,7 @@
 #include "DebugImages.h"
 #include "Dpi.h"
 #include "ImageTransformation.h"
+#include "FilterData.h"
 #include "foundation/Span.h"
 #include "imageproc/Binarize.h"
 #include "imageproc/BinaryThreshold.h"
@@ -244,23 +245,20 @@ int numPages(LayoutType const layout_type, ImageTransformation const& pre_xform)
 
 PageLayout
 PageLayoutEstimator::estimatePageLayout(
-    LayoutType const layout_type, QImage const& input,
-    ImageTransformation const& pre_xform,
-    BinaryThreshold const bw_threshold,
-    DebugImages* const dbg)
+    LayoutType const layout_type, FilterData const& data, DebugImages* const dbg)
 {
     if (layout_type == SINGLE_PAGE_UNCUT) {
-        return PageLayout(pre_xform.resultingRect());
+        return PageLayout(data.xform().resultingRect());
     }
 
     std::unique_ptr<PageLayout> layout(
-        tryCutAtFoldingLine(layout_type, input, pre_xform, dbg)
+        tryCutAtFoldingLine(layout_type, data.grayImage(), data.xform(), dbg)
     );
     if (layout.get()) {
         return *layout;
     }
 
-    return cutAtWhitespace(layout_type, input, pre_xform, bw_threshold, dbg);
+    return cutAtWhitespace(layout_type, data, dbg);
 }
 
 namespace
@@ -383,26 +381,21 @@ PageLayoutEstimator::tryCutAtFoldingLine(
  * \param layout_type The type of a layout to detect.  If set to
  *        something other than AUTO_LAYOUT_TYPE, the returned
  *        layout will have the same type.
- * \param input The input image.  Will be converted to grayscale unless
- *        it's already grayscale.
- * \param pre_xform The logical transformation applied to the input image.
- *        The resulting page layout will be in transformed coordinates.
- * \param bw_threshold The global binarization threshold for the input image.
+ * \param data The input image and the logical transformation applied
+ *        to it.  The resulting page layout will be in transformed coordinates.
  * \param dbg An optional sink for debugging images.
  * \return Even if no suitable whitespace was found, this function
  *         will return a PageLayout consistent with the layout_type requested.
  */
 PageLayout
 PageLayoutEstimator::cutAtWhitespace(
-    LayoutType const layout_type, QImage const& input,
-    ImageTransformation const& pre_xform,
-    BinaryThreshold const bw_threshold,
-    DebugImages* const dbg)
+    LayoutType const layout_type, FilterData const& data, DebugImages* const dbg)
 {
-    QTransform xform;
+    ImageTransformation const& pre_xform = data.xform();
 
-    // Convert to B/W and rotate.
-    BinaryImage img(to300DpiBinary(input, xform, bw_threshold));
+    // Get the 300 DPI B/W image and rotate it.
+    QTransform xform(data.bwImageTransform(Dpi(300, 300)));
+    BinaryImage img(data.bwImage(Dpi(300, 300)));
 
     // Note: here we assume the only transformation applied
     // to the input image is orthogonal rotation.
@@ -548,29 +541,6 @@ PageLayoutEstimator::cutAtWhitespaceDeskewed150(
     }
 }
 
-imageproc::BinaryImage
-PageLayoutEstimator::to300DpiBinary(
-    QImage const& img, QTransform& xform,
-    BinaryThreshold const binary_threshold)
-{
-    double const xfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterX();
-    double const yfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterY();
-    if (fabs(xfactor - 1.0) < 0.1 && fabs(yfactor - 1.0) < 0.1) {
-        return BinaryImage(img, binary_threshold);
-    }
-
-    QTransform scale_xform;
-    scale_xform.scale(xfactor, yfactor);
-    xform *= scale_xform;
-    QSize const new_size(
-        std::max(1, (int)ceil(xfactor * img.width())),
-        std::max(1, (int)ceil(yfactor * img.height()))
-    );
-
-    GrayImage const new_image(scaleToGray(GrayImage(img), new_size));
-    return BinaryImage(new_image, binary_threshold);
-}
-
 BinaryImage
 PageLayoutEstimator::removeGarbageAnd2xDownscale(
     BinaryImage const& image, DebugImages* dbg)
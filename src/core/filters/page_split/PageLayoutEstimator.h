@@ -30,6 +30,7 @@ class QPoint;
 class QImage;
 class QTransform;
 class ImageTransformation;
+class FilterData;
 class DebugImages;
 class Span;
 
@@ -53,20 +54,15 @@ public:
      * \param layout_type The type of a layout to detect.  If set to
      *        something other than Rule::AUTO_DETECT, the returned
      *        layout will have the same type.
-     * \param input The input image.  Will be converted to grayscale unless
-     *        it's already grayscale.
-     * \param pre_xform The logical transformation applied to the input image.
-     *        The resulting page layout will be in transformed coordinates.
-     * \param bw_threshold The global binarization threshold for the
-     *        input image.
+     * \param data The input image and the logical transformation applied
+     *        to it.  The resulting page layout will be in transformed
+     *        coordinates.
      * \param dbg An optional sink for debugging images.
      * \return The estimated PageLayout of type consistent with the
      *         requested layout type.
      */
     static PageLayout estimatePageLayout(
-        LayoutType layout_type, QImage const& input,
-        ImageTransformation const& pre_xform,
-        imageproc::BinaryThreshold bw_threshold,
+        LayoutType layout_type, FilterData const& data,
         DebugImages* dbg = 0);
 private:
     static std::unique_ptr<PageLayout> tryCutAtFoldingLine(
@@ -74,20 +70,13 @@ private:
         ImageTransformation const& pre_xform, DebugImages* dbg);
 
     static PageLayout cutAtWhitespace(
-        LayoutType layout_type, QImage const& input,
-        ImageTransformation const& pre_xform,
-        imageproc::BinaryThreshold const bw_threshold,
-        DebugImages* dbg);
+        LayoutType layout_type, FilterData const& data, DebugImages* dbg);
 
     static PageLayout cutAtWhitespaceDeskewed150(
         LayoutType layout_type, int num_pages,
         imageproc::BinaryImage const& input,
         bool left_offcut, bool right_offcut, DebugImages* dbg);
 
-    static imageproc::BinaryImage to300DpiBinary(
-        QImage const& img, QTransform& xform,
-        imageproc::BinaryThreshold threshold);
-
     static imageproc::BinaryImage removeGarbageAnd2xDownscale(
         imageproc::BinaryImage const& image, DebugImages* dbg);
 
@@ -19,7 +19,8 @@
 #include "Settings.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include <assert.h>
 
 namespace page_split
@@ -37,16 +38,17 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     m_perPageRecords.clear();
     m_defaultLayoutType = AUTO_LAYOUT_TYPE;
+    m_changedPages.addAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     PerPageRecords new_records;
 
     for (PerPageRecords::value_type const& kv : m_perPageRecords) {
@@ -57,19 +59,20 @@ Settings::performRelinking(AbstractRelinker const& relinker)
     }
 
     m_perPageRecords.swap(new_records);
+    m_changedPages.addAll();
 }
 
 LayoutType
 Settings::defaultLayoutType() const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
     return m_defaultLayoutType;
 }
 
 void
 Settings::setLayoutTypeForAllPages(LayoutType const layout_type)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     PerPageRecords::iterator it(m_perPageRecords.begin());
     PerPageRecords::iterator const end(m_perPageRecords.end());
@@ -83,12 +86,13 @@ Settings::setLayoutTypeForAllPages(LayoutType const layout_type)
     }
 
     m_defaultLayoutType = layout_type;
+    m_changedPages.addAll();
 }
 
 void
 Settings::setLayoutTypeFor(LayoutType const layout_type, std::set<PageId> const& pages)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
 
     UpdateAction action;
     //action.setLayoutType(layout_type);
@@ -101,7 +105,7 @@ Settings::setLayoutTypeFor(LayoutType const layout_type, std::set<PageId> const&
 Settings::Record
 Settings::getPageRecord(ImageId const& image_id) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
     return getPageRecordLocked(image_id);
 }
 
@@ -119,16 +123,17 @@ Settings::getPageRecordLocked(ImageId const& image_id) const
 void
 Settings::updatePage(ImageId const& image_id, UpdateAction const& action)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     updatePageLocked(image_id, action);
 }
 
 void
 Settings::updatePageLocked(ImageId const& image_id, UpdateAction const& action)
 {
-    PerPageRecords::iterator it(m_perPageRecords.lower_bound(image_id));
-    if (it == m_perPageRecords.end() ||
-            m_perPageRecords.key_comp()(image_id, it->first)) {
+    m_changedPages.add(image_id);
+
+    PerPageRecords::iterator it(m_perPageRecords.find(image_id));
+    if (it == m_perPageRecords.end()) {
         // No record exists for this page.
 
         Record record(m_defaultLayoutType);
@@ -140,7 +145,7 @@ Settings::updatePageLocked(ImageId const& image_id, UpdateAction const& action)
 
         if (!record.isNull()) {
             m_perPageRecords.insert(
-                it, PerPageRecords::value_type(image_id, record)
+                PerPageRecords::value_type(image_id, record)
             );
         }
     } else {
@@ -170,11 +175,11 @@ Settings::Record
 Settings::conditionalUpdate(
     ImageId const& image_id, UpdateAction const& action, bool* conflict)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
+    m_changedPages.add(image_id);
 
-    PerPageRecords::iterator it(m_perPageRecords.lower_bound(image_id));
-    if (it == m_perPageRecords.end() ||
-            m_perPageRecords.key_comp()(image_id, it->first)) {
+    PerPageRecords::iterator it(m_perPageRecords.find(image_id));
+    if (it == m_perPageRecords.end()) {
         // No record exists for this page.
 
         Record record(m_defaultLayoutType);
@@ -189,7 +194,7 @@ Settings::conditionalUpdate(
 
         if (!record.isNull()) {
             m_perPageRecords.insert(
-                it, PerPageRecords::value_type(image_id, record)
+                PerPageRecords::value_type(image_id, record)
             );
         }
 
@@ -26,9 +26,10 @@
 #include "Params.h"
 #include "ImageId.h"
 #include "PageId.h"
-#include <QMutex>
+#include "ChangedPages.h"
+#include <QReadWriteLock>
 #include <memory>
-#include <map>
+#include <unordered_map>
 #include <set>
 
 class AbstractRelinker;
@@ -188,8 +189,13 @@ public:
     Record conditionalUpdate(
         ImageId const& image_id, UpdateAction const& action,
         bool* conflict = 0);
+
+    bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return m_changedPages.take(pages);
+    }
 private:
-    typedef std::map<ImageId, BaseRecord> PerPageRecords;
+    typedef std::unordered_map<ImageId, BaseRecord> PerPageRecords;
 
     Record getPageRecordLocked(ImageId const& image_id) const;
 
@@ -197,9 +203,10 @@ private:
 
     void updatePageLocked(PerPageRecords::iterator it, UpdateAction const& action);
 
-    mutable QMutex m_mutex;
+    mutable QReadWriteLock m_lock;
     PerPageRecords m_perPageRecords;
     LayoutType m_defaultLayoutType;
+    ChangedPages m_changedPages;
 };
 
 } // namespace page_split
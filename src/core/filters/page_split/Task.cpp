@@ -163,9 +163,7 @@ Task::process(TaskStatus const& status, FilterData const& data)
 
         if (need_reprocess) {
             new_layout = PageLayoutEstimator::estimatePageLayout(
-                             record.combinedLayoutType(),
-                             data.grayImage(), data.xform(),
-                             data.bwThreshold(), m_ptrDbg.get()
+                             record.combinedLayoutType(), data, m_ptrDbg.get()
                          );
             status.throwIfCancelled();
         } else if (params->pageLayout().uncutOutline().isEmpty()) {
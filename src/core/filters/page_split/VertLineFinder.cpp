@@ -38,6 +38,7 @@
 #include <Qt>
 #include <QDebug>
 #include <list>
+#include <vector>
 #include <algorithm>
 #include <math.h>
 
@@ -145,17 +146,26 @@ VertLineFinder::findLines(
     double const margin_mm = 3.5;
     int const margin = (int)floor(0.5 + margin_mm * constants::MM2INCH * dpi);
 
-    int const x_limit = raster_lines.width() - margin;
+    int const width = raster_lines.width();
+    int const x_limit = width - margin;
     int const height = raster_lines.height();
-    uint8_t const* line = raster_lines.data();
-    int const stride = raster_lines.stride();
-    for (int y = 0; y < height; ++y, line += stride) {
-        for (int x = margin; x < x_limit; ++x) {
-            unsigned const val = line[x];
-            if (val > 1) {
-                line_detector.process(x, y, weight_table[val]);
+
+    {
+        // Points with zero weight are skipped by the line detector.
+        std::vector<unsigned> weights(width * height, 0);
+        uint8_t const* line = raster_lines.data();
+        int const stride = raster_lines.stride();
+        unsigned* weights_line = weights.data();
+        for (int y = 0; y < height; ++y, line += stride, weights_line += width) {
+            for (int x = margin; x < x_limit; ++x) {
+                unsigned const val = line[x];
+                if (val > 1) {
+                    weights_line[x] = weight_table[val];
+                }
             }
         }
+
+        line_detector.processRows(weights.data(), width, margin, x_limit, height);
     }
 
     unsigned const min_quality = (unsigned)(height * line_thickness * 1.8) + 1;
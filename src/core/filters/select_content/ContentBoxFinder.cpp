@@ -23,6 +23,7 @@
 #include "ImageTransformation.h"
 #include "Dpi.h"
 #include "Despeckle.h"
+#include "PerformanceTimer.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/Binarize.h"
@@ -35,6 +36,7 @@
 #include "imageproc/GrayRasterOp.h"
 #include "imageproc/SeedFill.h"
 #include "imageproc/Morphology.h"
+#include "imageproc/RunLengthImage.h"
 #include "imageproc/Grayscale.h"
 #include "imageproc/SlicedHistogram.h"
 #include "imageproc/PolygonRasterizer.h"
@@ -61,8 +63,6 @@
 #include <stdlib.h>
 #include <limits.h>
 
-#include "CommandLine.h"
-
 namespace select_content
 {
 
@@ -122,19 +122,10 @@ ContentBoxFinder::findContentBox(
         return QRectF();
     }
 
-    uint8_t const darkest_gray_level = darkestGrayLevel(data.grayImage());
-    QColor const outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
-
-    QImage gray150(
-        transformToGray(
-            data.grayImage(), xform_150dpi.transform(),
-            xform_150dpi.resultingRect().toRect(),
-            OutsidePixels::assumeColor(outside_color)
-        )
-    );
-    // Note that we fill new areas that appear as a result of
-    // rotation with black, not white.  Filling them with white
+    // Note that new areas that appear as a result of rotation
+    // are filled with black, not white.  Filling them with white
     // may be bad for detecting the shadow around the page.
+    QImage const gray150(data.transformedGrayImage(Dpi(150, 150)));
     if (dbg) {
         dbg->add(gray150, "gray150");
     }
@@ -159,24 +150,29 @@ ContentBoxFinder::findContentBox(
         dbg->add(bw150, "page_mask_applied");
     }
 
-    BinaryImage hor_shadows_seed(openBrick(bw150, QSize(200, 14), BLACK));
+    // Shadows are long and mostly solid, so opening them with long
+    // bricks is much cheaper on runs of black pixels than on bitmaps.
+    PerformanceTimer seeds_timer;
+    RunLengthImage const bw150_runs(bw150);
+
+    RunLengthImage shadows_seed_runs(bw150_runs.opened(QSize(200, 14), BLACK));
     if (dbg) {
-        dbg->add(hor_shadows_seed, "hor_shadows_seed");
+        dbg->add(shadows_seed_runs.toBinaryImage(), "hor_shadows_seed");
     }
 
     status.throwIfCancelled();
 
-    BinaryImage ver_shadows_seed(openBrick(bw150, QSize(14, 300), BLACK));
+    RunLengthImage const ver_shadows_seed_runs(bw150_runs.opened(QSize(14, 300), BLACK));
     if (dbg) {
-        dbg->add(ver_shadows_seed, "ver_shadows_seed");
+        dbg->add(ver_shadows_seed_runs.toBinaryImage(), "ver_shadows_seed");
     }
 
     status.throwIfCancelled();
 
-    BinaryImage shadows_seed(hor_shadows_seed.release());
-    rasterOp<RopOr<RopSrc, RopDst> >(shadows_seed, ver_shadows_seed);
-    ver_shadows_seed.release();
+    shadows_seed_runs.unite(ver_shadows_seed_runs);
+    BinaryImage const shadows_seed(shadows_seed_runs.toBinaryImage());
     if (dbg) {
+        seeds_timer.print("ContentBoxFinder: shadow seeds:");
         dbg->add(shadows_seed, "shadows_seed");
     }
 
@@ -189,9 +185,11 @@ ContentBoxFinder::findContentBox(
 
     status.throwIfCancelled();
 
+    PerformanceTimer seed_fill_timer;
     BinaryImage shadows_dilated(seedFill(shadows_seed, dilated, CONN8));
     dilated.release();
     if (dbg) {
+        seed_fill_timer.print("ContentBoxFinder: shadows seed fill:");
         dbg->add(shadows_dilated, "shadows_dilated");
     }
 
@@ -220,13 +218,10 @@ ContentBoxFinder::findContentBox(
 
     status.throwIfCancelled();
 
-    CommandLine const& cli = CommandLine::get();
-    Despeckle::Level despeckleLevel = Despeckle::NORMAL;
-    if (cli.hasContentRect()) {
-        despeckleLevel = cli.getContentDetection();
-    }
-
-    BinaryImage despeckled(Despeckle::despeckle(content, Dpi(150, 150), despeckleLevel, status, dbg));
+    ProcessingContext const& context = data.context();
+    BinaryImage despeckled(
+        Despeckle::despeckle(content, Dpi(150, 150), context.contentDespeckleLevel(), status, dbg)
+    );
     if (dbg) {
         dbg->add(despeckled, "despeckled");
     }
@@ -318,7 +313,7 @@ ContentBoxFinder::findContentBox(
     }
 
     BinaryImage text_mask(content_blocks);
-    if (cli.hasContentText()) {
+    if (context.contentTextMask()) {
         text_mask = estimateTextMask(content, content_blocks, dbg);
     }
 
@@ -347,18 +342,18 @@ ContentBoxFinder::findContentBox(
 
     QRect content_rect(content_blocks.contentBoundingBox());
 
-    // Temporarily reuse hor_shadows_seed and ver_shadows_seed.
-    // It's OK they are null.
-    segmentGarbage(garbage, hor_shadows_seed, ver_shadows_seed, dbg);
+    BinaryImage initial_hor_garbage;
+    BinaryImage initial_vert_garbage;
+    segmentGarbage(garbage, initial_hor_garbage, initial_vert_garbage, dbg);
     garbage.release();
 
     if (dbg) {
-        dbg->add(hor_shadows_seed, "initial_hor_garbage");
-        dbg->add(ver_shadows_seed, "initial_vert_garbage");
+        dbg->add(initial_hor_garbage, "initial_hor_garbage");
+        dbg->add(initial_vert_garbage, "initial_vert_garbage");
     }
 
-    Garbage hor_garbage(Garbage::HOR, hor_shadows_seed.release());
-    Garbage vert_garbage(Garbage::VERT, ver_shadows_seed.release());
+    Garbage hor_garbage(Garbage::HOR, initial_hor_garbage.release());
+    Garbage vert_garbage(Garbage::VERT, initial_vert_garbage.release());
 
     enum Side { LEFT = 1, RIGHT = 2, TOP = 4, BOTTOM = 8 };
     int side_mask = LEFT | RIGHT | TOP | BOTTOM;
@@ -668,7 +663,10 @@ ContentBoxFinder::segmentGarbage(
     imageproc::BinaryImage& vert_garbage,
     DebugImages* dbg)
 {
-    hor_garbage = openBrick(garbage, QSize(200, 1), WHITE);
+    PerformanceTimer timer;
+    RunLengthImage const garbage_runs(garbage);
+
+    hor_garbage = garbage_runs.opened(QSize(200, 1), WHITE).toBinaryImage();
 
     QRect rect(garbage.rect());
     rect.setHeight(1);
@@ -680,7 +678,10 @@ ContentBoxFinder::segmentGarbage(
         hor_garbage, rect, garbage, rect.topLeft()
     );
 
-    vert_garbage = openBrick(garbage, QSize(1, 200), WHITE);
+    vert_garbage = garbage_runs.opened(QSize(1, 200), WHITE).toBinaryImage();
+    if (dbg) {
+        timer.print("ContentBoxFinder: garbage segmentation:");
+    }
 
     rect = garbage.rect();
     rect.setWidth(1);
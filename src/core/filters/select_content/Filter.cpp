@@ -120,7 +120,39 @@ Filter::saveSettings(
     ProjectWriter const& writer, QDomDocument& doc) const
 {
 
-    QDomElement filter_el(doc.createElement("select-content"));
+    QDomElement filter_el(createFilterElement(doc));
+
+    writer.enumPages([this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
+       writePageSettings(doc, filter_el, page_id, numeric_id);
+    });
+
+    return filter_el;
+}
+
+QDomElement
+Filter::savePageSettings(
+    ProjectWriter const& writer, QDomDocument& doc,
+    std::set<PageId> const& pages) const
+{
+    QDomElement filter_el(createFilterElement(doc));
+
+    writer.enumPages(pages, [this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
+        writePageSettings(doc, filter_el, page_id, numeric_id);
+    });
+
+    return filter_el;
+}
+
+bool
+Filter::takeChangedPages(std::set<PageId>& pages)
+{
+    return m_ptrSettings->takeChangedPages(pages);
+}
+
+QDomElement
+Filter::createFilterElement(QDomDocument& doc) const
+{
+    QDomElement filter_el(doc.createElement(settingsElementName()));
 
     filter_el.setAttribute("average", m_ptrSettings->avg());
     filter_el.setAttribute("sigma", m_ptrSettings->std());
@@ -129,10 +161,6 @@ Filter::saveSettings(
     filter_el.setAttribute("pageDetectionBoxHeight", m_ptrSettings->pageDetectionBox().height());
     filter_el.setAttribute("pageDetectionTolerance", m_ptrSettings->pageDetectionTolerance());
 
-    writer.enumPages([this, &doc, &filter_el](PageId const& page_id, int numeric_id) {
-       writePageSettings(doc, filter_el, page_id, numeric_id);
-    });
-
     return filter_el;
 }
 
@@ -153,17 +181,20 @@ Filter::writePageSettings(
     filter_el.appendChild(page_el);
 }
 
+QString
+Filter::settingsElementName() const
+{
+    return "select-content";
+}
+
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadFilterSettings(
+    ProjectReader const& reader, QDomElement const& filter_el)
 {
     m_ptrSettings->clear();
 
     CommandLine cli = CommandLine::get();
 
-    QDomElement const filter_el(
-        filters_el.namedItem("select-content").toElement()
-    );
-
     m_ptrSettings->setAvg(filter_el.attribute("average").toDouble());
     m_ptrSettings->setStd(filter_el.attribute("sigma").toDouble());
 
@@ -179,37 +210,33 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
     m_ptrSettings->setPageDetectionBox(box);
 
     m_ptrSettings->setPageDetectionTolerance(filter_el.attribute("pageDetectionTolerance", "0.1").toDouble());
+}
+
+void
+Filter::loadPageSettings(ProjectReader const& reader, QDomElement const& el)
+{
+    if (el.tagName() != "page") {
+        return;
+    }
 
-    QString const page_tag_name("page");
-    QDomNode node(filter_el.firstChild());
-    for (; !node.isNull(); node = node.nextSibling()) {
-        if (!node.isElement()) {
-            continue;
-        }
-        if (node.nodeName() != page_tag_name) {
-            continue;
-        }
-        QDomElement const el(node.toElement());
-
-        bool ok = true;
-        int const id = el.attribute("id").toInt(&ok);
-        if (!ok) {
-            continue;
-        }
-
-        PageId const page_id(reader.pageId(id));
-        if (page_id.isNull()) {
-            continue;
-        }
-
-        QDomElement const params_el(el.namedItem("params").toElement());
-        if (params_el.isNull()) {
-            continue;
-        }
-
-        Params const params(params_el);
-        m_ptrSettings->setPageParams(page_id, params);
+    bool ok = true;
+    int const id = el.attribute("id").toInt(&ok);
+    if (!ok) {
+        return;
     }
+
+    PageId const page_id(reader.pageId(id));
+    if (page_id.isNull()) {
+        return;
+    }
+
+    QDomElement const params_el(el.namedItem("params").toElement());
+    if (params_el.isNull()) {
+        return;
+    }
+
+    Params const params(params_el);
+    m_ptrSettings->setPageParams(page_id, params);
 }
 
 IntrusivePtr<Task>
@@ -79,8 +79,19 @@ public:
     virtual QDomElement saveSettings(
         ProjectWriter const& writer, QDomDocument& doc) const;
 
-    virtual void loadSettings(
-        ProjectReader const& reader, QDomElement const& filters_el);
+    virtual QDomElement savePageSettings(
+        ProjectWriter const& writer, QDomDocument& doc,
+        std::set<PageId> const& pages) const;
+
+    virtual bool takeChangedPages(std::set<PageId>& pages);
+
+    virtual QString settingsElementName() const;
+
+    virtual void loadFilterSettings(
+        ProjectReader const& reader, QDomElement const& filter_el);
+
+    virtual void loadPageSettings(
+        ProjectReader const& reader, QDomElement const& el);
 
     IntrusivePtr<Task> createTask(
         PageId const& page_id,
@@ -100,6 +111,8 @@ public:
     }
     void invalidateSetting(PageId const& page_id);
 private:
+    QDomElement createFilterElement(QDomDocument& doc) const;
+
     void writePageSettings(
         QDomDocument& doc, QDomElement& filter_el,
         PageId const& page_id, int numeric_id) const;
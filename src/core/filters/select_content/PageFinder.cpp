@@ -26,19 +26,22 @@
 #include "ImageTransformation.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/Binarize.h"
-#include "imageproc/Transform.h"
 #include "imageproc/GrayRasterOp.h"
 #include "imageproc/Grayscale.h"
 #include "TaskStatus.h"
 
 #include <Qt>
-#include <QColor>
+#include <QAtomicInt>
 #include <QDebug>
 #include <QtGlobal>
 #include <QImage>
 #include <QRect>
 #include <QRectF>
 #include <QTransform>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <assert.h>
 
 namespace select_content
 {
@@ -66,87 +69,99 @@ PageFinder::findPageBox(
     std::cout << "exp_width = " << exp_width << "; exp_height" << exp_height << std::endl;
 #endif
 
-    uint8_t const darkest_gray_level = darkestGrayLevel(data.grayImage());
-    QColor const outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
-
-    QImage gray150(
-        transformToGray(
-            data.grayImage(), xform_150dpi.transform(),
-            xform_150dpi.resultingRect().toRect(),
-            OutsidePixels::assumeColor(outside_color)
-        )
-    );
-    // Note that we fill new areas that appear as a result of
-    // rotation with black, not white.  Filling them with white
+    // Note that new areas that appear as a result of rotation
+    // are filled with black, not white.  Filling them with white
     // may be bad for detecting the shadow around the page.
+    QImage const gray150(data.transformedGrayImage(Dpi(150, 150)));
     if (dbg) {
         dbg->add(gray150, "gray150");
     }
 
-    std::vector<QRect> rects;
-    std::vector<BinaryImage> bwimages;
-
-    // get binary images from gray150 using different algorithm
-    bwimages.push_back(peakThreshold(gray150));
-    bwimages.push_back(binarizeOtsu(gray150));
-    bwimages.push_back(binarizeMokji(gray150));
-    bwimages.push_back(binarizeSauvola(gray150, gray150.size()));
-    bwimages.push_back(binarizeWolf(gray150, gray150.size()));
-    if (dbg) {
-        dbg->add(bwimages[0], "peakThreshold");
-        dbg->add(bwimages[1], "OtsuThreshold");
-        dbg->add(bwimages[2], "MokjiThreshold");
-        dbg->add(bwimages[3], "SauvolaThreshold");
-        dbg->add(bwimages[4], "WolfThreshold");
-    }
+    // Gray level statistics shared by all the binarization methods.
+    BinarizationStats const stats(gray150);
 
     QRect content_rect(0, 0, 0, 0);
-    double err_width = 1.0;
-    double err_height = 1.0;
 
     if (box.isEmpty()) {
-        // detect content box with otsu
-        QImage bwimg(bwimages[3].toQImage());
+        // detect content box with sauvola
+        BinaryImage const bwimage(binarizeSauvola(stats, gray150.size()));
+        if (dbg) {
+            dbg->add(bwimage, "SauvolaThreshold");
+        }
+        QImage bwimg(bwimage.toQImage());
         content_rect = detectBorders(bwimg);
         if (fine_tune) {
             fineTuneCorners(bwimg, content_rect, QSize(0, 0), 1.0);
         }
     } else {
         // detect content box using different binarized images
-        for (size_t i = 0; i < bwimages.size(); ++i) {
-            // detect content box
-            QImage bwimg(bwimages[i].toQImage());
-            rects.push_back(QRect(detectBorders(bwimg)));
+        std::vector<Candidate> candidates(NUM_METHODS);
+
+        // A box this close to the expected size is not going
+        // to be improved upon by the remaining methods.
+        // Only the methods following the first confident one are
+        // skipped, and those are ignored below even if they did run,
+        // so that the result doesn't depend on thread timing.
+        double const confident_error = 0.005;
+        QAtomicInt first_confident(NUM_METHODS);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < NUM_METHODS; ++i) {
+            if (first_confident.load() < i) {
+                continue;
+            }
+
+            BinaryImage const bwimage(binarize(stats, Method(i)));
+            Candidate& candidate = candidates[i];
+            if (dbg) {
+                candidate.bwimage = bwimage;
+            }
+
+            QImage bwimg(bwimage.toQImage());
+            candidate.rect = detectBorders(bwimg);
             if (fine_tune) {
-                fineTuneCorners(bwimg, rects[i], QSize(exp_width, exp_height), tolerance);
+                fineTuneCorners(bwimg, candidate.rect, QSize(exp_width, exp_height), tolerance);
             }
-#ifdef DEBUG
-            std::cout << "width = " << rects[i].width() << "; height=" << rects[i].height() << std::endl;
-#endif
 
-            double err_w = double(abs(exp_width - rects[i].width())) / double(exp_width);
-            double err_h = double(abs(exp_height - rects[i].height())) / double(exp_height);
+            candidate.errWidth = double(abs(exp_width - candidate.rect.width())) / double(exp_width);
+            candidate.errHeight = double(abs(exp_height - candidate.rect.height())) / double(exp_height);
+            candidate.valid = true;
+
+            if (candidate.errWidth <= confident_error && candidate.errHeight <= confident_error) {
+                int prev = first_confident.load();
+                while (i < prev && !first_confident.testAndSetOrdered(prev, i)) {
+                    prev = first_confident.load();
+                }
+            }
+        }
+
+        status.throwIfCancelled();
+
+        double err_width = 1.0;
+        double err_height = 1.0;
+
+        int const num_used = std::min<int>(first_confident.load() + 1, NUM_METHODS);
+        for (int i = 0; i < num_used; ++i) {
+            Candidate const& candidate = candidates[i];
+            assert(candidate.valid);
+
+            if (dbg) {
+                dbg->add(candidate.bwimage, methodName(Method(i)));
+            }
 #ifdef DEBUG
-            std::cout << "err_w=" << err_w << "; err_h" << err_h << std::endl;
+            std::cout << "width = " << candidate.rect.width() << "; height=" << candidate.rect.height() << std::endl;
+            std::cout << "err_w=" << candidate.errWidth << "; err_h" << candidate.errHeight << std::endl;
 #endif
-            /*
-            // if detected box has lower error, change it
-            if ((err_width > tolerance || err_height > tolerance) && err_w <= err_width && err_h <= err_height) {
-                std::cout << "using: " << i << std::endl;
-                content_rect = rects[i];
-                err_width = err_w;
-                err_height = err_h;
-            }
-            */
-            if (err_w < err_width) {
-                content_rect.setLeft(rects[i].left());
-                content_rect.setRight(rects[i].right());
-                err_width = err_w;
+
+            if (candidate.errWidth < err_width) {
+                content_rect.setLeft(candidate.rect.left());
+                content_rect.setRight(candidate.rect.right());
+                err_width = candidate.errWidth;
             }
-            if (err_h < err_height) {
-                content_rect.setTop(rects[i].top());
-                content_rect.setBottom(rects[i].bottom());
-                err_height = err_h;
+            if (candidate.errHeight < err_height) {
+                content_rect.setTop(candidate.rect.top());
+                content_rect.setBottom(candidate.rect.bottom());
+                err_height = candidate.errHeight;
             }
         }
     }
@@ -168,6 +183,49 @@ PageFinder::findPageBox(
     return result;
 }
 
+BinaryImage
+PageFinder::binarize(BinarizationStats const& stats, Method method)
+{
+    switch (method) {
+    case PEAK:
+        return peakThreshold(stats);
+    case OTSU:
+        return binarizeOtsu(stats);
+    case MOKJI:
+        return binarizeMokji(stats.gray());
+    case SAUVOLA:
+        return binarizeSauvola(stats, stats.gray().size());
+    case WOLF:
+        return binarizeWolf(stats, stats.gray().size());
+    case NUM_METHODS:
+        break;
+    }
+
+    assert(!"Unreachable");
+    return BinaryImage();
+}
+
+char const*
+PageFinder::methodName(Method method)
+{
+    switch (method) {
+    case PEAK:
+        return "peakThreshold";
+    case OTSU:
+        return "OtsuThreshold";
+    case MOKJI:
+        return "MokjiThreshold";
+    case SAUVOLA:
+        return "SauvolaThreshold";
+    case WOLF:
+        return "WolfThreshold";
+    case NUM_METHODS:
+        break;
+    }
+
+    return "";
+}
+
 QRect
 PageFinder::detectBorders(QImage const& img)
 {
@@ -21,9 +21,11 @@
 #define SELECT_CONTENT_PAGEFINDER_H_
 
 #include "imageproc/BinaryThreshold.h"
+#include "imageproc/BinaryImage.h"
 #include "Margins.h"
 
 #include <Qt>
+#include <QRect>
 
 class TaskStatus;
 class DebugImages;
@@ -36,7 +38,7 @@ class QSize;
 
 namespace imageproc
 {
-class BinaryImage;
+class BinarizationStats;
 }
 
 namespace select_content
@@ -48,6 +50,27 @@ public:
     static QRectF findPageBox(
         TaskStatus const& status, FilterData const& data, bool fine_tune, QSizeF const& box, double tolerance, Margins borders, DebugImages* dbg = 0);
 private:
+    /**
+     * Binarization methods tried when looking for a page of known size.
+     * Each one is followed by border detection, with the resulting box
+     * edges taken from the method that got closest to the expected size.
+     */
+    enum Method { PEAK, OTSU, MOKJI, SAUVOLA, WOLF, NUM_METHODS };
+
+    struct Candidate
+    {
+        imageproc::BinaryImage bwimage; // Only kept for debugging.
+        QRect rect;
+        double errWidth;
+        double errHeight;
+        bool valid;
+
+        Candidate() : errWidth(1.0), errHeight(1.0), valid(false) {}
+    };
+
+    static imageproc::BinaryImage binarize(
+        imageproc::BinarizationStats const& stats, Method method);
+    static char const* methodName(Method method);
     static QRect detectBorders(QImage const& img);
     static int detectEdge(QImage const& img, int start, int end, int inc, int mid, Qt::Orientation orient);
     static void fineTuneCorners(QImage const& img, QRect& rect, QSize const& size, double tolerance);
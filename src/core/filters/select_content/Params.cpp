@@ -111,10 +111,19 @@ Params::Params(QDomElement const& filter_el)
                 filter_el.namedItem("original_dpi").toElement()
             )
         )
+{
+}
+
+Params::~Params()
+{
+}
+
+void
+Params::forceDisablePageDetection()
 {
     // ! m_contentDetect means content detection is disabled and should be the same as pageRect
     // turn off pagedetection if page detection was enabled and set content detection to manual
-    if (m_pageDetect && !m_contentDetect && CommandLine::get().isForcePageDetectionDisabled()) {
+    if (m_pageDetect && !m_contentDetect) {
         m_pageDetect = false;
         m_contentRect = m_pageRect;
         m_contentDetect = true;
@@ -122,10 +131,6 @@ Params::Params(QDomElement const& filter_el)
     }
 }
 
-Params::~Params()
-{
-}
-
 QDomElement
 Params::toXml(QDomDocument& doc, QString const& name) const
 {
@@ -54,6 +54,12 @@ public:
 
     ~Params();
 
+    /**
+     * \brief Replaces page detection without content detection
+     *        with a manual content box equal to the page box.
+     */
+    void forceDisablePageDetection();
+
     QRectF const& contentRect() const
     {
         return m_contentRect;
@@ -20,7 +20,8 @@
 #include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include "settings/ini_keys.h"
 #include <cmath>
 #include <iostream>
@@ -45,14 +46,15 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_pageParams.clear();
+    m_changedPages.addAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     PageParams new_params;
 
     for (PageParams::value_type const& kv : m_pageParams) {
@@ -63,10 +65,14 @@ Settings::performRelinking(AbstractRelinker const& relinker)
     }
 
     m_pageParams.swap(new_params);
+    m_changedPages.addAll();
 }
 
 void Settings::updateDeviation()
 {
+    QWriteLocker const locker(&m_lock);
+
+    double const old_avg = m_avg;
     m_avg = 0.0;
     for (PageParams::value_type& kv : m_pageParams) {
         kv.second.computeDeviation(0.0);
@@ -88,26 +94,33 @@ void Settings::updateDeviation()
     std::cout << "sigma2 = " << sigma2 << std::endl;
     std::cout << "sigma = " << m_sigma << std::endl;
 #endif
+
+    if (m_avg != old_avg) {
+        // The deviation of every page is relative to the average.
+        m_changedPages.addAll();
+    }
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker locker(&m_mutex);
-    Utils::mapSetValue(m_pageParams, page_id, params);
+    QWriteLocker const locker(&m_lock);
+    Utils::hashMapSetValue(m_pageParams, page_id, params);
+    m_changedPages.add(page_id);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker const locker(&m_lock);
     m_pageParams.erase(page_id);
+    m_changedPages.add(page_id);
 }
 
 std::unique_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker const locker(&m_lock);
 
     PageParams::const_iterator const it(m_pageParams.find(page_id));
     if (it != m_pageParams.end()) {
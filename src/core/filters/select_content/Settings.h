@@ -23,9 +23,11 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
-#include <QMutex>
+#include "ChangedPages.h"
+#include <QReadWriteLock>
 #include <memory>
-#include <map>
+#include <unordered_map>
+#include <set>
 
 class AbstractRelinker;
 
@@ -52,6 +54,11 @@ public:
 
     std::unique_ptr<Params> getPageParams(PageId const& page_id) const;
 
+    bool takeChangedPages(std::set<PageId>& pages)
+    {
+        return m_changedPages.take(pages);
+    }
+
     double maxDeviation() const
     {
         return m_maxDeviation;
@@ -97,15 +104,16 @@ public:
         m_sigma = s;
     }
 private:
-    typedef std::map<PageId, Params> PageParams;
+    typedef std::unordered_map<PageId, Params> PageParams;
 
-    mutable QMutex m_mutex;
+    mutable QReadWriteLock m_lock;
     PageParams m_pageParams;
     double m_avg;
     double m_sigma;
     double m_maxDeviation;
     QSizeF m_pageDetectionBox;
     double m_pageDetectionTolerance;
+    ChangedPages m_changedPages;
 };
 
 } // namespace select_content
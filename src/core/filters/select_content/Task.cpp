@@ -100,6 +100,9 @@ Task::process(TaskStatus const& status, FilterData const& data)
     ui_data.setSizeCalc(PhysSizeCalc(data.xform()));
 
     std::unique_ptr<Params> params(m_ptrSettings->getPageParams(m_pageId));
+    if (params.get() && data.context().forcePageDetectionDisabled()) {
+        params->forceDisablePageDetection();
+    }
 
     bool need_reprocess(!params.get());
     bool regeneration_enforced = false;
@@ -198,6 +198,8 @@ static const char* _key_output_default_dpi_x = "output/default_dpi_x";
 static const int _key_output_default_dpi_x_def = 600;
 static const char* _key_output_default_dpi_y = "output/default_dpi_y";
 static const int _key_output_default_dpi_y_def = 600;
+static const char* _key_output_out_of_core_threshold = "output/out_of_core_threshold_mpix";
+static const int _key_output_out_of_core_threshold_def = 0;
 static const char* _key_output_bin_threshold_min = "output/binrization_threshold_control_min";
 static const int _key_output_bin_threshold_min_def = -50;
 static const char* _key_output_bin_threshold_max = "output/binrization_threshold_control_max";
@@ -227,6 +229,8 @@ static const char* _key_autosave_enabled = "auto-save_project/enabled";
 static const bool _key_autosave_enabled_def = false;
 static const char* _key_autosave_time_period_min = "auto-save_project/time_period_min";
 static const int _key_autosave_time_period_min_def = 5;
+static const char* _key_autosave_journal = "auto-save_project/journal";
+static const bool _key_autosave_journal_def = true;
 static const char* _key_debug_enabled = "debug_mode/enabled";
 static const bool _key_debug_enabled_def = false;
 static const char* _key_dpi_predefined_list = "dpi/predefined_list";
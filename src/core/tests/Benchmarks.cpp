@@ -0,0 +1,281 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * \file
+ * Times I/O paths against the way they used to work, on generated inputs.
+ * This isn't a test and isn't run by ctest.  Run core_benchmarks by hand,
+ * optionally with the names of the benchmarks to run as arguments.
+ */
+
+#include "TiffWriter.h"
+#include "TiffReader.h"
+#include "ProjectReader.h"
+#include "ProcessingContext.h"
+#include "PerformanceTimer.h"
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QByteArray>
+#include <QDomDocument>
+#include <QXmlStreamWriter>
+#include <QStringList>
+#include <QString>
+#include <QImage>
+#include <QDebug>
+#include <stdlib.h>
+
+namespace
+{
+
+/**
+ * A bitonal page with some random specks, so that
+ * compression has something to do.
+ */
+QImage makePage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_Mono);
+    image.setColor(0, 0xffffffff);
+    image.setColor(1, 0xff000000);
+    image.fill(0);
+    for (int i = 0; i < width * height / 50; ++i) {
+        image.setPixel(rand() % width, rand() % height, 1);
+    }
+    return image;
+}
+
+/**
+ * Writes a 1,000 page TIFF by reopening it for every page,
+ * as exports used to, and through MultipageTiffWriter.
+ */
+void benchmarkMultipageWrite(QTemporaryDir const& dir)
+{
+    int const num_pages = 1000;
+    QImage const page(makePage(800, 1000));
+    ProcessingContextPtr const context(new ProcessingContext(ProcessingContext::Options()));
+
+    QString const reopening_path(dir.filePath("reopening.tif"));
+    PerformanceTimer reopening_timer;
+    for (int i = 0; i < num_pages; ++i) {
+        TiffWriter::writeImage(*context, reopening_path, page, true, i);
+    }
+    reopening_timer.print("multipage write, reopening per page:");
+
+    QString const session_path(dir.filePath("session.tif"));
+    PerformanceTimer session_timer;
+    MultipageTiffWriter writer(context, session_path);
+    for (int i = 0; i < num_pages; ++i) {
+        writer.writePage(page);
+    }
+    writer.finish();
+    session_timer.print("multipage write, one session:");
+}
+
+/**
+ * A color page with smooth gradients and some noise.
+ */
+QImage makeColorPage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            int const noise = rand() % 8;
+            line[x] = qRgb((x / 8 + noise) & 0xff, (y / 8 + noise) & 0xff, ((x + y) / 16) & 0xff);
+        }
+    }
+    return image;
+}
+
+/**
+ * Reads a TIFF file repeatedly through buffered reads, as input
+ * images used to be read, and through a memory mapping.
+ */
+void timeTiffReads(QString const& file_path, char const* name)
+{
+    int const num_reads = 20;
+
+    PerformanceTimer read_timer;
+    for (int i = 0; i < num_reads; ++i) {
+        QFile file(file_path);
+        file.open(QIODevice::ReadOnly);
+        TiffReader::readImage(file, 0, false);
+    }
+    read_timer.print(QString("%1 TIFF read, buffered:").arg(name).toLocal8Bit().constData());
+
+    PerformanceTimer map_timer;
+    for (int i = 0; i < num_reads; ++i) {
+        QFile file(file_path);
+        file.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        TiffReader::readImage(file, 0, true);
+    }
+    map_timer.print(QString("%1 TIFF read, mapped:").arg(name).toLocal8Bit().constData());
+}
+
+void benchmarkTiffRead(QTemporaryDir const& dir)
+{
+    QImage const page(makeColorPage(2500, 3500));
+
+    ProcessingContext::Options options;
+    options.tiffCompressionColor = "NONE";
+    ProcessingContextPtr const uncompressed_context(new ProcessingContext(options));
+    TiffWriter::writeImage(*uncompressed_context, dir.filePath("none.tif"), page);
+
+    options.tiffCompressionColor = "LZW";
+    ProcessingContextPtr const lzw_context(new ProcessingContext(options));
+    TiffWriter::writeImage(*lzw_context, dir.filePath("lzw.tif"), page);
+
+    timeTiffReads(dir.filePath("none.tif"), "uncompressed");
+    timeTiffReads(dir.filePath("lzw.tif"), "LZW");
+}
+
+/**
+ * A project with \p num_pages single page images, each with
+ * settings for one filter, laid out the way ProjectWriter does it.
+ */
+QByteArray makeProject(int num_pages)
+{
+    QByteArray data;
+    QXmlStreamWriter writer(&data);
+    writer.writeStartDocument();
+    writer.writeStartElement("project");
+    writer.writeAttribute("outputDirectory", "/tmp/out");
+
+    writer.writeStartElement("directories");
+    writer.writeStartElement("directory");
+    writer.writeAttribute("id", "1");
+    writer.writeAttribute("path", "/tmp/in");
+    writer.writeEndElement();
+    writer.writeEndElement();
+
+    int const first_file_id = 2;
+    writer.writeStartElement("files");
+    for (int i = 0; i < num_pages; ++i) {
+        writer.writeStartElement("file");
+        writer.writeAttribute("id", QString::number(first_file_id + i));
+        writer.writeAttribute("dirId", "1");
+        writer.writeAttribute("name", QString("%1.tif").arg(i, 5, 10, QChar('0')));
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+
+    int const first_image_id = first_file_id + num_pages;
+    writer.writeStartElement("images");
+    for (int i = 0; i < num_pages; ++i) {
+        writer.writeStartElement("image");
+        writer.writeAttribute("id", QString::number(first_image_id + i));
+        writer.writeAttribute("subPages", "1");
+        writer.writeAttribute("fileId", QString::number(first_file_id + i));
+        writer.writeAttribute("fileImage", "0");
+        writer.writeStartElement("size");
+        writer.writeAttribute("width", "2480");
+        writer.writeAttribute("height", "3508");
+        writer.writeEndElement();
+        writer.writeStartElement("dpi");
+        writer.writeAttribute("horizontal", "300");
+        writer.writeAttribute("vertical", "300");
+        writer.writeEndElement();
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+
+    int const first_page_id = first_image_id + num_pages;
+    writer.writeStartElement("pages");
+    for (int i = 0; i < num_pages; ++i) {
+        writer.writeStartElement("page");
+        writer.writeAttribute("id", QString::number(first_page_id + i));
+        writer.writeAttribute("imageId", QString::number(first_image_id + i));
+        writer.writeAttribute("subPage", "single");
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+
+    writer.writeStartElement("filters");
+    writer.writeStartElement("deskew");
+    for (int i = 0; i < num_pages; ++i) {
+        writer.writeStartElement("page");
+        writer.writeAttribute("id", QString::number(first_page_id + i));
+        writer.writeStartElement("params");
+        writer.writeAttribute("angle", "0.25");
+        writer.writeAttribute("mode", "auto");
+        writer.writeEndElement();
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+    writer.writeEndElement();
+
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return data;
+}
+
+/**
+ * Loads a 10,000 page project.  Projects used to be parsed into a DOM
+ * before ProjectReader looked at them.  Only that parsing is timed for
+ * the old way, so its timing is a lower bound.
+ */
+void benchmarkProjectLoad()
+{
+    QByteArray const data(makeProject(10000));
+
+    PerformanceTimer dom_timer;
+    {
+        QDomDocument doc;
+        doc.setContent(data);
+    }
+    dom_timer.print("project load, whole-file DOM only:");
+
+    PerformanceTimer stream_timer;
+    {
+        ProjectReader const reader(data);
+        if (!reader.success()) {
+            qDebug() << "The generated project failed to load";
+        }
+    }
+    stream_timer.print("project load, ProjectReader:");
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QStringList const selected(app.arguments().mid(1));
+    bool const run_all = selected.isEmpty();
+
+    QTemporaryDir const dir;
+    if (!dir.isValid()) {
+        qDebug() << "Unable to create a temporary directory";
+        return 1;
+    }
+
+    srand(1);
+
+    if (run_all || selected.contains("multipage_write")) {
+        benchmarkMultipageWrite(dir);
+    }
+    if (run_all || selected.contains("tiff_read")) {
+        benchmarkTiffRead(dir);
+    }
+    if (run_all || selected.contains("project_load")) {
+        benchmarkProjectLoad();
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageId.h"
+#include "PageId.h"
+#include "AbstractRelinker.h"
+#include "RelinkablePath.h"
+#include "OrthogonalRotation.h"
+#include "filters/fix_orientation/Settings.h"
+#include <QString>
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#endif
+#include <unordered_map>
+
+namespace Tests
+{
+
+BOOST_AUTO_TEST_SUITE(PageIdTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_equal_paths_equal_keys)
+{
+    ImageId const id1("/tmp/a.tif");
+    // A string built separately, so that it doesn't share data with the first one.
+    ImageId const id2(QString("/tmp/") + "a.tif");
+    ImageId const id3("/tmp/b.tif");
+
+    BOOST_CHECK_EQUAL(id1.filePathKey(), id2.filePathKey());
+    BOOST_CHECK(id1.filePathKey() != id3.filePathKey());
+    BOOST_CHECK(id1 == id2);
+    BOOST_CHECK(id1 != id3);
+    BOOST_CHECK(ImageId("/tmp/a.tif", 1) != ImageId("/tmp/a.tif", 2));
+}
+
+BOOST_AUTO_TEST_CASE(test_null_and_empty)
+{
+    BOOST_CHECK_EQUAL(ImageId().filePathKey(), 0);
+    BOOST_CHECK_EQUAL(ImageId(QString("")).filePathKey(), 0);
+    BOOST_CHECK(ImageId() == ImageId(QString("")));
+}
+
+BOOST_AUTO_TEST_CASE(test_set_file_path)
+{
+    ImageId id("/tmp/c.tif");
+    id.setFilePath("/tmp/d.tif");
+    BOOST_CHECK(id == ImageId("/tmp/d.tif"));
+    BOOST_CHECK(id != ImageId("/tmp/c.tif"));
+}
+
+BOOST_AUTO_TEST_CASE(test_ordering_follows_paths)
+{
+    // Intern the paths in the reverse order, so that keys
+    // and paths are ordered differently.
+    ImageId const z("/tmp/z.tif");
+    ImageId const y("/tmp/y.tif");
+
+    BOOST_CHECK(y < z);
+    BOOST_CHECK(!(z < y));
+    BOOST_CHECK(!(z < z));
+    BOOST_CHECK(ImageId("/tmp/z.tif", 1) < ImageId("/tmp/z.tif", 2));
+    BOOST_CHECK(PageId(z, PageId::LEFT_PAGE) < PageId(z, PageId::RIGHT_PAGE));
+    BOOST_CHECK(PageId(y, PageId::RIGHT_PAGE) < PageId(z, PageId::LEFT_PAGE));
+}
+
+BOOST_AUTO_TEST_CASE(test_hash_map)
+{
+    std::unordered_map<PageId, int> map;
+    for (int i = 0; i < 100; ++i) {
+        ImageId const image_id(QString("/tmp/%1.tif").arg(i));
+        map[PageId(image_id, PageId::LEFT_PAGE)] = 2 * i;
+        map[PageId(image_id, PageId::RIGHT_PAGE)] = 2 * i + 1;
+    }
+
+    BOOST_REQUIRE_EQUAL(map.size(), 200u);
+    for (int i = 0; i < 100; ++i) {
+        ImageId const image_id(QString("/tmp/%1.tif").arg(i));
+        BOOST_CHECK_EQUAL(map[PageId(image_id, PageId::LEFT_PAGE)], 2 * i);
+        BOOST_CHECK_EQUAL(map[PageId(image_id, PageId::RIGHT_PAGE)], 2 * i + 1);
+    }
+    BOOST_CHECK(map.find(PageId(ImageId("/tmp/100.tif"))) == map.end());
+}
+
+namespace
+{
+
+class PrefixRelinker : public AbstractRelinker
+{
+public:
+    PrefixRelinker(QString const& from, QString const& to) : m_from(from), m_to(to) {}
+
+    virtual QString substitutionPathFor(RelinkablePath const& orig_path) const
+    {
+        QString path(orig_path.normalizedPath());
+        if (path.startsWith(m_from)) {
+            path.replace(0, m_from.length(), m_to);
+        }
+        return path;
+    }
+private:
+    QString m_from;
+    QString m_to;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_lookup_after_relinking)
+{
+    OrthogonalRotation rotation;
+    rotation.nextClockwiseDirection();
+
+    fix_orientation::Settings settings;
+    settings.applyRotation(ImageId("/tmp/old/e.tif"), rotation);
+    settings.applyRotation(ImageId("/tmp/old/f.tif", 2), rotation);
+    settings.performRelinking(PrefixRelinker("/tmp/old/", "/tmp/new/"));
+
+    // Paths built separately from the ones the relinker produced.
+    QString const dir("/tmp/new/");
+    BOOST_CHECK(settings.getRotationFor(ImageId(dir + "e.tif")) == rotation);
+    BOOST_CHECK(settings.getRotationFor(ImageId(dir + "f.tif", 2)) == rotation);
+    BOOST_CHECK(settings.getRotationFor(ImageId(dir + "f.tif", 1)) == OrthogonalRotation());
+    BOOST_CHECK(settings.getRotationFor(ImageId("/tmp/old/e.tif")) == OrthogonalRotation());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,111 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DewarpPlan.h"
+#include <QTransform>
+#include <QPointF>
+#include <stdexcept>
+
+namespace dewarping
+{
+
+DewarpPlan::ColumnMapper::ColumnMapper(
+    CylindricalSurfaceDewarper::Generatrix const& generatrix)
+    :   m_homog(generatrix.pln2img.mat()),
+        m_origin(generatrix.imgLine.p1()),
+        m_vec(generatrix.imgLine.p2() - generatrix.imgLine.p1())
+{
+}
+
+DewarpPlan::ColumnMapper::ColumnMapper(
+    HomographicTransform<1, float> const& homog,
+    Vec2f const& origin, Vec2f const& vec)
+    :   m_homog(homog),
+        m_origin(origin),
+        m_vec(vec)
+{
+}
+
+DewarpPlan::DewarpPlan()
+{
+}
+
+DewarpPlan::DewarpPlan(
+    CylindricalSurfaceDewarper const& dewarper,
+    QRectF const& model_domain, QSize const& dst_size)
+    :   m_ptrDewarper(new CylindricalSurfaceDewarper(dewarper)),
+        m_modelDomain(model_domain),
+        m_dstSize(dst_size)
+{
+    if (model_domain.isEmpty()) {
+        throw std::invalid_argument("DewarpPlan: model_domain is empty.");
+    }
+
+    int const dst_width = dst_size.width();
+    int const dst_height = dst_size.height();
+
+    double const model_domain_left = model_domain.left();
+    double const model_x_scale = 1.0 / (model_domain.right() - model_domain.left());
+
+    float const model_domain_top = model_domain.top();
+    float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
+
+    // Generatrices are mapped serially, as the intersection and
+    // arc length hints in State make each one depend on the previous.
+    // That's cheap, as there is only one generatrix per grid column.
+    CylindricalSurfaceDewarper::State state;
+    m_columns.reserve(dst_width + 1);
+    for (int dst_x = 0; dst_x <= dst_width; ++dst_x) {
+        double const model_x = (dst_x - model_domain_left) * model_x_scale;
+        m_columns.push_back(ColumnMapper(dewarper.mapGeneratrix(model_x, state)));
+    }
+
+    m_modelYs.resize(dst_height + 1);
+    for (int dst_y = 0; dst_y <= dst_height; ++dst_y) {
+        m_modelYs[dst_y] = (float(dst_y) - model_domain_top) * model_y_scale;
+    }
+}
+
+DewarpPlan
+DewarpPlan::transformed(QTransform const& src_to_new_src) const
+{
+    if (!src_to_new_src.isAffine()) {
+        throw std::invalid_argument("DewarpPlan: transformation is not affine.");
+    }
+
+    DewarpPlan plan(*this);
+    if (src_to_new_src.isIdentity()) {
+        return plan;
+    }
+
+    // An affine transformation maps origin + vec * t
+    // to map(origin) + linear_part(vec) * t.
+    for (ColumnMapper& column : plan.m_columns) {
+        QPointF const origin(column.origin());
+        QPointF const vec(column.vec());
+        QPointF const new_vec(
+            src_to_new_src.m11() * vec.x() + src_to_new_src.m21() * vec.y(),
+            src_to_new_src.m12() * vec.x() + src_to_new_src.m22() * vec.y()
+        );
+        column = ColumnMapper(column.homog(), src_to_new_src.map(origin), new_vec);
+    }
+
+    return plan;
+}
+
+} // namespace dewarping
@@ -0,0 +1,174 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEWARPING_DEWARP_PLAN_H_
+#define DEWARPING_DEWARP_PLAN_H_
+
+#include "CylindricalSurfaceDewarper.h"
+#include "HomographicTransform.h"
+#include "VecNT.h"
+#ifndef Q_MOC_RUN
+#include <boost/shared_ptr.hpp>
+#endif
+#include <QRectF>
+#include <QSize>
+#include <vector>
+#include <assert.h>
+
+class QTransform;
+
+namespace dewarping
+{
+
+/**
+ * \brief The destination to source sampling grid of a dewarping operation.
+ *
+ * A plan is built once per page and distortion model, and then applied
+ * by RasterDewarper to any number of images, saving the generatrix
+ * mapping being redone for each of them.  Grid node (x, y) corresponds
+ * to the top-left corner of destination pixel (x, y), so there are
+ * (width + 1) x (height + 1) nodes.
+ *
+ * Rather than storing every node, the plan stores one mapping per grid
+ * column, from which nodes are evaluated on demand.  That's cheap
+ * and keeps the plan small even for huge pages.
+ */
+class DewarpPlan
+{
+public:
+    /**
+     * \brief Maps the destination Y coordinate to a source image point
+     *        along a single generatrix.
+     */
+    class ColumnMapper
+    {
+    public:
+        explicit ColumnMapper(CylindricalSurfaceDewarper::Generatrix const& generatrix);
+
+        ColumnMapper(HomographicTransform<1, float> const& homog,
+                     Vec2f const& origin, Vec2f const& vec);
+
+        Vec2f operator()(float model_y) const
+        {
+            return m_origin + m_vec * m_homog(model_y);
+        }
+
+        HomographicTransform<1, float> const& homog() const
+        {
+            return m_homog;
+        }
+
+        Vec2f const& origin() const
+        {
+            return m_origin;
+        }
+
+        Vec2f const& vec() const
+        {
+            return m_vec;
+        }
+    private:
+        HomographicTransform<1, float> m_homog;
+        Vec2f m_origin;
+        Vec2f m_vec;
+    };
+
+    /**
+     * \brief Constructs a null plan.
+     */
+    DewarpPlan();
+
+    /**
+     * \param dewarper The distortion model, in source image coordinates.
+     * \param model_domain A rectangle in destination image coordinates
+     *        that will be mapped to the curved quadrilateral of the model.
+     * \param dst_size The size of the destination image.
+     * \throw std::invalid_argument if \p model_domain is empty.
+     */
+    DewarpPlan(CylindricalSurfaceDewarper const& dewarper,
+               QRectF const& model_domain, QSize const& dst_size);
+
+    bool isNull() const
+    {
+        return m_columns.empty();
+    }
+
+    /**
+     * \brief Returns a plan for a different source coordinate system.
+     *
+     * \param src_to_new_src An affine transformation from the source image
+     *        coordinates of this plan to those of the returned plan.
+     *        Straight lines stay straight under such transformations,
+     *        so the generatrices don't have to be mapped again.
+     * \throw std::invalid_argument if \p src_to_new_src is not affine.
+     */
+    DewarpPlan transformed(QTransform const& src_to_new_src) const;
+
+    /**
+     * \brief The distortion model this plan was built from.
+     *
+     * Note that it's in the source coordinates of the original plan,
+     * even for plans created by transformed().
+     */
+    CylindricalSurfaceDewarper const& dewarper() const
+    {
+        assert(m_ptrDewarper);
+        return *m_ptrDewarper;
+    }
+
+    QRectF const& modelDomain() const
+    {
+        return m_modelDomain;
+    }
+
+    QSize const& dstSize() const
+    {
+        return m_dstSize;
+    }
+
+    ColumnMapper const& column(int x) const
+    {
+        return m_columns[x];
+    }
+
+    /**
+     * \brief The model Y coordinate of grid row \p y.
+     */
+    float modelY(int y) const
+    {
+        return m_modelYs[y];
+    }
+
+    /**
+     * \brief Source image position of grid node (x, y).
+     */
+    Vec2f gridPoint(int x, int y) const
+    {
+        return m_columns[x](m_modelYs[y]);
+    }
+private:
+    boost::shared_ptr<CylindricalSurfaceDewarper const> m_ptrDewarper;
+    QRectF m_modelDomain;
+    QSize m_dstSize;
+    std::vector<ColumnMapper> m_columns;
+    std::vector<float> m_modelYs;
+};
+
+} // namespace dewarping
+
+#endif
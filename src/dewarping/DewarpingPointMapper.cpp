@@ -18,6 +18,7 @@
 
 #include "DewarpingPointMapper.h"
 #include "DistortionModel.h"
+#include "DewarpPlan.h"
 #include <QTransform>
 #include <QSize>
 #include <QRect>
@@ -38,12 +39,22 @@ DewarpingPointMapper::DewarpingPointMapper(
 {
     // Model domain is a rectangle in output image coordinates that
     // will be mapped to our curved quadrilateral.
-    QRect const model_domain(
+    setModelDomain(
         distortion_model.modelDomain(
             m_dewarper, distortion_model_to_output, output_content_rect
         ).toRect()
     );
+}
 
+DewarpingPointMapper::DewarpingPointMapper(DewarpPlan const& plan)
+    :   m_dewarper(plan.dewarper())
+{
+    setModelDomain(plan.modelDomain().toRect());
+}
+
+void
+DewarpingPointMapper::setModelDomain(QRect const& model_domain)
+{
     // Note: QRect::right() - QRect::left() will give you size() - 1 not size()!
     // That's intended.
 
@@ -28,6 +28,7 @@ namespace dewarping
 {
 
 class DistortionModel;
+class DewarpPlan;
 
 class DewarpingPointMapper
 {
@@ -37,6 +38,14 @@ public:
         QTransform const& distortion_model_to_output,
         QRect const& output_content_rect);
 
+    /**
+     * \brief Takes the distortion model and the model domain from a plan.
+     *
+     * Warped points are in the coordinates the plan's dewarper works in.
+     * \see DewarpPlan::dewarper()
+     */
+    explicit DewarpingPointMapper(DewarpPlan const& plan);
+
     /**
      * Similar to CylindricalSurfaceDewarper::mapToDewarpedSpace(),
      * except it maps to dewarped image coordinates rather than
@@ -51,6 +60,8 @@ public:
      */
     QPointF mapToWarpedSpace(QPointF const& dewarped_pt) const;
 private:
+    void setModelDomain(QRect const& model_domain);
+
     CylindricalSurfaceDewarper m_dewarper;
     double m_modelDomainLeft;
     double m_modelDomainTop;
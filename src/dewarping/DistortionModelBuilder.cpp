@@ -24,6 +24,7 @@
 #include "SidesOfLine.h"
 #include "XSpline.h"
 #include "DebugImages.h"
+#include "PerformanceTimer.h"
 #include "VecNT.h"
 #include "MatMNT.h"
 #include "MatrixCalc.h"
@@ -43,6 +44,8 @@
 #include <exception>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <utility>
 #include <math.h>
 #include <assert.h>
 
@@ -82,14 +85,23 @@ struct DistortionModelBuilder::RansacModel {
     }
 };
 
+/**
+ * Candidate models are queued with addCandidate() and then assessed
+ * concurrently by run().  The best one is then selected in the order
+ * the candidates were added, so the result doesn't depend on threading.
+ */
 class DistortionModelBuilder::RansacAlgo
 {
 public:
     RansacAlgo(std::vector<TracedCurve> const& all_curves)
         : m_rAllCurves(all_curves) {}
 
-    void buildAndAssessModel(
-        TracedCurve const* top_curve, TracedCurve const* bottom_curve);
+    void addCandidate(TracedCurve const* top_curve, TracedCurve const* bottom_curve)
+    {
+        m_candidates.push_back(Candidate(top_curve, bottom_curve));
+    }
+
+    void run();
 
     RansacModel& bestModel()
     {
@@ -101,11 +113,20 @@ public:
         return m_bestModel;
     }
 private:
+    typedef std::pair<TracedCurve const*, TracedCurve const*> Candidate;
+
+    /**
+     * Returns the error of a model built from the given pair of curves,
+     * or NumericTraits<double>::max() if such a model can't be built.
+     */
+    double assessModel(TracedCurve const* top_curve, TracedCurve const* bottom_curve) const;
+
     double calcReferenceHeight(
         CylindricalSurfaceDewarper const& dewarper, QPointF const& loc);
 
     RansacModel m_bestModel;
     std::vector<TracedCurve> const& m_rAllCurves;
+    std::vector<Candidate> m_candidates;
 };
 
 class DistortionModelBuilder::BadCurve : public std::exception
@@ -180,17 +201,41 @@ DistortionModelBuilder::tryBuildModel(DebugImages* dbg, QImage const* dbg_backgr
         return DistortionModel();
     }
 
-    std::vector<TracedCurve> ordered_curves;
-    ordered_curves.reserve(num_curves);
+    PerformanceTimer curves_timer;
 
-    for (std::vector<QPointF> const& polyline : m_ltrPolylines) {
+    // Fitting splines is the expensive part, and it's independent
+    // for each polyline.  Results are collected in the original order.
+    std::vector<std::unique_ptr<TracedCurve> > traced_curves(num_curves);
+    std::vector<std::exception_ptr> errors(num_curves);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num_curves; ++i) {
         try {
-            ordered_curves.push_back(polylineToCurve(polyline));
+            traced_curves[i].reset(new TracedCurve(polylineToCurve(m_ltrPolylines[i])));
         } catch (BadCurve const&) {
             // Just skip it.
+        } catch (...) {
+            // Exceptions can't leave a parallel region.
+            errors[i] = std::current_exception();
+        }
+    }
+
+    std::vector<TracedCurve> ordered_curves;
+    ordered_curves.reserve(num_curves);
+    for (int i = 0; i < num_curves; ++i) {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+        if (traced_curves[i]) {
+            ordered_curves.push_back(*traced_curves[i]);
         }
     }
+    traced_curves.clear();
     num_curves = ordered_curves.size();
+
+    if (dbg) {
+        curves_timer.print("DistortionModelBuilder: fitting curves:");
+    }
     if (num_curves == 0) {
         return DistortionModel();
     }
@@ -201,6 +246,7 @@ DistortionModelBuilder::tryBuildModel(DebugImages* dbg, QImage const* dbg_backgr
     std::sort(ordered_curves.begin(), ordered_curves.end());
 
     // Select the best pair using RANSAC.
+    PerformanceTimer ransac_timer;
     RansacAlgo ransac(ordered_curves);
 
     // First let's try to combine each of the 3 top-most lines
@@ -208,7 +254,7 @@ DistortionModelBuilder::tryBuildModel(DebugImages* dbg, QImage const* dbg_backgr
     for (int i = 0; i < std::min<int>(3, num_curves); ++i) {
         for (int j = std::max<int>(0, num_curves - 3); j < num_curves; ++j) {
             if (i < j) {
-                ransac.buildAndAssessModel(&ordered_curves[i], &ordered_curves[j]);
+                ransac.addCandidate(&ordered_curves[i], &ordered_curves[j]);
             }
         }
     }
@@ -223,10 +269,16 @@ DistortionModelBuilder::tryBuildModel(DebugImages* dbg, QImage const* dbg_backgr
             std::swap(i, j);
         }
         if (i < j) {
-            ransac.buildAndAssessModel(&ordered_curves[i], &ordered_curves[j]);
+            ransac.addCandidate(&ordered_curves[i], &ordered_curves[j]);
         }
     }
 
+    ransac.run();
+
+    if (dbg) {
+        ransac_timer.print("DistortionModelBuilder: RANSAC:");
+    }
+
     if (dbg && dbg_background) {
         dbg->add(visualizeTrimmedPolylines(*dbg_background, ordered_curves), "trimmed_polylines");
         dbg->add(visualizeModel(*dbg_background, ordered_curves, ransac.bestModel()), "distortion_model");
@@ -480,15 +532,39 @@ DistortionModelBuilder::fitExtendedSpline(
 /*============================== RansacAlgo ============================*/
 
 void
-DistortionModelBuilder::RansacAlgo::buildAndAssessModel(
-    TracedCurve const* top_curve, TracedCurve const* bottom_curve)
+DistortionModelBuilder::RansacAlgo::run()
+{
+    int const num_candidates = m_candidates.size();
+    std::vector<double> errors(num_candidates);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num_candidates; ++i) {
+        errors[i] = assessModel(m_candidates[i].first, m_candidates[i].second);
+    }
+
+    // Ordered reduction: on equal errors, the earlier candidate wins,
+    // just like it would if they were assessed one by one.
+    for (int i = 0; i < num_candidates; ++i) {
+        if (errors[i] < m_bestModel.totalError) {
+            m_bestModel.topCurve = m_candidates[i].first;
+            m_bestModel.bottomCurve = m_candidates[i].second;
+            m_bestModel.totalError = errors[i];
+        }
+    }
+
+    m_candidates.clear();
+}
+
+double
+DistortionModelBuilder::RansacAlgo::assessModel(
+    TracedCurve const* top_curve, TracedCurve const* bottom_curve) const
 try
 {
     DistortionModel model;
     model.setTopCurve(Curve(top_curve->extendedPolyline));
     model.setBottomCurve(Curve(bottom_curve->extendedPolyline));
     if (!model.isValid()) {
-        return;
+        return NumericTraits<double>::max();
     }
 
     double const depth_perception = 2.0; // Doesn't matter much here.
@@ -551,14 +627,11 @@ try
         }
     }
 
-    if (error < m_bestModel.totalError) {
-        m_bestModel.topCurve = top_curve;
-        m_bestModel.bottomCurve = bottom_curve;
-        m_bestModel.totalError = error;
-    }
+    return error;
 } catch (std::runtime_error const&)
 {
     // Probably CylindricalSurfaceDewarper didn't like something.
+    return NumericTraits<double>::max();
 }
 #if 0
 double
@@ -18,6 +18,7 @@
 
 #include "RasterDewarper.h"
 #include "CylindricalSurfaceDewarper.h"
+#include "DewarpPlan.h"
 #include "HomographicTransform.h"
 #include "VecNT.h"
 #include "imageproc/ColorMixer.h"
@@ -28,6 +29,9 @@
 #include <QSize>
 #include <QRect>
 #include <QDebug>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 #include <math.h>
 
 #define INTERP_NONE 0
@@ -49,35 +53,16 @@ template<typename ColorMixer, typename PixelType>
 void dewarpGeneric(
     PixelType const* const src_data, QSize const src_size,
     int const src_stride, PixelType* const dst_data,
-    QSize const dst_size, int const dst_stride,
-    CylindricalSurfaceDewarper const& distortion_model,
-    QRectF const& model_domain, PixelType const bg_color)
+    int const dst_stride, DewarpPlan const& plan, PixelType const bg_color)
 {
     int const src_width = src_size.width();
     int const src_height = src_size.height();
-    int const dst_width = dst_size.width();
-    int const dst_height = dst_size.height();
-
-    CylindricalSurfaceDewarper::State state;
-
-    double const model_domain_left = model_domain.left();
-    double const model_x_scale = 1.0 / (model_domain.right() - model_domain.left());
-
-    float const model_domain_top = model_domain.top();
-    float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
+    int const dst_width = plan.dstSize().width();
+    int const dst_height = plan.dstSize().height();
 
     for (int dst_x = 0; dst_x < dst_width; ++dst_x) {
-        double const model_x = (dst_x - model_domain_left) * model_x_scale;
-        CylindricalSurfaceDewarper::Generatrix const generatrix(
-            distortion_model.mapGeneratrix(model_x, state)
-        );
-
-        HomographicTransform<1, float> const homog(generatrix.pln2img.mat());
-        Vec2f const origin(generatrix.imgLine.p1());
-        Vec2f const vec(generatrix.imgLine.p2() - generatrix.imgLine.p1());
         for (int dst_y = 0; dst_y < dst_height; ++dst_y) {
-            float const model_y = (float(dst_y) - model_domain_top) * model_y_scale;
-            Vec2f const src_pt(origin + vec * homog(model_y));
+            Vec2f const src_pt(plan.gridPoint(dst_x, dst_y));
             int const src_x = qRound(src_pt[0]);
             int const src_y = qRound(src_pt[1]);
             if (src_x < 0 || src_x >= src_width || src_y < 0 || src_y >= src_height) {
@@ -96,15 +81,17 @@ template<typename ColorMixer, typename PixelType>
 void dewarpGeneric(
     PixelType const* const src_data, QSize const src_size,
     int const src_stride, PixelType* const dst_data,
-    QSize const dst_size, int const dst_stride,
-    CylindricalSurfaceDewarper const& distortion_model,
-    QRectF const& model_domain, PixelType const bg_color)
+    int const dst_stride, DewarpPlan const& plan, PixelType const bg_color)
 {
     int const src_width = src_size.width();
     int const src_height = src_size.height();
-    int const dst_width = dst_size.width();
-    int const dst_height = dst_size.height();
+    int const dst_width = plan.dstSize().width();
+    int const dst_height = plan.dstSize().height();
 
+    // Bilinear interpolation samples at pixel centers rather than
+    // at grid nodes, so it maps its own generatrices.
+    CylindricalSurfaceDewarper const& distortion_model = plan.dewarper();
+    QRectF const& model_domain = plan.modelDomain();
     CylindricalSurfaceDewarper::State state;
 
     double const model_domain_left = model_domain.left() - 0.5f;
@@ -165,308 +152,302 @@ void dewarpGeneric(
 
 #elif INTERPOLATION_METHOD == INTERP_AREA_MAPPING
 
+/**
+ * Area-maps a single destination pixel, given the source image positions
+ * of its four corners.
+ */
 template<typename ColorMixer, typename PixelType>
-void areaMapGeneratrix(
-    PixelType const* const src_data, QSize const src_size,
-    int const src_stride, PixelType* p_dst,
-    QSize const dst_size, int const dst_stride,
-    PixelType const bg_color,
-    std::vector<Vec2f> const& prev_grid_column,
-    std::vector<Vec2f> const& next_grid_column)
+inline PixelType areaMapPixel(
+    PixelType const* const src_data, int const sw, int const sh,
+    int const src_stride, PixelType const bg_color,
+    Vec2f const& top_left, Vec2f const& top_right,
+    Vec2f const& bottom_left, Vec2f const& bottom_right)
 {
-    int const sw = src_size.width();
-    int const sh = src_size.height();
-    int const dst_height = dst_size.height();
-
-    Vec2f const* src_left_points = &prev_grid_column[0];
-    Vec2f const* src_right_points = &next_grid_column[0];
-
     Vec2f f_src32_quad[4];
 
-    for (int dst_y = 0; dst_y < dst_height; ++dst_y) {
-        // Take a mid-point of each edge, pre-multiply by 32,
-        // write the result to f_src32_quad. 16 comes from 32*0.5
-        f_src32_quad[0] = 16.0f * (src_left_points[0] + src_right_points[0]);
-        f_src32_quad[1] = 16.0f * (src_right_points[0] + src_right_points[1]);
-        f_src32_quad[2] = 16.0f * (src_right_points[1] + src_left_points[1]);
-        f_src32_quad[3] = 16.0f * (src_left_points[0] + src_left_points[1]);
-        ++src_left_points;
-        ++src_right_points;
-
-        // Calculate the bounding box of src_quad.
-
-        float f_src32_left = f_src32_quad[0][0];
-        float f_src32_top = f_src32_quad[0][1];
-        float f_src32_right = f_src32_left;
-        float f_src32_bottom = f_src32_top;
-
-        for (int i = 1; i < 4; ++i) {
-            Vec2f const pt(f_src32_quad[i]);
-            if (pt[0] < f_src32_left) {
-                f_src32_left = pt[0];
-            } else if (pt[0] > f_src32_right) {
-                f_src32_right = pt[0];
-            }
-            if (pt[1] < f_src32_top) {
-                f_src32_top = pt[1];
-            } else if (pt[1] > f_src32_bottom) {
-                f_src32_bottom = pt[1];
-            }
+    // Take a mid-point of each edge, pre-multiply by 32,
+    // write the result to f_src32_quad. 16 comes from 32*0.5
+    f_src32_quad[0] = 16.0f * (top_left + top_right);
+    f_src32_quad[1] = 16.0f * (top_right + bottom_right);
+    f_src32_quad[2] = 16.0f * (bottom_right + bottom_left);
+    f_src32_quad[3] = 16.0f * (top_left + bottom_left);
+
+    // Calculate the bounding box of src_quad.
+
+    float f_src32_left = f_src32_quad[0][0];
+    float f_src32_top = f_src32_quad[0][1];
+    float f_src32_right = f_src32_left;
+    float f_src32_bottom = f_src32_top;
+
+    for (int i = 1; i < 4; ++i) {
+        Vec2f const pt(f_src32_quad[i]);
+        if (pt[0] < f_src32_left) {
+            f_src32_left = pt[0];
+        } else if (pt[0] > f_src32_right) {
+            f_src32_right = pt[0];
         }
-
-        if (f_src32_top < -32.0f * 10000.0f || f_src32_left < -32.0f * 10000.0f ||
-                f_src32_bottom > 32.0f * (float(sh) + 10000.f) ||
-                f_src32_right > 32.0f * (float(sw) + 10000.f)) {
-            // This helps to prevent integer overflows.
-            *p_dst = bg_color;
-            p_dst += dst_stride;
-            continue;
+        if (pt[1] < f_src32_top) {
+            f_src32_top = pt[1];
+        } else if (pt[1] > f_src32_bottom) {
+            f_src32_bottom = pt[1];
         }
+    }
 
-        // Note: the code below is more or less the same as in transformGeneric()
-        // in imageproc/Transform.cpp
-
-        // Note that without using floor() and ceil()
-        // we can't guarantee that src_bottom >= src_top
-        // and src_right >= src_left.
-        int src32_left = (int)floor(f_src32_left);
-        int src32_right = (int)ceil(f_src32_right);
-        int src32_top = (int)floor(f_src32_top);
-        int src32_bottom = (int)ceil(f_src32_bottom);
-        int src_left = src32_left >> 5;
-        int src_right = (src32_right - 1) >> 5; // inclusive
-        int src_top = src32_top >> 5;
-        int src_bottom = (src32_bottom - 1) >> 5; // inclusive
-        assert(src_bottom >= src_top);
-        assert(src_right >= src_left);
-
-        if (src_bottom < 0 || src_right < 0 || src_left >= sw || src_top >= sh) {
-            // Completely outside of src image.
-            *p_dst = bg_color;
-            p_dst += dst_stride;
-            continue;
-        }
+    if (f_src32_top < -32.0f * 10000.0f || f_src32_left < -32.0f * 10000.0f ||
+            f_src32_bottom > 32.0f * (float(sh) + 10000.f) ||
+            f_src32_right > 32.0f * (float(sw) + 10000.f)) {
+        // This helps to prevent integer overflows.
+        return bg_color;
+    }
 
-        /*
-         * Note that (intval / 32) is not the same as (intval >> 5).
-         * The former rounds towards zero, while the latter rounds towards
-         * negative infinity.
-         * Likewise, (intval % 32) is not the same as (intval & 31).
-         * The following expression:
-         * top_fraction = 32 - (src32_top & 31);
-         * works correctly with both positive and negative src32_top.
-         */
-
-        unsigned background_area = 0;
-
-        if (src_top < 0) {
-            unsigned const top_fraction = 32 - (src32_top & 31);
-            unsigned const hor_fraction = src32_right - src32_left;
-            background_area += top_fraction * hor_fraction;
-            unsigned const full_pixels_ver = -1 - src_top;
-            background_area += hor_fraction * (full_pixels_ver << 5);
-            src_top = 0;
-            src32_top = 0;
-        }
-        if (src_bottom >= sh) {
-            unsigned const bottom_fraction = src32_bottom - (src_bottom << 5);
-            unsigned const hor_fraction = src32_right - src32_left;
-            background_area += bottom_fraction * hor_fraction;
-            unsigned const full_pixels_ver = src_bottom - sh;
-            background_area += hor_fraction * (full_pixels_ver << 5);
-            src_bottom = sh - 1; // inclusive
-            src32_bottom = sh << 5; // exclusive
-        }
-        if (src_left < 0) {
-            unsigned const left_fraction = 32 - (src32_left & 31);
-            unsigned const vert_fraction = src32_bottom - src32_top;
-            background_area += left_fraction * vert_fraction;
-            unsigned const full_pixels_hor = -1 - src_left;
-            background_area += vert_fraction * (full_pixels_hor << 5);
-            src_left = 0;
-            src32_left = 0;
-        }
-        if (src_right >= sw) {
-            unsigned const right_fraction = src32_right - (src_right << 5);
-            unsigned const vert_fraction = src32_bottom - src32_top;
-            background_area += right_fraction * vert_fraction;
-            unsigned const full_pixels_hor = src_right - sw;
-            background_area += vert_fraction * (full_pixels_hor << 5);
-            src_right = sw - 1; // inclusive
-            src32_right = sw << 5; // exclusive
-        }
-        assert(src_bottom >= src_top);
-        assert(src_right >= src_left);
+    // Note: the code below is more or less the same as in transformGeneric()
+    // in imageproc/Transform.cpp
+
+    // Note that without using floor() and ceil()
+    // we can't guarantee that src_bottom >= src_top
+    // and src_right >= src_left.
+    int src32_left = (int)floor(f_src32_left);
+    int src32_right = (int)ceil(f_src32_right);
+    int src32_top = (int)floor(f_src32_top);
+    int src32_bottom = (int)ceil(f_src32_bottom);
+    int src_left = src32_left >> 5;
+    int src_right = (src32_right - 1) >> 5; // inclusive
+    int src_top = src32_top >> 5;
+    int src_bottom = (src32_bottom - 1) >> 5; // inclusive
+    assert(src_bottom >= src_top);
+    assert(src_right >= src_left);
+
+    if (src_bottom < 0 || src_right < 0 || src_left >= sw || src_top >= sh) {
+        // Completely outside of src image.
+        return bg_color;
+    }
 
-        ColorMixer mixer;
-        //if (weak_background) {
-        //  background_area = 0;
-        //} else {
-        mixer.add(bg_color, background_area);
-        //}
+    /*
+     * Note that (intval / 32) is not the same as (intval >> 5).
+     * The former rounds towards zero, while the latter rounds towards
+     * negative infinity.
+     * Likewise, (intval % 32) is not the same as (intval & 31).
+     * The following expression:
+     * top_fraction = 32 - (src32_top & 31);
+     * works correctly with both positive and negative src32_top.
+     */
 
-        unsigned const left_fraction = 32 - (src32_left & 31);
+    unsigned background_area = 0;
+
+    if (src_top < 0) {
         unsigned const top_fraction = 32 - (src32_top & 31);
-        unsigned const right_fraction = src32_right - (src_right << 5);
+        unsigned const hor_fraction = src32_right - src32_left;
+        background_area += top_fraction * hor_fraction;
+        unsigned const full_pixels_ver = -1 - src_top;
+        background_area += hor_fraction * (full_pixels_ver << 5);
+        src_top = 0;
+        src32_top = 0;
+    }
+    if (src_bottom >= sh) {
         unsigned const bottom_fraction = src32_bottom - (src_bottom << 5);
+        unsigned const hor_fraction = src32_right - src32_left;
+        background_area += bottom_fraction * hor_fraction;
+        unsigned const full_pixels_ver = src_bottom - sh;
+        background_area += hor_fraction * (full_pixels_ver << 5);
+        src_bottom = sh - 1; // inclusive
+        src32_bottom = sh << 5; // exclusive
+    }
+    if (src_left < 0) {
+        unsigned const left_fraction = 32 - (src32_left & 31);
+        unsigned const vert_fraction = src32_bottom - src32_top;
+        background_area += left_fraction * vert_fraction;
+        unsigned const full_pixels_hor = -1 - src_left;
+        background_area += vert_fraction * (full_pixels_hor << 5);
+        src_left = 0;
+        src32_left = 0;
+    }
+    if (src_right >= sw) {
+        unsigned const right_fraction = src32_right - (src_right << 5);
+        unsigned const vert_fraction = src32_bottom - src32_top;
+        background_area += right_fraction * vert_fraction;
+        unsigned const full_pixels_hor = src_right - sw;
+        background_area += vert_fraction * (full_pixels_hor << 5);
+        src_right = sw - 1; // inclusive
+        src32_right = sw << 5; // exclusive
+    }
+    assert(src_bottom >= src_top);
+    assert(src_right >= src_left);
+
+    ColorMixer mixer;
+    //if (weak_background) {
+    //  background_area = 0;
+    //} else {
+    mixer.add(bg_color, background_area);
+    //}
+
+    unsigned const left_fraction = 32 - (src32_left & 31);
+    unsigned const top_fraction = 32 - (src32_top & 31);
+    unsigned const right_fraction = src32_right - (src_right << 5);
+    unsigned const bottom_fraction = src32_bottom - (src_bottom << 5);
+
+    assert(left_fraction + right_fraction + (src_right - src_left - 1) * 32 == static_cast<unsigned>(src32_right - src32_left));
+    assert(top_fraction + bottom_fraction + (src_bottom - src_top - 1) * 32 == static_cast<unsigned>(src32_bottom - src32_top));
+
+    unsigned const src_area = (src32_bottom - src32_top) * (src32_right - src32_left);
+    if (src_area == 0) {
+        return bg_color;
+    }
 
-        assert(left_fraction + right_fraction + (src_right - src_left - 1) * 32 == static_cast<unsigned>(src32_right - src32_left));
-        assert(top_fraction + bottom_fraction + (src_bottom - src_top - 1) * 32 == static_cast<unsigned>(src32_bottom - src32_top));
-
-        unsigned const src_area = (src32_bottom - src32_top) * (src32_right - src32_left);
-        if (src_area == 0) {
-            *p_dst = bg_color;
-            p_dst += dst_stride;
-            continue;
-        }
-
-        PixelType const* src_line = &src_data[src_top * src_stride];
-
-        if (src_top == src_bottom) {
-            if (src_left == src_right) {
-                // dst pixel maps to a single src pixel
-                PixelType const c = src_line[src_left];
-                if (background_area == 0) {
-                    // common case optimization
-                    *p_dst = c;
-                    p_dst += dst_stride;
-                    continue;
-                }
-                mixer.add(c, src_area);
-            } else {
-                // dst pixel maps to a horizontal line of src pixels
-                unsigned const vert_fraction = src32_bottom - src32_top;
-                unsigned const left_area = vert_fraction * left_fraction;
-                unsigned const middle_area = vert_fraction << 5;
-                unsigned const right_area = vert_fraction * right_fraction;
-
-                mixer.add(src_line[src_left], left_area);
-
-                for (int sx = src_left + 1; sx < src_right; ++sx) {
-                    mixer.add(src_line[sx], middle_area);
-                }
+    PixelType const* src_line = &src_data[src_top * src_stride];
 
-                mixer.add(src_line[src_right], right_area);
+    if (src_top == src_bottom) {
+        if (src_left == src_right) {
+            // dst pixel maps to a single src pixel
+            PixelType const c = src_line[src_left];
+            if (background_area == 0) {
+                // common case optimization
+                return c;
             }
-        } else if (src_left == src_right) {
-            // dst pixel maps to a vertical line of src pixels
-            unsigned const hor_fraction = src32_right - src32_left;
-            unsigned const top_area = hor_fraction * top_fraction;
-            unsigned const middle_area = hor_fraction << 5;
-            unsigned const bottom_area =  hor_fraction * bottom_fraction;
-
-            src_line += src_left;
-            mixer.add(*src_line, top_area);
-
-            src_line += src_stride;
+            mixer.add(c, src_area);
+        } else {
+            // dst pixel maps to a horizontal line of src pixels
+            unsigned const vert_fraction = src32_bottom - src32_top;
+            unsigned const left_area = vert_fraction * left_fraction;
+            unsigned const middle_area = vert_fraction << 5;
+            unsigned const right_area = vert_fraction * right_fraction;
 
-            for (int sy = src_top + 1; sy < src_bottom; ++sy) {
-                mixer.add(*src_line, middle_area);
-                src_line += src_stride;
-            }
+            mixer.add(src_line[src_left], left_area);
 
-            mixer.add(*src_line, bottom_area);
-        } else {
-            // dst pixel maps to a block of src pixels
-            unsigned const top_area = top_fraction << 5;
-            unsigned const bottom_area = bottom_fraction << 5;
-            unsigned const left_area = left_fraction << 5;
-            unsigned const right_area = right_fraction << 5;
-            unsigned const topleft_area = top_fraction * left_fraction;
-            unsigned const topright_area = top_fraction * right_fraction;
-            unsigned const bottomleft_area = bottom_fraction * left_fraction;
-            unsigned const bottomright_area = bottom_fraction * right_fraction;
-
-            // process the top-left corner
-            mixer.add(src_line[src_left], topleft_area);
-
-            // process the top line (without corners)
             for (int sx = src_left + 1; sx < src_right; ++sx) {
-                mixer.add(src_line[sx], top_area);
+                mixer.add(src_line[sx], middle_area);
             }
 
-            // process the top-right corner
-            mixer.add(src_line[src_right], topright_area);
+            mixer.add(src_line[src_right], right_area);
+        }
+    } else if (src_left == src_right) {
+        // dst pixel maps to a vertical line of src pixels
+        unsigned const hor_fraction = src32_right - src32_left;
+        unsigned const top_area = hor_fraction * top_fraction;
+        unsigned const middle_area = hor_fraction << 5;
+        unsigned const bottom_area =  hor_fraction * bottom_fraction;
 
-            src_line += src_stride;
+        src_line += src_left;
+        mixer.add(*src_line, top_area);
 
-            // process middle lines
-            for (int sy = src_top + 1; sy < src_bottom; ++sy) {
-                mixer.add(src_line[src_left], left_area);
+        src_line += src_stride;
 
-                for (int sx = src_left + 1; sx < src_right; ++sx) {
-                    mixer.add(src_line[sx], 32 * 32);
-                }
+        for (int sy = src_top + 1; sy < src_bottom; ++sy) {
+            mixer.add(*src_line, middle_area);
+            src_line += src_stride;
+        }
+
+        mixer.add(*src_line, bottom_area);
+    } else {
+        // dst pixel maps to a block of src pixels
+        unsigned const top_area = top_fraction << 5;
+        unsigned const bottom_area = bottom_fraction << 5;
+        unsigned const left_area = left_fraction << 5;
+        unsigned const right_area = right_fraction << 5;
+        unsigned const topleft_area = top_fraction * left_fraction;
+        unsigned const topright_area = top_fraction * right_fraction;
+        unsigned const bottomleft_area = bottom_fraction * left_fraction;
+        unsigned const bottomright_area = bottom_fraction * right_fraction;
+
+        // process the top-left corner
+        mixer.add(src_line[src_left], topleft_area);
+
+        // process the top line (without corners)
+        for (int sx = src_left + 1; sx < src_right; ++sx) {
+            mixer.add(src_line[sx], top_area);
+        }
 
-                mixer.add(src_line[src_right], right_area);
+        // process the top-right corner
+        mixer.add(src_line[src_right], topright_area);
 
-                src_line += src_stride;
-            }
+        src_line += src_stride;
 
-            // process bottom-left corner
-            mixer.add(src_line[src_left], bottomleft_area);
+        // process middle lines
+        for (int sy = src_top + 1; sy < src_bottom; ++sy) {
+            mixer.add(src_line[src_left], left_area);
 
-            // process the bottom line (without corners)
             for (int sx = src_left + 1; sx < src_right; ++sx) {
-                mixer.add(src_line[sx], bottom_area);
+                mixer.add(src_line[sx], 32 * 32);
             }
 
-            // process the bottom-right corner
-            mixer.add(src_line[src_right], bottomright_area);
+            mixer.add(src_line[src_right], right_area);
+
+            src_line += src_stride;
+        }
+
+        // process bottom-left corner
+        mixer.add(src_line[src_left], bottomleft_area);
+
+        // process the bottom line (without corners)
+        for (int sx = src_left + 1; sx < src_right; ++sx) {
+            mixer.add(src_line[sx], bottom_area);
         }
 
-        *p_dst = mixer.mix(src_area + background_area);
-        p_dst += dst_stride;
+        // process the bottom-right corner
+        mixer.add(src_line[src_right], bottomright_area);
     }
+
+    return mixer.mix(src_area + background_area);
 }
 
+/**
+ * Destination tiles are square, so that both the destination pixels and
+ * the source pixels they map to stay close in memory.
+ */
+int const TILE_SIZE = 64;
+
 template<typename ColorMixer, typename PixelType>
 void dewarpGeneric(
     PixelType const* const src_data, QSize const src_size,
     int const src_stride, PixelType* const dst_data,
-    QSize const dst_size, int const dst_stride,
-    CylindricalSurfaceDewarper const& distortion_model,
-    QRectF const& model_domain, PixelType const bg_color)
+    int const dst_stride, DewarpPlan const& plan, PixelType const bg_color)
 {
     int const src_width = src_size.width();
     int const src_height = src_size.height();
-    int const dst_width = dst_size.width();
-    int const dst_height = dst_size.height();
-
-    CylindricalSurfaceDewarper::State state;
-
-    double const model_domain_left = model_domain.left();
-    double const model_x_scale = 1.0 / (model_domain.right() - model_domain.left());
-
-    float const model_domain_top = model_domain.top();
-    float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
-
-    std::vector<Vec2f> prev_grid_column(dst_height + 1);
-    std::vector<Vec2f> next_grid_column(dst_height + 1);
-
-    for (int dst_x = 0; dst_x <= dst_width; ++dst_x) {
-        double const model_x = (dst_x - model_domain_left) * model_x_scale;
-        CylindricalSurfaceDewarper::Generatrix const generatrix(
-            distortion_model.mapGeneratrix(model_x, state)
-        );
-
-        HomographicTransform<1, float> const homog(generatrix.pln2img.mat());
-        Vec2f const origin(generatrix.imgLine.p1());
-        Vec2f const vec(generatrix.imgLine.p2() - generatrix.imgLine.p1());
-        for (int dst_y = 0; dst_y <= dst_height; ++dst_y) {
-            float const model_y = (float(dst_y) - model_domain_top) * model_y_scale;
-            next_grid_column[dst_y] = origin + vec * homog(model_y);
-        }
+    int const dst_width = plan.dstSize().width();
+    int const dst_height = plan.dstSize().height();
+
+    // Tiles are independent: each one maps its own part of the grid
+    // (re-doing the points on edges shared with its neighbours)
+    // and then area-maps its pixels in row-major order.
+    int const tiles_x = (dst_width + TILE_SIZE - 1) / TILE_SIZE;
+    int const tiles_y = (dst_height + TILE_SIZE - 1) / TILE_SIZE;
+    int const num_tiles = tiles_x * tiles_y;
+
+    #pragma omp parallel
+    {
+        std::vector<Vec2f> grid((TILE_SIZE + 1) * (TILE_SIZE + 1));
+
+        #pragma omp for schedule(dynamic)
+        for (int tile = 0; tile < num_tiles; ++tile) {
+            int const x0 = (tile % tiles_x) * TILE_SIZE;
+            int const y0 = (tile / tiles_x) * TILE_SIZE;
+            int const w = std::min(TILE_SIZE, dst_width - x0);
+            int const h = std::min(TILE_SIZE, dst_height - y0);
+            int const grid_stride = w + 1;
+
+            for (int gx = 0; gx <= w; ++gx) {
+                DewarpPlan::ColumnMapper const& mapper = plan.column(x0 + gx);
+                Vec2f* grid_point = &grid[gx];
+                for (int gy = 0; gy <= h; ++gy) {
+                    *grid_point = mapper(plan.modelY(y0 + gy));
+                    grid_point += grid_stride;
+                }
+            }
 
-        if (dst_x != 0) {
-            areaMapGeneratrix<ColorMixer, PixelType>(
-                src_data, src_size, src_stride,
-                dst_data + dst_x - 1, dst_size, dst_stride,
-                bg_color, prev_grid_column, next_grid_column
-            );
+            PixelType* dst_line = dst_data + y0 * dst_stride + x0;
+            Vec2f const* grid_line = &grid[0];
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    dst_line[x] = areaMapPixel<ColorMixer, PixelType>(
+                                      src_data, src_width, src_height, src_stride, bg_color,
+                                      grid_line[x], grid_line[x + 1],
+                                      grid_line[x + grid_stride], grid_line[x + grid_stride + 1]
+                                  );
+                }
+                dst_line += dst_stride;
+                grid_line += grid_stride;
+            }
         }
-
-        prev_grid_column.swap(next_grid_column);
     }
 }
 
@@ -479,47 +460,38 @@ typedef unsigned MixingWeight;
 #endif
 
 QImage dewarpGrayscale(
-    QImage const& src, QSize const& dst_size,
-    CylindricalSurfaceDewarper const& distortion_model,
-    QRectF const& model_domain, QColor const& bg_color)
+    QImage const& src, DewarpPlan const& plan, QColor const& bg_color)
 {
-    GrayImage dst(dst_size);
+    GrayImage dst(plan.dstSize());
     uint8_t const bg_sample = qGray(bg_color.rgb());
     dst.fill(bg_sample);
     dewarpGeneric<GrayColorMixer<MixingWeight>, uint8_t>(
         src.bits(), src.size(), src.bytesPerLine(),
-        dst.data(), dst_size, dst.stride(),
-        distortion_model, model_domain, bg_sample
+        dst.data(), dst.stride(), plan, bg_sample
     );
     return dst.toQImage();
 }
 
 QImage dewarpRgb(
-    QImage const& src, QSize const& dst_size,
-    CylindricalSurfaceDewarper const& distortion_model,
-    QRectF const& model_domain, QColor const& bg_color)
+    QImage const& src, DewarpPlan const& plan, QColor const& bg_color)
 {
-    QImage dst(dst_size, QImage::Format_RGB32);
+    QImage dst(plan.dstSize(), QImage::Format_RGB32);
     dst.fill(bg_color.rgb());
     dewarpGeneric<RgbColorMixer<MixingWeight>, uint32_t>(
         (uint32_t const*)src.bits(), src.size(), src.bytesPerLine() / 4,
-        (uint32_t*)dst.bits(), dst_size, dst.bytesPerLine() / 4,
-        distortion_model, model_domain, bg_color.rgb()
+        (uint32_t*)dst.bits(), dst.bytesPerLine() / 4, plan, bg_color.rgb()
     );
     return dst;
 }
 
 QImage dewarpArgb(
-    QImage const& src, QSize const& dst_size,
-    CylindricalSurfaceDewarper const& distortion_model,
-    QRectF const& model_domain, QColor const& bg_color)
+    QImage const& src, DewarpPlan const& plan, QColor const& bg_color)
 {
-    QImage dst(dst_size, QImage::Format_ARGB32);
+    QImage dst(plan.dstSize(), QImage::Format_ARGB32);
     dst.fill(bg_color.rgba());
     dewarpGeneric<ArgbColorMixer<MixingWeight>, uint32_t>(
         (uint32_t const*)src.bits(), src.size(), src.bytesPerLine() / 4,
-        (uint32_t*)dst.bits(), dst_size, dst.bytesPerLine() / 4,
-        distortion_model, model_domain, bg_color.rgba()
+        (uint32_t*)dst.bits(), dst.bytesPerLine() / 4, plan, bg_color.rgba()
     );
     return dst;
 }
@@ -536,21 +508,31 @@ RasterDewarper::dewarp(
         throw std::invalid_argument("RasterDewarper: model_domain is empty.");
     }
 
+    return dewarp(src, DewarpPlan(distortion_model, model_domain, dst_size), bg_color);
+}
+
+QImage
+RasterDewarper::dewarp(
+    QImage const& src, DewarpPlan const& plan, QColor const& bg_color)
+{
+    if (plan.isNull()) {
+        throw std::invalid_argument("RasterDewarper: plan is null.");
+    }
+
     switch (src.format()) {
     case QImage::Format_Invalid:
         return QImage();
     case QImage::Format_RGB32:
-        return dewarpRgb(src, dst_size, distortion_model, model_domain, bg_color);
+        return dewarpRgb(src, plan, bg_color);
     case QImage::Format_ARGB32:
-        return dewarpArgb(src, dst_size, distortion_model, model_domain, bg_color);
+        return dewarpArgb(src, plan, bg_color);
     case QImage::Format_Indexed8:
         if (src.isGrayscale()) {
-            return dewarpGrayscale(src, dst_size, distortion_model, model_domain, bg_color);
+            return dewarpGrayscale(src, plan, bg_color);
         } else if (src.allGray()) {
             // Only shades of gray but non-standard palette.
             return dewarpGrayscale(
-                       GrayImage(src).toQImage(), dst_size, distortion_model,
-                       model_domain, bg_color
+                       GrayImage(src).toQImage(), plan, bg_color
                    );
         }
         break;
@@ -559,7 +541,7 @@ RasterDewarper::dewarp(
         if (src.allGray()) {
             return dewarpGrayscale(
                        GrayImage(src).toQImage(),
-                       dst_size, distortion_model, model_domain, bg_color
+                       plan, bg_color
                    );
         }
         break;
@@ -570,12 +552,12 @@ RasterDewarper::dewarp(
     if (src.hasAlphaChannel()) {
         return dewarpArgb(
                    src.convertToFormat(QImage::Format_ARGB32),
-                   dst_size, distortion_model, model_domain, bg_color
+                   plan, bg_color
                );
     } else {
         return dewarpRgb(
                    src.convertToFormat(QImage::Format_RGB32),
-                   dst_size, distortion_model, model_domain, bg_color
+                   plan, bg_color
                );
     }
 }
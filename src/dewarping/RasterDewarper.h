@@ -28,6 +28,7 @@ namespace dewarping
 {
 
 class CylindricalSurfaceDewarper;
+class DewarpPlan;
 
 class RasterDewarper
 {
@@ -37,6 +38,18 @@ public:
         CylindricalSurfaceDewarper const& distortion_model,
         QRectF const& model_domain, QColor const& background_color
     );
+
+    /**
+     * \brief Dewarps an image according to a precomputed plan.
+     *
+     * Use this version when dewarping several images with the same
+     * distortion model, building the plan just once.
+     * \throw std::invalid_argument if \p plan is null.
+     */
+    static QImage dewarp(
+        QImage const& src, DewarpPlan const& plan,
+        QColor const& background_color
+    );
 };
 
 } // namespace dewarping
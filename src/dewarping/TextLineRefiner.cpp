@@ -21,6 +21,7 @@
 #include "VecNT.h"
 #include "NumericTraits.h"
 #include "DebugImages.h"
+#include "PerformanceTimer.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/GaussBlur.h"
 #include "imageproc/Sobel.h"
@@ -149,24 +150,32 @@ TextLineRefiner::refine(
     // Start with a rather strong blur.
     float h_sigma = (4.0f / 200.f) * m_dpi.horizontal();
     float v_sigma = (4.0f / 200.f) * m_dpi.vertical();
+    PerformanceTimer gradient_timer1;
     calcBlurredGradient(gradient, h_sigma, v_sigma);
-
-    for (Snake& snake : snakes) {
-        evolveSnake(snake, gradient, ON_CONVERGENCE_STOP);
+    if (dbg) {
+        gradient_timer1.print("TextLineRefiner: gradient 1:");
     }
+
+    PerformanceTimer evolve_timer1;
+    evolveSnakes(snakes, gradient, ON_CONVERGENCE_STOP);
     if (dbg) {
+        evolve_timer1.print("TextLineRefiner: snakes 1:");
         dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes1");
     }
 
     // Less blurring this time.
     h_sigma *= 0.5f;
     v_sigma *= 0.5f;
+    PerformanceTimer gradient_timer2;
     calcBlurredGradient(gradient, h_sigma, v_sigma);
-
-    for (Snake& snake : snakes) {
-        evolveSnake(snake, gradient, ON_CONVERGENCE_GO_FINER);
+    if (dbg) {
+        gradient_timer2.print("TextLineRefiner: gradient 2:");
     }
+
+    PerformanceTimer evolve_timer2;
+    evolveSnakes(snakes, gradient, ON_CONVERGENCE_GO_FINER);
     if (dbg) {
+        evolve_timer2.print("TextLineRefiner: snakes 2:");
         dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes2");
     }
 
@@ -331,6 +340,21 @@ TextLineRefiner::calcFrenetFrames(
     }
 }
 
+void
+TextLineRefiner::evolveSnakes(
+    std::vector<Snake>& snakes, Grid<float> const& gradient,
+    OnConvergence const on_convergence) const
+{
+    // Snakes only read the gradient, so they can evolve concurrently.
+    // Each one evolves the same way regardless of threading.
+    int const num_snakes = snakes.size();
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num_snakes; ++i) {
+        evolveSnake(snakes[i], gradient, on_convergence);
+    }
+}
+
 void
 TextLineRefiner::evolveSnake(Snake& snake, Grid<float> const& gradient,
                              OnConvergence const on_convergence) const
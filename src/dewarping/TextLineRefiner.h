@@ -81,6 +81,9 @@ private:
         std::vector<FrenetFrame>& frenet_frames, Snake const& snake,
         SnakeLength const& snake_length, Vec2f const& unit_down_vec);
 
+    void evolveSnakes(std::vector<Snake>& snakes, Grid<float> const& gradient,
+                      OnConvergence on_convergence) const;
+
     void evolveSnake(Snake& snake, Grid<float> const& gradient, OnConvergence on_convergence) const;
 
     QImage visualizeGradient(Grid<float> const& gradient) const;
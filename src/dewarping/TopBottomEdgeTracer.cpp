@@ -21,10 +21,10 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "NumericTraits.h"
-#include "PriorityQueue.h"
 #include "ToLineProjector.h"
 #include "LineBoundedByRect.h"
 #include "GridLineTraverser.h"
+#include "PerformanceTimer.h"
 #include "MatrixCalc.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/Scale.h"
@@ -52,32 +52,21 @@ namespace dewarping
 
 struct TopBottomEdgeTracer::GridNode {
 private:
-    static uint32_t const HEAP_IDX_BITS = 28;
     static uint32_t const PREV_NEIGHBOUR_BITS = 3;
     static uint32_t const PATH_CONTINUATION_BITS = 1;
 
-    static uint32_t const HEAP_IDX_SHIFT = 0;
-    static uint32_t const PREV_NEIGHBOUR_SHIFT = HEAP_IDX_SHIFT + HEAP_IDX_BITS;
+    static uint32_t const PREV_NEIGHBOUR_SHIFT = 0;
     static uint32_t const PATH_CONTINUATION_SHIFT = PREV_NEIGHBOUR_SHIFT + PREV_NEIGHBOUR_BITS;
 
-    static uint32_t const HEAP_IDX_MASK = ((uint32_t(1) << HEAP_IDX_BITS) - uint32_t(1)) << HEAP_IDX_SHIFT;
     static uint32_t const PREV_NEIGHBOUR_MASK = ((uint32_t(1) << PREV_NEIGHBOUR_BITS) - uint32_t(1)) << PREV_NEIGHBOUR_SHIFT;
     static uint32_t const PATH_CONTINUATION_MASK = ((uint32_t(1) << PATH_CONTINUATION_BITS) - uint32_t(1)) << PATH_CONTINUATION_SHIFT;
 public:
-    static uint32_t const INVALID_HEAP_IDX = HEAP_IDX_MASK >> HEAP_IDX_SHIFT;
+    float dirDeriv; // Directional derivative.
 
-    union {
-        float dirDeriv; // Directional derivative.
-        float xGrad; // x component of the gradient.
-    };
     union {
         float pathCost;
         float blurred;
-        float yGrad; // y component of the gradient.
     };
-    // Note: xGrad and yGrad are used to calculate the directional
-    // derivative, which then gets stored in dirDeriv.  Obviously,
-    // pathCost gets overwritten, which is not a problem in our case.
 
     uint32_t packedData;
 
@@ -90,7 +79,7 @@ public:
     {
         dirDeriv = 0;
         pathCost = -1;
-        packedData = INVALID_HEAP_IDX;
+        packedData = 0;
     }
 
     /**
@@ -99,18 +88,17 @@ public:
     void setupForInterior()
     {
         pathCost = NumericTraits<float>::max();
-        packedData = INVALID_HEAP_IDX;
+        packedData = 0;
     }
 
-    uint32_t heapIdx() const
-    {
-        return (packedData & HEAP_IDX_MASK) >> HEAP_IDX_SHIFT;
-    }
-
-    void setHeapIdx(uint32_t idx)
+    /**
+     * Makes the node unreachable by shortest paths, just like a padding node.
+     * Doesn't modify dirDeriv.
+     */
+    void setupForOutOfBand()
     {
-        assert(!(idx & ~(HEAP_IDX_MASK >> HEAP_IDX_SHIFT)));
-        packedData = idx | (packedData & ~HEAP_IDX_MASK);
+        pathCost = -1;
+        packedData = 0;
     }
 
     bool hasPathContinuation() const
@@ -134,36 +122,81 @@ public:
         assert(!(idx & ~(PREV_NEIGHBOUR_MASK >> PREV_NEIGHBOUR_SHIFT)));
         packedData = PATH_CONTINUATION_MASK | (idx << PREV_NEIGHBOUR_SHIFT) | (packedData & ~PREV_NEIGHBOUR_MASK);
     }
-
-    void setBothGradients(float grad)
-    {
-        xGrad = grad;
-        yGrad = grad;
-    }
 };
 
-class TopBottomEdgeTracer::PrioQueue :
-    public PriorityQueue<uint32_t, PrioQueue>
+/**
+ * A monotone bucket queue (Dial's algorithm) for path costs in [0, 1].
+ *
+ * Path costs are the maximum of (1 - |dirDeriv|) along a path, so they
+ * never decrease as we go and always fall into [0, 1].  Nodes are
+ * distributed into buckets by their quantized cost, while each bucket
+ * is a small heap keyed by the exact cost.  That keeps the extraction
+ * order exactly the same as with a global heap, while the expensive heap
+ * operations only involve the few nodes sharing a bucket.
+ *
+ * Instead of repositioning nodes whose cost got lowered, we push them
+ * again and skip the outdated entries on extraction.
+ */
+class TopBottomEdgeTracer::BucketQueue
 {
 public:
-    PrioQueue(Grid<GridNode>& grid) : m_pData(grid.data()) {}
+    struct Entry {
+        float cost;
+        uint32_t gridIdx;
+
+        Entry(float cost, uint32_t grid_idx) : cost(cost), gridIdx(grid_idx) {}
+
+        bool operator<(Entry const& other) const
+        {
+            // Reversed, to make std::push_heap() and friends build a min-heap.
+            return cost > other.cost;
+        }
+    };
 
-    bool higherThan(uint32_t lhs, uint32_t rhs) const
+    BucketQueue() : m_buckets(NUM_BUCKETS), m_curBucket(0), m_size(0) {}
+
+    bool empty() const
     {
-        return m_pData[lhs].pathCost < m_pData[rhs].pathCost;
+        return m_size == 0;
     }
 
-    void setIndex(uint32_t grid_idx, size_t heap_idx)
+    void push(uint32_t grid_idx, float cost)
     {
-        m_pData[grid_idx].setHeapIdx(static_cast<uint32_t>(heap_idx));
+        assert(cost >= 0.0f && cost <= 1.0f);
+        int const bucket_idx = std::min<int>(static_cast<int>(cost * NUM_BUCKETS), NUM_BUCKETS - 1);
+        assert(bucket_idx >= m_curBucket);
+
+        std::vector<Entry>& bucket = m_buckets[bucket_idx];
+        bucket.push_back(Entry(cost, grid_idx));
+        std::push_heap(bucket.begin(), bucket.end());
+        ++m_size;
     }
 
-    void reposition(GridNode* node)
+    /**
+     * Removes and returns the lowest cost entry.  The queue must not be empty.
+     */
+    Entry pop()
     {
-        PriorityQueue<uint32_t, PrioQueue>::reposition(node->heapIdx());
+        assert(!empty());
+
+        while (m_buckets[m_curBucket].empty()) {
+            ++m_curBucket;
+        }
+
+        std::vector<Entry>& bucket = m_buckets[m_curBucket];
+        std::pop_heap(bucket.begin(), bucket.end());
+        Entry const entry(bucket.back());
+        bucket.pop_back();
+        --m_size;
+
+        return entry;
     }
 private:
-    GridNode* const m_pData;
+    static int const NUM_BUCKETS = 1024;
+
+    std::vector<std::vector<Entry> > m_buckets;
+    int m_curBucket;
+    size_t m_size;
 };
 
 struct TopBottomEdgeTracer::Step {
@@ -241,21 +274,20 @@ TopBottomEdgeTracer::trace(
 
     Vec2f const avg_bounds_dir(calcAvgUnitVector(bounds));
     Grid<GridNode> grid(downscaled.width(), downscaled.height(), /*padding=*/1);
+    PerformanceTimer gradient_timer;
     calcDirectionalDerivative(grid, downscaled, avg_bounds_dir);
     if (dbg) {
+        gradient_timer.print("TopBottomEdgeTracer: gradient:");
         dbg->add(visualizeGradient(grid), "gradient");
     }
 
     status.throwIfCancelled();
 
-    PrioQueue queue(grid);
-
     // Shortest paths from bounds.first towards bounds.second.
-    prepareForShortestPathsFrom(queue, grid, bounds.first);
-    Vec2f const dir_1st_to_2nd(directionFromPointToLine(bounds.first.pointAt(0.5), bounds.second));
-    propagateShortestPaths(dir_1st_to_2nd, queue, grid);
-    std::vector<QPoint> const endpoints1(locateBestPathEndpoints(grid, bounds.second));
+    PerformanceTimer paths_timer;
+    std::vector<QPoint> const endpoints1(shortestPathEndpoints(grid, bounds.first, bounds.second));
     if (dbg) {
+        paths_timer.print("TopBottomEdgeTracer: shortest paths:");
         dbg->add(visualizePaths(downscaled, grid, bounds, endpoints1), "best_paths_ltr");
     }
 
@@ -293,6 +325,40 @@ TopBottomEdgeTracer::trace(
     }
 }
 
+std::vector<std::vector<QPoint> >
+TopBottomEdgeTracer::findBestPaths(
+    Grid<float> const& dir_deriv, QLineF const& from, QLineF const& to)
+{
+    int const width = dir_deriv.width();
+    int const height = dir_deriv.height();
+
+    Grid<GridNode> grid(width, height, /*padding=*/1);
+    for (int y = 0; y < height; ++y) {
+        float const* src_line = dir_deriv.data() + y * dir_deriv.stride();
+        GridNode* dst_line = grid.data() + y * grid.stride();
+        for (int x = 0; x < width; ++x) {
+            dst_line[x].dirDeriv = src_line[x];
+        }
+    }
+
+    std::vector<std::vector<QPoint> > paths;
+    for (QPoint const& endpoint : shortestPathEndpoints(grid, from, to)) {
+        paths.push_back(tracePathFromEndpoint(grid, endpoint));
+    }
+    return paths;
+}
+
+std::vector<QPoint>
+TopBottomEdgeTracer::shortestPathEndpoints(
+    Grid<GridNode>& grid, QLineF const& from, QLineF const& to)
+{
+    BucketQueue queue;
+    Vec2f const direction(directionFromPointToLine(from.pointAt(0.5), to));
+    prepareForShortestPathsFrom(queue, grid, from, to, direction);
+    propagateShortestPaths(direction, queue, grid);
+    return locateBestPathEndpoints(grid, to);
+}
+
 bool
 TopBottomEdgeTracer::intersectWithRect(
     std::pair<QLineF, QLineF>& bounds, QRectF const& rect)
@@ -322,136 +388,59 @@ TopBottomEdgeTracer::calcDirectionalDerivative(
     int const grid_stride = grid.stride();
     int const image_stride = image.stride();
 
-    uint8_t const* image_line = image.data();
-    GridNode* grid_line = grid.data();
-
     // This ensures that partial derivatives never go beyond the [-1, 1] range.
     float const scale = 1.0f / (255.0f * 8.0f);
 
-    // We are going to use both GridNode::gradient and GridNode::pathCost
-    // to calculate the gradient.
-
-    // Copy image to gradient.
-    for (int y = 0; y < height; ++y) {
+    // Both Sobel operators are computed in a single pass over the image.
+    // We keep a sliding window of three image lines converted to float,
+    // each padded by replicating its edge pixels.  Lines beyond the image
+    // are replicated from the edge lines as well.
+    int const line_stride = width + 2;
+    std::vector<float> lines(line_stride * 3);
+    float* above = &lines[1];
+    float* middle = above + line_stride;
+    float* below = middle + line_stride;
+
+    auto const load_line = [&](float* dst, int y) {
+        uint8_t const* src = image.data() + image_stride * qBound(0, y, height - 1);
         for (int x = 0; x < width; ++x) {
-            grid_line[x].setBothGradients(scale * image_line[x]);
+            dst[x] = scale * src[x];
         }
-        image_line += image_stride;
-        grid_line += grid_stride;
-    }
-
-    // Write border corners.
-    grid_line = grid.paddedData();
-    grid_line[0].setBothGradients(grid_line[grid_stride + 1].xGrad);
-    grid_line[grid_stride - 1].setBothGradients(grid_line[grid_stride * 2 - 2].xGrad);
-    grid_line += grid_stride * (height + 1);
-    grid_line[0].setBothGradients(grid_line[1 - grid_stride].xGrad);
-    grid_line[grid_stride - 1].setBothGradients(grid_line[-2].xGrad);
-
-    // Top border line.
-    grid_line = grid.paddedData() + 1;
-    for (int x = 0; x < width; ++x) {
-        grid_line[0].setBothGradients(grid_line[grid_stride].xGrad);
-        ++grid_line;
-    }
+        dst[-1] = dst[0];
+        dst[width] = dst[width - 1];
+    };
 
-    // Bottom border line.
-    grid_line = grid.paddedData() + grid_stride * (height + 1) + 1;
-    for (int x = 0; x < width; ++x) {
-        grid_line[0].setBothGradients(grid_line[-grid_stride].xGrad);
-        ++grid_line;
-    }
+    load_line(above, -1);
+    load_line(middle, 0);
+    load_line(below, 1);
 
-    // Left and right border lines.
-    grid_line = grid.paddedData() + grid_stride;
+    GridNode* grid_line = grid.data();
     for (int y = 0; y < height; ++y) {
-        grid_line[0].setBothGradients(grid_line[1].xGrad);
-        grid_line[grid_stride - 1].setBothGradients(grid_line[grid_stride - 2].xGrad);
-        grid_line += grid_stride;
-    }
-
-    horizontalSobelInPlace(grid);
-    verticalSobelInPlace(grid);
+        // Vertically smoothed value of column x - 1.
+        float left_vsum = above[-1] + middle[-1] + middle[-1] + below[-1];
+        float cur_vsum = above[0] + middle[0] + middle[0] + below[0];
 
-    // From horizontal and vertical gradients, calculate the directional one.
-    grid_line = grid.data();
-    for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
-            Vec2f const grad_vec(grid_line[x].xGrad, grid_line[x].yGrad);
-            grid_line[x].dirDeriv = grad_vec.dot(direction);
-            assert(fabs(grid_line[x].dirDeriv) <= 1.0);
-        }
-
-        grid_line += grid_stride;
-    }
-}
-
-void
-TopBottomEdgeTracer::horizontalSobelInPlace(Grid<GridNode>& grid)
-{
-    assert(grid.padding() == 1);
+            float const right_vsum = above[x + 1] + middle[x + 1] + middle[x + 1] + below[x + 1];
+            float const x_grad = right_vsum - left_vsum;
+            left_vsum = cur_vsum;
+            cur_vsum = right_vsum;
 
-    int const width = grid.width();
-    int const height = grid.height();
-    int const grid_stride = grid.stride();
+            float const above_hsum = above[x - 1] + above[x] + above[x] + above[x + 1];
+            float const below_hsum = below[x - 1] + below[x] + below[x] + below[x + 1];
+            float const y_grad = below_hsum - above_hsum;
 
-    // Do a vertical pass.
-    for (int x = -1; x < width + 1; ++x) {
-        GridNode* p_grid = grid.data() + x;
-        float prev = p_grid[-grid_stride].xGrad;
-        for (int y = 0; y < height; ++y) {
-            float const cur = p_grid->xGrad;
-            p_grid->xGrad = prev + cur + cur + p_grid[grid_stride].xGrad;
-            prev = cur;
-            p_grid += grid_stride;
-        }
-    }
-
-    // Do a horizontal pass and write results.
-    GridNode* grid_line = grid.data();
-    for (int y = 0; y < height; ++y) {
-        float prev = grid_line[-1].xGrad;
-        for (int x = 0; x < width; ++x) {
-            float cur = grid_line[x].xGrad;
-            grid_line[x].xGrad = grid_line[x + 1].xGrad - prev;
-            prev = cur;
+            Vec2f const grad_vec(x_grad, y_grad);
+            grid_line[x].dirDeriv = grad_vec.dot(direction);
+            assert(fabs(grid_line[x].dirDeriv) <= 1.0);
         }
-        grid_line += grid_stride;
-    }
-}
 
-void
-TopBottomEdgeTracer::verticalSobelInPlace(Grid<GridNode>& grid)
-{
-    assert(grid.padding() == 1);
+        std::swap(above, middle);
+        std::swap(middle, below);
+        load_line(below, y + 2);
 
-    int const width = grid.width();
-    int const height = grid.height();
-    int const grid_stride = grid.stride();
-
-    // Do a horizontal pass.
-    GridNode* grid_line = grid.paddedData() + 1;
-    for (int y = 0; y < height + 2; ++y) {
-        float prev = grid_line[-1].yGrad;
-        for (int x = 0; x < width; ++x) {
-            float cur = grid_line[x].yGrad;
-            grid_line[x].yGrad = prev + cur + cur + grid_line[x + 1].yGrad;
-            prev = cur;
-        }
         grid_line += grid_stride;
     }
-
-    // Do a vertical pass and write results.
-    for (int x = 0; x < width; ++x) {
-        GridNode* p_grid = grid.data() + x;
-        float prev = p_grid[-grid_stride].yGrad;
-        for (int y = 0; y < height; ++y) {
-            float const cur = p_grid->yGrad;
-            p_grid->yGrad = p_grid[grid_stride].yGrad - prev;
-            prev = cur;
-            p_grid += grid_stride;
-        }
-    }
 }
 
 Vec2f
@@ -482,7 +471,8 @@ TopBottomEdgeTracer::directionFromPointToLine(QPointF const& pt, QLineF const& l
 
 void
 TopBottomEdgeTracer::prepareForShortestPathsFrom(
-    PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from)
+    BucketQueue& queue, Grid<GridNode>& grid, QLineF const& from,
+    QLineF const& to, Vec2f const& direction)
 {
     GridNode padding_node;
     padding_node.setupForPadding();
@@ -493,13 +483,41 @@ TopBottomEdgeTracer::prepareForShortestPathsFrom(
     int const stride = grid.stride();
     GridNode* const data = grid.data();
 
+    // Every step of a path increases its projection onto the direction
+    // vector (see initNeighbours()).  Therefore nodes projecting before
+    // the "from" line are unreachable, while nodes projecting past the "to"
+    // line can't be on a path ending there.  We exclude such nodes, leaving
+    // a band between the two lines.  The extra pixel on each side guards
+    // against rounding errors.
+    float min_proj = NumericTraits<float>::max();
+    GridLineTraverser from_traverser(from);
+    while (from_traverser.hasNext()) {
+        QPoint const pt(from_traverser.next());
+        min_proj = std::min<float>(min_proj, pt.x() * direction[0] + pt.y() * direction[1]);
+    }
+
+    float max_proj = -NumericTraits<float>::max();
+    GridLineTraverser to_traverser(to);
+    while (to_traverser.hasNext()) {
+        QPoint const pt(to_traverser.next());
+        max_proj = std::max<float>(max_proj, pt.x() * direction[0] + pt.y() * direction[1]);
+    }
+
+    min_proj -= 1.0f;
+    max_proj += 1.0f;
+
     GridNode* line = grid.data();
     for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
             GridNode* node = line + x;
-            node->setupForInterior();
-            // This doesn't modify dirDeriv, which is why
+            float const proj = x * direction[0] + y * direction[1];
+            // These don't modify dirDeriv, which is why
             // we can't use grid.initInterior().
+            if (proj < min_proj || proj > max_proj) {
+                node->setupForOutOfBand();
+            } else {
+                node->setupForInterior();
+            }
         }
         line += stride;
     }
@@ -512,14 +530,16 @@ TopBottomEdgeTracer::prepareForShortestPathsFrom(
         assert(pt.x() >= 0 && pt.y() >= 0 && pt.x() < width && pt.y() < height);
 
         int const offset = pt.y() * stride + pt.x();
-        data[offset].pathCost = 0;
-        queue.push(offset);
+        if (data[offset].pathCost != 0) {
+            data[offset].pathCost = 0;
+            queue.push(offset, 0);
+        }
     }
 }
 
 void
 TopBottomEdgeTracer::propagateShortestPaths(
-    Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid)
+    Vec2f const& direction, BucketQueue& queue, Grid<GridNode>& grid)
 {
     GridNode* const data = grid.data();
 
@@ -528,26 +548,33 @@ TopBottomEdgeTracer::propagateShortestPaths(
     int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, grid.stride(), direction);
 
     while (!queue.empty()) {
-        int const grid_idx = queue.front();
+        BucketQueue::Entry const entry(queue.pop());
+        int const grid_idx = entry.gridIdx;
         GridNode* node = data + grid_idx;
+        if (entry.cost != node->pathCost) {
+            // An outdated entry, superseded by a cheaper one.
+            continue;
+        }
         assert(node->pathCost >= 0);
-        queue.pop();
-        node->setHeapIdx(GridNode::INVALID_HEAP_IDX);
+
+        assert(fabs(node->dirDeriv) <= 1.0);
+        float const new_cost = std::max<float>(node->pathCost, 1.0f - fabs(node->dirDeriv));
 
         for (int i = 0; i < num_neighbours; ++i) {
             int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
             GridNode* nbh_node = data + nbh_grid_idx;
 
-            assert(fabs(node->dirDeriv) <= 1.0);
-            float const new_cost = std::max<float>(node->pathCost, 1.0f - fabs(node->dirDeriv));
             if (new_cost < nbh_node->pathCost) {
                 nbh_node->pathCost = new_cost;
                 nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
-                if (nbh_node->heapIdx() == GridNode::INVALID_HEAP_IDX) {
-                    queue.push(nbh_grid_idx);
-                } else {
-                    queue.reposition(nbh_node);
-                }
+                queue.push(nbh_grid_idx, new_cost);
+            } else if (new_cost == nbh_node->pathCost && nbh_node->hasPathContinuation()
+                       && uint32_t(prev_nbh_indexes[i]) < nbh_node->prevNeighbourIdx()) {
+                // Bottleneck costs tie a lot.  Among equally good predecessors
+                // we take the one with the lowest neighbour index, rather than
+                // the first one extracted, so that paths don't depend on the
+                // order in which the queue hands out equal cost nodes.
+                nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
             }
         }
     }
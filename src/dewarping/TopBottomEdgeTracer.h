@@ -49,9 +49,20 @@ public:
     static void trace(
         imageproc::GrayImage const& image, std::pair<QLineF, QLineF> bounds,
         DistortionModelBuilder& output, TaskStatus const& status, DebugImages* dbg = 0);
+
+    /**
+     * \brief The shortest path stage of trace(), exposed for testing.
+     *
+     * Finds the best paths from \p from to \p to over a grid of
+     * directional derivatives.  Both lines must be within the grid.
+     * Each path is returned as a list of grid points, starting from
+     * its endpoint on \p to.
+     */
+    static std::vector<std::vector<QPoint> > findBestPaths(
+        Grid<float> const& dir_deriv, QLineF const& from, QLineF const& to);
 private:
     struct GridNode;
-    class PrioQueue;
+    class BucketQueue;
     struct Step;
 
     static bool intersectWithRect(std::pair<QLineF, QLineF>& bounds, QRectF const& rect);
@@ -61,17 +72,18 @@ private:
     static void calcDirectionalDerivative(
         Grid<GridNode>& gradient, imageproc::GrayImage const& image, Vec2f const& direction);
 
-    static void horizontalSobelInPlace(Grid<GridNode>& grid);
-
-    static void verticalSobelInPlace(Grid<GridNode>& grid);
-
     static Vec2f calcAvgUnitVector(std::pair<QLineF, QLineF> const& bounds);
 
     static Vec2f directionFromPointToLine(QPointF const& pt, QLineF const& line);
 
-    static void prepareForShortestPathsFrom(PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from);
+    static std::vector<QPoint> shortestPathEndpoints(
+        Grid<GridNode>& grid, QLineF const& from, QLineF const& to);
+
+    static void prepareForShortestPathsFrom(
+        BucketQueue& queue, Grid<GridNode>& grid, QLineF const& from,
+        QLineF const& to, Vec2f const& direction);
 
-    static void propagateShortestPaths(Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid);
+    static void propagateShortestPaths(Vec2f const& direction, BucketQueue& queue, Grid<GridNode>& grid);
 
     static int initNeighbours(int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
 
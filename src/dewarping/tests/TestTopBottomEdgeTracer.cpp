@@ -0,0 +1,468 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TopBottomEdgeTracer.h"
+#include "Grid.h"
+#include "VecNT.h"
+#include "PriorityQueue.h"
+#include "ToLineProjector.h"
+#include "GridLineTraverser.h"
+#include <QPoint>
+#include <QLineF>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+#include <math.h>
+#include <stddef.h>
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#endif
+
+namespace dewarping
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(TopBottomEdgeTracerTestSuite);
+
+namespace
+{
+
+/**
+ * The shortest path search TopBottomEdgeTracer used to do, copied from
+ * the version before the bucket queue: a global binary heap with
+ * repositioning over a padded grid.  A node only changes its predecessor
+ * on a strict improvement, so where several predecessors give the same
+ * cost, the one to win is whichever was extracted first.  The tracer
+ * breaks such ties deterministically instead, so only costs are expected
+ * to match in general, and paths only where ties can't occur.
+ */
+class ReferencePathFinder
+{
+public:
+    ReferencePathFinder(Grid<float> const& dir_deriv, QLineF const& from, QLineF const& to);
+
+    float costAt(QPoint const& pt) const;
+
+    std::vector<QPoint> pathFrom(QPoint const& endpoint) const;
+private:
+    struct GridNode {
+    private:
+        static uint32_t const HEAP_IDX_BITS = 28;
+        static uint32_t const PREV_NEIGHBOUR_BITS = 3;
+        static uint32_t const PATH_CONTINUATION_BITS = 1;
+
+        static uint32_t const HEAP_IDX_SHIFT = 0;
+        static uint32_t const PREV_NEIGHBOUR_SHIFT = HEAP_IDX_SHIFT + HEAP_IDX_BITS;
+        static uint32_t const PATH_CONTINUATION_SHIFT = PREV_NEIGHBOUR_SHIFT + PREV_NEIGHBOUR_BITS;
+
+        static uint32_t const HEAP_IDX_MASK = ((uint32_t(1) << HEAP_IDX_BITS) - uint32_t(1)) << HEAP_IDX_SHIFT;
+        static uint32_t const PREV_NEIGHBOUR_MASK = ((uint32_t(1) << PREV_NEIGHBOUR_BITS) - uint32_t(1)) << PREV_NEIGHBOUR_SHIFT;
+        static uint32_t const PATH_CONTINUATION_MASK = ((uint32_t(1) << PATH_CONTINUATION_BITS) - uint32_t(1)) << PATH_CONTINUATION_SHIFT;
+    public:
+        static uint32_t const INVALID_HEAP_IDX = HEAP_IDX_MASK >> HEAP_IDX_SHIFT;
+
+        float dirDeriv;
+        float pathCost;
+        uint32_t packedData;
+
+        void setupForPadding()
+        {
+            dirDeriv = 0;
+            pathCost = -1;
+            packedData = INVALID_HEAP_IDX;
+        }
+
+        void setupForInterior()
+        {
+            pathCost = std::numeric_limits<float>::max();
+            packedData = INVALID_HEAP_IDX;
+        }
+
+        uint32_t heapIdx() const
+        {
+            return (packedData & HEAP_IDX_MASK) >> HEAP_IDX_SHIFT;
+        }
+
+        void setHeapIdx(uint32_t idx)
+        {
+            packedData = idx | (packedData & ~HEAP_IDX_MASK);
+        }
+
+        bool hasPathContinuation() const
+        {
+            return packedData & PATH_CONTINUATION_MASK;
+        }
+
+        uint32_t prevNeighbourIdx() const
+        {
+            return (packedData & PREV_NEIGHBOUR_MASK) >> PREV_NEIGHBOUR_SHIFT;
+        }
+
+        void setPrevNeighbourIdx(uint32_t idx)
+        {
+            packedData = PATH_CONTINUATION_MASK | (idx << PREV_NEIGHBOUR_SHIFT) | (packedData & ~PREV_NEIGHBOUR_MASK);
+        }
+    };
+
+    class PrioQueue : public PriorityQueue<uint32_t, PrioQueue>
+    {
+    public:
+        PrioQueue(Grid<GridNode>& grid) : m_pData(grid.data()) {}
+
+        bool higherThan(uint32_t lhs, uint32_t rhs) const
+        {
+            return m_pData[lhs].pathCost < m_pData[rhs].pathCost;
+        }
+
+        void setIndex(uint32_t grid_idx, size_t heap_idx)
+        {
+            m_pData[grid_idx].setHeapIdx(static_cast<uint32_t>(heap_idx));
+        }
+
+        void reposition(GridNode* node)
+        {
+            PriorityQueue<uint32_t, PrioQueue>::reposition(node->heapIdx());
+        }
+    private:
+        GridNode* const m_pData;
+    };
+
+    void prepareForShortestPathsFrom(PrioQueue& queue, QLineF const& from);
+
+    void propagateShortestPaths(Vec2f const& direction, PrioQueue& queue);
+
+    static int initNeighbours(
+        int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
+
+    Grid<GridNode> m_grid;
+};
+
+ReferencePathFinder::ReferencePathFinder(
+    Grid<float> const& dir_deriv, QLineF const& from, QLineF const& to)
+    :   m_grid(dir_deriv.width(), dir_deriv.height(), /*padding=*/1)
+{
+    for (int y = 0; y < m_grid.height(); ++y) {
+        float const* src_line = dir_deriv.data() + y * dir_deriv.stride();
+        GridNode* dst_line = m_grid.data() + y * m_grid.stride();
+        for (int x = 0; x < m_grid.width(); ++x) {
+            dst_line[x].dirDeriv = src_line[x];
+        }
+    }
+
+    Vec2f direction(ToLineProjector(to).projectionVector(from.pointAt(0.5)));
+    float const sqlen = direction.squaredNorm();
+    if (sqlen > 1e-5) {
+        direction /= sqrt(sqlen);
+    }
+
+    PrioQueue queue(m_grid);
+    prepareForShortestPathsFrom(queue, from);
+    propagateShortestPaths(direction, queue);
+}
+
+float
+ReferencePathFinder::costAt(QPoint const& pt) const
+{
+    return m_grid.data()[pt.y() * m_grid.stride() + pt.x()].pathCost;
+}
+
+std::vector<QPoint>
+ReferencePathFinder::pathFrom(QPoint const& endpoint) const
+{
+    static int const dx[8] = {
+        -1, 0, 1,
+            -1,    1,
+            -1, 0, 1
+        };
+    static int const dy[8] = {
+        -1, -1, -1,
+            0,      0,
+            1,  1,  1
+        };
+
+    int const stride = m_grid.stride();
+    int const grid_offsets[8] = {
+        -stride - 1, -stride, -stride + 1,
+            - 1,                  + 1,
+            +stride - 1, +stride, +stride + 1
+        };
+
+    GridNode const* const data = m_grid.data();
+    std::vector<QPoint> path;
+
+    QPoint pt(endpoint);
+    int grid_offset = pt.x() + pt.y() * stride;
+    for (;;) {
+        path.push_back(pt);
+
+        GridNode const* node = data + grid_offset;
+        if (!node->hasPathContinuation()) {
+            break;
+        }
+
+        int const nbh_idx = node->prevNeighbourIdx();
+        grid_offset += grid_offsets[nbh_idx];
+        pt += QPoint(dx[nbh_idx], dy[nbh_idx]);
+    }
+
+    return path;
+}
+
+void
+ReferencePathFinder::prepareForShortestPathsFrom(PrioQueue& queue, QLineF const& from)
+{
+    GridNode padding_node;
+    padding_node.setupForPadding();
+    m_grid.initPadding(padding_node);
+
+    int const width = m_grid.width();
+    int const height = m_grid.height();
+    int const stride = m_grid.stride();
+    GridNode* const data = m_grid.data();
+
+    GridNode* line = m_grid.data();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            GridNode* node = line + x;
+            node->setupForInterior();
+        }
+        line += stride;
+    }
+
+    GridLineTraverser traverser(from);
+    while (traverser.hasNext()) {
+        QPoint const pt(traverser.next());
+        int const offset = pt.y() * stride + pt.x();
+        data[offset].pathCost = 0;
+        queue.push(offset);
+    }
+}
+
+void
+ReferencePathFinder::propagateShortestPaths(Vec2f const& direction, PrioQueue& queue)
+{
+    GridNode* const data = m_grid.data();
+
+    int next_nbh_offsets[8];
+    int prev_nbh_indexes[8];
+    int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, m_grid.stride(), direction);
+
+    while (!queue.empty()) {
+        int const grid_idx = queue.front();
+        GridNode* node = data + grid_idx;
+        queue.pop();
+        node->setHeapIdx(GridNode::INVALID_HEAP_IDX);
+
+        for (int i = 0; i < num_neighbours; ++i) {
+            int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
+            GridNode* nbh_node = data + nbh_grid_idx;
+
+            float const new_cost = std::max<float>(node->pathCost, 1.0f - fabs(node->dirDeriv));
+            if (new_cost < nbh_node->pathCost) {
+                nbh_node->pathCost = new_cost;
+                nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
+                if (nbh_node->heapIdx() == GridNode::INVALID_HEAP_IDX) {
+                    queue.push(nbh_grid_idx);
+                } else {
+                    queue.reposition(nbh_node);
+                }
+            }
+        }
+    }
+}
+
+int
+ReferencePathFinder::initNeighbours(
+    int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction)
+{
+    int const candidate_offsets[] = {
+        -stride - 1, -stride, -stride + 1,
+            -1,                    1,
+            stride - 1,  stride,  stride + 1
+        };
+
+    float const candidate_vectors[8][2] = {
+        { -1.0f, -1.0f }, { 0.0f, -1.0f }, { 1.0f, -1.0f },
+        { -1.0f,  0.0f },                  { 1.0f,  0.0f },
+        { -1.0f,  1.0f }, { 0.0f,  1.0f }, { 1.0f,  1.0f }
+    };
+
+    static int const opposite_nbh_map[] = {
+        7, 6, 5,
+        4,    3,
+        2, 1, 0
+    };
+
+    int out_idx = 0;
+    for (int i = 0; i < 8; ++i) {
+        Vec2f const vec(candidate_vectors[i][0], candidate_vectors[i][1]);
+        if (vec.dot(direction) > 0) {
+            next_nbh_offsets[out_idx] = candidate_offsets[i];
+            prev_nbh_indexes[out_idx] = opposite_nbh_map[i];
+            ++out_idx;
+        }
+    }
+    return out_idx;
+}
+
+/**
+ * Fills the grid with values of random sign and a magnitude of k / \p num_levels,
+ * with k being a random number in [1, num_levels].  Few levels mean lots
+ * of equal cost paths, while the lack of zeros keeps all path costs
+ * below the threshold for being reported.
+ */
+Grid<float> randomDirDerivGrid(int width, int height, int num_levels)
+{
+    Grid<float> grid(width, height, /*padding=*/0);
+    for (int y = 0; y < height; ++y) {
+        float* line = grid.data() + y * grid.stride();
+        for (int x = 0; x < width; ++x) {
+            float const magnitude = float(1 + rand() % num_levels) / num_levels;
+            line[x] = (rand() & 1) ? magnitude : -magnitude;
+        }
+    }
+    return grid;
+}
+
+/**
+ * Fills the grid so that 1 - |value| strictly grows from one row to the
+ * next, with a random order within a row.  When paths go downwards,
+ * every node's cost is then that of its most expensive predecessor,
+ * and no two predecessors ever give the same cost.
+ */
+Grid<float> tieFreeDirDerivGrid(int width, int height)
+{
+    std::vector<int> order(width);
+    for (int x = 0; x < width; ++x) {
+        order[x] = x;
+    }
+
+    Grid<float> grid(width, height, /*padding=*/0);
+    for (int y = 0; y < height; ++y) {
+        for (int x = width - 1; x > 0; --x) {
+            std::swap(order[x], order[rand() % (x + 1)]);
+        }
+        float* line = grid.data() + y * grid.stride();
+        for (int x = 0; x < width; ++x) {
+            float const cost = 0.9f * float(y * width + order[x] + 1) / float(width * height + 1);
+            line[x] = (rand() & 1) ? 1.0f - cost : cost - 1.0f;
+        }
+    }
+    return grid;
+}
+
+/**
+ * The cost of a path, as defined by the shortest path search:
+ * the largest 1 - |dir_deriv| among all its nodes but the endpoint.
+ */
+float pathCost(Grid<float> const& grid, std::vector<QPoint> const& path)
+{
+    float cost = 0;
+    for (size_t i = 1; i < path.size(); ++i) {
+        float const deriv = grid.data()[path[i].y() * grid.stride() + path[i].x()];
+        cost = std::max<float>(cost, 1.0f - fabs(deriv));
+    }
+    return cost;
+}
+
+bool isConnected(std::vector<QPoint> const& path)
+{
+    for (size_t i = 1; i < path.size(); ++i) {
+        QPoint const delta(path[i] - path[i - 1]);
+        if (delta.isNull() || abs(delta.x()) > 1 || abs(delta.y()) > 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks that every path the tracer reports is connected, starts at
+ * the \p from line and costs exactly as much as the best path to its
+ * endpoint found by the reference.  If \p same_paths is set, the paths
+ * themselves also have to match.
+ */
+void checkAgainstReference(
+    Grid<float> const& grid, QLineF const& from, QLineF const& to, bool same_paths)
+{
+    std::vector<std::vector<QPoint> > const paths(
+        TopBottomEdgeTracer::findBestPaths(grid, from, to)
+    );
+    ReferencePathFinder const reference(grid, from, to);
+
+    BOOST_REQUIRE(!paths.empty());
+    for (std::vector<QPoint> const& path : paths) {
+        BOOST_REQUIRE(!path.empty());
+        BOOST_REQUIRE(isConnected(path));
+        BOOST_REQUIRE_EQUAL(reference.costAt(path.back()), 0.0f);
+        BOOST_REQUIRE_EQUAL(pathCost(grid, path), reference.costAt(path.front()));
+        if (same_paths) {
+            std::vector<QPoint> const expected(reference.pathFrom(path.front()));
+            BOOST_REQUIRE(path == expected);
+        }
+    }
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_costs_match_global_heap_on_ties)
+{
+    for (int i = 0; i < 20; ++i) {
+        Grid<float> const grid(randomDirDerivGrid(150, 80, 3));
+        checkAgainstReference(grid, QLineF(5, 5, 140, 10), QLineF(5, 70, 140, 75), false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_costs_match_global_heap_on_slanted_bounds)
+{
+    for (int i = 0; i < 20; ++i) {
+        Grid<float> const grid(randomDirDerivGrid(120, 120, 17));
+        checkAgainstReference(grid, QLineF(10, 30, 110, 2), QLineF(10, 115, 110, 80), false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_paths_match_global_heap_without_ties)
+{
+    for (int i = 0; i < 20; ++i) {
+        Grid<float> const grid(tieFreeDirDerivGrid(150, 80));
+        checkAgainstReference(grid, QLineF(0, 3, 149, 3), QLineF(0, 76, 149, 76), true);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_path_along_edge)
+{
+    // A single horizontal edge across an otherwise flat grid.
+    Grid<float> grid(200, 60, /*padding=*/0);
+    for (int y = 0; y < grid.height(); ++y) {
+        float* line = grid.data() + y * grid.stride();
+        for (int x = 0; x < grid.width(); ++x) {
+            line[x] = (y == 30) ? 1.0f : 0.0f;
+        }
+    }
+
+    checkAgainstReference(grid, QLineF(3, 0, 3, 59), QLineF(196, 0, 196, 59), true);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace dewarping
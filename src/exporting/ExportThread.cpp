@@ -21,12 +21,14 @@
 #include "ImageLoader.h"
 #include "ImageSplitOps.h"
 #include "TiffWriter.h"
+#include "CommandLine.h"
 #include "settings/globalstaticsettings.h"
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 #include <QDir>
 #include <QMetaType>
+#include <memory>
 
 
 
@@ -37,6 +39,7 @@ const int dummy = qRegisterMetaType<PageId>("PageId");
 ExportThread::ExportThread(const ExportSettings& settings, const QVector<ExportRec>& outpaths,
                            const QString& export_dir, QObject *parent): QThread(parent),
     m_settings(settings),
+    m_ptrContext(ProcessingContext::create(CommandLine::get())),
     m_outpaths_vector(outpaths),
     m_export_dir(export_dir),
     m_interrupted(false)
@@ -168,32 +171,38 @@ ExportThread::run()
 
             }
 
-            int page_no = 0;
+            QImage const& whole_img = m_settings.page_gen_tweaks.testFlag(PageGenTweak::IgnoreOutputProcessingStage) ? m_orig_fore_subscan : out_img;
+            if (!(img_background && (!only_bw || m_settings.generate_blank_back_subscans))) {
+                img_background.reset(nullptr);
+            }
 
-            if (m_settings.mode.testFlag(ExportMode::WholeImage)) {
-                TiffWriter::writeImage(out_file_path_no_split,
-                                       m_settings.page_gen_tweaks.testFlag(PageGenTweak::IgnoreOutputProcessingStage) ? m_orig_fore_subscan : out_img,
-                                       m_settings.export_to_multipage, page_no);
-                if (m_settings.export_to_multipage) {
-                    page_no++;
+            // All pages of a multipage file go through a single session,
+            // rather than reopening the file for every page.
+            std::unique_ptr<MultipageTiffWriter> multipage_writer;
+            if (m_settings.export_to_multipage) {
+                multipage_writer.reset(new MultipageTiffWriter(m_ptrContext, out_file_path_no_split));
+            }
+
+            auto write_image = [this, &multipage_writer](QString const& file_path, QImage const& image) {
+                if (multipage_writer) {
+                    multipage_writer->writePage(image);
+                } else {
+                    TiffWriter::writeImage(*m_ptrContext, file_path, image);
                 }
+            };
+
+            if (m_settings.mode.testFlag(ExportMode::WholeImage)) {
+                write_image(out_file_path_no_split, whole_img);
             }
 
             if (img_foreground) {
                 QString out_filepath_foreground = text_dir + QDir::separator() + name + ".tif";
-                TiffWriter::writeImage(m_settings.export_to_multipage ? out_file_path_no_split : out_filepath_foreground,
-                                       *img_foreground,
-                                       m_settings.export_to_multipage,
-                                       page_no++
-                                       );
+                write_image(out_filepath_foreground, *img_foreground);
             }
-            if (img_background && (!only_bw || m_settings.generate_blank_back_subscans)) {
+            if (img_background) {
                 QString out_filepath_background = m_settings.use_sep_suffix_for_pics ? ".sep.tif" : ".tif";
                 out_filepath_background = pic_dir + QDir::separator() + name + out_filepath_background;
-                TiffWriter::writeImage(m_settings.export_to_multipage ? out_file_path_no_split : out_filepath_background,
-                                       *img_background,
-                                       m_settings.export_to_multipage,
-                                       page_no++);
+                write_image(out_filepath_background, *img_background);
             }
 
             if (m_settings.mode.testFlag(ExportMode::AutoMask)) {
@@ -202,21 +211,16 @@ ExportThread::run()
                 QImage automask_img = (QFile::exists(filepath_automask)) ? ImageLoader::load(filepath_automask) :
                                                                            ImageSplitOps::GenerateBlankImage(out_img, out_img.format(), 0x00000000);
                 QString out_filepath_mask = mask_dir + QDir::separator() + name + ".auto.tif";
-                TiffWriter::writeImage(m_settings.export_to_multipage ? out_file_path_no_split : out_filepath_mask,
-                                       automask_img,
-                                       m_settings.export_to_multipage,
-                                       page_no);
-                if (m_settings.export_to_multipage) {
-                    page_no++;
-                }
+                write_image(out_filepath_mask, automask_img);
             }
 
             if (img_mask) {
                 QString out_filepath_mask = mask_dir + QDir::separator() + name + ".tif";
-                TiffWriter::writeImage(m_settings.export_to_multipage ? out_file_path_no_split : out_filepath_mask,
-                                       *img_mask,
-                                       m_settings.export_to_multipage,
-                                       page_no++);
+                write_image(out_filepath_mask, *img_mask);
+            }
+
+            if (multipage_writer) {
+                multipage_writer->finish();
             }
 
             emit imageProcessed();
@@ -26,6 +26,7 @@
 #include <QImage>
 #include "PageId.h"
 #include "ExportSettings.h"
+#include "ProcessingContext.h"
 
 namespace exporting {
 
@@ -59,6 +60,7 @@ private:
     bool isCancelRequested();
 private:
     ExportSettings m_settings;
+    ProcessingContextPtr m_ptrContext;
     QVector<ExportRec> m_outpaths_vector;
     QString m_export_dir;
     QMutex m_paused;
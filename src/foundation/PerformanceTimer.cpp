@@ -22,8 +22,9 @@
 void
 PerformanceTimer::print(char const* prefix)
 {
-    clock_t const now = clock();
-    double const sec = double(now - m_start) / CLOCKS_PER_SEC;
+    double const sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - m_start
+                       ).count();
     if (sec > 10.0) {
         qDebug() << prefix << (long)sec << " sec";
     } else if (sec > 0.01) {
@@ -19,16 +19,22 @@
 #ifndef PERFORMANCETIMER_H_
 #define PERFORMANCETIMER_H_
 
-#include <time.h>
-
+#include <chrono>
+
+/**
+ * \brief Measures wall clock time.
+ *
+ * Wall clock rather than CPU time, as the latter adds up
+ * the time spent by all threads of a parallel section.
+ */
 class PerformanceTimer
 {
 public:
-    PerformanceTimer() : m_start(clock()) {}
+    PerformanceTimer() : m_start(std::chrono::steady_clock::now()) {}
 
     void print(char const* prefix = "");
 private:
-    clock_t const m_start;
+    std::chrono::steady_clock::time_point const m_start;
 };
 
 #endif
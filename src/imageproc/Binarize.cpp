@@ -52,6 +52,38 @@ BinaryImage binarizeMokji(
     return BinaryImage(src, threshold);
 }
 
+BinarizationStats::BinarizationStats(QImage const& src)
+    :   m_gray(toGrayscale(src)),
+        m_histogram(m_gray),
+        m_integralImage(m_gray.size()),
+        m_integralSqImage(m_gray.size()),
+        m_minGrayLevel(255)
+{
+    int const w = m_gray.width();
+    int const h = m_gray.height();
+
+    uint8_t const* gray_line = m_gray.bits();
+    int const gray_bpl = m_gray.bytesPerLine();
+
+    for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
+        m_integralImage.beginRow();
+        m_integralSqImage.beginRow();
+        for (int x = 0; x < w; ++x) {
+            uint32_t const pixel = gray_line[x];
+            m_integralImage.push(pixel);
+            m_integralSqImage.push(pixel * pixel);
+            m_minGrayLevel = std::min(m_minGrayLevel, pixel);
+        }
+    }
+}
+
+BinaryImage binarizeOtsu(BinarizationStats const& stats)
+{
+    return BinaryImage(
+        stats.gray(), BinaryThreshold::otsuThreshold(stats.histogram())
+    );
+}
+
 BinaryImage binarizeSauvola(QImage const& src, QSize const window_size)
 {
     if (window_size.isEmpty()) {
@@ -62,26 +94,29 @@ BinaryImage binarizeSauvola(QImage const& src, QSize const window_size)
         return BinaryImage();
     }
 
-    QImage const gray(toGrayscale(src));
+    return binarizeSauvola(BinarizationStats(src), window_size);
+}
+
+BinaryImage binarizeSauvola(BinarizationStats const& stats, QSize const window_size)
+{
+    if (window_size.isEmpty()) {
+        throw std::invalid_argument("binarizeSauvola: invalid window_size");
+    }
+
+    QImage const& gray = stats.gray();
+    if (gray.isNull()) {
+        return BinaryImage();
+    }
+
     int const w = gray.width();
     int const h = gray.height();
 
-    IntegralImage<uint32_t> integral_image(w, h);
-    IntegralImage<uint64_t> integral_sqimage(w, h);
+    IntegralImage<uint32_t> const& integral_image = stats.integralImage();
+    IntegralImage<uint64_t> const& integral_sqimage = stats.integralSqImage();
 
     uint8_t const* gray_line = gray.bits();
     int const gray_bpl = gray.bytesPerLine();
 
-    for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
-        integral_image.beginRow();
-        integral_sqimage.beginRow();
-        for (int x = 0; x < w; ++x) {
-            uint32_t const pixel = gray_line[x];
-            integral_image.push(pixel);
-            integral_sqimage.push(pixel * pixel);
-        }
-    }
-
     int const window_lower_half = window_size.height() >> 1;
     int const window_upper_half = window_size.height() - window_lower_half;
     int const window_left_half = window_size.width() >> 1;
@@ -146,28 +181,32 @@ BinaryImage binarizeWolf(
         return BinaryImage();
     }
 
-    QImage const gray(toGrayscale(src));
+    return binarizeWolf(BinarizationStats(src), window_size, lower_bound, upper_bound);
+}
+
+BinaryImage binarizeWolf(
+    BinarizationStats const& stats, QSize const window_size,
+    unsigned char const lower_bound, unsigned char const upper_bound)
+{
+    if (window_size.isEmpty()) {
+        throw std::invalid_argument("binarizeWolf: invalid window_size");
+    }
+
+    QImage const& gray = stats.gray();
+    if (gray.isNull()) {
+        return BinaryImage();
+    }
+
     int const w = gray.width();
     int const h = gray.height();
 
-    IntegralImage<uint32_t> integral_image(w, h);
-    IntegralImage<uint64_t> integral_sqimage(w, h);
+    IntegralImage<uint32_t> const& integral_image = stats.integralImage();
+    IntegralImage<uint64_t> const& integral_sqimage = stats.integralSqImage();
 
     uint8_t const* gray_line = gray.bits();
     int const gray_bpl = gray.bytesPerLine();
 
-    uint32_t min_gray_level = 255;
-
-    for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
-        integral_image.beginRow();
-        integral_sqimage.beginRow();
-        for (int x = 0; x < w; ++x) {
-            uint32_t const pixel = gray_line[x];
-            integral_image.push(pixel);
-            integral_sqimage.push(pixel * pixel);
-            min_gray_level = std::min(min_gray_level, pixel);
-        }
-    }
+    uint32_t const min_gray_level = stats.minGrayLevel();
 
     int const window_lower_half = window_size.height() >> 1;
     int const window_upper_half = window_size.height() - window_lower_half;
@@ -205,8 +244,6 @@ BinaryImage binarizeWolf(
         }
     }
 
-    // TODO: integral images can be disposed at this point.
-
     BinaryImage bw_img(w, h);
     uint32_t* bw_line = bw_img.data();
     int const bw_wpl = bw_img.wordsPerLine();
@@ -243,4 +280,12 @@ peakThreshold(QImage const& image)
     return BinaryImage(image, BinaryThreshold::peakThreshold(image));
 }
 
+BinaryImage
+peakThreshold(BinarizationStats const& stats)
+{
+    return BinaryImage(
+        stats.gray(), BinaryThreshold::peakThreshold(stats.histogram())
+    );
+}
+
 } // namespace imageproc
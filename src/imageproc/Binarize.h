@@ -19,15 +19,61 @@
 #ifndef IMAGEPROC_BINARIZE_H_
 #define IMAGEPROC_BINARIZE_H_
 
+#include "NonCopyable.h"
+#include "Grayscale.h"
+#include "IntegralImage.h"
 #include <QSize>
-
-class QImage;
+#include <QImage>
+#include <stdint.h>
 
 namespace imageproc
 {
 
 class BinaryImage;
 
+/**
+ * \brief Gray level statistics of an image, as needed by the
+ *        binarization methods below.
+ *
+ * Trying several binarization methods on the same image, one can
+ * compute these once and pass them to each method, instead of having
+ * each one compute them again.
+ */
+class BinarizationStats
+{
+    DECLARE_NON_COPYABLE(BinarizationStats)
+public:
+    /**
+     * \param src The image to collect statistics of.  May be in any format.
+     */
+    explicit BinarizationStats(QImage const& src);
+
+    /**
+     * \brief The source image converted to grayscale.
+     */
+    QImage const& gray() const { return m_gray; }
+
+    GrayscaleHistogram const& histogram() const { return m_histogram; }
+
+    /**
+     * \brief Sums of gray levels.
+     */
+    IntegralImage<uint32_t> const& integralImage() const { return m_integralImage; }
+
+    /**
+     * \brief Sums of squared gray levels.
+     */
+    IntegralImage<uint64_t> const& integralSqImage() const { return m_integralSqImage; }
+
+    uint32_t minGrayLevel() const { return m_minGrayLevel; }
+private:
+    QImage m_gray;
+    GrayscaleHistogram m_histogram;
+    IntegralImage<uint32_t> m_integralImage;
+    IntegralImage<uint64_t> m_integralSqImage;
+    uint32_t m_minGrayLevel;
+};
+
 /**
  * \brief Image binarization using Otsu's global thresholding method.
  *
@@ -36,6 +82,8 @@ class BinaryImage;
  */
 BinaryImage binarizeOtsu(QImage const& src);
 
+BinaryImage binarizeOtsu(BinarizationStats const& stats);
+
 /**
  * \brief Image binarization using Mokji's global thresholding method.
  *
@@ -61,6 +109,8 @@ BinaryImage binarizeMokji(
  */
 BinaryImage binarizeSauvola(QImage const& src, QSize window_size);
 
+BinaryImage binarizeSauvola(BinarizationStats const& stats, QSize window_size);
+
 /**
  * \brief Image binarization using Wolf's local thresholding method.
  *
@@ -77,7 +127,13 @@ BinaryImage binarizeWolf(
     QImage const& src, QSize window_size,
     unsigned char lower_bound = 1, unsigned char upper_bound = 254);
 
+BinaryImage binarizeWolf(
+    BinarizationStats const& stats, QSize window_size,
+    unsigned char lower_bound = 1, unsigned char upper_bound = 254);
+
 BinaryImage peakThreshold(QImage const& image);
+
+BinaryImage peakThreshold(BinarizationStats const& stats);
 } // namespace imageproc
 
 #endif
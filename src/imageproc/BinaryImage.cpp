@@ -19,6 +19,7 @@
 #include "BinaryImage.h"
 #include "ByteOrder.h"
 #include "BitOps.h"
+#include "ImageArena.h"
 #include <QAtomicInt>
 #include <QImage>
 #include <QRect>
@@ -1417,7 +1418,7 @@ BinaryImage::SharedData::unref() const
 {
     if (!m_refCounter.deref()) {
         this->~SharedData();
-        free((void*)this);
+        ImageArena::release((void*)this);
     }
 }
 
@@ -1425,17 +1426,13 @@ void*
 BinaryImage::SharedData::operator new (size_t, NumWords const num_words)
 {
     SharedData* sd = 0;
-    void* addr = malloc(((char*)&sd->m_data[0] - (char*)sd) + num_words.numWords * 4);
-    if (!addr) {
-        throw std::bad_alloc();
-    }
-    return addr;
+    return ImageArena::allocate(((char*)&sd->m_data[0] - (char*)sd) + num_words.numWords * 4);
 }
 
 void
 BinaryImage::SharedData::operator delete (void* addr, NumWords)
 {
-    free(addr);
+    ImageArena::release(addr);
 }
 
 } // namespace imageproc
@@ -18,22 +18,43 @@
 
 #include "GrayImage.h"
 #include "Grayscale.h"
+#include "ImageArena.h"
 #include <new>
 
 namespace imageproc
 {
 
+namespace
+{
+
+void releaseArenaBuffer(void* buffer)
+{
+    ImageArena::release(buffer);
+}
+
+} // anonymous namespace
+
 GrayImage::GrayImage(QSize size)
 {
     if (size.isEmpty()) {
         return;
     }
 
-    m_image = QImage(size, QImage::Format_Indexed8);
-    m_image.setColorTable(createGrayscalePalette());
+    // QImage wants 32-bit aligned lines.
+    int const bpl = (size.width() + 3) & ~3;
+    uchar* const buffer = static_cast<uchar*>(
+                              ImageArena::allocate(size_t(bpl) * size.height())
+                          );
+
+    m_image = QImage(
+                  buffer, size.width(), size.height(), bpl,
+                  QImage::Format_Indexed8, &releaseArenaBuffer, buffer
+              );
     if (m_image.isNull()) {
+        ImageArena::release(buffer);
         throw std::bad_alloc();
     }
+    m_image.setColorTable(createGrayscalePalette());
 }
 
 GrayImage::GrayImage(QImage const& image)
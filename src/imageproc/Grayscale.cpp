@@ -118,6 +118,48 @@ static QImage monoLsbToGrayscale(QImage const& src)
     return dst;
 }
 
+/**
+ * Same as qGray() applied to every pixel, but written in a way
+ * the compiler is able to vectorize.
+ */
+static void rgbLineToGray(uint32_t const* src_line, uint8_t* dst_line, int const width)
+{
+    for (int x = 0; x < width; ++x) {
+        uint32_t const rgb = src_line[x];
+        uint32_t const r = (rgb >> 16) & 0xff;
+        uint32_t const g = (rgb >> 8) & 0xff;
+        uint32_t const b = rgb & 0xff;
+        dst_line[x] = static_cast<uint8_t>((r * 11 + g * 16 + b * 5) >> 5);
+    }
+}
+
+static bool isRgb32Format(QImage::Format const format)
+{
+    switch (format) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Builds a color index to gray level lookup table for an indexed image.
+ * Indexes not present in the color table map to qGray(0), which is what
+ * QImage::pixel() would give us.
+ */
+static void buildIndexedGrayTable(QImage const& src, uint8_t* table)
+{
+    memset(table, 0, 256);
+
+    int const num_colors = std::min(src.colorCount(), 256);
+    for (int i = 0; i < num_colors; ++i) {
+        table[i] = static_cast<uint8_t>(qGray(src.color(i)));
+    }
+}
+
 static QImage rgbToGrayscale(QImage const& src)
 {
     int const width = src.width();
@@ -129,12 +171,50 @@ static QImage rgbToGrayscale(QImage const& src)
         throw std::bad_alloc();
     }
 
-    #pragma omp parallel for
+    uint8_t const* const src_data = src.bits();
+    uint8_t* const dst_data = dst.bits();
+    int const src_bpl = src.bytesPerLine();
+    int const dst_bpl = dst.bytesPerLine();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        rgbLineToGray(
+            reinterpret_cast<uint32_t const*>(src_data + y * src_bpl),
+            dst_data + y * dst_bpl, width
+        );
+    }
+
+    dst.setDotsPerMeterX(src.dotsPerMeterX());
+    dst.setDotsPerMeterY(src.dotsPerMeterY());
+
+    return dst;
+}
+
+static QImage indexedToGrayscale(QImage const& src)
+{
+    int const width = src.width();
+    int const height = src.height();
+
+    QImage dst(width, height, QImage::Format_Indexed8);
+    dst.setColorTable(createGrayscalePalette());
+    if (width > 0 && height > 0 && dst.isNull()) {
+        throw std::bad_alloc();
+    }
+
+    uint8_t gray_table[256];
+    buildIndexedGrayTable(src, gray_table);
+
+    uint8_t const* const src_data = src.bits();
+    uint8_t* const dst_data = dst.bits();
+    int const src_bpl = src.bytesPerLine();
+    int const dst_bpl = dst.bytesPerLine();
+
+    #pragma omp parallel for schedule(static)
     for (int y = 0; y < height; ++y) {
-        uint8_t* dst_line = dst.scanLine(y);
-        const QRgb* src_line = reinterpret_cast<const QRgb*>(src.scanLine(y));
+        uint8_t const* const src_line = src_data + y * src_bpl;
+        uint8_t* const dst_line = dst_data + y * dst_bpl;
         for (int x = 0; x < width; ++x) {
-            dst_line[x] = static_cast<uint8_t>(qGray(*src_line++));
+            dst_line[x] = gray_table[src_line[x]];
         }
     }
 
@@ -144,6 +224,101 @@ static QImage rgbToGrayscale(QImage const& src)
     return dst;
 }
 
+/**
+ * \brief Accumulates a histogram of 8-bit values into \p hist.
+ *
+ * Every thread accumulates into its own set of sub-histograms, one for
+ * each of 4 consecutive pixels.  That way, runs of identical values
+ * (typical for scanned pages) don't stall on incrementing the same counter
+ * over and over.  Sub-histograms are merged at the end.
+ */
+static void accumulateHistogram(
+    uint8_t const* const data, int const width, int const height,
+    int const stride, int* const hist)
+{
+    #pragma omp parallel
+    {
+        int sub_hists[4][256];
+        memset(sub_hists, 0, sizeof(sub_hists));
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; ++y) {
+            uint8_t const* const line = data + y * stride;
+            int x = 0;
+            for (; x + 4 <= width; x += 4) {
+                ++sub_hists[0][line[x]];
+                ++sub_hists[1][line[x + 1]];
+                ++sub_hists[2][line[x + 2]];
+                ++sub_hists[3][line[x + 3]];
+            }
+            for (; x < width; ++x) {
+                ++sub_hists[0][line[x]];
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int i = 0; i < 256; ++i) {
+                hist[i] += sub_hists[0][i] + sub_hists[1][i]
+                           + sub_hists[2][i] + sub_hists[3][i];
+            }
+        }
+    }
+}
+
+/**
+ * \brief Same as above, but only takes into account pixels
+ *        that are black in \p mask.
+ */
+static void accumulateHistogram(
+    uint8_t const* const data, int const width, int const height,
+    int const stride, BinaryImage const& mask, int* const hist)
+{
+    uint32_t const* const mask_data = mask.data();
+    int const mask_wpl = mask.wordsPerLine();
+
+    #pragma omp parallel
+    {
+        int sub_hists[4][256];
+        memset(sub_hists, 0, sizeof(sub_hists));
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; ++y) {
+            uint8_t const* const line = data + y * stride;
+            uint32_t const* const mask_line = mask_data + y * mask_wpl;
+            for (int x = 0; x < width; ++x) {
+                uint32_t const bit = mask_line[x >> 5] >> (31 - (x & 31));
+                sub_hists[x & 3][line[x]] += bit & 1;
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int i = 0; i < 256; ++i) {
+                hist[i] += sub_hists[0][i] + sub_hists[1][i]
+                           + sub_hists[2][i] + sub_hists[3][i];
+            }
+        }
+    }
+}
+
+/**
+ * \brief Folds a histogram of color indexes into a histogram of gray levels.
+ *
+ * Several palette entries may map to the same gray level, so a palette
+ * lookup has to be applied to the counts rather than to the pixels.
+ */
+static void foldIndexedHistogram(
+    QImage const& img, int const* const index_hist, int* const hist)
+{
+    uint8_t gray_table[256];
+    buildIndexedGrayTable(img, gray_table);
+
+    for (int i = 0; i < 256; ++i) {
+        hist[gray_table[i]] += index_hist[i];
+    }
+}
+
 static QImage anyToGrayscale(QImage const& src)
 {
     int const width = src.width();
@@ -211,7 +386,7 @@ QImage toGrayscale(QImage const& src)
                 return dst;
             }
         }
-    // fall though
+        return indexedToGrayscale(src);
     default:
         return anyToGrayscale(src);
     }
@@ -476,42 +651,39 @@ GrayscaleHistogram::fromMonoMSBImage(QImage const& img, BinaryImage const& mask)
 void
 GrayscaleHistogram::fromGrayscaleImage(QImage const& img)
 {
-    int const w = img.width();
-    int const h = img.height();
-    int const bpl = img.bytesPerLine();
-
-    #pragma omp parallel for
-    for (int y = 0; y < h; ++y) {
-        uint8_t const* line = img.bits() + y * bpl;
-        for (int x = 0; x < w; ++x) {
-            ++m_pixels[line[x]];
-        }
-    }
+    accumulateHistogram(
+        img.bits(), img.width(), img.height(), img.bytesPerLine(), m_pixels
+    );
 }
 
 void
 GrayscaleHistogram::fromGrayscaleImage(QImage const& img, BinaryImage const& mask)
 {
-    int const w = img.width();
-    int const h = img.height();
-    int const bpl = img.bytesPerLine();
-    uint8_t const* line = img.bits();
-    uint32_t const* mask_line = mask.data();
-    int const mask_wpl = mask.wordsPerLine();
-    uint32_t const msb = uint32_t(1) << 31;
-
-    for (int y = 0; y < h; ++y, line += bpl, mask_line += mask_wpl) {
-        for (int x = 0; x < w; ++x) {
-            if (mask_line[x >> 5] & (msb >> (x & 31))) {
-                ++m_pixels[line[x]];
-            }
-        }
-    }
+    accumulateHistogram(
+        img.bits(), img.width(), img.height(), img.bytesPerLine(), mask, m_pixels
+    );
 }
 
 void
 GrayscaleHistogram::fromAnyImage(QImage const& img)
 {
+    if (img.format() == QImage::Format_Indexed8) {
+        int index_hist[256];
+        memset(index_hist, 0, sizeof(index_hist));
+        accumulateHistogram(
+            img.bits(), img.width(), img.height(), img.bytesPerLine(), index_hist
+        );
+        foldIndexedHistogram(img, index_hist, m_pixels);
+        return;
+    }
+
+    if (isRgb32Format(img.format())) {
+        // Going through a grayscale copy is much faster than QImage::pixel().
+        QImage const gray(toGrayscale(img));
+        fromGrayscaleImage(gray);
+        return;
+    }
+
     int const w = img.width();
     int const h = img.height();
 
@@ -525,6 +697,24 @@ GrayscaleHistogram::fromAnyImage(QImage const& img)
 void
 GrayscaleHistogram::fromAnyImage(QImage const& img, BinaryImage const& mask)
 {
+    if (img.format() == QImage::Format_Indexed8) {
+        int index_hist[256];
+        memset(index_hist, 0, sizeof(index_hist));
+        accumulateHistogram(
+            img.bits(), img.width(), img.height(), img.bytesPerLine(),
+            mask, index_hist
+        );
+        foldIndexedHistogram(img, index_hist, m_pixels);
+        return;
+    }
+
+    if (isRgb32Format(img.format())) {
+        // Going through a grayscale copy is much faster than QImage::pixel().
+        QImage const gray(toGrayscale(img));
+        fromGrayscaleImage(gray, mask);
+        return;
+    }
+
     int const w = img.width();
     int const h = img.height();
     uint32_t const* mask_line = mask.data();
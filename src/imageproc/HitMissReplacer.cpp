@@ -0,0 +1,219 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HitMissReplacer.h"
+#include "BinaryImage.h"
+#include <string.h>
+#include <assert.h>
+
+namespace imageproc
+{
+
+static_assert(
+    HitMissReplacer::BAND_HEIGHT > 0, "BAND_HEIGHT has to be positive"
+);
+
+HitMissReplacer::HitMissReplacer()
+    : m_pImageData(0),
+      m_height(0),
+      m_wordsPerLine(0),
+      m_stride(0),
+      m_lastWordMask(0),
+      m_lastSourceLine(-1)
+{
+}
+
+void
+HitMissReplacer::replaceInPlace(BinaryImage& img)
+{
+    if (!begin(img)) {
+        return;
+    }
+
+    for (int y = 0; y < m_height; ++y) {
+        processLine(y);
+    }
+}
+
+void
+HitMissReplacer::addStage(
+    MatchFunc const match_line, ReplaceFunc const replace_line,
+    HitMissPattern const& pattern)
+{
+    static_assert(
+        RING_LINES > HitMissPattern::MAX_SIZE && (RING_LINES & (RING_LINES - 1)) == 0,
+        "RING_LINES has to be a power of 2 larger than any pattern"
+    );
+
+    Stage stage;
+    stage.matchLine = match_line;
+    stage.replaceLine = replace_line;
+    stage.height = pattern.height();
+    stage.originY = pattern.originY();
+    stage.lastMatch = -1;
+    stage.lastOutput = -1;
+    m_stages.push_back(stage);
+}
+
+bool
+HitMissReplacer::begin(BinaryImage& img)
+{
+    if (img.isNull() || m_stages.empty()) {
+        return false;
+    }
+
+    m_pImageData = img.data();
+    m_height = img.height();
+    m_wordsPerLine = img.wordsPerLine();
+
+    // A guard word on each side of every line.
+    m_stride = m_wordsPerLine + 2;
+
+    int const tail_bits = img.width() % 32;
+    m_lastWordMask = tail_bits ? ~uint32_t(0) << (32 - tail_bits) : ~uint32_t(0);
+
+    m_blankLine.assign(m_stride, 0);
+    m_source.assign(RING_LINES * m_stride, 0);
+    m_lastSourceLine = -1;
+
+    for (Stage& stage : m_stages) {
+        stage.matches.assign(RING_LINES * m_stride, 0);
+        stage.output.assign(RING_LINES * m_stride, 0);
+        stage.lastMatch = -1;
+        stage.lastOutput = -1;
+    }
+
+    return true;
+}
+
+void
+HitMissReplacer::processLine(int const y)
+{
+    size_t const last_stage = m_stages.size() - 1;
+    produceOutput(last_stage, y);
+
+    // All the stages are past this line, and so is produceSource(),
+    // so we may overwrite it.
+    uint32_t const* const src = ringLine(m_stages[last_stage].output, y);
+    uint32_t* const dst = m_pImageData + y * m_wordsPerLine;
+    int const last_word = m_wordsPerLine - 1;
+    memcpy(dst, src, last_word * sizeof(*dst));
+    dst[last_word] = (dst[last_word] & ~m_lastWordMask) | src[last_word];
+}
+
+void
+HitMissReplacer::produceSource(int const y)
+{
+    int const last_word = m_wordsPerLine - 1;
+    while (m_lastSourceLine < y) {
+        ++m_lastSourceLine;
+        uint32_t* const dst = ringLine(m_source, m_lastSourceLine);
+        memcpy(
+            dst, m_pImageData + m_lastSourceLine * m_wordsPerLine,
+            m_wordsPerLine * sizeof(*dst)
+        );
+
+        // Bits past the image width are pixels outside of the image,
+        // that is white.
+        dst[last_word] &= m_lastWordMask;
+    }
+}
+
+void
+HitMissReplacer::produceInput(size_t const stage_idx, int const y)
+{
+    if (stage_idx == 0) {
+        produceSource(y);
+    } else {
+        produceOutput(stage_idx - 1, y);
+    }
+}
+
+void
+HitMissReplacer::produceOutput(size_t const stage_idx, int const y)
+{
+    assert(y < m_height);
+
+    Stage& stage = m_stages[stage_idx];
+    uint32_t const* lines[HitMissPattern::MAX_SIZE];
+    int const last_word = m_wordsPerLine - 1;
+
+    while (stage.lastOutput < y) {
+        int const out_y = stage.lastOutput + 1;
+
+        // Pattern row r at line y affects pixels on line y + r - originY,
+        // so line out_y depends on matches up to out_y + originY.
+        int const last_match = std::min(out_y + stage.originY, m_height - 1);
+        while (stage.lastMatch < last_match) {
+            int const match_y = stage.lastMatch + 1;
+            int const top = match_y - stage.originY;
+            produceInput(stage_idx, std::min(top + stage.height - 1, m_height - 1));
+
+            for (int r = 0; r < stage.height; ++r) {
+                int const line_y = top + r;
+                if (line_y >= 0 && line_y < m_height) {
+                    lines[r] = inputLine(stage_idx, line_y);
+                } else {
+                    lines[r] = &m_blankLine[1];
+                }
+            }
+
+            uint32_t* const dst = ringLine(stage.matches, match_y);
+            stage.matchLine(dst, lines, m_wordsPerLine);
+
+            // Only origins inside the image count.
+            dst[last_word] &= m_lastWordMask;
+            stage.lastMatch = match_y;
+        }
+
+        for (int r = 0; r < stage.height; ++r) {
+            int const line_y = out_y - r + stage.originY;
+            if (line_y >= 0 && line_y < m_height) {
+                lines[r] = ringLine(stage.matches, line_y);
+            } else {
+                lines[r] = &m_blankLine[1];
+            }
+        }
+
+        produceInput(stage_idx, out_y);
+        uint32_t* const dst = ringLine(stage.output, out_y);
+        stage.replaceLine(dst, inputLine(stage_idx, out_y), lines, m_wordsPerLine);
+
+        // Don't let replacements spill past the image width.
+        dst[last_word] &= m_lastWordMask;
+        stage.lastOutput = out_y;
+    }
+}
+
+uint32_t const*
+HitMissReplacer::inputLine(size_t const stage_idx, int const y)
+{
+    if (stage_idx == 0) {
+        return ringLine(m_source, y);
+    } else {
+        return ringLine(m_stages[stage_idx - 1].output, y);
+    }
+}
+
+uint32_t*
+HitMissReplacer::ringLine(std::vector<uint32_t>& ring, int const y)
+{
+    return &ring[(y & (RING_LINES - 1)) * m_stride + 1];
+}
+
+} // namespace imageproc
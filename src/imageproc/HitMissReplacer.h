@@ -0,0 +1,491 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_HITMISSREPLACER_H_
+#define IMAGEPROC_HITMISSREPLACER_H_
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+class BinaryImage;
+
+namespace detail
+{
+
+namespace hit_miss
+{
+
+template<int... Idx>
+struct IndexList {};
+
+template<int N, int... Idx>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, Idx...> {};
+
+template<int... Idx>
+struct MakeIndexList<0, Idx...> {
+    typedef IndexList<Idx...> type;
+};
+
+} // namespace hit_miss
+
+} // namespace detail
+
+/**
+ * \brief A hit-miss-replace pattern, parsed at compile time.
+ *
+ * Patterns are written the same way as for hitMissReplaceInPlace():\n
+ * 'X': A black pixel.\n
+ * ' ': A white pixel.\n
+ * '-': A black pixel we want to turn into white.\n
+ * '+': A white pixel we want to turn into black.\n
+ * '?': Any pixel, we don't care which.\n
+ * A pattern may be up to MAX_SIZE x MAX_SIZE and must request at least
+ * one replacement.  When declared constexpr, a malformed pattern is
+ * a compilation error.
+ */
+class HitMissPattern
+{
+public:
+    enum Orientation { AS_IS, ROTATE_CW, ROTATE_180, ROTATE_CCW };
+
+    static int const MAX_SIZE = 9;
+
+    constexpr HitMissPattern(
+        char const* pattern, int width, int height,
+        Orientation orientation = AS_IS)
+        : HitMissPattern(
+            pattern, width, height, orientation,
+            detail::hit_miss::MakeIndexList<MAX_SIZE * MAX_SIZE>::type()
+        ) {}
+
+    /**
+     * \brief Width of the pattern, after applying the orientation.
+     */
+    constexpr int width() const { return m_width; }
+
+    /**
+     * \brief Height of the pattern, after applying the orientation.
+     */
+    constexpr int height() const { return m_height; }
+
+    /**
+     * \brief The first replacement position, in row-major order.
+     *
+     * Just like hitMissReplaceInPlace(), we only look for matches
+     * having this point inside the image.
+     */
+    constexpr int originX() const { return m_origin % m_width; }
+
+    constexpr int originY() const { return m_origin / m_width; }
+
+    /**
+     * \brief Pattern character at (idx % width(), idx / width()).
+     */
+    constexpr char cell(int idx) const { return m_cells[idx]; }
+private:
+    template<int... Idx>
+    constexpr HitMissPattern(
+        char const* pattern, int width, int height,
+        Orientation orientation, detail::hit_miss::IndexList<Idx...>)
+        : m_width(rotatedWidth(checkedSize(width), checkedSize(height), orientation)),
+          m_height(rotatedWidth(height, width, orientation)),
+          m_origin(findOrigin(pattern, width, height, orientation, 0)),
+          m_cells{ cellAt(pattern, width, height, orientation, Idx)... } {}
+
+    static constexpr int checkedSize(int size)
+    {
+        return size >= 1 && size <= MAX_SIZE ? size
+            : throw std::invalid_argument("HitMissPattern: unsupported pattern size");
+    }
+
+    static constexpr char checkedChar(char ch)
+    {
+        return ch == 'X' || ch == ' ' || ch == '-' || ch == '+' || ch == '?' ? ch
+            : throw std::invalid_argument("HitMissPattern: invalid character in pattern");
+    }
+
+    static constexpr int rotatedWidth(int width, int height, Orientation orientation)
+    {
+        return orientation == ROTATE_CW || orientation == ROTATE_CCW ? height : width;
+    }
+
+    /**
+     * Character at (x, y) in the rotated pattern.
+     */
+    static constexpr char rotatedCell(
+        char const* p, int w, int h, Orientation orientation, int x, int y)
+    {
+        return checkedChar(
+            orientation == AS_IS ? p[y * w + x]
+            : orientation == ROTATE_CW ? p[(h - 1 - x) * w + y]
+            : orientation == ROTATE_180 ? p[(h - 1 - y) * w + (w - 1 - x)]
+            : p[x * w + (w - 1 - y)]
+        );
+    }
+
+    static constexpr char cellAt(
+        char const* p, int w, int h, Orientation orientation, int idx)
+    {
+        return idx >= w * h ? '?' : rotatedCell(
+            p, w, h, orientation,
+            idx % rotatedWidth(w, h, orientation),
+            idx / rotatedWidth(w, h, orientation)
+        );
+    }
+
+    static constexpr int findOrigin(
+        char const* p, int w, int h, Orientation orientation, int idx)
+    {
+        return idx == w * h
+            ? throw std::invalid_argument("HitMissPattern: no replacements requested")
+            : cellAt(p, w, h, orientation, idx) == '-'
+            || cellAt(p, w, h, orientation, idx) == '+' ? idx
+            : findOrigin(p, w, h, orientation, idx + 1);
+    }
+
+    int m_width;
+    int m_height;
+    int m_origin;
+    char m_cells[MAX_SIZE * MAX_SIZE];
+};
+
+namespace detail
+{
+
+namespace hit_miss
+{
+
+/**
+ * Pixels x + Dx for the 32 pixels x of word i.  Lines have
+ * a white guard word on each side, which makes them pixels
+ * outside of the image.
+ */
+template<int Dx, int Sign = (Dx > 0) - (Dx < 0)>
+struct Shifted;
+
+template<int Dx>
+struct Shifted<Dx, 1> {
+    static uint32_t get(uint32_t const* line, int i)
+    {
+        return (line[i] << Dx) | (line[i + 1] >> (32 - Dx));
+    }
+};
+
+template<int Dx>
+struct Shifted<Dx, 0> {
+    static uint32_t get(uint32_t const* line, int i)
+    {
+        return line[i];
+    }
+};
+
+template<int Dx>
+struct Shifted<Dx, -1> {
+    static uint32_t get(uint32_t const* line, int i)
+    {
+        return (line[i] >> -Dx) | (line[i - 1] << (32 + Dx));
+    }
+};
+
+template<char Cell, int Dx>
+struct MatchTerm {
+    // '?'
+    static uint32_t get(uint32_t const*, int)
+    {
+        return ~uint32_t(0);
+    }
+};
+
+template<int Dx>
+struct MatchTerm<'X', Dx> {
+    static uint32_t get(uint32_t const* line, int i)
+    {
+        return Shifted<Dx>::get(line, i);
+    }
+};
+
+template<int Dx>
+struct MatchTerm<'-', Dx> : MatchTerm<'X', Dx> {};
+
+template<int Dx>
+struct MatchTerm<' ', Dx> {
+    static uint32_t get(uint32_t const* line, int i)
+    {
+        return ~Shifted<Dx>::get(line, i);
+    }
+};
+
+template<int Dx>
+struct MatchTerm<'+', Dx> : MatchTerm<' ', Dx> {};
+
+/**
+ * ANDs the terms of cells [Cell, width * height) of a pattern.
+ * \p lines are the input lines for each row of the pattern.
+ */
+template<HitMissPattern const& P, int Cell,
+         bool Done = (Cell == P.width() * P.height())>
+struct MatchCells {
+    static uint32_t get(uint32_t const* const* lines, int i)
+    {
+        return MatchTerm<P.cell(Cell), Cell % P.width() - P.originX()>::get(
+            lines[Cell / P.width()], i
+        ) & MatchCells<P, Cell + 1>::get(lines, i);
+    }
+};
+
+template<HitMissPattern const& P, int Cell>
+struct MatchCells<P, Cell, true> {
+    static uint32_t get(uint32_t const* const*, int)
+    {
+        return ~uint32_t(0);
+    }
+};
+
+template<bool Selected, int Dx>
+struct ReplaceTerm {
+    static uint32_t get(uint32_t const*, int)
+    {
+        return 0;
+    }
+};
+
+template<int Dx>
+struct ReplaceTerm<true, Dx> {
+    static uint32_t get(uint32_t const* match_line, int i)
+    {
+        return Shifted<-Dx>::get(match_line, i);
+    }
+};
+
+/**
+ * ORs the matches that replace a pixel with the \p Replacement
+ * character ('+' or '-') in cells [Cell, width * height) of a pattern.
+ * \p match_lines are the match lines for each row of the pattern,
+ * that is a pixel in row r is affected by matches on line y - r + originY.
+ */
+template<HitMissPattern const& P, char Replacement, int Cell,
+         bool Done = (Cell == P.width() * P.height())>
+struct ReplaceCells {
+    static uint32_t get(uint32_t const* const* match_lines, int i)
+    {
+        return ReplaceTerm<P.cell(Cell) == Replacement, Cell % P.width() - P.originX()>::get(
+            match_lines[Cell / P.width()], i
+        ) | ReplaceCells<P, Replacement, Cell + 1>::get(match_lines, i);
+    }
+};
+
+template<HitMissPattern const& P, char Replacement, int Cell>
+struct ReplaceCells<P, Replacement, Cell, true> {
+    static uint32_t get(uint32_t const* const*, int)
+    {
+        return 0;
+    }
+};
+
+template<HitMissPattern const& P>
+void matchLine(uint32_t* dst, uint32_t const* const* lines, int words)
+{
+    for (int i = 0; i < words; ++i) {
+        dst[i] = MatchCells<P, 0>::get(lines, i);
+    }
+}
+
+template<HitMissPattern const& P>
+void replaceLine(
+    uint32_t* dst, uint32_t const* src,
+    uint32_t const* const* match_lines, int words)
+{
+    for (int i = 0; i < words; ++i) {
+        uint32_t const white_to_black = ReplaceCells<P, '+', 0>::get(match_lines, i);
+        uint32_t const black_to_white = ReplaceCells<P, '-', 0>::get(match_lines, i);
+        dst[i] = (src[i] | white_to_black) & ~black_to_white;
+    }
+}
+
+template<char const* Pattern, int Width, int Height>
+struct AllOrientations {
+    static constexpr HitMissPattern asIs = HitMissPattern(
+        Pattern, Width, Height, HitMissPattern::AS_IS
+    );
+    static constexpr HitMissPattern rotatedCw = HitMissPattern(
+        Pattern, Width, Height, HitMissPattern::ROTATE_CW
+    );
+    static constexpr HitMissPattern upsideDown = HitMissPattern(
+        Pattern, Width, Height, HitMissPattern::ROTATE_180
+    );
+    static constexpr HitMissPattern rotatedCcw = HitMissPattern(
+        Pattern, Width, Height, HitMissPattern::ROTATE_CCW
+    );
+};
+
+template<char const* Pattern, int Width, int Height>
+constexpr HitMissPattern AllOrientations<Pattern, Width, Height>::asIs;
+
+template<char const* Pattern, int Width, int Height>
+constexpr HitMissPattern AllOrientations<Pattern, Width, Height>::rotatedCw;
+
+template<char const* Pattern, int Width, int Height>
+constexpr HitMissPattern AllOrientations<Pattern, Width, Height>::upsideDown;
+
+template<char const* Pattern, int Width, int Height>
+constexpr HitMissPattern AllOrientations<Pattern, Width, Height>::rotatedCcw;
+
+} // namespace hit_miss
+
+} // namespace detail
+
+/**
+ * \brief Applies a sequence of hit-miss-replace patterns in a single pass.
+ *
+ * The result is exactly the same as calling hitMissReplaceInPlace()
+ * with WHITE surroundings for each pattern in turn.  The difference is
+ * that the image is traversed once: each pattern keeps a few lines of
+ * its input and of its matches, and feeds its output to the next one
+ * line by line.  Matching and replacing code is generated for each
+ * pattern at compile time, so no pattern parsing or pixel-by-pixel
+ * dispatch takes place at runtime.
+ */
+class HitMissReplacer
+{
+public:
+    /**
+     * \brief Number of lines processed between calls to the callback
+     *        of replaceInPlace().
+     */
+    static int const BAND_HEIGHT = 64;
+
+    HitMissReplacer();
+
+    template<HitMissPattern const& Pattern>
+    void addPattern();
+
+    /**
+     * \brief Adds a pattern as is, rotated 90 degrees clockwise,
+     *        upside down and rotated 90 degrees counter-clockwise.
+     *
+     * \p Pattern has to be a constexpr character array.
+     */
+    template<char const* Pattern, int Width, int Height>
+    void addAllOrientations();
+
+    void replaceInPlace(BinaryImage& img);
+
+    /**
+     * \brief Same as above, but calls \p between_bands() after every
+     *        BAND_HEIGHT lines, for example to check for cancellation.
+     *
+     * If between_bands() throws, \p img is left partially processed.
+     */
+    template<typename Callback>
+    void replaceInPlace(BinaryImage& img, Callback between_bands);
+private:
+    typedef void (*MatchFunc)(uint32_t* dst, uint32_t const* const* lines, int words);
+
+    typedef void (*ReplaceFunc)(
+        uint32_t* dst, uint32_t const* src,
+        uint32_t const* const* match_lines, int words);
+
+    /**
+     * Lines kept in each ring buffer.  Has to be a power of 2
+     * and larger than HitMissPattern::MAX_SIZE.
+     */
+    static int const RING_LINES = 16;
+
+    struct Stage {
+        MatchFunc matchLine;
+        ReplaceFunc replaceLine;
+        int height;
+        int originY;
+        std::vector<uint32_t> matches;
+        std::vector<uint32_t> output;
+        int lastMatch;
+        int lastOutput;
+    };
+
+    void addStage(MatchFunc match_line, ReplaceFunc replace_line,
+                  HitMissPattern const& pattern);
+
+    bool begin(BinaryImage& img);
+
+    void processLine(int y);
+
+    void produceSource(int y);
+
+    void produceInput(size_t stage_idx, int y);
+
+    void produceOutput(size_t stage_idx, int y);
+
+    uint32_t const* inputLine(size_t stage_idx, int y);
+
+    uint32_t* ringLine(std::vector<uint32_t>& ring, int y);
+
+    std::vector<Stage> m_stages;
+    std::vector<uint32_t> m_source;
+    std::vector<uint32_t> m_blankLine;
+    uint32_t* m_pImageData;
+    int m_height;
+    int m_wordsPerLine;
+    int m_stride;
+    uint32_t m_lastWordMask;
+    int m_lastSourceLine;
+};
+
+template<HitMissPattern const& Pattern>
+void HitMissReplacer::addPattern()
+{
+    addStage(
+        &detail::hit_miss::matchLine<Pattern>,
+        &detail::hit_miss::replaceLine<Pattern>, Pattern
+    );
+}
+
+template<char const* Pattern, int Width, int Height>
+void HitMissReplacer::addAllOrientations()
+{
+    typedef detail::hit_miss::AllOrientations<Pattern, Width, Height> Orientations;
+
+    addPattern<Orientations::asIs>();
+    addPattern<Orientations::rotatedCw>();
+    addPattern<Orientations::upsideDown>();
+    addPattern<Orientations::rotatedCcw>();
+}
+
+template<typename Callback>
+void HitMissReplacer::replaceInPlace(BinaryImage& img, Callback between_bands)
+{
+    if (!begin(img)) {
+        return;
+    }
+
+    for (int y = 0; y < m_height;) {
+        int const band_end = std::min(y + BAND_HEIGHT, m_height);
+        for (; y < band_end; ++y) {
+            processLine(y);
+        }
+        between_bands();
+    }
+}
+
+} // namespace imageproc
+
+#endif
@@ -63,10 +63,13 @@ HoughLineDetector::HoughLineDetector(
     int const max_x = input_dimensions.width() - 1;
     int const max_y = input_dimensions.height() - 1;
 
-    QPoint checkpoints[3];
+    // The origin is here because for angles in [180, 270] degrees
+    // it's the point with the maximum distance.
+    QPoint checkpoints[4];
     checkpoints[0] = QPoint(max_x, max_y);
     checkpoints[1] = QPoint(max_x, 0);
     checkpoints[2] = QPoint(0, max_y);
+    checkpoints[3] = QPoint(0, 0);
 
     double max_distance = 0.0;
     double min_distance = 0.0;
@@ -88,11 +91,26 @@ HoughLineDetector::HoughLineDetector(
 
     // We bias distances to make them non-negative.
     m_distanceBias = -min_distance;
+    m_scaledBias = m_distanceBias * m_recipDistanceResolution + 0.5;
 
-    double const max_biased_distance = max_distance + m_distanceBias;
-    int const max_bin = int(
-                            max_biased_distance * m_recipDistanceResolution + 0.5
-                        );
+    m_scaledCosines.reserve(num_angles);
+    m_scaledSines.reserve(num_angles);
+    for (QPointF const& uv : m_angleUnitVectors) {
+        m_scaledCosines.push_back(uv.x() * m_recipDistanceResolution);
+        m_scaledSines.push_back(uv.y() * m_recipDistanceResolution);
+    }
+
+    // Find the maximum bin with the same arithmetic voting uses,
+    // so that rounding can't take a vote out of the histogram.
+    int max_bin = 0;
+    for (int i = 0; i < num_angles; ++i) {
+        for (QPoint const& p : qAsConst(checkpoints)) {
+            int const bin = (int)(
+                m_scaledCosines[i] * p.x() + (m_scaledSines[i] * p.y() + m_scaledBias)
+            );
+            max_bin = std::max(max_bin, bin);
+        }
+    }
 
     m_histWidth = max_bin + 1;
     m_histHeight = num_angles;
@@ -102,13 +120,12 @@ HoughLineDetector::HoughLineDetector(
 void
 HoughLineDetector::process(int x, int y, unsigned weight)
 {
-    unsigned* hist_line = &m_histogram[0];
+    unsigned* hist_line = m_histogram.data();
 
-    for (QPointF const& uv : m_angleUnitVectors) {
-        double const distance = uv.x() * x + uv.y() * y;
-        double const biased_distance = distance + m_distanceBias;
-
-        int const bin = (int)(biased_distance * m_recipDistanceResolution + 0.5);
+    for (int i = 0; i < m_histHeight; ++i) {
+        int const bin = (int)(
+            m_scaledCosines[i] * x + (m_scaledSines[i] * y + m_scaledBias)
+        );
         assert(bin >= 0 && bin < m_histWidth);
         hist_line[bin] += weight;
 
@@ -116,6 +133,84 @@ HoughLineDetector::process(int x, int y, unsigned weight)
     }
 }
 
+void
+HoughLineDetector::processRow(
+    int const y, unsigned const* const weights, int const x_begin, int const x_end)
+{
+    std::vector<double> row_offsets(m_histHeight);
+    std::vector<int> bins(m_histHeight);
+    voteRow(m_histogram, y, weights, x_begin, x_end, row_offsets, bins);
+}
+
+void
+HoughLineDetector::processRows(
+    unsigned const* const weights, int const stride,
+    int const x_begin, int const x_end, int const num_rows)
+{
+    // Every thread votes into its own histogram.
+    // Histograms are merged at the end.
+    #pragma omp parallel
+    {
+        std::vector<unsigned> hist(m_histogram.size(), 0);
+        std::vector<double> row_offsets(m_histHeight);
+        std::vector<int> bins(m_histHeight);
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < num_rows; ++y) {
+            voteRow(hist, y, weights + y * stride, x_begin, x_end, row_offsets, bins);
+        }
+
+        #pragma omp critical
+        {
+            size_t const size = hist.size();
+            for (size_t i = 0; i < size; ++i) {
+                m_histogram[i] += hist[i];
+            }
+        }
+    }
+}
+
+/**
+ * Votes for the points of a row.  The per-angle loops are free of
+ * dependencies and branches, so that the compiler can vectorize them.
+ * Only the scattered increments remain scalar.
+ */
+void
+HoughLineDetector::voteRow(
+    std::vector<unsigned>& hist, int const y,
+    unsigned const* const weights, int const x_begin, int const x_end,
+    std::vector<double>& row_offsets, std::vector<int>& bins) const
+{
+    int const num_angles = m_histHeight;
+    int const hist_width = m_histWidth;
+    double const* const cosines = m_scaledCosines.data();
+    double const* const sines = m_scaledSines.data();
+    double const bias = m_scaledBias;
+    double* const offsets = row_offsets.data();
+    int* const bin_indexes = bins.data();
+    unsigned* const hist_data = hist.data();
+
+    for (int i = 0; i < num_angles; ++i) {
+        offsets[i] = sines[i] * y + bias;
+    }
+
+    for (int x = x_begin; x < x_end; ++x) {
+        unsigned const weight = weights[x];
+        if (weight == 0) {
+            continue;
+        }
+
+        for (int i = 0; i < num_angles; ++i) {
+            bin_indexes[i] = (int)(cosines[i] * x + offsets[i]) + i * hist_width;
+        }
+
+        for (int i = 0; i < num_angles; ++i) {
+            assert(bin_indexes[i] >= i * hist_width && bin_indexes[i] < (i + 1) * hist_width);
+            hist_data[bin_indexes[i]] += weight;
+        }
+    }
+}
+
 QImage
 HoughLineDetector::visualizeHoughSpace(unsigned const lower_bound) const
 {
@@ -110,6 +110,23 @@ public:
      */
     void process(int x, int y, unsigned weight = 1);
 
+    /**
+     * \brief Processes a row of points at once.
+     *
+     * Same as calling process(x, y, weights[x]) for every x
+     * in [x_begin, x_end) where weights[x] is not zero.
+     */
+    void processRow(int y, unsigned const* weights, int x_begin, int x_end);
+
+    /**
+     * \brief Processes rows of points, in parallel if possible.
+     *
+     * Same as calling processRow(y, weights + y * stride, x_begin, x_end)
+     * for every y in [0, num_rows).
+     */
+    void processRows(unsigned const* weights, int stride,
+                     int x_begin, int x_end, int num_rows);
+
     QImage visualizeHoughSpace(unsigned lower_bound) const;
 
     /**
@@ -124,6 +141,10 @@ public:
 private:
     class GreaterQualityFirst;
 
+    void voteRow(std::vector<unsigned>& hist, int y,
+                 unsigned const* weights, int x_begin, int x_end,
+                 std::vector<double>& row_offsets, std::vector<int>& bins) const;
+
     static BinaryImage findHistogramPeaks(
         std::vector<unsigned> const& hist, int width, int height,
         unsigned lower_bound);
@@ -166,6 +187,25 @@ private:
      */
     std::vector<QPointF> m_angleUnitVectors;
 
+    /**
+     * \brief Cosines of our angles divided by m_distanceResolution.
+     *
+     * Together with m_scaledSines and m_scaledBias, these map a point
+     * directly to a histogram column: for angle i, the column is
+     * int(m_scaledCosines[i] * x + m_scaledSines[i] * y + m_scaledBias).
+     */
+    std::vector<double> m_scaledCosines;
+
+    /**
+     * \brief Sines of our angles divided by m_distanceResolution.
+     */
+    std::vector<double> m_scaledSines;
+
+    /**
+     * m_distanceBias / m_distanceResolution + 0.5
+     */
+    double m_scaledBias;
+
     /**
      * \see HoughLineDetector:HoughLineDetector()
      */
@@ -0,0 +1,365 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageArena.h"
+#include <QThreadStorage>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <map>
+#include <memory>
+#include <new>
+#include <stdlib.h>
+#ifndef Q_OS_WIN
+#include <unistd.h>
+#endif
+
+namespace imageproc
+{
+
+namespace
+{
+
+/**
+ * Every block is preceded by a header of this size.  It's 16 bytes
+ * rather than sizeof(size_t) to keep the payload 16-byte aligned.
+ */
+size_t const HEADER_SIZE = 16;
+
+/** Blocks smaller than this are not pooled. */
+size_t const MIN_POOLED_SIZE = 64 * 1024;
+
+/** File name prefix of backing files, to recognize them after a crash. */
+char const BACKING_FILE_PREFIX[] = "scantailor-arena-";
+
+/** Retention limit across all threads, in MiB. */
+QAtomicInt g_maxRetainedMiB(128);
+
+struct BlockHeader
+{
+    size_t capacity;
+
+    /** The backing file for file-backed blocks, null otherwise. */
+    QFile* file;
+};
+
+static_assert(sizeof(BlockHeader) <= HEADER_SIZE, "BlockHeader doesn't fit");
+
+inline BlockHeader* headerOf(void* block)
+{
+    return reinterpret_cast<BlockHeader*>(static_cast<char*>(block) - HEADER_SIZE);
+}
+
+inline void* payloadOf(BlockHeader* header)
+{
+    return reinterpret_cast<char*>(header) + HEADER_SIZE;
+}
+
+/**
+ * Free blocks shared by all threads.  Only blocks of MIN_POOLED_SIZE
+ * or more get here, so taking a mutex is cheap compared to what's
+ * going to be done with such a block.
+ */
+class Pool
+{
+public:
+    Pool() : m_retainedBytes(0) {}
+
+    /**
+     * Returns a free block of at least \p size bytes, or null.
+     * Blocks more than 25% larger than requested are not considered,
+     * to avoid a small image pinning a huge buffer.
+     */
+    BlockHeader* take(size_t size)
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        FreeList::iterator const it(m_freeList.lower_bound(size));
+        if (it == m_freeList.end() || it->first > size + size / 4) {
+            return 0;
+        }
+
+        BlockHeader* header = it->second;
+        m_retainedBytes -= it->first;
+        m_freeList.erase(it);
+        return header;
+    }
+
+    void put(BlockHeader* header)
+    {
+        size_t const max_retained = size_t(g_maxRetainedMiB.load()) << 20;
+        if (header->capacity > max_retained) {
+            free(header);
+            return;
+        }
+
+        QMutexLocker const locker(&m_mutex);
+
+        // Evict the smallest blocks first, as they are the cheapest
+        // ones to allocate again.
+        while (m_retainedBytes + header->capacity > max_retained) {
+            FreeList::iterator const it(m_freeList.begin());
+            m_retainedBytes -= it->first;
+            free(it->second);
+            m_freeList.erase(it);
+        }
+
+        m_freeList.insert(FreeList::value_type(header->capacity, header));
+        m_retainedBytes += header->capacity;
+    }
+
+    void trim()
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        for (FreeList::value_type const& entry : m_freeList) {
+            free(entry.second);
+        }
+        m_freeList.clear();
+        m_retainedBytes = 0;
+    }
+private:
+    typedef std::multimap<size_t, BlockHeader*> FreeList;
+
+    QMutex m_mutex;
+    FreeList m_freeList;
+    size_t m_retainedBytes;
+};
+
+/**
+ * Per-thread state: allocation statistics and file backing settings.
+ */
+struct ThreadState
+{
+    ImageArena::Stats stats;
+    size_t fileBackingThreshold;
+
+    ThreadState() : fileBackingThreshold(0) {}
+};
+
+/**
+ * Creates a block backed by a temporary file.
+ * Returns null if the file couldn't be created or mapped,
+ * in which case the caller falls back to the heap.
+ *
+ * Except on Windows, the file is unlinked as soon as it's mapped,
+ * so it goes away with the process, even if the process crashes.
+ * Windows doesn't let us do that, so there we leave it to
+ * ImageArena::removeStaleBackingFiles() to clean up after a crash.
+ */
+BlockHeader* allocateFileBacked(size_t const size)
+{
+    std::unique_ptr<QTemporaryFile> file(
+        new QTemporaryFile(
+            QDir::temp().filePath(QLatin1String(BACKING_FILE_PREFIX) + "XXXXXX")
+        )
+    );
+    if (!file->open() || !file->resize(qint64(HEADER_SIZE + size))) {
+        return 0;
+    }
+
+    uchar* const addr = file->map(0, qint64(HEADER_SIZE + size));
+    if (!addr) {
+        return 0;
+    }
+
+#ifndef Q_OS_WIN
+    if (unlink(QFile::encodeName(file->fileName()).constData()) == 0) {
+        file->setAutoRemove(false);
+    }
+#endif
+
+    BlockHeader* const header = reinterpret_cast<BlockHeader*>(addr);
+    header->capacity = size;
+    header->file = file.release();
+    return header;
+}
+
+void releaseFileBacked(BlockHeader* const header)
+{
+    QFile* const file = header->file;
+    file->unmap(reinterpret_cast<uchar*>(header));
+    delete file; // QTemporaryFile removes the file, unless it's unlinked already.
+}
+
+Pool& sharedPool()
+{
+    // Deliberately leaked, so that images destroyed during static
+    // destruction can still be released.
+    static Pool* const pool = new Pool;
+    return *pool;
+}
+
+ThreadState& localState()
+{
+    // Leaked for the same reason as the pool.  Per-thread states are
+    // still destroyed when their threads finish.
+    static QThreadStorage<ThreadState*>* const storage = new QThreadStorage<ThreadState*>;
+
+    if (!storage->hasLocalData()) {
+        storage->setLocalData(new ThreadState);
+    }
+    return *storage->localData();
+}
+
+} // anonymous namespace
+
+void*
+ImageArena::allocate(size_t const size)
+{
+    ThreadState& state = localState();
+    state.stats.bytesRequested += size;
+
+    // The pool only holds heap blocks, which a file-backed
+    // request must not get, or RAM use wouldn't be bounded.
+    bool const file_backed = state.fileBackingThreshold != 0
+                             && size >= state.fileBackingThreshold;
+
+    if (!file_backed && size >= MIN_POOLED_SIZE) {
+        if (BlockHeader* header = sharedPool().take(size)) {
+            return payloadOf(header);
+        }
+    }
+
+    state.stats.bytesAllocated += size;
+
+    if (file_backed) {
+        if (BlockHeader* header = allocateFileBacked(size)) {
+            state.stats.bytesFileBacked += size;
+            return payloadOf(header);
+        }
+    }
+
+    void* const addr = malloc(HEADER_SIZE + size);
+    if (!addr) {
+        throw std::bad_alloc();
+    }
+
+    BlockHeader* const header = static_cast<BlockHeader*>(addr);
+    header->capacity = size;
+    header->file = 0;
+    return payloadOf(header);
+}
+
+void
+ImageArena::release(void* const block)
+{
+    if (!block) {
+        return;
+    }
+
+    BlockHeader* const header = headerOf(block);
+    if (header->file) {
+        releaseFileBacked(header);
+    } else if (header->capacity < MIN_POOLED_SIZE) {
+        free(header);
+    } else {
+        sharedPool().put(header);
+    }
+}
+
+void
+ImageArena::trim()
+{
+    sharedPool().trim();
+}
+
+void
+ImageArena::setMaxRetainedBytes(size_t const bytes)
+{
+    g_maxRetainedMiB.store(int(bytes >> 20));
+}
+
+void
+ImageArena::removeStaleBackingFiles()
+{
+    QDir const dir(QDir::temp());
+    QStringList const filters(QLatin1String(BACKING_FILE_PREFIX) + "*");
+    for (QFileInfo const& info : dir.entryInfoList(filters, QDir::Files)) {
+        // Files in use by another instance can't be removed on Windows,
+        // while elsewhere they are unlinked right after being created.
+        QFile::remove(info.absoluteFilePath());
+    }
+}
+
+ImageArena::Stats
+ImageArena::stats()
+{
+    return localState().stats;
+}
+
+/*====================== ImageArena::FileBackingScope =====================*/
+
+ImageArena::FileBackingScope::FileBackingScope(size_t const min_block_size)
+    :   m_prevThreshold(localState().fileBackingThreshold)
+{
+    localState().fileBackingThreshold = min_block_size;
+}
+
+ImageArena::FileBackingScope::~FileBackingScope()
+{
+    localState().fileBackingThreshold = m_prevThreshold;
+}
+
+/*============================ ImageArenaUsage ============================*/
+
+ImageArenaUsage::ImageArenaUsage()
+    :   m_start(ImageArena::stats())
+{
+}
+
+unsigned long long
+ImageArenaUsage::bytesRequested() const
+{
+    return ImageArena::stats().bytesRequested - m_start.bytesRequested;
+}
+
+unsigned long long
+ImageArenaUsage::bytesAllocated() const
+{
+    return ImageArena::stats().bytesAllocated - m_start.bytesAllocated;
+}
+
+unsigned long long
+ImageArenaUsage::bytesFileBacked() const
+{
+    return ImageArena::stats().bytesFileBacked - m_start.bytesFileBacked;
+}
+
+void
+ImageArenaUsage::print(char const* prefix) const
+{
+    unsigned long long const requested = bytesRequested();
+    unsigned long long const allocated = bytesAllocated();
+    unsigned long long const file_backed = bytesFileBacked();
+    if (file_backed == 0) {
+        qDebug() << prefix << (requested >> 20) << "MiB requested,"
+                 << (allocated >> 20) << "MiB allocated";
+    } else {
+        qDebug() << prefix << (requested >> 20) << "MiB requested,"
+                 << (allocated >> 20) << "MiB allocated, of which"
+                 << (file_backed >> 20) << "MiB file-backed";
+    }
+}
+
+} // namespace imageproc
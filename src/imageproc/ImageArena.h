@@ -0,0 +1,164 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_IMAGEARENA_H_
+#define IMAGEPROC_IMAGEARENA_H_
+
+#include "NonCopyable.h"
+#include <stddef.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief A pool of pixel buffers shared by all threads.
+ *
+ * BinaryImage and GrayImage take their pixel storage from here.
+ * Morphological operators and friends create lots of short-lived
+ * page-sized intermediates, and without pooling each of them means
+ * a trip to the system allocator plus fresh page faults.
+ * Released buffers are kept in a free list and handed out again
+ * to requests of a similar size, from whatever thread.  The total
+ * size of the retained buffers is capped by a single global limit.
+ *
+ * Small buffers are not pooled, as malloc() handles them well enough.
+ *
+ * For pages too big to fit in RAM, a FileBackingScope makes large
+ * allocations on the current thread come from memory-mapped temporary
+ * files instead.  Such blocks look like any other memory to the code
+ * using them, so every operator keeps working, while the OS is free
+ * to page them out to their files rather than to swap.  The files go
+ * to QDir::tempPath(), which may be redirected with TMPDIR (or TMP on
+ * Windows).  File-backed blocks are never pooled.  Note that whether
+ * file backing is in effect is a per-thread setting.
+ */
+class ImageArena
+{
+public:
+    /**
+     * \brief Allocation statistics of the calling thread.
+     *
+     * Both counters only ever grow.
+     */
+    struct Stats
+    {
+        /** Total size of all allocation requests. */
+        unsigned long long bytesRequested;
+
+        /** The part of bytesRequested that had to go to the system allocator. */
+        unsigned long long bytesAllocated;
+
+        /** The part of bytesAllocated that went to memory-mapped files. */
+        unsigned long long bytesFileBacked;
+
+        Stats() : bytesRequested(0), bytesAllocated(0), bytesFileBacked(0) {}
+    };
+
+    /**
+     * \brief Enables file-backed allocations on the current thread.
+     *
+     * While an instance is alive, blocks of \p min_block_size bytes
+     * or more allocated by the current thread are backed by temporary
+     * files.  Passing zero disables file backing.  Scopes may be nested.
+     * If a backing file can't be created, the heap is used instead.
+     */
+    class FileBackingScope
+    {
+        DECLARE_NON_COPYABLE(FileBackingScope)
+    public:
+        explicit FileBackingScope(size_t min_block_size);
+
+        ~FileBackingScope();
+    private:
+        size_t m_prevThreshold;
+    };
+
+    /**
+     * \brief Allocates a block of at least \p size bytes.
+     *
+     * The returned memory is 16-byte aligned and uninitialized.
+     * \throw std::bad_alloc
+     */
+    static void* allocate(size_t size);
+
+    /**
+     * \brief Returns a block previously obtained from allocate().
+     *
+     * The block may be released from a thread other than the one
+     * that allocated it.  Null pointers are ignored.
+     */
+    static void release(void* block);
+
+    /**
+     * \brief Frees all the retained blocks.
+     *
+     * Called when a batch finishes and when running out of memory.
+     * May be called from any thread.
+     */
+    static void trim();
+
+    /**
+     * \brief Limits the total amount of memory retained by the pool.
+     *
+     * The default is 128 MiB.
+     */
+    static void setMaxRetainedBytes(size_t bytes);
+
+    /**
+     * \brief Removes backing files left behind by crashed processes.
+     *
+     * To be called on startup.  Backing files of running processes
+     * are left alone.
+     */
+    static void removeStaleBackingFiles();
+
+    static Stats stats();
+};
+
+/**
+ * \brief Reports the arena traffic of the calling thread over a time span.
+ *
+ * Used the same way as PerformanceTimer:
+ * \code
+ * ImageArenaUsage usage;
+ * ...
+ * usage.print("processing: ");
+ * \endcode
+ */
+class ImageArenaUsage
+{
+public:
+    ImageArenaUsage();
+
+    /** Bytes requested from the arena since construction. */
+    unsigned long long bytesRequested() const;
+
+    /** Bytes that had to be obtained from the system allocator since construction. */
+    unsigned long long bytesAllocated() const;
+
+    /** The part of bytesAllocated() that went to memory-mapped files. */
+    unsigned long long bytesFileBacked() const;
+
+    void print(char const* prefix = "") const;
+private:
+    ImageArena::Stats const m_start;
+};
+
+} // namespace imageproc
+
+#endif
@@ -0,0 +1,368 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RunLengthImage.h"
+#include "BinaryImage.h"
+#include <QSize>
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+/**
+ * Sets bits [begin, end) in a line of a BinaryImage.
+ */
+void fillRun(uint32_t* line, int const begin, int const end)
+{
+    int const first_word = begin >> 5;
+    int const last_word = (end - 1) >> 5;
+    uint32_t const first_mask = ~uint32_t(0) >> (begin & 31);
+    uint32_t const last_mask = ~uint32_t(0) << (31 - ((end - 1) & 31));
+
+    if (first_word == last_word) {
+        line[first_word] |= first_mask & last_mask;
+        return;
+    }
+
+    line[first_word] |= first_mask;
+    for (int i = first_word + 1; i < last_word; ++i) {
+        line[i] = ~uint32_t(0);
+    }
+    line[last_word] |= last_mask;
+}
+
+} // anonymous namespace
+
+RunLengthImage::Run const*
+RunLengthImage::Rows::begin(int const row) const
+{
+    int const idx = row - m_firstRow;
+    assert(idx >= 0 && idx < int(m_rowEnds.size()));
+    return m_runs.data() + (idx == 0 ? 0 : m_rowEnds[idx - 1]);
+}
+
+RunLengthImage::Run const*
+RunLengthImage::Rows::end(int const row) const
+{
+    int const idx = row - m_firstRow;
+    assert(idx >= 0 && idx < int(m_rowEnds.size()));
+    return m_runs.data() + m_rowEnds[idx];
+}
+
+void
+RunLengthImage::Rows::merge(int const begin, int const end, size_t const row_begin_idx)
+{
+    if (m_runs.size() > row_begin_idx && m_runs.back().end >= begin) {
+        m_runs.back().end = std::max(m_runs.back().end, end);
+    } else {
+        m_runs.push_back(Run(begin, end));
+    }
+}
+
+RunLengthImage::RunLengthImage()
+{
+}
+
+RunLengthImage::RunLengthImage(QSize const& size, Rows const& rows)
+    :   m_size(size),
+        m_rows(rows)
+{
+}
+
+RunLengthImage::RunLengthImage(BinaryImage const& image)
+    :   m_size(image.size())
+{
+    int const width = image.width();
+    int const height = image.height();
+    int const last_word_idx = (width - 1) >> 5;
+    uint32_t const last_word_mask = ~uint32_t(0) << (31 - ((width - 1) & 31));
+
+    uint32_t const* line = image.data();
+    int const wpl = image.wordsPerLine();
+
+    for (int y = 0; y < height; ++y, line += wpl) {
+        int run_begin = -1;
+        for (int i = 0; i <= last_word_idx; ++i) {
+            uint32_t word = line[i];
+            if (i == last_word_idx) {
+                word &= last_word_mask;
+            }
+
+            // Whole words of the same color don't end or start a run.
+            if (word == 0) {
+                if (run_begin >= 0) {
+                    m_rows.append(run_begin, i << 5);
+                    run_begin = -1;
+                }
+                continue;
+            } else if (word == ~uint32_t(0) && run_begin >= 0) {
+                continue;
+            }
+
+            int const x0 = i << 5;
+            for (int bit = 0; bit < 32; ++bit) {
+                bool const black = (word >> (31 - bit)) & 1;
+                if (black) {
+                    if (run_begin < 0) {
+                        run_begin = x0 + bit;
+                    }
+                } else if (run_begin >= 0) {
+                    m_rows.append(run_begin, x0 + bit);
+                    run_begin = -1;
+                }
+            }
+        }
+        if (run_begin >= 0) {
+            m_rows.append(run_begin, width);
+        }
+        m_rows.finishRow();
+    }
+}
+
+BinaryImage
+RunLengthImage::toBinaryImage() const
+{
+    if (isNull()) {
+        return BinaryImage();
+    }
+
+    BinaryImage image(m_size, WHITE);
+    uint32_t* line = image.data();
+    int const wpl = image.wordsPerLine();
+
+    for (int y = 0; y < m_size.height(); ++y, line += wpl) {
+        Run const* const end = m_rows.end(y);
+        for (Run const* run = m_rows.begin(y); run != end; ++run) {
+            fillRun(line, run->begin, run->end);
+        }
+    }
+
+    return image;
+}
+
+RunLengthImage
+RunLengthImage::opened(QSize const& brick, BWColor const src_surroundings) const
+{
+    if (isNull()) {
+        throw std::invalid_argument("RunLengthImage::opened: image is null");
+    }
+    if (brick.isEmpty()) {
+        throw std::invalid_argument("RunLengthImage::opened: brick is empty");
+    }
+
+    int const width = m_size.width();
+    int const height = m_size.height();
+    int const bw = brick.width();
+    int const bh = brick.height();
+    bool const black_surroundings = src_surroundings == BLACK;
+
+    // An opening is an erosion followed by a dilation.  Erosion produces
+    // the positions of the brick's top-left corner where it fits into
+    // black areas, and dilation paints the brick at those positions.
+    // Both are separable into a horizontal and a vertical pass.
+    // With black surroundings, the brick may fit partially outside
+    // of the image, so positions extend beyond its top-left corner.
+    int const min_x = black_surroundings ? -(bw - 1) : 0;
+    int const end_x = black_surroundings ? width : width - bw + 1;
+    int const min_y = black_surroundings ? -(bh - 1) : 0;
+    int const end_y = black_surroundings ? height : height - bh + 1;
+    if (end_x <= min_x || end_y <= min_y) {
+        Rows empty(0);
+        for (int y = 0; y < height; ++y) {
+            empty.finishRow();
+        }
+        return RunLengthImage(m_size, empty);
+    }
+
+    // Horizontal erosion.  In a row, it's a matter of
+    // shrinking each run by the width of the brick.
+    Rows hor_eroded(0);
+    for (int y = 0; y < height; ++y) {
+        Run const* const end = m_rows.end(y);
+        for (Run const* run = m_rows.begin(y); run != end; ++run) {
+            int const begin = (black_surroundings && run->begin == 0) ? min_x : run->begin;
+            int const run_end = (black_surroundings && run->end == width) ? end_x + bw - 1 : run->end;
+            if (run_end - begin >= bw) {
+                hor_eroded.append(begin, run_end - bw + 1);
+            }
+        }
+        hor_eroded.finishRow();
+    }
+
+    // Rows above and below the image.
+    Rows outside(0);
+    if (black_surroundings) {
+        outside.append(min_x, end_x);
+    }
+    outside.finishRow();
+
+    // Vertical erosion, then vertical dilation.
+    Rows const eroded(
+        spreadVertically(hor_eroded, outside, min_y, end_y, bh, 1, INTERSECT)
+    );
+    hor_eroded = Rows();
+    Rows no_rows(0);
+    no_rows.finishRow();
+    Rows const dilated(
+        spreadVertically(eroded, no_rows, 0, height, bh, -1, UNITE)
+    );
+
+    // Horizontal dilation.  Growing runs may make them touch.
+    Rows result(0);
+    for (int y = 0; y < height; ++y) {
+        size_t const row_begin_idx = result.numRuns();
+        Run const* const end = dilated.end(y);
+        for (Run const* run = dilated.begin(y); run != end; ++run) {
+            int const begin = std::max(run->begin, 0);
+            int const run_end = std::min(run->end + bw - 1, width);
+            if (begin < run_end) {
+                result.merge(begin, run_end, row_begin_idx);
+            }
+        }
+        result.finishRow();
+    }
+
+    return RunLengthImage(m_size, result);
+}
+
+void
+RunLengthImage::unite(RunLengthImage const& other)
+{
+    if (other.m_size != m_size) {
+        throw std::invalid_argument("RunLengthImage::unite: images have different sizes");
+    }
+
+    Rows result(0);
+    for (int y = 0; y < m_size.height(); ++y) {
+        combine(
+            m_rows.begin(y), m_rows.end(y),
+            other.m_rows.begin(y), other.m_rows.end(y), UNITE, result
+        );
+        result.finishRow();
+    }
+
+    m_rows = result;
+}
+
+void
+RunLengthImage::combine(
+    Run const* a, Run const* const a_end, Run const* b, Run const* const b_end,
+    Op const op, Rows& out)
+{
+    if (op == INTERSECT) {
+        while (a != a_end && b != b_end) {
+            int const begin = std::max(a->begin, b->begin);
+            int const end = std::min(a->end, b->end);
+            if (begin < end) {
+                out.append(begin, end);
+            }
+            if (a->end < b->end) {
+                ++a;
+            } else {
+                ++b;
+            }
+        }
+    } else {
+        size_t const row_begin_idx = out.numRuns();
+        while (a != a_end || b != b_end) {
+            Run const* next;
+            if (b == b_end || (a != a_end && a->begin < b->begin)) {
+                next = a++;
+            } else {
+                next = b++;
+            }
+            out.merge(next->begin, next->end, row_begin_idx);
+        }
+    }
+}
+
+/**
+ * \brief Combines each row with the following or preceding rows.
+ *
+ * Computes rows [first_row, end_row) of the result, where a row y is
+ * the intersection or union of rows y, y + direction, ..., y + direction
+ * * (extent - 1) of \p src.  Rows not present in \p src are taken to be
+ * the only row of \p outside.  This is done by combining pairs of rows
+ * at doubling distances, so the cost is O(runs * log(extent)).
+ */
+RunLengthImage::Rows
+RunLengthImage::spreadVertically(
+    Rows const& src, Rows const& outside, int const first_row, int const end_row,
+    int const extent, int const direction, Op const op)
+{
+    assert(direction == 1 || direction == -1);
+
+    Run const* const outside_begin = outside.begin(outside.firstRow());
+    Run const* const outside_end = outside.end(outside.firstRow());
+
+    // Level 1: the source rows that will be needed,
+    // including the ones not present in src.
+    int level_first = direction > 0 ? first_row : first_row - (extent - 1);
+    int level_end = direction > 0 ? end_row + (extent - 1) : end_row;
+    Rows level(level_first);
+    for (int y = level_first; y < level_end; ++y) {
+        if (y >= src.firstRow() && y < src.endRow()) {
+            combine(src.begin(y), src.end(y), nullptr, nullptr, UNITE, level);
+        } else {
+            combine(outside_begin, outside_end, nullptr, nullptr, UNITE, level);
+        }
+        level.finishRow();
+    }
+
+    // Level 2 * span covers rows y .. y + direction * (2 * span - 1).
+    int span = 1;
+    for (; span * 2 <= extent; span *= 2) {
+        if (direction > 0) {
+            level_end -= span;
+        } else {
+            level_first += span;
+        }
+
+        Rows next_level(level_first);
+        for (int y = level_first; y < level_end; ++y) {
+            int const other = y + direction * span;
+            combine(
+                level.begin(y), level.end(y),
+                level.begin(other), level.end(other), op, next_level
+            );
+            next_level.finishRow();
+        }
+        level = next_level;
+    }
+
+    // Two overlapping spans cover the whole extent.
+    Rows result(first_row);
+    int const shift = direction * (extent - span);
+    for (int y = first_row; y < end_row; ++y) {
+        combine(
+            level.begin(y), level.end(y),
+            level.begin(y + shift), level.end(y + shift), op, result
+        );
+        result.finishRow();
+    }
+
+    return result;
+}
+
+} // namespace imageproc
@@ -0,0 +1,135 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_RUNLENGTHIMAGE_H_
+#define IMAGEPROC_RUNLENGTHIMAGE_H_
+
+#include "BWColor.h"
+#include <QSize>
+#include <vector>
+#include <stddef.h>
+
+namespace imageproc
+{
+
+class BinaryImage;
+
+/**
+ * \brief A binary image stored as runs of black pixels, row by row.
+ *
+ * Morphological operations with long bricks, like those used to
+ * detect shadows and lines, cost O(pixels * log(brick)) in a bitmap,
+ * but only O(runs * log(brick height)) here, horizontal brick size
+ * being free.  Converting from and to a BinaryImage is a single
+ * pass over its words.
+ */
+class RunLengthImage
+{
+    // Member-wise copying is OK.
+public:
+    RunLengthImage();
+
+    explicit RunLengthImage(BinaryImage const& image);
+
+    BinaryImage toBinaryImage() const;
+
+    QSize size() const { return m_size; }
+
+    bool isNull() const { return m_size.isEmpty(); }
+
+    /**
+     * \brief Same as openBrick(image, brick, src_surroundings).
+     *
+     * \param brick The brick to fit into black areas.
+     * \param src_surroundings The color of pixels that are assumed to
+     *        surround the image.  If set to BLACK, a brick will be able
+     *        to fit by going partially off the image area.
+     */
+    RunLengthImage opened(QSize const& brick, BWColor src_surroundings = WHITE) const;
+
+    /**
+     * \brief Makes black the pixels that are black in \p other.
+     *
+     * The images must have the same size.
+     */
+    void unite(RunLengthImage const& other);
+private:
+    struct Run
+    {
+        int begin;
+        int end; // exclusive
+
+        Run(int b, int e) : begin(b), end(e) {}
+    };
+
+    /**
+     * Sorted, non-touching runs, row by row.  Rows are numbered
+     * from firstRow() and may lie outside of the image area.
+     */
+    class Rows
+    {
+    public:
+        explicit Rows(int first_row = 0) : m_firstRow(first_row) {}
+
+        int firstRow() const { return m_firstRow; }
+
+        int endRow() const { return m_firstRow + int(m_rowEnds.size()); }
+
+        Run const* begin(int row) const;
+
+        Run const* end(int row) const;
+
+        void append(int begin, int end) { m_runs.push_back(Run(begin, end)); }
+
+        /**
+         * To be called after appending all runs of a row.
+         */
+        void finishRow() { m_rowEnds.push_back(m_runs.size()); }
+
+        /**
+         * Appends a run, merging it with the last one of the
+         * current row if they overlap or touch.
+         */
+        void merge(int begin, int end, size_t row_begin_idx);
+
+        size_t numRuns() const { return m_runs.size(); }
+    private:
+        std::vector<Run> m_runs;
+        std::vector<size_t> m_rowEnds;
+        int m_firstRow;
+    };
+
+    enum Op { INTERSECT, UNITE };
+
+    static void combine(
+        Run const* a, Run const* a_end, Run const* b, Run const* b_end,
+        Op op, Rows& out);
+
+    static Rows spreadVertically(
+        Rows const& src, Rows const& outside, int first_row, int end_row,
+        int extent, int direction, Op op);
+
+    RunLengthImage(QSize const& size, Rows const& rows);
+
+    QSize m_size;
+    Rows m_rows;
+};
+
+} // namespace imageproc
+
+#endif
@@ -25,6 +25,7 @@
 #include "Morphology.h"
 #include "SeedFill.h"
 #include "RasterOp.h"
+#include <QRect>
 #include <algorithm>
 #include <string.h>
 #include <math.h>
@@ -33,6 +34,16 @@
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * The number of columns processed together by processColumns().
+ */
+int const COLUMN_STRIP_WIDTH = 64;
+
+} // anonymous namespace
+
 // Note that -1 is an implementation detail.
 // It exists to make sure INF_DIST + 1 doesn't overflow.
 uint32_t const SEDM::INF_DIST = ~uint32_t(0) - 1;
@@ -55,60 +66,34 @@ SEDM::SEDM(
         return;
     }
 
-    int const width = m_size.width();
-    int const height = m_size.height();
-
-    m_data.resize((width + 2) * (height + 2), INF_DIST);
-    m_stride = width + 2;
-    m_pData = &m_data[0] + m_stride + 1;
-
-    if (borders & DIST_TO_TOP_BORDER) {
-        memset(&m_data[0], 0, m_stride * sizeof(m_data[0]));
-    }
-    if (borders & DIST_TO_BOTTOM_BORDER) {
-        memset(
-            &m_data[m_data.size() - m_stride],
-            0, m_stride * sizeof(m_data[0])
-        );
-    }
-    if (borders & (DIST_TO_LEFT_BORDER | DIST_TO_RIGHT_BORDER)) {
-        int const last = m_stride - 1;
-        uint32_t* line = &m_data[0];
-        for (int todo = height + 2; todo > 0; --todo) {
-            if (borders & DIST_TO_LEFT_BORDER) {
-                line[0] = 0;
-            }
-            if (borders & DIST_TO_RIGHT_BORDER) {
-                line[last] = 0;
-            }
-            line += m_stride;
-        }
-    }
+    initDistances(image, dist_type, borders);
+    processColumns();
+    processRows(0, m_size.height() + 1);
+}
 
-    uint32_t initial_distance[2];
-    if (dist_type == DIST_TO_WHITE) {
-        initial_distance[0] = 0; // white
-        initial_distance[1] = INF_DIST; // black
-    } else {
-        initial_distance[0] = INF_DIST; // white
-        initial_distance[1] = 0; // black
+SEDM::SEDM(
+    BinaryImage const& image, QRect const& roi,
+    DistType const dist_type, Borders const borders)
+    :   m_pData(0),
+        m_size(image.size()),
+        m_stride(0)
+{
+    if (image.isNull()) {
+        return;
     }
 
-    uint32_t* p_dist = m_pData;
-    uint32_t const* img_line = image.data();
-    int const img_stride = image.wordsPerLine();
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x, ++p_dist) {
-            uint32_t word = img_line[x >> 5];
-            word >>= 31 - (x & 31);
-            *p_dist = initial_distance[word & 1];
-        }
-        p_dist += 2;
-        img_line += img_stride;
-    }
+    initDistances(image, dist_type, borders);
 
+    // The column pass has to cover the whole image, as the nearest object
+    // for a cell inside the ROI may be located outside of it.  The row pass,
+    // on the other hand, only needs to cover the lines of the ROI.
     processColumns();
-    processRows();
+
+    QRect const bounded_roi(roi.intersected(image.rect()));
+    if (!bounded_roi.isEmpty()) {
+        // Line 0 is the top padding line.
+        processRows(bounded_roi.top() + 1, bounded_roi.bottom() + 1);
+    }
 }
 
 SEDM::SEDM(ConnectivityMap& cmap)
@@ -219,6 +204,67 @@ SEDM::findPeaksDestructive()
     return peak_candidates;
 }
 
+void
+SEDM::initDistances(
+    BinaryImage const& image, DistType const dist_type,
+    Borders const borders)
+{
+    int const width = m_size.width();
+    int const height = m_size.height();
+
+    m_data.resize((width + 2) * (height + 2), INF_DIST);
+    m_stride = width + 2;
+    m_pData = &m_data[0] + m_stride + 1;
+
+    if (borders & DIST_TO_TOP_BORDER) {
+        memset(&m_data[0], 0, m_stride * sizeof(m_data[0]));
+    }
+    if (borders & DIST_TO_BOTTOM_BORDER) {
+        memset(
+            &m_data[m_data.size() - m_stride],
+            0, m_stride * sizeof(m_data[0])
+        );
+    }
+    if (borders & (DIST_TO_LEFT_BORDER | DIST_TO_RIGHT_BORDER)) {
+        int const last = m_stride - 1;
+        uint32_t* line = &m_data[0];
+        for (int todo = height + 2; todo > 0; --todo) {
+            if (borders & DIST_TO_LEFT_BORDER) {
+                line[0] = 0;
+            }
+            if (borders & DIST_TO_RIGHT_BORDER) {
+                line[last] = 0;
+            }
+            line += m_stride;
+        }
+    }
+
+    uint32_t initial_distance[2];
+    if (dist_type == DIST_TO_WHITE) {
+        initial_distance[0] = 0; // white
+        initial_distance[1] = INF_DIST; // black
+    } else {
+        initial_distance[0] = INF_DIST; // white
+        initial_distance[1] = 0; // black
+    }
+
+    uint32_t* const dist_data = m_pData;
+    int const dist_stride = m_stride;
+    uint32_t const* const img_data = image.data();
+    int const img_stride = image.wordsPerLine();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        uint32_t* const dist_line = dist_data + y * dist_stride;
+        uint32_t const* const img_line = img_data + y * img_stride;
+        for (int x = 0; x < width; ++x) {
+            uint32_t word = img_line[x >> 5];
+            word >>= 31 - (x & 31);
+            dist_line[x] = initial_distance[word & 1];
+        }
+    }
+}
+
 inline uint32_t
 SEDM::distSq(
     int const x1, int const x2, uint32_t const dy_sq)
@@ -231,37 +277,56 @@ SEDM::distSq(
     return dx_sq + dy_sq;
 }
 
+/**
+ * Columns are independent from each other, so we split them into strips
+ * processed in parallel.  Within a strip, columns are processed in lockstep,
+ * line by line, which keeps memory access sequential.
+ */
 void
 SEDM::processColumns()
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    int const num_strips = (width + COLUMN_STRIP_WIDTH - 1) / COLUMN_STRIP_WIDTH;
+    uint32_t* const data = &m_data[0];
+
+    #pragma omp parallel for schedule(static)
+    for (int strip = 0; strip < num_strips; ++strip) {
+        int const x0 = strip * COLUMN_STRIP_WIDTH;
+        int const strip_width = std::min<int>(COLUMN_STRIP_WIDTH, width - x0);
 
-    uint32_t* p_sqd = &m_data[0];
-    for (int x = 0; x < width; ++x, ++p_sqd) {
         // (d + 1)^2 = d^2 + 2d + 1
-        uint32_t b = 1; // 2d + 1 in the above formula.
+        uint32_t b[COLUMN_STRIP_WIDTH]; // 2d + 1 in the above formula.
+
+        std::fill(b, b + strip_width, 1);
+        uint32_t* p_sqd = data + x0;
         for (int todo = height - 1; todo > 0; --todo) {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd += width;
-            if (*p_sqd > sqd) {
-                *p_sqd = sqd;
-                b += 2;
-            } else {
-                b = 1;
+            uint32_t* const p_next = p_sqd + width;
+            for (int i = 0; i < strip_width; ++i) {
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (p_next[i] > sqd) {
+                    p_next[i] = sqd;
+                    b[i] += 2;
+                } else {
+                    b[i] = 1;
+                }
             }
+            p_sqd = p_next;
         }
 
-        b = 1;
+        std::fill(b, b + strip_width, 1);
         for (int todo = height - 1; todo > 0; --todo) {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd -= width;
-            if (*p_sqd > sqd) {
-                *p_sqd = sqd;
-                b += 2;
-            } else {
-                b = 1;
+            uint32_t* const p_next = p_sqd - width;
+            for (int i = 0; i < strip_width; ++i) {
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (p_next[i] > sqd) {
+                    p_next[i] = sqd;
+                    b[i] += 2;
+                } else {
+                    b[i] = 1;
+                }
             }
+            p_sqd = p_next;
         }
     }
 }
@@ -271,88 +336,77 @@ SEDM::processColumns(ConnectivityMap& cmap)
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    int const num_strips = (width + COLUMN_STRIP_WIDTH - 1) / COLUMN_STRIP_WIDTH;
+    uint32_t* const data = &m_data[0];
+    uint32_t* const labels = cmap.paddedData();
+
+    #pragma omp parallel for schedule(static)
+    for (int strip = 0; strip < num_strips; ++strip) {
+        int const x0 = strip * COLUMN_STRIP_WIDTH;
+        int const strip_width = std::min<int>(COLUMN_STRIP_WIDTH, width - x0);
 
-    uint32_t* p_sqd = &m_data[0];
-    uint32_t* p_label = cmap.paddedData();
-    for (int x = 0; x < width; ++x, ++p_sqd, ++p_label) {
         // (d + 1)^2 = d^2 + 2d + 1
-        uint32_t b = 1; // 2d + 1 in the above formula.
+        uint32_t b[COLUMN_STRIP_WIDTH]; // 2d + 1 in the above formula.
+
+        std::fill(b, b + strip_width, 1);
+        uint32_t* p_sqd = data + x0;
+        uint32_t* p_label = labels + x0;
         for (int todo = height - 1; todo > 0; --todo) {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd += width;
-            p_label += width;
-            if (sqd < *p_sqd) {
-                *p_sqd = sqd;
-                *p_label = p_label[-width];
-                b += 2;
-            } else {
-                b = 1;
+            uint32_t* const p_next = p_sqd + width;
+            uint32_t* const p_next_label = p_label + width;
+            for (int i = 0; i < strip_width; ++i) {
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (sqd < p_next[i]) {
+                    p_next[i] = sqd;
+                    p_next_label[i] = p_label[i];
+                    b[i] += 2;
+                } else {
+                    b[i] = 1;
+                }
             }
+            p_sqd = p_next;
+            p_label = p_next_label;
         }
 
-        b = 1;
+        std::fill(b, b + strip_width, 1);
         for (int todo = height - 1; todo > 0; --todo) {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd -= width;
-            p_label -= width;
-            if (sqd < *p_sqd) {
-                *p_sqd = sqd;
-                *p_label = p_label[width];
-                b += 2;
-            } else {
-                b = 1;
+            uint32_t* const p_next = p_sqd - width;
+            uint32_t* const p_next_label = p_label - width;
+            for (int i = 0; i < strip_width; ++i) {
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (sqd < p_next[i]) {
+                    p_next[i] = sqd;
+                    p_next_label[i] = p_label[i];
+                    b[i] += 2;
+                } else {
+                    b[i] = 1;
+                }
             }
+            p_sqd = p_next;
+            p_label = p_next_label;
         }
     }
 }
 
+/**
+ * Lines are independent from each other, so they are processed in parallel,
+ * each thread having its own scratch buffers.
+ */
 void
-SEDM::processRows()
+SEDM::processRows(int const first_line, int const last_line)
 {
     int const width = m_size.width() + 2;
-    int const height = m_size.height() + 2;
+    uint32_t* const data = &m_data[0];
 
-    std::vector<int> s(width, 0);
-    std::vector<int> t(width, 0);
-    std::vector<uint32_t> row_copy(width, 0);
-
-    uint32_t* line = &m_data[0];
-    for (int y = 0; y < height; ++y, line += width) {
-        int q = 0;
-        s[0] = 0;
-        t[0] = 0;
-        for (int x = 1; x < width; ++x) {
-            while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-                    > distSq(t[q], x, line[x])) {
-                --q;
-            }
+    #pragma omp parallel
+    {
+        std::vector<int> s(width, 0);
+        std::vector<int> t(width, 0);
+        std::vector<uint32_t> row_copy(width, 0);
 
-            if (q < 0) {
-                q = 0;
-                s[0] = x;
-            } else {
-                int const x2 = s[q];
-                if (line[x] != INF_DIST && line[x2] != INF_DIST) {
-                    int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-                    w /= (x - x2) << 1;
-                    ++w;
-                    if ((unsigned)w < (unsigned)width) {
-                        ++q;
-                        s[q] = x;
-                        t[q] = w;
-                    }
-                }
-            }
-        }
-
-        memcpy(&row_copy[0], line, width * sizeof(*line));
-
-        for (int x = width - 1; x >= 0; --x) {
-            int const x2 = s[q];
-            line[x] = distSq(x, x2, row_copy[x2]);
-            if (x == t[q]) {
-                --q;
-            }
+        #pragma omp for schedule(static)
+        for (int y = first_line; y <= last_line; ++y) {
+            processRow(data + y * width, 0, width, &s[0], &t[0], &row_copy[0], 0);
         }
     }
 }
@@ -362,52 +416,78 @@ SEDM::processRows(ConnectivityMap& cmap)
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    uint32_t* const data = &m_data[0];
+    uint32_t* const labels = cmap.paddedData();
+
+    #pragma omp parallel
+    {
+        std::vector<int> s(width, 0);
+        std::vector<int> t(width, 0);
+        std::vector<uint32_t> row_copy(width, 0);
+        std::vector<uint32_t> cmap_row_copy(width, 0);
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; ++y) {
+            processRow(
+                data + y * width, labels + y * width, width,
+                &s[0], &t[0], &row_copy[0], &cmap_row_copy[0]
+            );
+        }
+    }
+}
 
-    std::vector<int> s(width, 0);
-    std::vector<int> t(width, 0);
-    std::vector<uint32_t> row_copy(width, 0);
-    std::vector<uint32_t> cmap_row_copy(width, 0);
-
-    uint32_t* line = &m_data[0];
-    uint32_t* cmap_line = cmap.paddedData();
-    for (int y = 0; y < height; ++y, line += width, cmap_line += width) {
-        int q = 0;
-        s[0] = 0;
-        t[0] = 0;
-        for (int x = 1; x < width; ++x) {
-            while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-                    > distSq(t[q], x, line[x])) {
-                --q;
-            }
+/**
+ * Computes the lower envelope of parabolas rooted at every cell
+ * of the line, then samples it.  If \p cmap_line is not null,
+ * labels are propagated along with distances.
+ */
+void
+SEDM::processRow(
+    uint32_t* const line, uint32_t* const cmap_line, int const width,
+    int* const s, int* const t, uint32_t* const row_copy,
+    uint32_t* const cmap_row_copy)
+{
+    int q = 0;
+    s[0] = 0;
+    t[0] = 0;
+    for (int x = 1; x < width; ++x) {
+        while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+                > distSq(t[q], x, line[x])) {
+            --q;
+        }
 
-            if (q < 0) {
-                q = 0;
-                s[0] = x;
-            } else {
-                int const x2 = s[q];
-                if (line[x] != INF_DIST && line[x2] != INF_DIST) {
-                    int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-                    w /= (x - x2) << 1;
-                    ++w;
-                    if ((unsigned)w < (unsigned)width) {
-                        ++q;
-                        s[q] = x;
-                        t[q] = w;
-                    }
+        if (q < 0) {
+            q = 0;
+            s[0] = x;
+        } else {
+            int const x2 = s[q];
+            if (line[x] != INF_DIST && line[x2] != INF_DIST) {
+                int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+                w /= (x - x2) << 1;
+                ++w;
+                if ((unsigned)w < (unsigned)width) {
+                    ++q;
+                    s[q] = x;
+                    t[q] = w;
                 }
             }
         }
+    }
 
-        memcpy(&row_copy[0], line, width * sizeof(*line));
-        memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+    memcpy(row_copy, line, width * sizeof(*line));
 
-        for (int x = width - 1; x >= 0; --x) {
-            int const x2 = s[q];
-            line[x] = distSq(x, x2, row_copy[x2]);
+    if (cmap_line) {
+        memcpy(cmap_row_copy, cmap_line, width * sizeof(*cmap_line));
+    }
+
+    for (int x = width - 1; x >= 0; --x) {
+        int const x2 = s[q];
+        line[x] = distSq(x, x2, row_copy[x2]);
+        if (cmap_line) {
             cmap_line[x] = cmap_row_copy[x2];
-            if (x == t[q]) {
-                --q;
-            }
+        }
+        if (x == t[q]) {
+            --q;
         }
     }
 }
@@ -24,6 +24,8 @@
 #include <QSize>
 #include <stdint.h>
 
+class QRect;
+
 namespace imageproc
 {
 
@@ -111,6 +113,25 @@ public:
         BinaryImage const& image, DistType dist_type = DIST_TO_WHITE,
         Borders borders = DIST_TO_ALL_BORDERS);
 
+    /**
+     * \brief Build a distance map from a binary image, restricted
+     *        to a region of interest.
+     *
+     * Works like the constructor above, except exact distances are
+     * only guaranteed for cells inside \p roi.  Objects outside
+     * of \p roi are still taken into account.  Cells outside
+     * of \p roi hold upper bounds of their exact distances.
+     * This is cheaper than building a full distance map,
+     * as the horizontal pass is limited to the lines of \p roi.
+     *
+     * \note findPeaksDestructive() is only meaningful on
+     *       distance maps built without a region of interest.
+     */
+    SEDM(
+        BinaryImage const& image, QRect const& roi,
+        DistType dist_type = DIST_TO_WHITE,
+        Borders borders = DIST_TO_ALL_BORDERS);
+
     /**
      * \brief Build a distance map from a connectivity map.
      *
@@ -186,14 +207,23 @@ public:
 private:
     static uint32_t distSq(int x1, int x2, uint32_t dy_sq);
 
+    void initDistances(BinaryImage const& image, DistType dist_type, Borders borders);
+
     void processColumns();
 
     void processColumns(ConnectivityMap& cmap);
 
-    void processRows();
+    /**
+     * Processes padded lines in [first_line, last_line] range.
+     */
+    void processRows(int first_line, int last_line);
 
     void processRows(ConnectivityMap& cmap);
 
+    static void processRow(
+        uint32_t* line, uint32_t* cmap_line, int width,
+        int* s, int* t, uint32_t* row_copy, uint32_t* cmap_row_copy);
+
     BinaryImage findPeakCandidatesNonPadded() const;
 
     BinaryImage buildEqualMapNonPadded(uint32_t const* src1, uint32_t const* src2) const;
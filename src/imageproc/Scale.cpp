@@ -21,7 +21,9 @@
 #include <QImage>
 #include <QSize>
 #include <stdexcept>
+#include <vector>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
 namespace imageproc
@@ -103,7 +105,7 @@ static GrayImage scaleUpIntGrayToGray(GrayImage const& src, QSize const& dst_siz
 
     int sy = 0;
     int dy = 0;
-    for (; dy < dh; ++sy, dy += xscale) {
+    for (; dy < dh; ++sy, dy += yscale) {
         int sx = 0;
         int dx = 0;
 
@@ -380,6 +382,313 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
     return dst;
 }
 
+/*============================ Fast versions ============================*/
+
+/**
+ * Describes which source pixels contribute to a destination pixel along
+ * one axis, and with what weights.  Weights are in 1/32 of a pixel.
+ * Source pixels strictly between \p first and \p last have
+ * the weight of 32.
+ */
+struct BoxSpan
+{
+    int first;
+    int last;
+    unsigned firstWeight;
+    unsigned lastWeight;
+    unsigned totalWeight;
+};
+
+/**
+ * Builds a table of BoxSpan's, one for each destination pixel.
+ * The source pixel boundaries are calculated exactly the same way
+ * scaleGrayToGray() calculates them.
+ */
+static void buildBoxTable(std::vector<BoxSpan>& table, int const dst_len, double const d2s32)
+{
+    table.resize(dst_len);
+
+    int s32_end = 0;
+    for (int d = 0; d < dst_len; ++d) {
+        int const s32_begin = s32_end;
+        s32_end = (int)((d + 1) * d2s32);
+
+        BoxSpan& span = table[d];
+        span.first = s32_begin >> 5;
+        span.last = (s32_end - 1) >> 5;
+        span.totalWeight = s32_end - s32_begin;
+        if (span.first == span.last) {
+            span.firstWeight = span.totalWeight;
+            span.lastWeight = 0;
+        } else {
+            span.firstWeight = 32 - (s32_begin & 31);
+            span.lastWeight = s32_end - (span.last << 5);
+        }
+    }
+}
+
+/**
+ * A row-parallel version of scaleDownIntGrayToGray().
+ * Source lines of a block are first summed into a line of accumulators,
+ * which is then reduced horizontally.  The results are identical.
+ */
+static GrayImage scaleDownIntGrayToGrayFast(GrayImage const& src, QSize const& dst_size)
+{
+    int const sw = src.width();
+    int const dw = dst_size.width();
+    int const dh = dst_size.height();
+
+    int const xscale = sw / dw;
+    int const yscale = src.height() / dh;
+    unsigned const total_area = xscale * yscale;
+
+    GrayImage dst(dst_size);
+
+    uint8_t const* const src_data = src.data();
+    uint8_t* const dst_data = dst.data();
+    int const src_stride = src.stride();
+    int const dst_stride = dst.stride();
+
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> acc(sw);
+
+        #pragma omp for schedule(static)
+        for (int dy = 0; dy < dh; ++dy) {
+            uint8_t const* src_line = src_data + dy * yscale * src_stride;
+            uint8_t* const dst_line = dst_data + dy * dst_stride;
+
+            for (int x = 0; x < sw; ++x) {
+                acc[x] = src_line[x];
+            }
+            for (int i = 1; i < yscale; ++i) {
+                src_line += src_stride;
+                for (int x = 0; x < sw; ++x) {
+                    acc[x] += src_line[x];
+                }
+            }
+
+            uint32_t const* p_acc = &acc[0];
+            for (int dx = 0; dx < dw; ++dx, p_acc += xscale) {
+                unsigned gray_level = 0;
+                for (int j = 0; j < xscale; ++j) {
+                    gray_level += p_acc[j];
+                }
+                unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+                assert(pix_value < 256);
+                dst_line[dx] = static_cast<uint8_t>(pix_value);
+            }
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * A row-parallel version of scaleUpIntGrayToGray().
+ * Only the first line of every block is built pixel by pixel,
+ * the rest are copied from it.
+ */
+static GrayImage scaleUpIntGrayToGrayFast(GrayImage const& src, QSize const& dst_size)
+{
+    int const sw = src.width();
+    int const sh = src.height();
+    int const dw = dst_size.width();
+
+    int const xscale = dw / sw;
+    int const yscale = dst_size.height() / sh;
+
+    GrayImage dst(dst_size);
+
+    uint8_t const* const src_data = src.data();
+    uint8_t* const dst_data = dst.data();
+    int const src_stride = src.stride();
+    int const dst_stride = dst.stride();
+
+    #pragma omp parallel for schedule(static)
+    for (int sy = 0; sy < sh; ++sy) {
+        uint8_t const* const src_line = src_data + sy * src_stride;
+        uint8_t* const dst_line = dst_data + sy * yscale * dst_stride;
+
+        uint8_t* pdst = dst_line;
+        for (int sx = 0; sx < sw; ++sx, pdst += xscale) {
+            uint8_t const pix = src_line[sx];
+            for (int j = 0; j < xscale; ++j) {
+                pdst[j] = pix;
+            }
+        }
+
+        for (int i = 1; i < yscale; ++i) {
+            memcpy(dst_line + i * dst_stride, dst_line, dw);
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * A row-parallel version of scaleUpGrayToGray().
+ *
+ * Horizontal source positions and fractions are computed once for every
+ * destination column.  For every destination line, the two source lines
+ * are first blended vertically, and then horizontally using the table.
+ * As the bilinear weights are separable, the results are identical.
+ */
+static GrayImage scaleUpGrayToGrayFast(GrayImage const& src, QSize const& dst_size)
+{
+    int const sw = src.width();
+    int const sh = src.height();
+    int const dw = dst_size.width();
+    int const dh = dst_size.height();
+
+    double const dx2sx32 = calc32xRatio1(dw, sw);
+    double const dy2sy32 = calc32xRatio1(dh, sh);
+
+    std::vector<int> col_sx(dw);
+    std::vector<unsigned> col_right_fraction(dw);
+    for (int dx = 0; dx < dw; ++dx) {
+        int const sx32 = (int)(dx * dx2sx32);
+        col_sx[dx] = sx32 >> 5;
+        col_right_fraction[dx] = sx32 & 31;
+        assert(col_sx[dx] + 1 < sw); // calc32xRatio1() ensures that.
+    }
+
+    GrayImage dst(dst_size);
+
+    uint8_t const* const src_data = src.data();
+    uint8_t* const dst_data = dst.data();
+    int const src_stride = src.stride();
+    int const dst_stride = dst.stride();
+
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> blended(sw);
+
+        #pragma omp for schedule(static)
+        for (int dy = 0; dy < dh; ++dy) {
+            int const sy32 = (int)(dy * dy2sy32);
+            int const sy = sy32 >> 5;
+            unsigned const top_fraction = 32 - (sy32 & 31);
+            unsigned const bottom_fraction = sy32 & 31;
+            assert(sy + 1 < sh); // calc32xRatio1() ensures that.
+
+            uint8_t const* const top_line = src_data + sy * src_stride;
+            uint8_t const* const bottom_line = top_line + src_stride;
+            for (int x = 0; x < sw; ++x) {
+                blended[x] = top_line[x] * top_fraction + bottom_line[x] * bottom_fraction;
+            }
+
+            uint8_t* const dst_line = dst_data + dy * dst_stride;
+            for (int dx = 0; dx < dw; ++dx) {
+                uint32_t const* const p = &blended[col_sx[dx]];
+                unsigned const right_fraction = col_right_fraction[dx];
+                unsigned const gray_level = p[0] * (32 - right_fraction) + p[1] * right_fraction;
+
+                unsigned const total_area = 32 * 32;
+                unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+                assert(pix_value < 256);
+                dst_line[dx] = static_cast<uint8_t>(pix_value);
+            }
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * A row-parallel version of scaleGrayToGray().
+ *
+ * The area weights used by scaleGrayToGray() are products of horizontal
+ * and vertical weights, so we apply them separately: first the source lines
+ * covered by a destination line are accumulated with their vertical weights,
+ * then every destination pixel is computed from the accumulators using
+ * a precomputed table of horizontal weights.  The arithmetic is exactly
+ * the same as in scaleGrayToGray(), so are the results.
+ */
+static GrayImage scaleGrayToGrayFast(GrayImage const& src, QSize const& dst_size)
+{
+    int const sw = src.width();
+    int const sh = src.height();
+    int const dw = dst_size.width();
+    int const dh = dst_size.height();
+
+    // Try versions optimized for a particular case.
+    if (sw == dw && sh == dh) {
+        return src;
+    } else if (sw % dw == 0 && sh % dh == 0) {
+        return scaleDownIntGrayToGrayFast(src, dst_size);
+    } else if (dw % sw == 0 && dh % sh == 0) {
+        return scaleUpIntGrayToGrayFast(src, dst_size);
+    } else if (dw > sw && dh > sh) {
+        return scaleUpGrayToGrayFast(src, dst_size);
+    }
+
+    std::vector<BoxSpan> cols;
+    std::vector<BoxSpan> rows;
+    buildBoxTable(cols, dw, calc32xRatio2(dw, sw));
+    buildBoxTable(rows, dh, calc32xRatio2(dh, sh));
+
+    GrayImage dst(dst_size);
+
+    uint8_t const* const src_data = src.data();
+    uint8_t* const dst_data = dst.data();
+    int const src_stride = src.stride();
+    int const dst_stride = dst.stride();
+
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> acc(sw);
+
+        #pragma omp for schedule(static)
+        for (int dy = 0; dy < dh; ++dy) {
+            BoxSpan const& row = rows[dy];
+            assert(row.last < sh); // calc32xRatio2() ensures that.
+
+            uint8_t const* src_line = src_data + row.first * src_stride;
+            unsigned const first_weight = row.firstWeight;
+            for (int x = 0; x < sw; ++x) {
+                acc[x] = src_line[x] * first_weight;
+            }
+
+            if (row.last != row.first) {
+                for (int sy = row.first + 1; sy < row.last; ++sy) {
+                    src_line += src_stride;
+                    for (int x = 0; x < sw; ++x) {
+                        acc[x] += src_line[x] << 5;
+                    }
+                }
+
+                src_line += src_stride;
+                unsigned const last_weight = row.lastWeight;
+                for (int x = 0; x < sw; ++x) {
+                    acc[x] += src_line[x] * last_weight;
+                }
+            }
+
+            uint8_t* const dst_line = dst_data + dy * dst_stride;
+            for (int dx = 0; dx < dw; ++dx) {
+                BoxSpan const& col = cols[dx];
+                assert(col.last < sw); // calc32xRatio2() ensures that.
+
+                unsigned gray_level = acc[col.first] * col.firstWeight;
+                if (col.last != col.first) {
+                    for (int sx = col.first + 1; sx < col.last; ++sx) {
+                        gray_level += acc[sx] << 5;
+                    }
+                    gray_level += acc[col.last] * col.lastWeight;
+                }
+
+                unsigned const total_area = row.totalWeight * col.totalWeight;
+                unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+                assert(pix_value < 256);
+                dst_line[dx] = static_cast<uint8_t>(pix_value);
+            }
+        }
+    }
+
+    return dst;
+}
+
 GrayImage scaleToGray(GrayImage const& src, QSize const& dst_size)
 {
     if (src.isNull()) {
@@ -394,6 +703,23 @@ GrayImage scaleToGray(GrayImage const& src, QSize const& dst_size)
         return GrayImage();
     }
 
+    return scaleGrayToGrayFast(src, dst_size);
+}
+
+GrayImage scaleToGrayReference(GrayImage const& src, QSize const& dst_size)
+{
+    if (src.isNull()) {
+        return src;
+    }
+
+    if (!dst_size.isValid()) {
+        throw std::invalid_argument("scaleToGrayReference: dst_size is invalid");
+    }
+
+    if (dst_size.isEmpty()) {
+        return GrayImage();
+    }
+
     return scaleGrayToGray(src, dst_size);
 }
 
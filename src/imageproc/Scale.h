@@ -38,6 +38,14 @@ class GrayImage;
  */
 GrayImage scaleToGray(GrayImage const& src, QSize const& dst_size);
 
+/**
+ * \brief A straightforward single-threaded version of scaleToGray().
+ *
+ * Produces exactly the same results as scaleToGray(), only slower.
+ * It's kept as a reference implementation for tests.
+ */
+GrayImage scaleToGrayReference(GrayImage const& src, QSize const& dst_size);
+
 } // namespace imageproc
 
 #endif
@@ -34,6 +34,19 @@ namespace tests
 using namespace utils;
 
 BOOST_AUTO_TEST_SUITE(BinarizeTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_shared_stats)
+{
+    QImage const img(randomGrayImage(97, 61));
+    BinarizationStats const stats(img);
+
+    BOOST_CHECK(binarizeOtsu(stats) == binarizeOtsu(img));
+    BOOST_CHECK(peakThreshold(stats) == peakThreshold(img));
+    BOOST_CHECK(binarizeSauvola(stats, QSize(15, 15)) == binarizeSauvola(img, QSize(15, 15)));
+    BOOST_CHECK(binarizeSauvola(stats, img.size()) == binarizeSauvola(img, img.size()));
+    BOOST_CHECK(binarizeWolf(stats, QSize(15, 15)) == binarizeWolf(img, QSize(15, 15)));
+    BOOST_CHECK(binarizeWolf(stats, img.size()) == binarizeWolf(img, img.size()));
+}
 #if 0
 BOOST_AUTO_TEST_CASE(test)
 {
@@ -18,6 +18,8 @@
 
 #include "BinaryImage.h"
 #include "BWColor.h"
+#include "GrayImage.h"
+#include "ImageArena.h"
 #include "Utils.h"
 #include <QImage>
 #ifndef Q_MOC_RUN
@@ -161,6 +163,77 @@ BOOST_AUTO_TEST_CASE(test_content_bounding_box4)
     BOOST_CHECK(img.contentBoundingBox() == QRect(1, 1, 6, 6));
 }
 
+BOOST_AUTO_TEST_CASE(test_arena_reuse)
+{
+    QSize const size(1200, 900);
+    {
+        // Leave a buffer of each kind in the free list.
+        BinaryImage bw(size, WHITE);
+        GrayImage gray(size);
+    }
+
+    ImageArenaUsage const usage;
+    {
+        BinaryImage bw(size, BLACK);
+        GrayImage gray(size);
+        BOOST_CHECK(bw.countBlackPixels() == size.width() * size.height());
+        BOOST_CHECK(gray.stride() >= size.width());
+    }
+
+    BOOST_CHECK(usage.bytesRequested() > 0);
+    BOOST_CHECK(usage.bytesAllocated() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_trimmed_buffers_not_reused)
+{
+    QSize const size(1000, 1000);
+    {
+        BinaryImage bw(size, WHITE);
+    }
+
+    ImageArena::trim();
+
+    ImageArenaUsage const usage;
+    {
+        BinaryImage bw(size, WHITE);
+    }
+
+    BOOST_CHECK(usage.bytesAllocated() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_file_backed)
+{
+    QSize const size(1000, 1000);
+    ImageArenaUsage const usage;
+    {
+        ImageArena::FileBackingScope const file_backing(100000);
+        BinaryImage bw(size, WHITE);
+        bw.fill(QRect(100, 100, 500, 500), BLACK);
+        BOOST_CHECK(bw.countBlackPixels() == 500 * 500);
+        BOOST_CHECK(bw.contentBoundingBox() == QRect(100, 100, 500, 500));
+    }
+
+    BOOST_CHECK(usage.bytesFileBacked() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_file_backed_with_pooled_buffer)
+{
+    QSize const size(1000, 1000);
+    {
+        // Leave a heap buffer of the same size in the pool.
+        BinaryImage bw(size, WHITE);
+    }
+
+    ImageArenaUsage const usage;
+    {
+        ImageArena::FileBackingScope const file_backing(100000);
+        BinaryImage bw(size, WHITE);
+    }
+
+    BOOST_CHECK(usage.bytesFileBacked() > 0);
+    BOOST_CHECK(usage.bytesFileBacked() == usage.bytesAllocated());
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
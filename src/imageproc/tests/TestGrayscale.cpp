@@ -18,7 +18,11 @@
 
 #include "Grayscale.h"
 #include "Utils.h"
+#include "BinaryImage.h"
+#include "BWColor.h"
 #include <QImage>
+#include <QVector>
+#include <QColor>
 #ifndef Q_MOC_RUN
 #include <boost/test/unit_test.hpp>
 #endif
@@ -81,6 +85,111 @@ BOOST_AUTO_TEST_CASE(test_argb32_to_grayscale)
     BOOST_CHECK(toGrayscale(argb32) == gray);
 }
 
+BOOST_AUTO_TEST_CASE(test_rgb32_random_to_grayscale)
+{
+    int const w = 71;
+    int const h = 33;
+    QImage rgb32(w, h, QImage::Format_RGB32);
+    QImage gray(w, h, QImage::Format_Indexed8);
+    gray.setColorTable(createGrayscalePalette());
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            QRgb const rgb = qRgb(rand() % 256, rand() % 256, rand() % 256);
+            rgb32.setPixel(x, y, rgb);
+            gray.setPixel(x, y, qGray(rgb));
+        }
+    }
+
+    BOOST_CHECK(toGrayscale(rgb32) == gray);
+}
+
+BOOST_AUTO_TEST_CASE(test_indexed8_color_to_grayscale)
+{
+    int const w = 45;
+    int const h = 20;
+    QImage indexed(w, h, QImage::Format_Indexed8);
+    QVector<QRgb> palette(16);
+    for (int i = 0; i < palette.size(); ++i) {
+        palette[i] = qRgb(rand() % 256, rand() % 256, rand() % 256);
+    }
+    indexed.setColorTable(palette);
+
+    QImage gray(w, h, QImage::Format_Indexed8);
+    gray.setColorTable(createGrayscalePalette());
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int const idx = rand() % palette.size();
+            indexed.setPixel(x, y, idx);
+            gray.setPixel(x, y, qGray(palette[idx]));
+        }
+    }
+
+    BOOST_CHECK(toGrayscale(indexed) == gray);
+}
+
+BOOST_AUTO_TEST_CASE(test_histogram)
+{
+    int const w = 67;
+    int const h = 41;
+    QImage rgb32(w, h, QImage::Format_RGB32);
+    int control[256] = { 0 };
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            // Few distinct levels to produce runs of identical values.
+            int const level = (rand() % 4) * 60;
+            rgb32.setPixel(x, y, qRgb(level, level, level));
+            ++control[level];
+        }
+    }
+
+    GrayscaleHistogram const rgb_hist(rgb32);
+    GrayscaleHistogram const gray_hist(toGrayscale(rgb32));
+    for (int i = 0; i < 256; ++i) {
+        BOOST_REQUIRE_EQUAL(rgb_hist[i], control[i]);
+        BOOST_REQUIRE_EQUAL(gray_hist[i], control[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_indexed8_color_histogram)
+{
+    int const w = 53;
+    int const h = 31;
+    QImage indexed(w, h, QImage::Format_Indexed8);
+    QVector<QRgb> palette(16);
+    for (int i = 0; i < palette.size(); ++i) {
+        // Reversed and duplicated gray levels, unlike an identity palette.
+        int const level = 255 - (i / 2) * 30;
+        palette[i] = qRgb(level, rand() % 2 ? level : 0, level);
+    }
+    indexed.setColorTable(palette);
+
+    BinaryImage mask(w, h, WHITE);
+    int control[256] = { 0 };
+    int masked_control[256] = { 0 };
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int const idx = rand() % palette.size();
+            indexed.setPixel(x, y, idx);
+            ++control[qGray(palette[idx])];
+            if (rand() % 2) {
+                mask.setPixel(x, y, BLACK);
+                ++masked_control[qGray(palette[idx])];
+            }
+        }
+    }
+
+    GrayscaleHistogram const hist(indexed);
+    GrayscaleHistogram const masked_hist(indexed, mask);
+    for (int i = 0; i < 256; ++i) {
+        BOOST_REQUIRE_EQUAL(hist[i], control[i]);
+        BOOST_REQUIRE_EQUAL(masked_hist[i], masked_control[i]);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
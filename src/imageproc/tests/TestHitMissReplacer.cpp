@@ -0,0 +1,299 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HitMissReplacer.h"
+#include "Morphology.h"
+#include "RasterOp.h"
+#include "BinaryImage.h"
+#include "BWColor.h"
+#include "Utils.h"
+#include <string>
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#endif
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+namespace
+{
+
+constexpr char PATTERN_1[] =
+    "XXX"
+    " - "
+    "   ";
+
+constexpr char PATTERN_2[] =
+    "X ?"
+    "X  "
+    "X- "
+    "X- "
+    "X  "
+    "X ?";
+
+constexpr char PATTERN_3[] =
+    "XX?"
+    "XX "
+    "X+ "
+    "X+ "
+    "XX "
+    "XX?";
+
+constexpr char PATTERN_4[] =
+    "   "
+    "X+X"
+    "XXX";
+
+// The patterns OutputGenerator::morphologicalSmoothInPlace() applies.
+
+constexpr char SMOOTH_PATTERN_3[] =
+    "X ?"
+    "X ?"
+    "X  "
+    "X- "
+    "X- "
+    "X- "
+    "X  "
+    "X ?"
+    "X ?";
+
+constexpr char SMOOTH_PATTERN_4[] =
+    "XX?"
+    "XX?"
+    "XX "
+    "X+ "
+    "X+ "
+    "X+ "
+    "XX "
+    "XX?"
+    "XX?";
+
+constexpr HitMissPattern PATTERN_2_CW(PATTERN_2, 3, 6, HitMissPattern::ROTATE_CW);
+
+/**
+ * Rotates a pattern the way HitMissPattern does, but at runtime.
+ */
+std::string rotatePattern(
+    char const* pattern, int width, int height,
+    HitMissPattern::Orientation orientation)
+{
+    std::string rotated(width * height, '?');
+    int const new_width = (orientation == HitMissPattern::ROTATE_CW
+                           || orientation == HitMissPattern::ROTATE_CCW) ? height : width;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int new_x = x;
+            int new_y = y;
+            switch (orientation) {
+            case HitMissPattern::AS_IS:
+                break;
+            case HitMissPattern::ROTATE_CW:
+                new_x = height - 1 - y;
+                new_y = x;
+                break;
+            case HitMissPattern::ROTATE_180:
+                new_x = width - 1 - x;
+                new_y = height - 1 - y;
+                break;
+            case HitMissPattern::ROTATE_CCW:
+                new_x = y;
+                new_y = width - 1 - x;
+                break;
+            }
+            rotated[new_y * new_width + new_x] = pattern[y * width + x];
+        }
+    }
+    return rotated;
+}
+
+void hitMissReplaceAllOrientations(
+    BinaryImage& img, char const* pattern, int width, int height)
+{
+    static HitMissPattern::Orientation const orientations[] = {
+        HitMissPattern::AS_IS, HitMissPattern::ROTATE_CW,
+        HitMissPattern::ROTATE_180, HitMissPattern::ROTATE_CCW
+    };
+
+    for (HitMissPattern::Orientation const orientation : orientations) {
+        bool const swap = orientation == HitMissPattern::ROTATE_CW
+                          || orientation == HitMissPattern::ROTATE_CCW;
+        std::string const rotated(rotatePattern(pattern, width, height, orientation));
+        hitMissReplaceInPlace(
+            img, WHITE, rotated.c_str(),
+            swap ? height : width, swap ? width : height
+        );
+    }
+}
+
+/**
+ * Blocks of \p block_size pixels, with sparse noise on top,
+ * so that long patterns find edges to match.
+ */
+BinaryImage blockyBinaryImage(int width, int height, int block_size)
+{
+    BinaryImage blocks(
+        randomBinaryImage(
+            (width + block_size - 1) / block_size,
+            (height + block_size - 1) / block_size
+        )
+    );
+
+    BinaryImage noise(randomBinaryImage(width, height));
+    for (int i = 0; i < 2; ++i) {
+        rasterOp<RopAnd<RopSrc, RopDst> >(noise, randomBinaryImage(width, height));
+    }
+
+    BinaryImage img(width, height, WHITE);
+    uint32_t* line = img.data();
+    int const wpl = img.wordsPerLine();
+    uint32_t const msb = uint32_t(1) << 31;
+    for (int y = 0; y < height; ++y, line += wpl) {
+        for (int x = 0; x < width; ++x) {
+            if (blocks.getPixel(x / block_size, y / block_size) == BLACK) {
+                line[x >> 5] |= msb >> (x & 31);
+            }
+        }
+    }
+
+    rasterOp<RopXor<RopSrc, RopDst> >(img, noise);
+    return img;
+}
+
+/**
+ * The sequence of hitMissReplaceInPlace() calls
+ * OutputGenerator::morphologicalSmoothInPlace() used to make.
+ */
+void smoothSequentially(BinaryImage& img)
+{
+    hitMissReplaceAllOrientations(img, PATTERN_1, 3, 3);
+    hitMissReplaceAllOrientations(img, PATTERN_2, 3, 6);
+    hitMissReplaceAllOrientations(img, SMOOTH_PATTERN_3, 3, 9);
+    hitMissReplaceAllOrientations(img, SMOOTH_PATTERN_4, 3, 9);
+    hitMissReplaceAllOrientations(img, PATTERN_3, 3, 6);
+    hitMissReplaceAllOrientations(img, PATTERN_4, 3, 3);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(HitMissReplacerTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_pattern_parsing)
+{
+    static_assert(PATTERN_2_CW.width() == 6, "rotated width");
+    static_assert(PATTERN_2_CW.height() == 3, "rotated height");
+
+    std::string const rotated(
+        rotatePattern(PATTERN_2, 3, 6, HitMissPattern::ROTATE_CW)
+    );
+    for (int i = 0; i < 18; ++i) {
+        BOOST_CHECK_EQUAL(PATTERN_2_CW.cell(i), rotated[i]);
+    }
+
+    // The origin is the first replacement position.
+    BOOST_CHECK_EQUAL(PATTERN_2_CW.originX(), 2);
+    BOOST_CHECK_EQUAL(PATTERN_2_CW.originY(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_same_as_sequential_replacements)
+{
+    HitMissReplacer replacer;
+    replacer.addAllOrientations<PATTERN_1, 3, 3>();
+    replacer.addAllOrientations<PATTERN_2, 3, 6>();
+    replacer.addAllOrientations<PATTERN_3, 3, 6>();
+    replacer.addAllOrientations<PATTERN_4, 3, 3>();
+
+    // Widths around word boundaries and heights around band boundaries.
+    static int const sizes[][2] = {
+        { 1, 1 }, { 5, 3 }, { 31, 70 }, { 32, 64 }, { 33, 65 }, { 97, 130 }
+    };
+
+    for (auto const& size : sizes) {
+        for (int density = 0; density < 3; ++density) {
+            BinaryImage img(randomBinaryImage(size[0], size[1]));
+            BinaryImage const other(randomBinaryImage(size[0], size[1]));
+            if (density == 0) {
+                rasterOp<RopAnd<RopSrc, RopDst> >(img, other);
+            } else if (density == 2) {
+                rasterOp<RopOr<RopSrc, RopDst> >(img, other);
+            }
+
+            BinaryImage control(img);
+            hitMissReplaceAllOrientations(control, PATTERN_1, 3, 3);
+            hitMissReplaceAllOrientations(control, PATTERN_2, 3, 6);
+            hitMissReplaceAllOrientations(control, PATTERN_3, 3, 6);
+            hitMissReplaceAllOrientations(control, PATTERN_4, 3, 3);
+
+            int bands = 0;
+            replacer.replaceInPlace(img, [&bands]() { ++bands; });
+
+            BOOST_CHECK(img == control);
+            BOOST_CHECK_EQUAL(
+                bands, (size[1] + HitMissReplacer::BAND_HEIGHT - 1)
+                / HitMissReplacer::BAND_HEIGHT
+            );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_production_smoothing)
+{
+    HitMissReplacer replacer;
+    replacer.addAllOrientations<PATTERN_1, 3, 3>();
+    replacer.addAllOrientations<PATTERN_2, 3, 6>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_3, 3, 9>();
+    replacer.addAllOrientations<SMOOTH_PATTERN_4, 3, 9>();
+    replacer.addAllOrientations<PATTERN_3, 3, 6>();
+    replacer.addAllOrientations<PATTERN_4, 3, 3>();
+
+    // Including sizes smaller than the 3x9 patterns.
+    static int const sizes[][2] = {
+        { 3, 9 }, { 9, 3 }, { 8, 8 }, { 63, 9 }, { 64, 127 }, { 200, 257 }
+    };
+
+    for (auto const& size : sizes) {
+        for (int block_size = 1; block_size <= 7; block_size += 3) {
+            BinaryImage img(blockyBinaryImage(size[0], size[1], block_size));
+            BinaryImage control(img);
+            smoothSequentially(control);
+
+            replacer.replaceInPlace(img);
+            BOOST_CHECK(img == control);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_null_image)
+{
+    HitMissReplacer replacer;
+    replacer.addAllOrientations<PATTERN_1, 3, 3>();
+
+    BinaryImage img;
+    replacer.replaceInPlace(img);
+    BOOST_CHECK(img.isNull());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -0,0 +1,220 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HoughLineDetector.h"
+#include "Constants.h"
+#include <QSize>
+#include <QPointF>
+#include <QImage>
+#include <QColor>
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#endif
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(HoughLineDetectorTestSuite);
+
+namespace
+{
+
+int const width = 300;
+int const height = 200;
+int const margin = 10;
+
+/**
+ * Sparse noise with a vertical line at x = 150
+ * and a slightly tilted one starting at x = 60.
+ */
+std::vector<unsigned> makeWeights()
+{
+    std::vector<unsigned> weights(width * height, 0);
+    srand(1);
+    for (unsigned& weight : weights) {
+        if (rand() % 20 == 0) {
+            weight = 1 + rand() % 3;
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        weights[y * width + 150] = 5;
+        weights[y * width + 60 + y / 20] = 4;
+    }
+    return weights;
+}
+
+HoughLineDetector makeDetector()
+{
+    return HoughLineDetector(QSize(width, height), 5.0, -7.0, 0.25, 57);
+}
+
+void checkSameLines(
+    std::vector<HoughLine> const& lines1, std::vector<HoughLine> const& lines2)
+{
+    BOOST_REQUIRE_EQUAL(lines1.size(), lines2.size());
+    for (size_t i = 0; i < lines1.size(); ++i) {
+        BOOST_CHECK_EQUAL(lines1[i].quality(), lines2[i].quality());
+        BOOST_CHECK(lines1[i].normUnitVector() == lines2[i].normUnitVector());
+        BOOST_CHECK_EQUAL(lines1[i].distance(), lines2[i].distance());
+    }
+}
+
+/**
+ * The histogram column the detector voted into for each angle,
+ * provided a single point was voted for.  Recovered from the
+ * visualization, where it's the only non-black pixel in its row.
+ */
+std::vector<int> votedBins(HoughLineDetector const& detector)
+{
+    // No bin reaches the lower bound, so no peaks are drawn.
+    QImage const visual(detector.visualizeHoughSpace(2));
+
+    std::vector<int> bins;
+    for (int y = 0; y < visual.height(); ++y) {
+        int bin = -1;
+        for (int x = 0; x < visual.width(); ++x) {
+            if (qGray(visual.pixel(x, y)) != 0) {
+                bin = (bin == -1) ? x : -2;
+            }
+        }
+        bins.push_back(bin);
+    }
+    return bins;
+}
+
+/**
+ * Checks every point of a small image against the way bins used to be
+ * computed: distance / resolution + bias, rounded, with the bias making
+ * the smallest distance to a corner of the image zero.
+ */
+void checkBinsMatchDistanceFormula(
+    double distance_resolution, double start_angle, double angle_delta, int num_angles)
+{
+    int const w = 40;
+    int const h = 30;
+
+    std::vector<QPointF> unit_vectors;
+    double min_distance = 0.0;
+    for (int i = 0; i < num_angles; ++i) {
+        double const angle = (start_angle + angle_delta * i) * constants::DEG2RAD;
+        QPointF const uv(cos(angle), sin(angle));
+        min_distance = std::min(min_distance, uv.x() * (w - 1));
+        min_distance = std::min(min_distance, uv.y() * (h - 1));
+        min_distance = std::min(min_distance, uv.x() * (w - 1) + uv.y() * (h - 1));
+        unit_vectors.push_back(uv);
+    }
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            HoughLineDetector detector(
+                QSize(w, h), distance_resolution, start_angle, angle_delta, num_angles
+            );
+            detector.process(x, y);
+            std::vector<int> const bins(votedBins(detector));
+
+            BOOST_REQUIRE_EQUAL(bins.size(), unit_vectors.size());
+            for (int i = 0; i < num_angles; ++i) {
+                QPointF const& uv = unit_vectors[i];
+                double const distance = uv.x() * x + uv.y() * y;
+                double const biased_distance = distance - min_distance;
+                int const expected = (int)(
+                    biased_distance * (1.0 / distance_resolution) + 0.5
+                );
+                BOOST_REQUIRE_EQUAL(bins[i], expected);
+            }
+        }
+    }
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_bins_match_distance_formula)
+{
+    checkBinsMatchDistanceFormula(5.0, -7.0, 0.25, 57);
+    checkBinsMatchDistanceFormula(1.0, 85.0, 0.5, 21);
+}
+
+BOOST_AUTO_TEST_CASE(test_bins_match_distance_formula_in_third_quadrant)
+{
+    // Between 180 and 270 degrees all distances are non-positive,
+    // so the origin votes into the last column of the histogram.
+    checkBinsMatchDistanceFormula(5.0, 180.0, 0.5, 181);
+    checkBinsMatchDistanceFormula(0.7, 170.0, 1.0, 111);
+}
+
+BOOST_AUTO_TEST_CASE(test_batched_voting_matches_per_point_voting)
+{
+    std::vector<unsigned> const weights(makeWeights());
+
+    HoughLineDetector per_point(makeDetector());
+    HoughLineDetector per_row(makeDetector());
+    HoughLineDetector all_rows(makeDetector());
+
+    for (int y = 0; y < height; ++y) {
+        unsigned const* const line = &weights[y * width];
+        for (int x = margin; x < width - margin; ++x) {
+            if (line[x] != 0) {
+                per_point.process(x, y, line[x]);
+            }
+        }
+        per_row.processRow(y, line, margin, width - margin);
+    }
+    all_rows.processRows(&weights[0], width, margin, width - margin, height);
+
+    unsigned const min_quality = 300;
+    std::vector<HoughLine> const lines(per_point.findLines(min_quality));
+    checkSameLines(lines, per_row.findLines(min_quality));
+    checkSameLines(lines, all_rows.findLines(min_quality));
+}
+
+BOOST_AUTO_TEST_CASE(test_finds_lines)
+{
+    std::vector<unsigned> const weights(makeWeights());
+
+    HoughLineDetector detector(makeDetector());
+    detector.processRows(&weights[0], width, margin, width - margin, height);
+
+    std::vector<HoughLine> const lines(detector.findLines(height * 3));
+    BOOST_REQUIRE(lines.size() >= 2);
+
+    // The vertical line has the greater weight.
+    BOOST_CHECK(fabs(lines[0].pointAtY(0).x() - 150) < 3.0);
+    BOOST_CHECK(fabs(lines[0].pointAtY(height).x() - 150) < 3.0);
+
+    bool tilted_found = false;
+    for (HoughLine const& line : lines) {
+        if (fabs(line.pointAtY(0).x() - 60) < 3.0
+                && fabs(line.pointAtY(height).x() - 70) < 3.0) {
+            tilted_found = true;
+        }
+    }
+    BOOST_CHECK(tilted_found);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -0,0 +1,104 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RunLengthImage.h"
+#include "Morphology.h"
+#include "RasterOp.h"
+#include "BinaryImage.h"
+#include "BWColor.h"
+#include "Utils.h"
+#include <QSize>
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#endif
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(RunLengthImageTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_round_trip)
+{
+    for (int i = 0; i < 10; ++i) {
+        BinaryImage const img(randomBinaryImage(71 + i, 13));
+        BOOST_CHECK(RunLengthImage(img).toBinaryImage() == img);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_open_same_as_open_brick)
+{
+    static QSize const bricks[] = {
+        QSize(1, 1), QSize(3, 1), QSize(1, 3), QSize(2, 5),
+        QSize(7, 4), QSize(40, 2), QSize(2, 30)
+    };
+
+    for (int i = 0; i < 10; ++i) {
+        BinaryImage img(randomBinaryImage(97, 43));
+        // Make some black areas large enough for bricks to fit.
+        for (int j = 0; j < 3; ++j) {
+            img = dilateBrick(img, QSize(2, 2));
+        }
+        RunLengthImage const rle(img);
+
+        for (QSize const& brick : bricks) {
+            BOOST_CHECK(
+                rle.opened(brick, WHITE).toBinaryImage()
+                == openBrick(img, brick, WHITE)
+            );
+            BOOST_CHECK(
+                rle.opened(brick, BLACK).toBinaryImage()
+                == openBrick(img, brick, BLACK)
+            );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_open_with_brick_larger_than_image)
+{
+    BinaryImage const img(20, 10, BLACK);
+    RunLengthImage const rle(img);
+
+    BOOST_CHECK(rle.opened(QSize(30, 2), WHITE).toBinaryImage() == BinaryImage(20, 10, WHITE));
+    BOOST_CHECK(rle.opened(QSize(30, 2), BLACK).toBinaryImage() == img);
+}
+
+BOOST_AUTO_TEST_CASE(test_unite)
+{
+    for (int i = 0; i < 10; ++i) {
+        BinaryImage const img1(randomBinaryImage(65, 17));
+        BinaryImage const img2(randomBinaryImage(65, 17));
+
+        BinaryImage expected(img1);
+        rasterOp<RopOr<RopSrc, RopDst> >(expected, img2);
+
+        RunLengthImage rle(img1);
+        rle.unite(RunLengthImage(img2));
+        BOOST_CHECK(rle.toBinaryImage() == expected);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
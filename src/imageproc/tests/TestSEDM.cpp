@@ -21,7 +21,11 @@
 #include "BWColor.h"
 #include "Utils.h"
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
 #include <QImage>
+#include <QRect>
 #ifndef Q_MOC_RUN
 #include <boost/test/unit_test.hpp>
 #endif
@@ -96,6 +100,93 @@ BOOST_AUTO_TEST_CASE(test1)
     BOOST_CHECK(verifySEDM(sedm, out));
 }
 
+static BinaryImage sparseRandomImage(int const width, int const height)
+{
+    BinaryImage img(width, height, WHITE);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (rand() % 16 == 0) {
+                img.setPixel(x, y, BLACK);
+            }
+        }
+    }
+    return img;
+}
+
+/**
+ * Computes distances from every white pixel to the nearest
+ * black one the slow but obviously correct way.
+ */
+static std::vector<uint32_t> bruteForceDistToBlack(BinaryImage& img)
+{
+    int const width = img.width();
+    int const height = img.height();
+    std::vector<uint32_t> dist(width * height, SEDM::INF_DIST);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uint32_t& d = dist[y * width + x];
+            for (int y2 = 0; y2 < height; ++y2) {
+                for (int x2 = 0; x2 < width; ++x2) {
+                    if (img.getPixel(x2, y2) == BLACK) {
+                        uint32_t const dx = x2 - x;
+                        uint32_t const dy = y2 - y;
+                        d = std::min(d, dx * dx + dy * dy);
+                    }
+                }
+            }
+        }
+    }
+
+    return dist;
+}
+
+BOOST_AUTO_TEST_CASE(test_random_vs_brute_force)
+{
+    for (int i = 0; i < 10; ++i) {
+        // Widths both smaller and larger than a single column strip.
+        int const width = 1 + rand() % 100;
+        int const height = 1 + rand() % 30;
+        BinaryImage img(sparseRandomImage(width, height));
+        std::vector<uint32_t> const control(bruteForceDistToBlack(img));
+
+        SEDM const sedm(img, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
+        BOOST_REQUIRE(verifySEDM(sedm, &control[0]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_roi)
+{
+    for (int i = 0; i < 10; ++i) {
+        int const width = 1 + rand() % 150;
+        int const height = 1 + rand() % 150;
+        BinaryImage const img(sparseRandomImage(width, height));
+
+        int const left = rand() % width;
+        int const top = rand() % height;
+        QRect const roi(
+            left, top, 1 + rand() % (width - left), 1 + rand() % (height - top)
+        );
+
+        SEDM const full(img, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+        SEDM const partial(img, roi, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+        BOOST_REQUIRE(full.size() == partial.size());
+        BOOST_REQUIRE(full.stride() == partial.stride());
+
+        for (int y = 0; y < height; ++y) {
+            uint32_t const* full_line = full.data() + y * full.stride();
+            uint32_t const* partial_line = partial.data() + y * partial.stride();
+            for (int x = 0; x < width; ++x) {
+                if (roi.contains(x, y)) {
+                    BOOST_REQUIRE_EQUAL(partial_line[x], full_line[x]);
+                } else {
+                    BOOST_REQUIRE(partial_line[x] >= full_line[x]);
+                }
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
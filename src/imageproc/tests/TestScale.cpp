@@ -100,6 +100,51 @@ BOOST_AUTO_TEST_CASE(test_random_image)
     //BOOST_CHECK(checkScale(img, QSize(145, 55)));
 }
 
+static bool checkAgainstReference(GrayImage const& img, QSize const& new_size)
+{
+    GrayImage const scaled1(scaleToGray(img, new_size));
+    GrayImage const scaled2(scaleToGrayReference(img, new_size));
+    BOOST_REQUIRE(scaled1.size() == scaled2.size());
+
+    for (int y = 0; y < new_size.height(); ++y) {
+        uint8_t const* line1 = scaled1.data() + y * scaled1.stride();
+        uint8_t const* line2 = scaled2.data() + y * scaled2.stride();
+        for (int x = 0; x < new_size.width(); ++x) {
+            if (line1[x] != line2[x]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(test_vs_reference)
+{
+    GrayImage img(QSize(120, 90));
+    uint8_t* line = img.data();
+    for (int y = 0; y < img.height(); ++y) {
+        for (int x = 0; x < img.width(); ++x) {
+            line[x] = rand() % 256;
+        }
+        line += img.stride();
+    }
+
+    // Integer downscaling.
+    BOOST_CHECK(checkAgainstReference(img, QSize(40, 45)));
+    BOOST_CHECK(checkAgainstReference(img, QSize(60, 30)));
+    // Integer upscaling.
+    BOOST_CHECK(checkAgainstReference(img, QSize(240, 270)));
+    // Generic upscaling.
+    BOOST_CHECK(checkAgainstReference(img, QSize(200, 100)));
+    // Generic downscaling.
+    BOOST_CHECK(checkAgainstReference(img, QSize(77, 53)));
+    BOOST_CHECK(checkAgainstReference(img, QSize(1, 1)));
+    // Mixed.
+    BOOST_CHECK(checkAgainstReference(img, QSize(50, 145)));
+    BOOST_CHECK(checkAgainstReference(img, QSize(145, 50)));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -0,0 +1,126 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BandedLdlt.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+#include <math.h>
+
+BandedLdlt::BandedLdlt()
+    :   m_bandwidth(0)
+{
+}
+
+bool
+BandedLdlt::factorize(MatT<double> const& A, size_t const bandwidth)
+{
+    assert(A.rows() == A.cols());
+
+    size_t const n = A.rows();
+    size_t const w = bandwidth;
+    m_bandwidth = w;
+    m_L.resize(n * w);
+    m_D.resize(n);
+
+    double max_diag = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        max_diag = std::max(max_diag, fabs(A(i, i)));
+    }
+    double const min_pivot = max_diag * n * std::numeric_limits<double>::epsilon();
+
+    // L(i, j) for j in [i - w, i) lives at row_i[j - (i - w)].
+    for (size_t i = 0; i < n; ++i) {
+        double* const row_i = m_L.data() + i * w;
+        size_t const first = i > w ? i - w : 0;
+
+        for (size_t j = first; j < i; ++j) {
+            // Row j only has elements from column j - w on,
+            // which may be further to the left than first.
+            double const* const row_j = m_L.data() + j * w;
+            double sum = A(i, j);
+            for (size_t k = std::max(first, j > w ? j - w : 0); k < j; ++k) {
+                sum -= row_i[k + w - i] * row_j[k + w - j] * m_D[k];
+            }
+            row_i[j + w - i] = sum / m_D[j];
+        }
+
+        double d = A(i, i);
+        for (size_t k = first; k < i; ++k) {
+            double const l = row_i[k + w - i];
+            d -= l * l * m_D[k];
+        }
+
+        if (!(d > min_pivot)) {
+            // Not positive definite, or too close to being singular.
+            return false;
+        }
+        m_D[i] = d;
+    }
+
+    return true;
+}
+
+void
+BandedLdlt::solve(double* const x) const
+{
+    size_t const n = m_D.size();
+    size_t const w = m_bandwidth;
+
+    // Solve Lz = b.
+    for (size_t i = 0; i < n; ++i) {
+        double const* const row_i = m_L.data() + i * w;
+        double sum = x[i];
+        for (size_t k = i > w ? i - w : 0; k < i; ++k) {
+            sum -= row_i[k + w - i] * x[k];
+        }
+        x[i] = sum;
+    }
+
+    // Solve Dy = z.
+    for (size_t i = 0; i < n; ++i) {
+        x[i] /= m_D[i];
+    }
+
+    // Solve L^T x = y.
+    for (size_t i = n; i-- > 0;) {
+        double sum = x[i];
+        size_t const last = std::min(n, i + w + 1);
+        for (size_t k = i + 1; k < last; ++k) {
+            sum -= m_L[k * w + i + w - k] * x[k];
+        }
+        x[i] = sum;
+    }
+}
+
+void
+BandedLdlt::solve(double* const X, size_t const cols) const
+{
+    size_t const n = m_D.size();
+    for (size_t c = 0; c < cols; ++c) {
+        solve(X + c * n);
+    }
+}
+
+void
+BandedLdlt::swap(BandedLdlt& other)
+{
+    m_L.swap(other.m_L);
+    m_D.swap(other.m_D);
+    std::swap(m_bandwidth, other.m_bandwidth);
+}
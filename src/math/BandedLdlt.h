@@ -0,0 +1,93 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BANDED_LDLT_H_
+#define BANDED_LDLT_H_
+
+#include "MatT.h"
+#include <vector>
+#include <stddef.h>
+
+/**
+ * \brief Solves Ax = b for a symmetric positive definite band matrix A,
+ *        using LDL^T decomposition.
+ *
+ * With N being the size of A and W being the number of its non-zero
+ * subdiagonals, factorization takes O(N * W^2) and solving O(N * W),
+ * compared to O(N^3) for LinearSolver.  Storage is reused between
+ * factorizations.
+ *
+ * \see LinearSolver
+ */
+class BandedLdlt
+{
+    // Member-wise copying is OK.
+public:
+    BandedLdlt();
+
+    /**
+     * \brief Factorizes a symmetric matrix.
+     *
+     * Only the lower triangle of A is accessed, and only
+     * \p bandwidth subdiagonals of it.
+     *
+     * \return True on success, false if A turned out not to be
+     *         positive definite.  In the latter case, solve()
+     *         must not be called.
+     */
+    bool factorize(MatT<double> const& A, size_t bandwidth);
+
+    size_t size() const { return m_D.size(); }
+
+    /**
+     * \brief Solves Ax = b in place.
+     *
+     * \param x On input, vector b.  On output, vector x.
+     */
+    void solve(double* x) const;
+
+    /**
+     * \brief Same as above, for multiple right-hand sides.
+     *
+     * \param X Column-major matrix of size() rows and \p cols columns.
+     */
+    void solve(double* X, size_t cols) const;
+
+    void swap(BandedLdlt& other);
+private:
+    /**
+     * Elements of the unit lower triangular L.  Row i stores
+     * L(i, i - m_bandwidth) through L(i, i - 1), with elements
+     * that fall outside of the matrix left unused.
+     */
+    std::vector<double> m_L;
+
+    /**
+     * The diagonal of D.
+     */
+    std::vector<double> m_D;
+
+    size_t m_bandwidth;
+};
+
+inline void swap(BandedLdlt& o1, BandedLdlt& o2)
+{
+    o1.swap(o2);
+}
+
+#endif
@@ -317,6 +317,14 @@ XSpline::linearCombinationAt(double t, std::vector<LinearCoefficient>& coeffs) c
     coeffs.resize(num_coeffs);
 }
 
+int
+XSpline::linearCombinationSpan() const
+{
+    // linearCombinationFor() combines control points
+    // segment - 1 through segment + 2.
+    return std::min(3, std::max(0, numControlPoints() - 1));
+}
+
 int
 XSpline::linearCombinationFor(LinearCoefficient* coeffs, int segment, double t) const
 {
@@ -112,6 +112,9 @@ public:
     /** \see spfit::FittableSpline::linearCombinationAt() */
     virtual void linearCombinationAt(double t, std::vector<LinearCoefficient>& coeffs) const;
 
+    /** \see spfit::FittableSpline::linearCombinationSpan() */
+    virtual int linearCombinationSpan() const;
+
     /**
      * Returns a function equivalent to:
      * \code
@@ -24,6 +24,7 @@
 #include "FlagOps.h"
 #include <QPointF>
 #include <vector>
+#include <algorithm>
 
 namespace spfit
 {
@@ -96,6 +97,18 @@ public:
      */
     virtual void linearCombinationAt(double t, std::vector<LinearCoefficient>& coeffs) const = 0;
 
+    /**
+     * \brief Returns the largest difference between control point indexes
+     *        within a linear combination produced by linearCombinationAt().
+     *
+     * SplineFitter derives the bandwidth of the systems it solves from this.
+     * The default is correct for any spline, but makes those systems dense.
+     */
+    virtual int linearCombinationSpan() const
+    {
+        return std::max(0, numControlPoints() - 1);
+    }
+
     /**
      * \brief Generates an ordered set of points on a spline.
      *
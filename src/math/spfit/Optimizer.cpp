@@ -19,14 +19,19 @@
 #include "Optimizer.h"
 #include "MatrixCalc.h"
 #include <stdexcept>
+#include <vector>
 #include <algorithm>
+#include <limits>
+#include <stdlib.h>
+#include <math.h>
 #include <assert.h>
 
 namespace spfit
 {
 
-Optimizer::Optimizer(size_t num_vars)
+Optimizer::Optimizer(size_t num_vars, size_t bandwidth)
     : m_numVars(num_vars)
+    , m_bandwidth(std::min(bandwidth, num_vars > 0 ? num_vars - 1 : 0))
     , m_A(num_vars, num_vars)
     , m_b(num_vars)
     , m_x(num_vars)
@@ -72,6 +77,7 @@ Optimizer::setConstraints(std::list<LinearFunction> const& constraints)
 void
 Optimizer::addExternalForce(QuadraticFunction const& force)
 {
+    assert(fitsInBand(force));
     m_externalForce += force;
 }
 
@@ -83,6 +89,7 @@ Optimizer::addExternalForce(QuadraticFunction const& force, std::vector<int> con
         int const ii = sparse_map[i];
         for (size_t j = 0; j < num_vars; ++j) {
             int const jj = sparse_map[j];
+            assert(force.A(i, j) == 0.0 || size_t(abs(ii - jj)) <= m_bandwidth);
             m_externalForce.A(ii, jj) += force.A(i, j);
         }
         m_externalForce.b[ii] += force.b[i];
@@ -93,6 +100,7 @@ Optimizer::addExternalForce(QuadraticFunction const& force, std::vector<int> con
 void
 Optimizer::addInternalForce(QuadraticFunction const& force)
 {
+    assert(fitsInBand(force));
     m_internalForce += force;
 }
 
@@ -105,6 +113,7 @@ Optimizer::addInternalForce(
         int const ii = sparse_map[i];
         for (size_t j = 0; j < num_vars; ++j) {
             int const jj = sparse_map[j];
+            assert(force.A(i, j) == 0.0 || size_t(abs(ii - jj)) <= m_bandwidth);
             m_internalForce.A(ii, jj) += force.A(i, j);
         }
         m_internalForce.b[ii] += force.b[i];
@@ -124,21 +133,27 @@ Optimizer::optimize(double internal_force_weight)
     QuadraticFunction::Gradient const grad(m_internalForce.gradient());
     for (size_t i = 0; i < m_numVars; ++i) {
         m_b[i] = -grad.b[i];
-        for (size_t j = 0; j < m_numVars; ++j) {
-            m_A(i, j) = grad.A(i, j);
-        }
     }
 
     double const total_force_before = m_internalForce.c;
-    DynamicMatrixCalc<double> mc;
 
-    try {
-        mc(m_A).solve(mc(m_b)).write(m_x.data());
-    } catch (std::runtime_error const&) {
-        m_externalForce.reset();
-        m_internalForce.reset();
-        m_x.fill(0); // To make undoLastStep() work as expected.
-        return OptimizationResult(total_force_before, total_force_before);
+    if (!solveBanded(grad.A)) {
+        for (size_t i = 0; i < m_numVars; ++i) {
+            for (size_t j = 0; j < m_numVars; ++j) {
+                m_A(i, j) = grad.A(i, j);
+            }
+        }
+
+        DynamicMatrixCalc<double> mc;
+
+        try {
+            mc(m_A).solve(mc(m_b)).write(m_x.data());
+        } catch (std::runtime_error const&) {
+            m_externalForce.reset();
+            m_internalForce.reset();
+            m_x.fill(0); // To make undoLastStep() work as expected.
+            return OptimizationResult(total_force_before, total_force_before);
+        }
     }
 
     double const total_force_after = m_internalForce.evaluate(m_x.data());
@@ -152,6 +167,118 @@ Optimizer::optimize(double internal_force_weight)
     return OptimizationResult(total_force_before, total_force_after);
 }
 
+/**
+ * Solves the system described in setConstraints() by eliminating
+ * the Lagrange multipliers.  With N being the gradient matrix
+ * and C the constraint matrix, we have:
+ * \code
+ * N * x + C^T * l = -D
+ * C * x = -J
+ * \endcode
+ * Substituting x = N^-1 * (-D - C^T * l) into the second equation gives
+ * a small system for l, after which x is found by back substitution.
+ * Factorizing the banded N takes most of the time.
+ *
+ * \return False if N is not positive definite, or if the constraints
+ *         are linearly dependent.  In that case, the dense path has
+ *         to be taken.
+ */
+bool
+Optimizer::solveBanded(MatT<double> const& N)
+{
+    size_t const num_vars = m_numVars;
+    size_t const num_constraints = m_b.size() - num_vars;
+
+    if (!m_bandedSolver.factorize(N, m_bandwidth)) {
+        return false;
+    }
+
+    // y = N^-1 * -D
+    double* const x = m_x.data();
+    for (size_t i = 0; i < num_vars; ++i) {
+        x[i] = m_b[i];
+    }
+    m_bandedSolver.solve(x);
+
+    if (num_constraints == 0) {
+        return true;
+    }
+
+    // Y = N^-1 * C^T
+    std::vector<double>& Y = m_constraintSolutions;
+    Y.resize(num_vars * num_constraints);
+    for (size_t c = 0; c < num_constraints; ++c) {
+        for (size_t i = 0; i < num_vars; ++i) {
+            Y[c * num_vars + i] = m_A(num_vars + c, i);
+        }
+    }
+    m_bandedSolver.solve(Y.data(), num_constraints);
+
+    // (C * N^-1 * C^T) * l = C * y + J
+    MatT<double> S(num_constraints, num_constraints);
+    VecT<double> rhs(num_constraints);
+    for (size_t r = 0; r < num_constraints; ++r) {
+        double sum = -m_b[num_vars + r];
+        for (size_t i = 0; i < num_vars; ++i) {
+            sum += m_A(num_vars + r, i) * x[i];
+        }
+        rhs[r] = sum;
+
+        for (size_t c = 0; c < num_constraints; ++c) {
+            double s = 0;
+            for (size_t i = 0; i < num_vars; ++i) {
+                s += m_A(num_vars + r, i) * Y[c * num_vars + i];
+            }
+            S(r, c) = s;
+        }
+    }
+
+    DynamicMatrixCalc<double> mc;
+    try {
+        mc(S).solve(mc(rhs)).write(x + num_vars);
+    } catch (std::runtime_error const&) {
+        // Linearly dependent constraints.  Let the dense path decide.
+        return false;
+    }
+
+    // x = y - N^-1 * C^T * l
+    for (size_t c = 0; c < num_constraints; ++c) {
+        double const l = x[num_vars + c];
+        for (size_t i = 0; i < num_vars; ++i) {
+            x[i] -= Y[c * num_vars + i] * l;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Forces built with automatic differentiation may have rounding noise
+ * outside of the band.  Dropping it doesn't change the solution.
+ */
+bool
+Optimizer::fitsInBand(QuadraticFunction const& force) const
+{
+    size_t const num_vars = force.numVars();
+
+    double max_abs = 0.0;
+    for (size_t i = 0; i < num_vars; ++i) {
+        for (size_t j = 0; j < num_vars; ++j) {
+            max_abs = std::max(max_abs, fabs(force.A(i, j)));
+        }
+    }
+    double const noise = max_abs * num_vars * std::numeric_limits<double>::epsilon();
+
+    for (size_t i = 0; i < num_vars; ++i) {
+        for (size_t j = i + m_bandwidth + 1; j < num_vars; ++j) {
+            if (fabs(force.A(i, j)) > noise || fabs(force.A(j, i)) > noise) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 void
 Optimizer::undoLastStep()
 {
@@ -186,6 +313,9 @@ Optimizer::swap(Optimizer& other)
     m_x.swap(other.m_x);
     m_externalForce.swap(other.m_externalForce);
     m_internalForce.swap(other.m_internalForce);
+    m_bandedSolver.swap(other.m_bandedSolver);
+    m_constraintSolutions.swap(other.m_constraintSolutions);
+    std::swap(m_bandwidth, other.m_bandwidth);
     std::swap(m_numVars, other.m_numVars);
 }
 
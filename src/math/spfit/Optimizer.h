@@ -28,8 +28,11 @@
 #include "VecT.h"
 #include "LinearFunction.h"
 #include "QuadraticFunction.h"
+#include "BandedLdlt.h"
 #include <vector>
 #include <list>
+#include <limits>
+#include <stddef.h>
 
 namespace spfit
 {
@@ -38,7 +41,13 @@ class Optimizer
 {
     // Member-wise copying is OK.
 public:
-    Optimizer(size_t num_vars = 0);
+    /**
+     * \param num_vars The number of variables.
+     * \param bandwidth The number of subdiagonals of the gradient matrix
+     *        forces may make non-zero.  Forces must not couple variables
+     *        that are further apart.  The default allows any force.
+     */
+    Optimizer(size_t num_vars = 0, size_t bandwidth = std::numeric_limits<size_t>::max());
 
     /**
      * Sets linear constraints in the form of b^T * x + c = 0
@@ -96,10 +105,35 @@ public:
 
     void swap(Optimizer& other);
 private:
+    bool solveBanded(MatT<double> const& N);
+
+    bool fitsInBand(QuadraticFunction const& force) const;
+
     void adjustConstraints(double direction);
 
     size_t m_numVars;
+
+    size_t m_bandwidth;
+
+    /**
+     * The dense system of equations, used when the banded one fails.
+     * Its constraint rows are also used by adjustConstraints().
+     * \see setConstraints()
+     */
     MatT<double> m_A;
+
+    /**
+     * Control points of a spline only interact with their neighbors,
+     * so the non-constraint part of the system is a band matrix.
+     * The factorization storage is reused from one optimize() call
+     * to the next.
+     */
+    BandedLdlt m_bandedSolver;
+
+    /**
+     * N^-1 * C^T, one column per constraint.  \see solveBanded()
+     */
+    std::vector<double> m_constraintSolutions;
     VecT<double> m_b;
     VecT<double> m_x;
     QuadraticFunction m_externalForce;
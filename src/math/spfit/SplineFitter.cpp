@@ -29,7 +29,7 @@ namespace spfit
 
 SplineFitter::SplineFitter(FittableSpline* spline)
     : m_pSpline(spline)
-    , m_optimizer(spline->numControlPoints() * 2)
+    , m_optimizer(spline->numControlPoints() * 2, gradientBandwidth(*spline))
 // Each control point is a pair of (x, y) variables.
 {
 }
@@ -37,7 +37,15 @@ SplineFitter::SplineFitter(FittableSpline* spline)
 void
 SplineFitter::splineModified()
 {
-    Optimizer(m_pSpline->numControlPoints() * 2).swap(m_optimizer);
+    Optimizer(m_pSpline->numControlPoints() * 2, gradientBandwidth(*m_pSpline)).swap(m_optimizer);
+}
+
+size_t
+SplineFitter::gradientBandwidth(FittableSpline const& spline)
+{
+    // Control points i and i + d map to variables [2i, 2i + 1]
+    // and [2i + 2d, 2i + 2d + 1].
+    return (spline.linearCombinationSpan() + 1) * 2 + 1;
 }
 
 void
@@ -50,6 +50,18 @@ public:
 
     void setSamplingParams(FittableSpline::SamplingParams const& sampling_params);
 
+    /**
+     * \brief Returns the bandwidth of the gradient matrices built for a spline.
+     *
+     * Forces are built either from a single point on the spline or from
+     * two points at neighbouring control points, as in
+     * XSpline::junctionPointsAttractionForce().  Either way they couple
+     * control points at most FittableSpline::linearCombinationSpan() + 1
+     * apart.  Forces passed to addExternalForce() and addInternalForce()
+     * must respect that.
+     */
+    static size_t gradientBandwidth(FittableSpline const& spline);
+
     void addAttractionForce(Vec2d const& spline_point,
                             std::vector<FittableSpline::LinearCoefficient> const& coeffs,
                             SqDistApproximant const& sqdist_approx);
@@ -0,0 +1,338 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Optimizer.h"
+#include "SplineFitter.h"
+#include "XSpline.h"
+#include "BandedLdlt.h"
+#include "MatrixCalc.h"
+#include "QuadraticFunction.h"
+#include "LinearFunction.h"
+#include "MatT.h"
+#include "VecT.h"
+#ifndef Q_MOC_RUN
+#include <boost/test/unit_test.hpp>
+#include <boost/test/tools/floating_point_comparison.hpp>
+#endif
+#include <QPointF>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+#include <math.h>
+
+namespace spfit
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(OptimizerTestSuite);
+
+static double frand(double from, double to)
+{
+    double const rand_0_1 = rand() / double(RAND_MAX);
+    return from + (to - from) * rand_0_1;
+}
+
+/**
+ * A random symmetric, diagonally dominant band matrix.
+ */
+static MatT<double> randomBandMatrix(size_t n, size_t bandwidth)
+{
+    MatT<double> A(n, n);
+    for (size_t j = 0; j < n; ++j) {
+        for (size_t i = j + 1; i < n && i <= j + bandwidth; ++i) {
+            A(i, j) = A(j, i) = frand(-1, 1);
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        A(i, i) = frand(2 * bandwidth + 1, 4 * bandwidth + 1);
+    }
+    return A;
+}
+
+/**
+ * Adds (x[i] - x[j])^2 * weight.
+ */
+static void addSpring(QuadraticFunction& f, int i, int j, double weight)
+{
+    f.A(i, i) += weight;
+    f.A(j, j) += weight;
+    f.A(i, j) -= weight;
+    f.A(j, i) -= weight;
+}
+
+/**
+ * Adds (x[i] - target)^2.
+ */
+static void addAttraction(QuadraticFunction& f, int i, double target)
+{
+    f.A(i, i) += 1.0;
+    f.b[i] -= 2.0 * target;
+    f.c += target * target;
+}
+
+/**
+ * Solves the system Optimizer::optimize() solves, with a dense solver.
+ */
+static std::vector<double> denseSolution(
+    QuadraticFunction const& internal, QuadraticFunction const& external,
+    double internal_weight, std::list<LinearFunction> const& constraints)
+{
+    QuadraticFunction total(internal);
+    total *= internal_weight;
+    total += external;
+    QuadraticFunction::Gradient const grad(total.gradient());
+
+    size_t const num_vars = total.numVars();
+    size_t const num_dims = num_vars + constraints.size();
+    MatT<double> A(num_dims, num_dims);
+    VecT<double> b(num_dims);
+    for (size_t i = 0; i < num_vars; ++i) {
+        b[i] = -grad.b[i];
+        for (size_t j = 0; j < num_vars; ++j) {
+            A(i, j) = grad.A(i, j);
+        }
+    }
+    size_t row = num_vars;
+    for (LinearFunction const& constraint : constraints) {
+        b[row] = -constraint.b;
+        for (size_t j = 0; j < num_vars; ++j) {
+            A(row, j) = A(j, row) = constraint.a[j];
+        }
+        ++row;
+    }
+
+    std::vector<double> x(num_dims);
+    DynamicMatrixCalc<double> mc;
+    mc(A).solve(mc(b)).write(x.data());
+    x.resize(num_vars);
+    return x;
+}
+
+/**
+ * Runs a few iterations of an Optimizer with the given bandwidth,
+ * checking each one against the dense solution.  The forces are
+ * scaled differently on each iteration, and the constraints are
+ * adjusted the way Optimizer adjusts them.
+ */
+static void checkOptimizer(
+    QuadraticFunction const& internal, QuadraticFunction const& external,
+    std::list<LinearFunction> constraints, size_t bandwidth)
+{
+    Optimizer optimizer(internal.numVars(), bandwidth);
+    optimizer.setConstraints(constraints);
+
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        double const internal_weight = 0.5 * (iteration + 1);
+        std::vector<double> const expected(
+            denseSolution(internal, external, internal_weight, constraints)
+        );
+
+        optimizer.addInternalForce(internal);
+        optimizer.addExternalForce(external);
+        optimizer.optimize(internal_weight);
+
+        // LinearSolver treats values below sqrt(epsilon) as zeros,
+        // so the dense solution is only that accurate.
+        double const* x = optimizer.displacementVector();
+        for (size_t i = 0; i < expected.size(); ++i) {
+            BOOST_CHECK_SMALL(x[i] - expected[i], 1e-6);
+        }
+
+        for (LinearFunction& constraint : constraints) {
+            for (size_t i = 0; i < expected.size(); ++i) {
+                constraint.b += constraint.a[i] * x[i];
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_banded_ldlt_matches_dense)
+{
+    size_t const sizes[] = { 1, 2, 7, 40 };
+    size_t const bandwidths[] = { 0, 1, 3, 8 };
+
+    BandedLdlt ldlt;
+    for (size_t const n : sizes) {
+        for (size_t const bandwidth : bandwidths) {
+            MatT<double> const A(randomBandMatrix(n, bandwidth));
+            VecT<double> b(n);
+            for (size_t i = 0; i < n; ++i) {
+                b[i] = frand(-10, 10);
+            }
+
+            std::vector<double> expected(n);
+            DynamicMatrixCalc<double> mc;
+            mc(A).solve(mc(b)).write(expected.data());
+
+            BOOST_REQUIRE(ldlt.factorize(A, bandwidth));
+            std::vector<double> x(b.data(), b.data() + n);
+            ldlt.solve(x.data());
+
+            for (size_t i = 0; i < n; ++i) {
+                BOOST_CHECK_SMALL(x[i] - expected[i], 1e-10);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_banded_ldlt_rejects_indefinite)
+{
+    MatT<double> A(randomBandMatrix(10, 2));
+    A(4, 4) = -A(4, 4);
+
+    BandedLdlt ldlt;
+    BOOST_CHECK(!ldlt.factorize(A, 2));
+}
+
+BOOST_AUTO_TEST_CASE(test_optimizer_matches_dense)
+{
+    // A chain of points with springs between neighbors, like the
+    // internal forces of a spline, pulled towards random targets.
+    size_t const num_vars = 40;
+    QuadraticFunction internal(num_vars);
+    QuadraticFunction external(num_vars);
+    for (size_t i = 0; i + 2 < num_vars; ++i) {
+        addSpring(internal, i, i + 2, frand(0.5, 2.0));
+    }
+    for (size_t i = 0; i < num_vars; ++i) {
+        addAttraction(external, i, frand(-10, 10));
+    }
+
+    // Without constraints.
+    checkOptimizer(internal, external, std::list<LinearFunction>(), 2);
+
+    // A constraint on a single variable and one involving all of them.
+    std::list<LinearFunction> constraints;
+    constraints.push_back(LinearFunction(num_vars));
+    constraints.back().a[0] = 1.0;
+    constraints.back().b = -3.0;
+    constraints.push_back(LinearFunction(num_vars));
+    for (size_t i = 0; i < num_vars; ++i) {
+        constraints.back().a[i] = frand(-1, 1);
+    }
+    constraints.back().b = frand(-5, 5);
+    checkOptimizer(internal, external, constraints, 2);
+
+    // A band wider than necessary, and one covering the whole matrix.
+    checkOptimizer(internal, external, constraints, 5);
+    checkOptimizer(internal, external, constraints, num_vars - 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_optimizer_singular_gradient)
+{
+    // Variable 0 is only determined by a constraint, which makes
+    // the gradient matrix singular.  The dense path has to handle it.
+    size_t const num_vars = 30;
+    QuadraticFunction internal(num_vars);
+    QuadraticFunction external(num_vars);
+    for (size_t i = 1; i + 1 < num_vars; ++i) {
+        addSpring(internal, i, i + 1, 1.0);
+    }
+    for (size_t i = 1; i < num_vars; ++i) {
+        addAttraction(external, i, frand(-10, 10));
+    }
+
+    std::list<LinearFunction> constraints;
+    constraints.push_back(LinearFunction(num_vars));
+    constraints.back().a[0] = 1.0;
+    constraints.back().b = -2.0;
+    checkOptimizer(internal, external, constraints, 1);
+}
+
+static XSpline randomSpline(int num_control_points)
+{
+    XSpline spline;
+    for (int i = 0; i < num_control_points; ++i) {
+        spline.appendControlPoint(QPointF(i * 50 + frand(-10, 10), frand(-20, 20)), frand(0, 1));
+    }
+    return spline;
+}
+
+BOOST_AUTO_TEST_CASE(test_spline_forces_fit_in_band)
+{
+    for (int num_control_points = 2; num_control_points <= 12; ++num_control_points) {
+        XSpline const spline(randomSpline(num_control_points));
+        size_t const bandwidth = SplineFitter::gradientBandwidth(spline);
+
+        QuadraticFunction const forces[] = {
+            spline.junctionPointsAttractionForce(),
+            spline.controlPointsAttractionForce()
+        };
+        for (QuadraticFunction const& force : forces) {
+            size_t const num_vars = force.numVars();
+
+            // Automatic differentiation leaves rounding noise
+            // where there should be zeros.
+            double max_abs = 0.0;
+            for (size_t i = 0; i < num_vars; ++i) {
+                for (size_t j = 0; j < num_vars; ++j) {
+                    max_abs = std::max(max_abs, fabs(force.A(i, j)));
+                }
+            }
+            double const noise = max_abs * num_vars * std::numeric_limits<double>::epsilon();
+
+            for (size_t i = 0; i < num_vars; ++i) {
+                for (size_t j = i + bandwidth + 1; j < num_vars; ++j) {
+                    BOOST_CHECK_SMALL(force.A(i, j), noise);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_optimizer_matches_dense_on_spline_forces)
+{
+    // The forces DistortionModelBuilder::fitExtendedSpline() uses,
+    // with its 5 control points and with a longer spline.
+    int const sizes[] = { 5, 12 };
+    for (int const num_control_points : sizes) {
+        XSpline const spline(randomSpline(num_control_points));
+        size_t const num_vars = num_control_points * 2;
+
+        QuadraticFunction internal(spline.junctionPointsAttractionForce());
+        internal += spline.controlPointsAttractionForce();
+
+        QuadraticFunction external(num_vars);
+        for (size_t i = 0; i < num_vars; ++i) {
+            addAttraction(external, i, frand(-10, 10));
+        }
+
+        // Pin both ends to lines, the way spline endpoints are constrained.
+        std::list<LinearFunction> constraints;
+        constraints.push_back(LinearFunction(num_vars));
+        constraints.back().a[0] = 1.0;
+        constraints.back().a[1] = 0.5;
+        constraints.back().b = frand(-5, 5);
+        constraints.push_back(LinearFunction(num_vars));
+        constraints.back().a[num_vars - 2] = 0.5;
+        constraints.back().a[num_vars - 1] = 1.0;
+        constraints.back().b = frand(-5, 5);
+
+        checkOptimizer(internal, external, constraints, SplineFitter::gradientBandwidth(spline));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace spfit